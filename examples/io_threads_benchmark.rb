@@ -0,0 +1,63 @@
+# Measures KV throughput for different values of "num_io_threads" connection string option.
+#
+#   ruby -Ilib examples/io_threads_benchmark.rb [connection_string] [bucket]
+#
+# Every Ruby thread keeps WINDOW operations in flight using pending results, so the client side of the
+# connection (IO, encoding and decoding of the packets) becomes the bottleneck.
+
+require 'couchbase'
+include Couchbase
+
+connection_string = ARGV[0] || "couchbase://localhost"
+bucket_name = ARGV[1] || "default"
+username = ENV.fetch("CB_USERNAME", "Administrator")
+password = ENV.fetch("CB_PASSWORD", "password")
+
+DURATION = Integer(ENV.fetch("DURATION", 10))
+RUBY_THREADS = Integer(ENV.fetch("RUBY_THREADS", 4))
+WINDOW = Integer(ENV.fetch("WINDOW", 64))
+NUM_KEYS = Integer(ENV.fetch("NUM_KEYS", 10_000))
+IO_THREADS = ENV.fetch("IO_THREADS", "1,2,4,8").split(",").map { |n| Integer(n) }
+
+content = JSON.generate("value" => "x" * 256)
+keys = Array.new(NUM_KEYS) { |i| "io_threads_benchmark_#{i}" }
+
+def connect(connection_string, username, password, num_io_threads)
+  separator = connection_string.include?("?") ? "&" : "?"
+  backend = Backend.new
+  backend.open("#{connection_string}#{separator}num_io_threads=#{num_io_threads}", username, password, {})
+  backend
+end
+
+results = IO_THREADS.map do |num_io_threads|
+  backend = connect(connection_string, username, password, num_io_threads)
+  backend.open_bucket(bucket_name, true)
+  keys.each_slice(WINDOW) do |slice|
+    slice.map { |key| backend.document_upsert_async(bucket_name, "_default._default", key, nil, content, 0, nil) }.each(&:wait)
+  end
+
+  deadline = Process.clock_gettime(Process::CLOCK_MONOTONIC) + DURATION
+  workers = Array.new(RUBY_THREADS) do
+    Thread.new do
+      count = 0
+      while Process.clock_gettime(Process::CLOCK_MONOTONIC) < deadline
+        Array.new(WINDOW) do
+          backend.document_get_async(bucket_name, "_default._default", keys.sample, nil)
+        end.each(&:wait)
+        count += WINDOW
+      end
+      count
+    end
+  end
+  total = workers.map(&:value).sum
+  backend.close
+
+  ops_per_second = total / DURATION.to_f
+  printf("num_io_threads=%-3d %12.0f ops/s\n", num_io_threads, ops_per_second)
+  [num_io_threads, ops_per_second]
+end
+
+baseline = results.first[1]
+results.each do |num_io_threads, ops_per_second|
+  printf("num_io_threads=%-3d speedup x%.2f\n", num_io_threads, ops_per_second / baseline)
+end
@@ -0,0 +1,56 @@
+# Measures Ruby objects allocated per get and upsert, when results are returned as Hashes (default) and as structs
+# ("lightweight_results" option of the backend).
+#
+#   ruby -Ilib examples/lightweight_results_benchmark.rb [connection_string] [bucket]
+#
+# Keys and the document are allocated upfront, so the difference between the modes is the result objects (the result
+# itself, CAS, content, mutation token). The counters come from GC.stat(:total_allocated_objects), which is process-wide,
+# so nothing else should run in the process.
+
+require 'objspace'
+require 'couchbase'
+include Couchbase
+
+connection_string = ARGV[0] || "couchbase://localhost"
+bucket_name = ARGV[1] || "default"
+username = ENV.fetch("CB_USERNAME", "Administrator")
+password = ENV.fetch("CB_PASSWORD", "password")
+
+OPERATIONS = Integer(ENV.fetch("OPERATIONS", 10_000))
+NUM_KEYS = Integer(ENV.fetch("NUM_KEYS", 1_000))
+
+content = JSON.generate("value" => "x" * 256).freeze
+keys = Array.new(NUM_KEYS) { |i| "lightweight_results_benchmark_#{i}".freeze }
+collection = "_default._default".freeze
+
+def allocations_per_op(operations)
+  GC.start
+  before = GC.stat(:total_allocated_objects)
+  operations.times { |i| yield i }
+  (GC.stat(:total_allocated_objects) - before) / operations.to_f
+end
+
+results = [false, true].map do |lightweight_results|
+  backend = Backend.new
+  backend.open(connection_string, username, password, {lightweight_results: lightweight_results})
+  backend.open_bucket(bucket_name, true)
+  keys.each { |key| backend.document_upsert(bucket_name, collection, key, nil, content, 0, nil) }
+
+  upsert = allocations_per_op(OPERATIONS) do |i|
+    backend.document_upsert(bucket_name, collection, keys[i % NUM_KEYS], nil, content, 0, nil)
+  end
+  get = allocations_per_op(OPERATIONS) do |i|
+    backend.document_get(bucket_name, collection, keys[i % NUM_KEYS], nil)
+  end
+  upsert_size = ObjectSpace.memsize_of(backend.document_upsert(bucket_name, collection, keys[0], nil, content, 0, nil))
+  get_size = ObjectSpace.memsize_of(backend.document_get(bucket_name, collection, keys[0], nil))
+  backend.close
+
+  mode = lightweight_results ? "struct" : "hash"
+  printf("%-6s get: %6.2f objects/op, result %4d bytes   upsert: %6.2f objects/op, result %4d bytes\n",
+         mode, get, get_size, upsert, upsert_size)
+  [mode, get, upsert]
+end
+
+(_, hash_get, hash_upsert), (_, struct_get, struct_upsert) = results
+printf("struct saves %.2f objects per get and %.2f objects per upsert\n", hash_get - struct_get, hash_upsert - struct_upsert)
@@ -0,0 +1,189 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <tao/json.hpp>
+
+#include <build_version.hxx>
+
+namespace couchbase::benchmarks
+{
+
+/**
+ * Process-wide counters of the global operator new, maintained by allocation_counter.cxx, which has to be linked into the benchmark.
+ */
+struct allocation_counters {
+    std::atomic<std::uint64_t> allocations{ 0 };
+    std::atomic<std::uint64_t> bytes{ 0 };
+};
+
+allocation_counters&
+allocation_stats();
+
+/**
+ * Describes what single call of the benchmarked function does, so that the results are reported per logical operation (e.g. per
+ * parsed frame, when one call parses the whole stream of frames).
+ */
+struct workload {
+    std::size_t operations_per_call{ 1 };
+    std::size_t bytes_per_call{ 0 };
+};
+
+struct result {
+    std::string name;
+    std::uint64_t operations{};
+    double ns_per_op{};
+    double allocated_bytes_per_op{};
+    double allocations_per_op{};
+    double mb_per_second{};
+};
+
+/**
+ * Runs the benchmarks and reports ns/op, allocated bytes/op and allocations/op (and throughput, for workloads with known size).
+ *
+ *   <benchmark> [--filter=SUBSTRING] [--min-time=SECONDS] [--format=text|json]
+ *
+ * JSON output contains the build context (git revision, compiler, platform), so that the results could be tracked across releases.
+ */
+class runner
+{
+  public:
+    runner(int argc, char** argv)
+    {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg(argv[i]);
+            if (arg.rfind("--filter=", 0) == 0) {
+                filter_ = arg.substr(9);
+            } else if (arg.rfind("--min-time=", 0) == 0) {
+                min_time_ = std::chrono::duration<double>(std::strtod(arg.c_str() + 11, nullptr));
+            } else if (arg == "--format=json") {
+                json_ = true;
+            } else if (arg == "--format=text") {
+                json_ = false;
+            } else {
+                std::fprintf(stderr, "usage: %s [--filter=SUBSTRING] [--min-time=SECONDS] [--format=text|json]\n", argv[0]);
+                std::exit(EXIT_FAILURE);
+            }
+        }
+        if (!json_) {
+            std::printf("%-48s %12s %12s %12s %12s %10s\n", "name", "operations", "ns/op", "bytes/op", "allocs/op", "MB/s");
+        }
+    }
+
+    /**
+     * Measures the function, which has signature std::size_t(), and returns a checksum to keep the optimizer from removing the work.
+     *
+     * The number of calls is doubled until the batch runs for at least --min-time, the allocations are counted for the last batch.
+     */
+    template<typename Function>
+    void run(const std::string& name, workload load, Function&& function)
+    {
+        if (!filter_.empty() && name.find(filter_) == std::string::npos) {
+            return;
+        }
+        checksum_ += function(); // warm up caches and lazily initialized state
+
+        std::uint64_t calls = 1;
+        while (true) {
+            auto allocations_before = allocation_stats().allocations.load(std::memory_order_relaxed);
+            auto bytes_before = allocation_stats().bytes.load(std::memory_order_relaxed);
+            auto start = std::chrono::steady_clock::now();
+            for (std::uint64_t i = 0; i < calls; ++i) {
+                checksum_ += function();
+            }
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            if (elapsed < min_time_ && calls < (std::uint64_t{ 1 } << 40U)) {
+                double scale = elapsed.count() > 0 ? min_time_.count() / elapsed.count() * 1.2 : 10;
+                calls = static_cast<std::uint64_t>(static_cast<double>(calls) * std::clamp(scale, 2.0, 10.0));
+                continue;
+            }
+            auto operations = static_cast<double>(calls * load.operations_per_call);
+            result entry{ name, calls * load.operations_per_call };
+            entry.ns_per_op = std::chrono::duration<double, std::nano>(elapsed).count() / operations;
+            entry.allocations_per_op =
+              static_cast<double>(allocation_stats().allocations.load(std::memory_order_relaxed) - allocations_before) / operations;
+            entry.allocated_bytes_per_op =
+              static_cast<double>(allocation_stats().bytes.load(std::memory_order_relaxed) - bytes_before) / operations;
+            if (load.bytes_per_call > 0) {
+                entry.mb_per_second = static_cast<double>(calls * load.bytes_per_call) / elapsed.count() / (1024.0 * 1024.0);
+            }
+            if (!json_) {
+                std::printf("%-48s %12llu %12.1f %12.1f %12.2f %10.1f\n",
+                            entry.name.c_str(),
+                            static_cast<unsigned long long>(entry.operations),
+                            entry.ns_per_op,
+                            entry.allocated_bytes_per_op,
+                            entry.allocations_per_op,
+                            entry.mb_per_second);
+                std::fflush(stdout);
+            }
+            results_.emplace_back(std::move(entry));
+            return;
+        }
+    }
+
+    int finish()
+    {
+        if (json_) {
+            tao::json::value benchmarks = tao::json::empty_array;
+            for (const auto& entry : results_) {
+                benchmarks.get_array().emplace_back(tao::json::value{
+                  { "name", entry.name },
+                  { "operations", entry.operations },
+                  { "ns_per_op", entry.ns_per_op },
+                  { "bytes_per_op", entry.allocated_bytes_per_op },
+                  { "allocations_per_op", entry.allocations_per_op },
+                  { "mb_per_second", entry.mb_per_second },
+                });
+            }
+            tao::json::value report{
+                { "context",
+                  {
+                    { "revision", BACKEND_GIT_REVISION },
+                    { "build_timestamp", BACKEND_BUILD_TIMESTAMP },
+                    { "compiler", BACKEND_CXX_COMPILER },
+                    { "system", BACKEND_SYSTEM },
+                    { "processor", BACKEND_SYSTEM_PROCESSOR },
+                    { "min_time", min_time_.count() },
+                  } },
+                { "benchmarks", benchmarks },
+            };
+            std::printf("%s\n", tao::json::to_string(report, 2).c_str());
+        }
+        std::fprintf(stderr, "checksum %zu\n", checksum_);
+        return EXIT_SUCCESS;
+    }
+
+  private:
+    std::string filter_{};
+    std::chrono::duration<double> min_time_{ 0.5 };
+    bool json_{ false };
+    std::size_t checksum_{ 0 };
+    std::vector<result> results_{};
+};
+
+} // namespace couchbase::benchmarks
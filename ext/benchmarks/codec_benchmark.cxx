@@ -0,0 +1,358 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <asio.hpp>
+#include <snappy.h>
+#include <spdlog/spdlog.h>
+#include <zlib.h>
+
+#include <configuration.hxx>
+#include <io/buffer_pool.hxx>
+#include <io/http_parser.hxx>
+#include <io/mcbp_message.hxx>
+#include <io/mcbp_parser.hxx>
+#include <operations/document_query.hxx>
+#include <protocol/client_request.hxx>
+#include <protocol/cmd_get_cluster_config.hxx>
+#include <protocol/cmd_upsert.hxx>
+
+#include "benchmark.hxx"
+
+/**
+ * Microbenchmarks of the wire codecs, which are on the hot path of every operation.
+ *
+ *   codec_benchmark [--filter=SUBSTRING] [--min-time=SECONDS] [--format=text|json]
+ */
+
+namespace
+{
+using couchbase::benchmarks::runner;
+using couchbase::benchmarks::workload;
+
+/**
+ * JSON document of the given size, which compresses roughly as well as the typical application documents.
+ */
+std::string
+make_document(std::size_t size)
+{
+    std::string doc = R"({"type":"order","items":[)";
+    for (std::size_t i = 0; doc.size() + 64 < size; ++i) {
+        doc += fmt::format(R"({{"sku":"item-{}","quantity":{},"price":{}.99}},)", i, i % 7 + 1, i % 100);
+    }
+    doc.back() = ']';
+    doc.resize(std::max(doc.size(), size - 1), ' ');
+    doc += '}';
+    return doc;
+}
+
+/**
+ * Stream of GET responses as the server would send them, optionally with snappy-compressed values.
+ */
+std::vector<std::uint8_t>
+make_mcbp_stream(std::size_t number_of_frames, std::size_t value_size, bool compressed)
+{
+    std::string value = make_document(value_size);
+    if (compressed) {
+        std::string compressed_value;
+        snappy::Compress(value.data(), value.size(), &compressed_value);
+        value = std::move(compressed_value);
+    }
+    std::vector<std::uint8_t> stream;
+    stream.reserve(number_of_frames * (couchbase::protocol::header_size + 4 + value.size()));
+    for (std::size_t i = 0; i < number_of_frames; ++i) {
+        couchbase::io::binary_header header{};
+        header.magic = static_cast<std::uint8_t>(couchbase::protocol::magic::client_response);
+        header.opcode = static_cast<std::uint8_t>(couchbase::protocol::client_opcode::get);
+        header.extlen = 4;
+        header.datatype = static_cast<std::uint8_t>(couchbase::protocol::datatype::json);
+        if (compressed) {
+            header.datatype |= static_cast<std::uint8_t>(couchbase::protocol::datatype::snappy);
+        }
+        header.bodylen = htonl(static_cast<std::uint32_t>(4 + value.size()));
+        header.opaque = static_cast<std::uint32_t>(i);
+        header.cas = i + 1;
+        const auto* header_bytes = reinterpret_cast<const std::uint8_t*>(&header);
+        stream.insert(stream.end(), header_bytes, header_bytes + sizeof(header));
+        stream.insert(stream.end(), { 0, 0, 0, 0 }); // flags
+        stream.insert(stream.end(), value.begin(), value.end());
+    }
+    return stream;
+}
+
+/**
+ * Feeds the stream through prepare()/commit() in socket-sized reads, and parses all frames as the session does.
+ */
+std::size_t
+parse_mcbp_stream(couchbase::io::mcbp_parser& parser, const std::vector<std::uint8_t>& stream)
+{
+    constexpr std::size_t socket_read_size = 16 * 1024;
+    std::size_t checksum = 0;
+    std::size_t offset = 0;
+    couchbase::io::mcbp_message msg{};
+    while (offset < stream.size()) {
+        auto buffer = parser.prepare();
+        std::size_t bytes = std::min({ buffer.size(), socket_read_size, stream.size() - offset });
+        std::memcpy(buffer.data(), stream.data() + offset, bytes);
+        parser.commit(bytes);
+        offset += bytes;
+        while (parser.next(msg) == couchbase::io::mcbp_parser::result::ok) {
+            checksum += msg.body.size();
+        }
+    }
+    return checksum;
+}
+
+/**
+ * Cluster configuration, as returned by the server for the bucket with the given number of nodes.
+ */
+std::string
+make_configuration(std::size_t number_of_nodes, std::size_t number_of_partitions)
+{
+    tao::json::value nodes = tao::json::empty_array;
+    tao::json::value server_list = tao::json::empty_array;
+    for (std::size_t i = 0; i < number_of_nodes; ++i) {
+        std::string hostname = fmt::format("node{}.cluster.example.com", i);
+        nodes.get_array().emplace_back(tao::json::value{
+          { "hostname", hostname },
+          { "services",
+            {
+              { "kv", 11210 },
+              { "kvSSL", 11207 },
+              { "mgmt", 8091 },
+              { "mgmtSSL", 18091 },
+              { "capi", 8092 },
+              { "capiSSL", 18092 },
+              { "n1ql", 8093 },
+              { "n1qlSSL", 18093 },
+            } },
+        });
+        server_list.get_array().emplace_back(hostname + ":11210");
+    }
+    tao::json::value vbucket_map = tao::json::empty_array;
+    for (std::size_t p = 0; p < number_of_partitions; ++p) {
+        vbucket_map.get_array().emplace_back(tao::json::value::array({ p % number_of_nodes, (p + 1) % number_of_nodes }));
+    }
+    tao::json::value config{
+        { "rev", 1024 },
+        { "name", "travel-sample" },
+        { "uuid", "8e3b8c0d6d7a4f0a9b8d2e4c2f6a1b3c" },
+        { "nodeLocator", "vbucket" },
+        { "nodesExt", nodes },
+        { "clusterCapabilities", { { "n1ql", tao::json::value::array({ "enhancedPreparedStatements" }) } } },
+        { "vBucketServerMap",
+          {
+            { "hashAlgorithm", "CRC" },
+            { "numReplicas", 1 },
+            { "serverList", server_list },
+            { "vBucketMap", vbucket_map },
+          } },
+    };
+    return tao::json::to_string(config);
+}
+
+std::string
+gzip_compress(const std::string& data)
+{
+    z_stream stream{};
+    deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+    std::string result(deflateBound(&stream, data.size()), '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream.avail_in = static_cast<uInt>(data.size());
+    stream.next_out = reinterpret_cast<Bytef*>(result.data());
+    stream.avail_out = static_cast<uInt>(result.size());
+    deflate(&stream, Z_FINISH);
+    result.resize(stream.total_out);
+    deflateEnd(&stream);
+    return result;
+}
+
+std::string
+make_http_response(const std::string& payload, bool chunked, bool gzipped = false)
+{
+    std::string response = "HTTP/1.1 200 OK\r\n"
+                           "Content-Type: application/json\r\n"
+                           "X-Request-Id: 7c1f4d2e\r\n"
+                           "Connection: keep-alive\r\n";
+    std::string body = payload;
+    if (gzipped) {
+        response += "Content-Encoding: gzip\r\n";
+        body = gzip_compress(payload);
+    }
+    if (!chunked) {
+        return response + fmt::format("Content-Length: {}\r\n\r\n", body.size()) + body;
+    }
+    response += "Transfer-Encoding: chunked\r\n\r\n";
+    constexpr std::size_t chunk_size = 8 * 1024;
+    for (std::size_t offset = 0; offset < body.size(); offset += chunk_size) {
+        std::size_t size = std::min(chunk_size, body.size() - offset);
+        response += fmt::format("{:x}\r\n", size);
+        response.append(body, offset, size);
+        response += "\r\n";
+    }
+    return response + "0\r\n\r\n";
+}
+
+std::string
+make_query_response(std::size_t number_of_rows)
+{
+    std::string body = R"({"requestID":"f5e5a4a0-5b8e-4b1b-9a6f-2c3d4e5f6a7b","clientContextID":"benchmark",)"
+                       R"("signature":{"*":"*"},"results":[)";
+    for (std::size_t i = 0; i < number_of_rows; ++i) {
+        if (i > 0) {
+            body += ',';
+        }
+        body += fmt::format(
+          R"({{"id":{},"name":"airline-{}","country":"United States","callsign":"CS{}","iata":"A{}"}})", i, i, i, i % 100);
+    }
+    body += fmt::format(R"(],"status":"success","metrics":{{"elapsedTime":"12.3ms","executionTime":"12.1ms","resultCount":{},)"
+                        R"("resultSize":{}}}}})",
+                        number_of_rows,
+                        body.size());
+    return body;
+}
+} // namespace
+
+int
+main(int argc, char** argv)
+{
+    spdlog::set_level(spdlog::level::off);
+    runner bench(argc, argv);
+
+    struct stream_case {
+        const char* name;
+        std::size_t frames;
+        std::size_t value_size;
+    };
+    for (const auto& [name, frames, value_size] : { stream_case{ "small", 4096, 128 }, stream_case{ "big", 8, 1024 * 1024 } }) {
+        for (bool compressed : { false, true }) {
+            auto stream = make_mcbp_stream(frames, value_size, compressed);
+            couchbase::io::mcbp_parser parser;
+            bench.run(fmt::format("mcbp_parser/next/{}/{}x{}", compressed ? "snappy" : "plain", frames, value_size),
+                      workload{ frames, stream.size() },
+                      [&]() { return parse_mcbp_stream(parser, stream); });
+        }
+    }
+
+    for (std::size_t value_size : { 256U, 16U * 1024, 256U * 1024 }) {
+        std::string value = make_document(value_size);
+        couchbase::document_id id{ "travel-sample", "_default._default", "order::000000000042", 8 };
+        for (bool compress : { false, true }) {
+            bench.run(fmt::format("client_request/data/upsert/{}/{}", compress ? "snappy" : "plain", value_size),
+                      workload{ 1, value.size() },
+                      [&]() {
+                          couchbase::protocol::client_request<couchbase::protocol::upsert_request_body> request;
+                          request.opaque(42);
+                          request.partition(115);
+                          request.body().id(id);
+                          request.body().content(value);
+                          request.body().flags(0x02000006);
+                          return request.data(compress).size();
+                      });
+        }
+        // the way sessions encode requests: the frame storage comes from the pool and goes back after the socket write
+        couchbase::io::buffer_pool pool;
+        bench.run(fmt::format("client_request/data/upsert/pooled/{}", value_size), workload{ 1, value.size() }, [&]() {
+            couchbase::protocol::client_request<couchbase::protocol::upsert_request_body> request;
+            request.opaque(42);
+            request.partition(115);
+            request.body().id(id);
+            request.body().content(value);
+            request.body().flags(0x02000006);
+            request.payload_storage(pool.acquire());
+            std::size_t size = request.data().size();
+            pool.release(std::move(request.data()));
+            return size;
+        });
+    }
+
+    {
+        couchbase::configuration config = tao::json::from_string<couchbase::protocol::deduplicate_keys>(make_configuration(4, 1024))
+                                            .as<couchbase::configuration>();
+        std::vector<std::string> keys;
+        for (std::size_t i = 0; i < 1024; ++i) {
+            keys.emplace_back(fmt::format("order::{:012}", i));
+        }
+        bench.run("utils/hash_crc32/19B", workload{ keys.size(), keys.size() * keys[0].size() }, [&]() {
+            std::size_t checksum = 0;
+            for (const auto& key : keys) {
+                checksum += couchbase::utils::hash_crc32(key.data(), key.size());
+            }
+            return checksum;
+        });
+        bench.run("configuration/map_key/19B", workload{ keys.size(), keys.size() * keys[0].size() }, [&]() {
+            std::size_t checksum = 0;
+            for (const auto& key : keys) {
+                auto [partition, index] = config.map_key(key);
+                checksum += partition + index;
+            }
+            return checksum;
+        });
+    }
+
+    for (std::size_t nodes : { 1U, 4U, 16U }) {
+        std::string text = make_configuration(nodes, 1024);
+        bench.run(fmt::format("traits<configuration>/as/{}-nodes", nodes), workload{ 1, text.size() }, [&]() {
+            auto config = tao::json::from_string<couchbase::protocol::deduplicate_keys>(text).as<couchbase::configuration>();
+            return config.nodes.size() + config.vbmap->size();
+        });
+    }
+
+    std::string query_body = make_query_response(1000);
+    for (bool gzipped : { false, true }) {
+        for (bool chunked : { false, true }) {
+            std::string wire = make_http_response(query_body, chunked, gzipped);
+            couchbase::io::http_parser parser;
+            auto framing = fmt::format("{}{}", gzipped ? "gzip-" : "", chunked ? "chunked" : "content-length");
+            // throughput is reported for the decoded body, so that compressed and plain responses could be compared
+            bench.run(fmt::format("http_parser/feed/{}/{}B", framing, query_body.size()), workload{ 1, query_body.size() }, [&]() {
+                constexpr std::size_t socket_read_size = 16 * 1024;
+                parser.reset();
+                for (std::size_t offset = 0; offset < wire.size(); offset += socket_read_size) {
+                    parser.feed(wire.data() + offset, std::min(socket_read_size, wire.size() - offset));
+                }
+                return parser.response.body.size() + (parser.complete ? 1 : 0);
+            });
+        }
+    }
+
+    for (std::size_t rows : { 1U, 100U, 1000U }) {
+        std::string body = make_query_response(rows);
+        couchbase::operations::query_request request{};
+        request.client_context_id = "benchmark";
+        bench.run(fmt::format("document_query/make_response/{}-rows", rows), workload{ rows, body.size() }, [&]() {
+            couchbase::io::http_response encoded{ 200, "OK", {}, body };
+            auto response = couchbase::operations::make_response({}, request, std::move(encoded));
+            return response.payload.rows.size();
+        });
+        bench.run(fmt::format("document_query/streaming_lexer/{}-rows", rows), workload{ rows, body.size() }, [&]() {
+            couchbase::utils::json_streaming_lexer lexer("results");
+            std::string meta;
+            std::size_t checksum = 0;
+            lexer.feed(body, meta, [&checksum](std::string&& row) {
+                checksum += row.size();
+                return true;
+            });
+            return checksum + meta.size();
+        });
+    }
+
+    return bench.finish();
+}
@@ -0,0 +1,535 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <build_config.hxx>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include <build_version.hxx>
+#include <cluster.hxx>
+#include <operations.hxx>
+#include <utils/connection_string.hxx>
+
+#include <mock/mock_cluster.hxx>
+
+/*
+ * End-to-end load generator: drives couchbase::cluster with KV operations or queries and reports throughput, errors and latency
+ * percentiles. Without --connection-string it starts in-process mock cluster (see test/mock/mock_cluster.hxx), so that the whole
+ * client (pipelining, backpressure, retries) could be measured without network and server.
+ *
+ *   load_generator [--nodes=N] [--duration=SECONDS] [--concurrency=N | --rate=OPS_PER_SECOND]
+ *                  [--operation=get|upsert|mixed|query|bootstrap] [--value-size=BYTES] [--keys=N]
+ *                  [--kv-latency-us=US] [--nmvb=RATIO] [--tmpfail=RATIO] [--slow-node=INDEX:US]
+ *                  [--connection-string=STRING --username=NAME --password=SECRET --bucket=NAME] [--format=text|json]
+ *
+ * With --concurrency (default) every worker sends the next request as soon as the previous has completed (closed loop). With --rate
+ * the requests are scheduled at fixed rate regardless of completions (open loop), and the latency is measured from the scheduled
+ * time, so that the queueing inside the client is not hidden when it cannot keep up.
+ *
+ * --operation=bootstrap measures the startup instead: it repeatedly opens new cluster and the bucket (connecting all nodes from the
+ * seed configuration) and closes it, the latencies are the times to the usable bucket. Other operations report it as "startup_us".
+ */
+
+namespace couchbase::benchmarks
+{
+enum class operation_kind { get, upsert, mixed, query, bootstrap };
+
+struct load_options {
+    std::size_t nodes{ 1 };
+    std::chrono::duration<double> duration{ 10 };
+    std::size_t concurrency{ 16 };
+    double rate{ 0 };
+    operation_kind operation{ operation_kind::get };
+    std::size_t value_size{ 256 };
+    std::size_t keys{ 10'000 };
+    std::chrono::microseconds kv_latency{ 0 };
+    mock::fault_profile faults{};
+    std::optional<std::pair<std::size_t, std::chrono::microseconds>> slow_node{};
+    std::string connection_string{};
+    std::string username{ "Administrator" };
+    std::string password{ "password" };
+    std::string bucket{ "default" };
+    bool json{ false };
+};
+
+[[noreturn]] void
+usage(const char* program)
+{
+    std::fprintf(stderr,
+                 "usage: %s [--nodes=N] [--duration=SECONDS] [--concurrency=N | --rate=OPS_PER_SECOND]\n"
+                 "          [--operation=get|upsert|mixed|query|bootstrap] [--value-size=BYTES] [--keys=N]\n"
+                 "          [--kv-latency-us=US] [--nmvb=RATIO] [--tmpfail=RATIO] [--slow-node=INDEX:US]\n"
+                 "          [--connection-string=STRING --username=NAME --password=SECRET --bucket=NAME] [--format=text|json]\n",
+                 program);
+    std::exit(EXIT_FAILURE);
+}
+
+load_options
+parse_options(int argc, char** argv)
+{
+    load_options options{};
+    for (int i = 1; i < argc; ++i) {
+        std::string arg(argv[i]);
+        auto eq = arg.find('=');
+        if (arg.rfind("--", 0) != 0 || eq == std::string::npos) {
+            usage(argv[0]);
+        }
+        std::string name = arg.substr(2, eq - 2);
+        std::string value = arg.substr(eq + 1);
+        if (name == "nodes") {
+            options.nodes = std::stoul(value);
+        } else if (name == "duration") {
+            options.duration = std::chrono::duration<double>(std::stod(value));
+        } else if (name == "concurrency") {
+            options.concurrency = std::stoul(value);
+        } else if (name == "rate") {
+            options.rate = std::stod(value);
+        } else if (name == "operation" && value == "get") {
+            options.operation = operation_kind::get;
+        } else if (name == "operation" && value == "upsert") {
+            options.operation = operation_kind::upsert;
+        } else if (name == "operation" && value == "mixed") {
+            options.operation = operation_kind::mixed;
+        } else if (name == "operation" && value == "query") {
+            options.operation = operation_kind::query;
+        } else if (name == "operation" && value == "bootstrap") {
+            options.operation = operation_kind::bootstrap;
+        } else if (name == "value-size") {
+            options.value_size = std::stoul(value);
+        } else if (name == "keys") {
+            options.keys = std::max<std::size_t>(1, std::stoul(value));
+        } else if (name == "kv-latency-us") {
+            options.kv_latency = std::chrono::microseconds(std::stoll(value));
+        } else if (name == "nmvb") {
+            options.faults.not_my_vbucket_ratio = std::stod(value);
+        } else if (name == "tmpfail") {
+            options.faults.temporary_failure_ratio = std::stod(value);
+        } else if (name == "slow-node" && value.find(':') != std::string::npos) {
+            options.slow_node = { std::stoul(value.substr(0, value.find(':'))),
+                                  std::chrono::microseconds(std::stoll(value.substr(value.find(':') + 1))) };
+        } else if (name == "connection-string") {
+            options.connection_string = value;
+        } else if (name == "username") {
+            options.username = value;
+        } else if (name == "password") {
+            options.password = value;
+        } else if (name == "bucket") {
+            options.bucket = value;
+        } else if (name == "format" && (value == "text" || value == "json")) {
+            options.json = value == "json";
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (options.concurrency == 0 || options.nodes == 0 || (options.slow_node && options.slow_node->first >= options.nodes)) {
+        usage(argv[0]);
+    }
+    return options;
+}
+
+/**
+ * Collects latencies and errors of completed requests. Handlers are invoked on the IO threads of the cluster.
+ */
+class recorder
+{
+  public:
+    void record(std::chrono::steady_clock::time_point started, std::error_code ec)
+    {
+        auto latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started);
+        std::scoped_lock lock(mutex_);
+        if (ec) {
+            ++errors_[ec.message()];
+        } else {
+            latencies_.push_back(static_cast<std::uint64_t>(latency.count()));
+        }
+    }
+
+    [[nodiscard]] tao::json::value report(std::chrono::duration<double> elapsed)
+    {
+        std::scoped_lock lock(mutex_);
+        std::sort(latencies_.begin(), latencies_.end());
+        auto percentile = [this](double p) -> std::uint64_t {
+            if (latencies_.empty()) {
+                return 0;
+            }
+            auto index = static_cast<std::size_t>(p / 100.0 * static_cast<double>(latencies_.size() - 1));
+            return latencies_[index];
+        };
+        tao::json::value errors = tao::json::empty_object;
+        std::uint64_t number_of_errors = 0;
+        for (const auto& [message, count] : errors_) {
+            errors[message] = count;
+            number_of_errors += count;
+        }
+        return {
+            { "succeeded", latencies_.size() },
+            { "failed", number_of_errors },
+            { "ops_per_second", static_cast<double>(latencies_.size()) / elapsed.count() },
+            { "latency_us",
+              {
+                { "p50", percentile(50) },
+                { "p90", percentile(90) },
+                { "p99", percentile(99) },
+                { "p99.9", percentile(99.9) },
+                { "max", latencies_.empty() ? 0 : latencies_.back() },
+              } },
+            { "errors", errors },
+        };
+    }
+
+  private:
+    std::mutex mutex_{};
+    std::vector<std::uint64_t> latencies_{};
+    std::map<std::string, std::uint64_t> errors_{};
+};
+
+class load_generator
+{
+  public:
+    load_generator(couchbase::cluster& cluster, const load_options& options)
+      : cluster_(cluster)
+      , options_(options)
+      , value_(options.value_size, 'x')
+    {
+        if (options_.value_size >= 2) {
+            value_.front() = '"';
+            value_.back() = '"';
+        }
+    }
+
+    /**
+     * Stores all keys, so that the gets of the measured phase are not misses.
+     */
+    void populate()
+    {
+        std::atomic_size_t next_key{ 0 };
+        std::promise<void> done;
+        std::atomic_size_t running{ options_.concurrency };
+        std::function<void()> store = [&]() {
+            auto key = next_key.fetch_add(1);
+            if (key >= options_.keys) {
+                if (running.fetch_sub(1) == 1) {
+                    done.set_value();
+                }
+                return;
+            }
+            cluster_.execute(operations::upsert_request{ make_id(key), value_ },
+                             [&store](operations::upsert_response&& /* response */) { store(); });
+        };
+        for (std::size_t i = 0; i < options_.concurrency; ++i) {
+            store();
+        }
+        done.get_future().wait();
+    }
+
+    void run_closed_loop()
+    {
+        deadline_ = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(options_.duration);
+        std::promise<void> done;
+        std::atomic_size_t running{ options_.concurrency };
+        std::function<void()> next = [&]() {
+            if (std::chrono::steady_clock::now() >= deadline_) {
+                if (running.fetch_sub(1) == 1) {
+                    done.set_value();
+                }
+                return;
+            }
+            issue(std::chrono::steady_clock::now(), next);
+        };
+        for (std::size_t i = 0; i < options_.concurrency; ++i) {
+            next();
+        }
+        done.get_future().wait();
+    }
+
+    /**
+     * Issues requests from the timer, which ticks every millisecond, all requests due since the previous tick are sent together.
+     */
+    void run_open_loop(asio::io_context& ctx)
+    {
+        auto start = std::chrono::steady_clock::now();
+        deadline_ = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(options_.duration);
+        auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / options_.rate));
+        std::promise<void> done;
+        std::atomic_size_t in_flight{ 1 }; // the timer holds one reference until the deadline
+        std::function<void()> completed = [&]() {
+            if (in_flight.fetch_sub(1) == 1) {
+                done.set_value();
+            }
+        };
+        asio::steady_timer timer(ctx);
+        auto scheduled = start;
+        std::function<void(std::error_code)> tick = [&](std::error_code ec) {
+            auto now = std::chrono::steady_clock::now();
+            while (!ec && scheduled <= now && scheduled < deadline_) {
+                in_flight.fetch_add(1);
+                issue(scheduled, completed);
+                scheduled += interval;
+            }
+            if (ec || scheduled >= deadline_) {
+                return completed();
+            }
+            timer.expires_at(std::max(scheduled, now + std::chrono::milliseconds(1)));
+            timer.async_wait(tick);
+        };
+        asio::post(ctx, [&tick]() { tick({}); });
+        done.get_future().wait();
+    }
+
+    [[nodiscard]] recorder& stats()
+    {
+        return recorder_;
+    }
+
+  private:
+    [[nodiscard]] document_id make_id(std::size_t key) const
+    {
+        return { options_.bucket, "_default._default", fmt::format("key_{:08}", key) };
+    }
+
+    template<typename Continuation>
+    void issue(std::chrono::steady_clock::time_point started, Continuation& continuation)
+    {
+        operation_kind kind = options_.operation;
+        std::size_t key{};
+        {
+            std::scoped_lock lock(random_mutex_);
+            key = std::uniform_int_distribution<std::size_t>(0, options_.keys - 1)(random_);
+            if (kind == operation_kind::mixed) {
+                kind = std::uniform_int_distribution<int>(0, 9)(random_) < 8 ? operation_kind::get : operation_kind::upsert;
+            }
+        }
+        switch (kind) {
+            case operation_kind::get:
+            case operation_kind::mixed:
+                cluster_.execute(operations::get_request{ make_id(key) },
+                                 [this, started, &continuation](operations::get_response&& response) {
+                                     recorder_.record(started, response.ec);
+                                     continuation();
+                                 });
+                break;
+            case operation_kind::upsert:
+                cluster_.execute(operations::upsert_request{ make_id(key), value_ },
+                                 [this, started, &continuation](operations::upsert_response&& response) {
+                                     recorder_.record(started, response.ec);
+                                     continuation();
+                                 });
+                break;
+            case operation_kind::query: {
+                operations::query_request request{};
+                request.statement = "SELECT 1";
+                cluster_.execute_http(std::move(request), [this, started, &continuation](operations::query_response&& response) {
+                    recorder_.record(started, response.ec);
+                    continuation();
+                });
+            } break;
+        }
+    }
+
+    couchbase::cluster& cluster_;
+    const load_options& options_;
+    std::string value_;
+    std::chrono::steady_clock::time_point deadline_{};
+    recorder recorder_{};
+    std::mutex random_mutex_{};
+    std::mt19937_64 random_{ 42 };
+};
+
+/**
+ * Opens the cluster and then the bucket (unless the name is empty), returns the error of the first failed step.
+ */
+std::error_code
+open_cluster(couchbase::cluster& cluster, const couchbase::origin& origin, const std::string& bucket_name)
+{
+    {
+        std::promise<std::error_code> barrier;
+        cluster.open(origin, [&barrier](std::error_code ec) { barrier.set_value(ec); });
+        if (auto ec = barrier.get_future().get(); ec) {
+            return ec;
+        }
+    }
+    if (bucket_name.empty()) {
+        return {};
+    }
+    std::promise<std::error_code> barrier;
+    cluster.open_bucket(bucket_name, [&barrier](std::error_code ec) { barrier.set_value(ec); });
+    return barrier.get_future().get();
+}
+
+void
+close_cluster(couchbase::cluster& cluster, std::thread& worker)
+{
+    std::promise<void> barrier;
+    cluster.close([&barrier]() { barrier.set_value(); });
+    barrier.get_future().wait();
+    worker.join();
+}
+
+/**
+ * Measures the startup: every round opens new cluster and the bucket, which includes connecting to all nodes, authentication and
+ * fetching of the configurations, and closes it again.
+ */
+void
+measure_bootstrap(const couchbase::origin& origin, const load_options& options, recorder& stats)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(options.duration);
+    do {
+        asio::io_context ctx{};
+        couchbase::cluster cluster(ctx);
+        std::thread worker([&ctx]() { ctx.run(); });
+        auto started = std::chrono::steady_clock::now();
+        stats.record(started, open_cluster(cluster, origin, options.bucket));
+        close_cluster(cluster, worker);
+    } while (std::chrono::steady_clock::now() < deadline);
+}
+} // namespace couchbase::benchmarks
+
+int
+main(int argc, char** argv)
+{
+    using namespace couchbase::benchmarks;
+    spdlog::set_level(spdlog::level::warn);
+    auto options = parse_options(argc, argv);
+
+    std::unique_ptr<couchbase::mock::mock_cluster> mock{};
+    couchbase::origin origin{};
+    if (options.connection_string.empty()) {
+        couchbase::mock::mock_options settings{};
+        settings.number_of_nodes = options.nodes;
+        settings.bucket_name = options.bucket;
+        settings.kv_latency = options.kv_latency;
+        mock = std::make_unique<couchbase::mock::mock_cluster>(settings);
+        for (std::size_t i = 0; i < options.nodes; ++i) {
+            auto faults = options.faults;
+            if (options.slow_node && options.slow_node->first == i) {
+                faults.extra_latency = options.slow_node->second;
+            }
+            mock->set_faults(i, faults);
+        }
+        origin = couchbase::origin(options.username, options.password, "127.0.0.1", mock->kv_port(0), couchbase::cluster_options{});
+    } else {
+        origin =
+          couchbase::origin(options.username, options.password, couchbase::utils::parse_connection_string(options.connection_string));
+    }
+
+    tao::json::value report{};
+    std::chrono::duration<double> elapsed{};
+    if (options.operation == operation_kind::bootstrap) {
+        recorder stats{};
+        auto start = std::chrono::steady_clock::now();
+        measure_bootstrap(origin, options, stats);
+        elapsed = std::chrono::steady_clock::now() - start;
+        report = stats.report(elapsed);
+    } else {
+        asio::io_context ctx{};
+        couchbase::cluster cluster(ctx);
+        std::thread worker([&ctx]() { ctx.run(); });
+
+        auto open_started = std::chrono::steady_clock::now();
+        auto ec = open_cluster(cluster, origin, options.operation == operation_kind::query ? std::string{} : options.bucket);
+        auto open_elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - open_started);
+        if (ec) {
+            spdlog::critical("unable to open cluster or bucket \"{}\": {}", options.bucket, ec.message());
+            close_cluster(cluster, worker);
+            return EXIT_FAILURE;
+        }
+
+        load_generator generator(cluster, options);
+        if (options.operation == operation_kind::get || options.operation == operation_kind::mixed) {
+            generator.populate();
+        }
+        auto start = std::chrono::steady_clock::now();
+        if (options.rate > 0) {
+            generator.run_open_loop(ctx);
+        } else {
+            generator.run_closed_loop();
+        }
+        elapsed = std::chrono::steady_clock::now() - start;
+        report = generator.stats().report(elapsed);
+        report["startup_us"] = open_elapsed.count();
+
+        tao::json::value retries = tao::json::empty_object;
+        for (const auto& [reason, count] : cluster.retry_stats()) {
+            retries[fmt::format("{}", reason)] = count;
+        }
+        report["retries"] = retries;
+        close_cluster(cluster, worker);
+    }
+    if (mock) {
+        tao::json::value nodes = tao::json::empty_array;
+        for (std::size_t i = 0; i < options.nodes; ++i) {
+            auto node = mock->stats(i);
+            nodes.get_array().emplace_back(tao::json::value{
+              { "kv_requests", node.kv_requests },
+              { "query_requests", node.query_requests },
+              { "not_my_vbucket_injected", node.not_my_vbucket_injected },
+              { "temporary_failures_injected", node.temporary_failures_injected },
+            });
+        }
+        report["mock_nodes"] = nodes;
+        mock->stop();
+    }
+    report["context"] = tao::json::value{
+        { "revision", BACKEND_GIT_REVISION },
+        { "compiler", BACKEND_CXX_COMPILER },
+        { "duration", elapsed.count() },
+        { "mode", options.rate > 0 ? "open" : "closed" },
+        { "concurrency", options.concurrency },
+        { "rate", options.rate },
+    };
+
+    if (options.json) {
+        std::printf("%s\n", tao::json::to_string(report, 2).c_str());
+        return EXIT_SUCCESS;
+    }
+    const auto& latency = report.at("latency_us");
+    std::printf("%-24s %12s\n%-24s %12llu\n%-24s %12llu\n%-24s %12.1f\n",
+                "mode",
+                options.rate > 0 ? "open" : "closed",
+                "succeeded",
+                static_cast<unsigned long long>(report.at("succeeded").as<std::uint64_t>()),
+                "failed",
+                static_cast<unsigned long long>(report.at("failed").as<std::uint64_t>()),
+                "ops/s",
+                report.at("ops_per_second").as<double>());
+    for (const auto* name : { "p50", "p90", "p99", "p99.9", "max" }) {
+        std::printf("latency %-16s %10llu us\n", name, static_cast<unsigned long long>(latency.at(name).as<std::uint64_t>()));
+    }
+    for (const auto& [message, count] : report.at("errors").get_object()) {
+        std::printf("error %-18s %12llu\n", message.c_str(), static_cast<unsigned long long>(count.as<std::uint64_t>()));
+    }
+    if (const auto* startup = report.find("startup_us"); startup != nullptr) {
+        std::printf("%-24s %10llu us\n", "startup", static_cast<unsigned long long>(startup->as<std::uint64_t>()));
+    }
+    if (const auto* retries = report.find("retries"); retries != nullptr) {
+        for (const auto& [reason, count] : retries->get_object()) {
+            std::printf("retry %-18s %12llu\n", reason.c_str(), static_cast<unsigned long long>(count.as<std::uint64_t>()));
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,136 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <asio.hpp>
+
+#include <configuration.hxx>
+
+/**
+ * Compares mapping of the keys to partitions with the previous implementation: bytewise CRC32 and vector of vectors for the map.
+ *
+ *   map_key_benchmark [number_of_keys] [key_length]
+ */
+
+namespace
+{
+std::uint32_t
+bytewise_crc32(const char* key, std::size_t key_length)
+{
+    std::uint32_t crc = UINT32_MAX;
+    for (std::size_t x = 0; x < key_length; x++) {
+        crc = (crc >> 8U) ^ couchbase::utils::crc32tab[(crc ^ static_cast<unsigned char>(key[x])) & 0xffU];
+    }
+    return ((~crc) >> 16U) & 0x7fffU;
+}
+
+template<typename Function>
+double
+measure(const char* name, std::size_t operations, Function&& function)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::size_t checksum = function();
+    auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    double ns_per_op = elapsed / static_cast<double>(operations);
+    std::printf("%-24s %10.2f ns/op (checksum %zu)\n", name, ns_per_op, checksum);
+    return ns_per_op;
+}
+} // namespace
+
+int
+main(int argc, char** argv)
+{
+    std::size_t number_of_keys = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1'000'000;
+    std::size_t key_length = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 24;
+    constexpr std::size_t num_partitions = 1024;
+    constexpr std::size_t num_copies = 2;
+
+    std::vector<std::string> keys;
+    keys.reserve(number_of_keys);
+    for (std::size_t i = 0; i < number_of_keys; ++i) {
+        std::string key = "key_" + std::to_string(i);
+        key.resize(std::max(key_length, key.size()), 'x');
+        keys.emplace_back(std::move(key));
+    }
+
+    std::vector<std::vector<std::int16_t>> nested_map(num_partitions, std::vector<std::int16_t>(num_copies));
+    couchbase::configuration config;
+    config.vbmap = couchbase::configuration::vbucket_map(num_partitions, num_copies);
+    for (std::size_t p = 0; p < num_partitions; ++p) {
+        for (std::size_t c = 0; c < num_copies; ++c) {
+            auto server = static_cast<std::int16_t>((p + c) % 4);
+            nested_map[p][c] = server;
+            config.vbmap->set(p, c, server);
+        }
+    }
+
+    for (const auto& key : keys) {
+        if (bytewise_crc32(key.data(), key.size()) != couchbase::utils::hash_crc32(key.data(), key.size())) {
+            std::fprintf(stderr, "CRC32 mismatch for key \"%s\"\n", key.c_str());
+            return EXIT_FAILURE;
+        }
+    }
+
+    double legacy_crc = measure("crc32/bytewise", number_of_keys, [&]() {
+        std::size_t sum = 0;
+        for (const auto& key : keys) {
+            sum += bytewise_crc32(key.data(), key.size());
+        }
+        return sum;
+    });
+    double sliced_crc = measure("crc32/slicing-by-8", number_of_keys, [&]() {
+        std::size_t sum = 0;
+        for (const auto& key : keys) {
+            sum += couchbase::utils::hash_crc32(key.data(), key.size());
+        }
+        return sum;
+    });
+    double legacy_map = measure("map_key/nested", number_of_keys, [&]() {
+        std::size_t sum = 0;
+        for (const auto& key : keys) {
+            auto vbucket = static_cast<std::uint16_t>(bytewise_crc32(key.data(), key.size()) % nested_map.size());
+            sum += static_cast<std::size_t>(nested_map.at(vbucket)[0]) + vbucket;
+        }
+        return sum;
+    });
+    double flat_map = measure("map_key/flat", number_of_keys, [&]() {
+        std::size_t sum = 0;
+        for (const auto& key : keys) {
+            auto [vbucket, index] = config.map_key(key);
+            sum += index + vbucket;
+        }
+        return sum;
+    });
+    double batch_map = measure("map_keys/flat", number_of_keys, [&]() {
+        std::size_t sum = 0;
+        for (const auto& [vbucket, index] : config.map_keys(keys)) {
+            sum += index + vbucket;
+        }
+        return sum;
+    });
+
+    std::printf("crc32 speedup x%.2f, map_key speedup x%.2f, map_keys speedup x%.2f\n",
+                legacy_crc / sliced_crc,
+                legacy_map / flat_map,
+                legacy_map / batch_map);
+    return EXIT_SUCCESS;
+}
@@ -17,9 +17,17 @@
 
 #pragma once
 
+#include <algorithm>
 #include <utility>
 #include <queue>
+#include <random>
+#include <tuple>
 
+#include <collection_cache.hxx>
+#include <compression_policy.hxx>
+#include <config_store.hxx>
+#include <io/io_context_pool.hxx>
+#include <metrics/snapshot.hxx>
 #include <operations.hxx>
 #include <origin.hxx>
 
@@ -30,17 +38,27 @@ class bucket : public std::enable_shared_from_this<bucket>
   public:
     explicit bucket(const std::string& client_id,
                     asio::io_context& ctx,
+                    io::io_context_pool& io_pool,
                     asio::ssl::context& tls,
                     std::string name,
                     couchbase::origin origin,
-                    const std::vector<protocol::hello_feature>& known_features)
+                    const std::vector<protocol::hello_feature>& known_features,
+                    std::shared_ptr<tracing::threshold_logging_tracer> tracer = {},
+                    std::shared_ptr<compression_policy> compression = {},
+                    std::optional<configuration> seed = {},
+                    std::shared_ptr<const error_map> errmap = {})
 
       : client_id_(client_id)
       , ctx_(ctx)
+      , io_pool_(io_pool)
       , tls_(tls)
       , name_(std::move(name))
       , origin_(std::move(origin))
       , known_features_(known_features)
+      , tracer_(std::move(tracer))
+      , compression_(std::move(compression))
+      , seed_(std::move(seed))
+      , errmap_(std::move(errmap))
     {
     }
 
@@ -54,72 +72,251 @@ class bucket : public std::enable_shared_from_this<bucket>
         return name_;
     }
 
+    /**
+     * Subscribes for configurations applied to the bucket. The listener is invoked on the thread of the session, which has received
+     * the configuration.
+     */
+    void on_configuration_update(config_store::listener_type&& listener)
+    {
+        config_store_->subscribe(std::move(listener));
+    }
+
+    /**
+     * Opens the bucket. With the seed (the configuration of the cluster), the connections to all KV nodes are opened at once, and
+     * the first one to select the bucket delivers its configuration. Otherwise the nodes are connected after the bucket configuration
+     * has been received from the bootstrap address.
+     */
     template<typename Handler>
     void bootstrap(Handler&& handler)
     {
-        std::shared_ptr<io::mcbp_session> new_session;
-        if (origin_.options().enable_tls) {
-            new_session = std::make_shared<io::mcbp_session>(client_id_, ctx_, tls_, origin_, name_, known_features_);
-        } else {
-            new_session = std::make_shared<io::mcbp_session>(client_id_, ctx_, origin_, name_, known_features_);
+        config_store_->subscribe([weak_self = weak_from_this()](config_store::config_ptr config) {
+            if (auto self = weak_self.lock()) {
+                asio::post(self->ctx_, [self, config = std::move(config)]() mutable { self->update_config(std::move(config)); });
+            }
+        });
+        if (seed_ && std::none_of(seed_->nodes.begin(), seed_->nodes.end(), [tls = origin_.options().enable_tls](const auto& n) {
+                return n.port_or(service_type::kv, tls, 0) != 0;
+            })) {
+            seed_.reset();
+        }
+        if (seed_) {
+            auto h = std::make_shared<std::decay_t<Handler>>(std::forward<Handler>(handler));
+            bootstrap_handler_ = [h](std::error_code ec, const configuration& cfg) { (*h)(ec, cfg); };
+            asio::post(ctx_, [self = shared_from_this()]() { self->bootstrap_from_seed(); });
+            return;
         }
+        auto new_session = make_session(origin_);
         new_session->bootstrap([self = shared_from_this(), new_session, h = std::forward<Handler>(handler)](
                                  std::error_code ec, const configuration& cfg) mutable {
-            if (!ec) {
-                self->config_ = cfg;
-                size_t this_index = new_session->index();
-                self->sessions_.emplace(this_index, std::move(new_session));
-                if (cfg.nodes.size() > 1) {
-                    for (const auto& n : cfg.nodes) {
-                        if (n.index != this_index) {
-                            couchbase::origin origin(self->origin_.get_username(),
-                                                     self->origin_.get_password(),
-                                                     n.hostname,
-                                                     n.port_or(service_type::kv, self->origin_.options().enable_tls, 0),
-                                                     self->origin_.options());
-                            std::shared_ptr<io::mcbp_session> s;
-                            if (self->origin_.options().enable_tls) {
-                                s = std::make_shared<io::mcbp_session>(
-                                  self->client_id_, self->ctx_, self->tls_, origin, self->name_, self->known_features_);
-                            } else {
-                                s = std::make_shared<io::mcbp_session>(
-                                  self->client_id_, self->ctx_, origin, self->name_, self->known_features_);
-                            }
-                            s->bootstrap([host = n.hostname, bucket = self->name_](std::error_code err, const configuration& /*config*/) {
-                                // TODO: retry, we know that auth is correct
-                                if (err) {
-                                    spdlog::warn("unable to bootstrap node {} ({}): {}", host, bucket, err.message());
-                                }
-                            });
-                            self->sessions_.emplace(n.index, std::move(s));
-                        }
-                    }
-                }
-                while (!self->deferred_commands_.empty()) {
-                    self->deferred_commands_.front()();
-                    self->deferred_commands_.pop();
-                }
-            }
-            h(ec, cfg);
+            // the session might live on the other thread, so continue on the context of the bucket
+            asio::post(self->ctx_, [self, new_session, h = std::move(h), ec, cfg]() mutable {
+                self->on_bootstrap(ec, cfg, std::move(new_session));
+                h(ec, cfg);
+            });
         });
     }
 
     template<typename Request, typename Handler>
-    void execute(Request request, Handler&& handler)
+    std::shared_ptr<operations::mcbp_command<Request>> execute(Request request, Handler&& handler)
     {
         if (closed_) {
-            return;
+            handler(make_response(std::make_error_code(error::common_errc::request_canceled), request, {}));
+            return nullptr;
         }
         auto cmd = std::make_shared<operations::mcbp_command<Request>>(ctx_, request);
+        install_retry_handler(cmd);
+        cmd->tracer_ = tracer_;
+        cmd->compression_ = compression_;
         cmd->start([cmd, handler = std::forward<Handler>(handler)](std::error_code ec, std::optional<io::mcbp_message> msg) mutable {
             using encoded_response_type = typename Request::encoded_response_type;
             handler(make_response(ec, cmd->request, msg ? encoded_response_type(*msg) : encoded_response_type{}));
         });
-        if (config_) {
-            map_and_send(cmd);
-        } else {
-            deferred_commands_.emplace([self = shared_from_this(), cmd]() { self->map_and_send(cmd); });
+        asio::post(ctx_, [self = shared_from_this(), cmd]() {
+            if (self->config_) {
+                self->map_and_send(cmd);
+            } else if (self->can_defer()) {
+                self->deferred_commands_.emplace([self, cmd]() { self->map_and_send(cmd); });
+            } else {
+                cmd->deadline.cancel();
+                cmd->cancel(std::make_error_code(error::common_errc::request_queue_full));
+            }
+        });
+        return cmd;
+    }
+
+    /**
+     * Dispatches batch of requests at once, so that every node session receives all its requests with a single flush.
+     *
+     * The handler is invoked once with responses in the same order as requests. Returns the commands, to allow cancellation.
+     */
+    template<typename Request, typename Handler>
+    std::vector<std::shared_ptr<operations::mcbp_command<Request>>> execute_multi(std::vector<Request> requests, Handler&& handler)
+    {
+        using encoded_response_type = typename Request::encoded_response_type;
+        using response_type = decltype(make_response(std::error_code{}, std::declval<Request&>(), encoded_response_type{}));
+        struct batch_state {
+            std::vector<response_type> responses;
+            std::size_t remaining;
+            std::decay_t<Handler> handler;
+        };
+
+        if (requests.empty()) {
+            handler(std::vector<response_type>{});
+            return {};
         }
+        auto state = std::make_shared<batch_state>(
+          batch_state{ std::vector<response_type>(requests.size()), requests.size(), std::forward<Handler>(handler) });
+        std::vector<std::shared_ptr<operations::mcbp_command<Request>>> cmds;
+        cmds.reserve(requests.size());
+        for (std::size_t i = 0; i < requests.size(); ++i) {
+            auto cmd = std::make_shared<operations::mcbp_command<Request>>(ctx_, std::move(requests[i]));
+            install_retry_handler(cmd);
+            cmd->tracer_ = tracer_;
+            cmd->compression_ = compression_;
+            cmd->start([cmd, state, i](std::error_code ec, std::optional<io::mcbp_message> msg) mutable {
+                state->responses[i] = make_response(ec, cmd->request, msg ? encoded_response_type(*msg) : encoded_response_type{});
+                if (--state->remaining == 0) {
+                    state->handler(std::move(state->responses));
+                }
+            });
+            cmds.emplace_back(cmd);
+        }
+        asio::post(ctx_, [self = shared_from_this(), cmds]() {
+            if (self->closed_) {
+                for (const auto& cmd : cmds) {
+                    cmd->cancel(std::make_error_code(error::common_errc::request_canceled));
+                }
+            } else if (self->config_) {
+                self->map_and_send_multi(cmds);
+            } else if (self->can_defer()) {
+                self->deferred_commands_.emplace([self, cmds]() { self->map_and_send_multi(cmds); });
+            } else {
+                for (const auto& cmd : cmds) {
+                    cmd->deadline.cancel();
+                    cmd->cancel(std::make_error_code(error::common_errc::request_queue_full));
+                }
+            }
+        });
+        return cmds;
+    }
+
+    /**
+     * Reads the document from the active node and all replicas, and completes with the first copy received.
+     *
+     * Returns cancellation function, that might be called from any thread.
+     */
+    template<typename Handler>
+    std::function<void()> execute_get_any_replica(operations::get_any_replica_request request, Handler&& handler)
+    {
+        return read_replicas(
+          request.id,
+          request.timeout,
+          true,
+          [id = request.id, handler = std::forward<Handler>(handler)](std::error_code ec,
+                                                                      std::vector<operations::replica_entry>&& entries) mutable {
+              operations::get_any_replica_response response{ id, ec };
+              if (!entries.empty()) {
+                  response.entry = std::move(entries.front());
+              }
+              handler(std::move(response));
+          });
+    }
+
+    /**
+     * Reads the document from the active node and all replicas, and completes with all copies received.
+     *
+     * Returns cancellation function, that might be called from any thread.
+     */
+    template<typename Handler>
+    std::function<void()> execute_get_all_replicas(operations::get_all_replicas_request request, Handler&& handler)
+    {
+        return read_replicas(
+          request.id,
+          request.timeout,
+          false,
+          [id = request.id, handler = std::forward<Handler>(handler)](std::error_code ec,
+                                                                      std::vector<operations::replica_entry>&& entries) mutable {
+              handler(operations::get_all_replicas_response{ id, ec, std::move(entries) });
+          });
+    }
+
+    /**
+     * Reads the document from the active node, and if it does not respond within kv_hedged_read_delay, sends the same read to the
+     * first replica. The first successful response wins, and the other request is cancelled.
+     *
+     * Returns cancellation function, that might be called from any thread.
+     */
+    template<typename Handler>
+    std::function<void()> execute_hedged_get(operations::get_request request, Handler&& handler)
+    {
+        auto state = std::make_shared<hedged_get>(ctx_);
+        state->handler = std::forward<Handler>(handler);
+        asio::post(ctx_, [self = shared_from_this(), state, request]() {
+            if (state->done) {
+                return;
+            }
+            state->pending = 1;
+            auto cmd =
+              self->execute(request, [state](operations::get_response resp) { on_hedged_response(*state, std::move(resp), false); });
+            if (!state->done) {
+                state->cancel_active = make_canceler(cmd);
+            }
+            auto delay = self->origin_.options().kv_hedged_read_delay;
+            state->timer.expires_after(delay);
+            state->timer.async_wait([self, state, request, delay](std::error_code ec) {
+                if (ec == asio::error::operation_aborted || state->done) {
+                    return;
+                }
+                operations::get_replica_request replica_request{ request.id };
+                replica_request.timeout = std::max(request.timeout - delay, std::chrono::milliseconds(1));
+                ++state->pending;
+                auto replica_cmd = self->execute(replica_request, [state](operations::get_replica_response resp) {
+                    on_hedged_response(
+                      *state, operations::get_response{ resp.id, resp.opaque, resp.ec, std::move(resp.value), resp.cas, resp.flags }, true);
+                });
+                if (!state->done) {
+                    state->cancel_replica = make_canceler(replica_cmd);
+                }
+            });
+        });
+        return [ctx = std::ref(ctx_), state, id = request.id]() {
+            asio::post(ctx.get(), [state, id]() {
+                finish_hedged_get(*state, operations::get_response{ id, 0, std::make_error_code(error::common_errc::request_canceled) });
+            });
+        };
+    }
+
+    [[nodiscard]] const io::retry_counters& retry_counters() const
+    {
+        return *retry_counters_;
+    }
+
+    /**
+     * Snapshot of the sessions of the bucket. Must be called on the context of the bucket.
+     */
+    [[nodiscard]] metrics::bucket_metrics metrics()
+    {
+        metrics::bucket_metrics result{};
+        result.name = name_;
+        result.deferred_commands = deferred_commands_.size();
+        result.rejected_deferred_commands = rejected_deferred_commands_;
+        for (const auto& [index, node_sessions] : sessions_) {
+            std::string node{};
+            if (config_) {
+                for (const auto& n : config_->nodes) {
+                    if (n.index == index) {
+                        node = fmt::format("{}:{}", n.hostname, n.port_or(service_type::kv, origin_.options().enable_tls, 0));
+                        break;
+                    }
+                }
+            }
+            for (const auto& session : node_sessions) {
+                auto snapshot = session->metrics();
+                snapshot.node = node;
+                result.sessions.emplace_back(std::move(snapshot));
+            }
+        }
+        return result;
     }
 
     void close()
@@ -128,8 +325,13 @@ class bucket : public std::enable_shared_from_this<bucket>
             return;
         }
         closed_ = true;
-        for (auto& session : sessions_) {
-            session.second->stop();
+        for (auto& [id, timer] : reconnect_timers_) {
+            timer->cancel();
+        }
+        for (auto& node_sessions : sessions_) {
+            for (auto& session : node_sessions.second) {
+                asio::dispatch(session->context(), [session]() { session->stop(); });
+            }
         }
     }
 
@@ -138,23 +340,660 @@ class bucket : public std::enable_shared_from_this<bucket>
     {
         size_t index = 0;
         std::tie(cmd->request.partition, index) = config_->map_key(cmd->request.id.key);
-        auto session = sessions_.at(index);
+        if constexpr (std::is_same_v<Request, operations::get_replica_request>) {
+            auto replica = config_->vbmap->replica(cmd->request.partition, cmd->request.replica_index);
+            if (replica < 0 || sessions_.count(static_cast<std::size_t>(replica)) == 0) {
+                cmd->deadline.cancel();
+                return cmd->cancel(std::make_error_code(error::key_value_errc::document_irretrievable));
+            }
+            index = static_cast<std::size_t>(replica);
+        }
+        auto session = select_session(index, value_size(cmd->request));
+        if (!session) {
+            return defer(cmd);
+        }
+        if (session->is_congested()) {
+            session->record_backpressure();
+            return handle_backpressure(cmd);
+        }
         cmd->send_to(session);
     }
 
+    template<typename Request>
+    void map_and_send_multi(const std::vector<std::shared_ptr<operations::mcbp_command<Request>>>& cmds)
+    {
+        std::vector<std::string_view> keys;
+        keys.reserve(cmds.size());
+        for (const auto& cmd : cmds) {
+            keys.emplace_back(cmd->request.id.key);
+        }
+        auto locations = config_->map_keys(keys);
+        std::vector<std::shared_ptr<io::mcbp_session>> used_sessions;
+        for (std::size_t i = 0; i < cmds.size(); ++i) {
+            const auto& cmd = cmds[i];
+            cmd->request.partition = locations[i].first;
+            auto session = select_session(locations[i].second, value_size(cmd->request));
+            if (!session) {
+                defer(cmd);
+                continue;
+            }
+            if (session->is_congested()) {
+                session->record_backpressure();
+                handle_backpressure(cmd);
+                continue;
+            }
+            cmd->send_to(session, false);
+            if (std::find(used_sessions.begin(), used_sessions.end(), session) == used_sessions.end()) {
+                used_sessions.emplace_back(std::move(session));
+            }
+        }
+        for (auto& session : used_sessions) {
+            session->flush();
+        }
+    }
+
   private:
+    /**
+     * Fails the command with request_queue_full, or lets it wait for the capacity when kv_backpressure_wait is set.
+     */
+    template<typename Request>
+    void handle_backpressure(const std::shared_ptr<operations::mcbp_command<Request>>& cmd)
+    {
+        if (origin_.options().kv_backpressure_wait) {
+            return cmd->handle_backpressure();
+        }
+        cmd->deadline.cancel();
+        cmd->cancel(std::make_error_code(error::common_errc::request_queue_full));
+    }
+
+    /**
+     * Keeps the command until a session of its node has been bootstrapped, see run_deferred_commands(). Commands, which have been
+     * completed meanwhile (e.g. by the deadline), are dropped when the queue runs.
+     */
+    template<typename Request>
+    void defer(const std::shared_ptr<operations::mcbp_command<Request>>& cmd)
+    {
+        if (!can_defer()) {
+            cmd->deadline.cancel();
+            return cmd->cancel(std::make_error_code(error::common_errc::request_queue_full));
+        }
+        deferred_commands_.emplace([self = shared_from_this(), cmd]() {
+            if (cmd->handler_) {
+                self->map_and_send(cmd);
+            }
+        });
+    }
+
+    /**
+     * Dispatches the commands waiting for configuration or for bootstrapped session. Commands, that still have no session to go to,
+     * are deferred again, and wait for the next bootstrapped session.
+     */
+    void run_deferred_commands()
+    {
+        std::queue<std::function<void()>> commands{};
+        std::swap(commands, deferred_commands_);
+        while (!commands.empty()) {
+            commands.front()();
+            commands.pop();
+        }
+    }
+
+    /**
+     * Returns false when the number of commands waiting for configuration has reached kv_max_deferred_commands.
+     */
+    bool can_defer()
+    {
+        std::size_t limit = origin_.options().kv_max_deferred_commands;
+        if (limit > 0 && deferred_commands_.size() >= limit) {
+            ++rejected_deferred_commands_;
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * State of the read from the active node and replicas. Lives on the context of the bucket, so it does not need locking.
+     */
+    struct replica_reads {
+        std::vector<operations::replica_entry> entries{};
+        std::vector<std::function<void()>> cancels{};
+        std::size_t remaining{ 0 };
+        bool first_only{ false };
+        bool done{ false };
+        std::function<void(std::error_code, std::vector<operations::replica_entry>&&)> handler{};
+    };
+
+    struct hedged_get {
+        explicit hedged_get(asio::io_context& ctx)
+          : timer(ctx)
+        {
+        }
+
+        asio::steady_timer timer;
+        std::function<void()> cancel_active{};
+        std::function<void()> cancel_replica{};
+        std::optional<operations::get_response> failure{};
+        std::size_t pending{ 0 };
+        bool done{ false };
+        std::function<void(operations::get_response&&)> handler{};
+    };
+
+    template<typename Request>
+    void install_retry_handler(const std::shared_ptr<operations::mcbp_command<Request>>& cmd)
+    {
+        cmd->retry_counters_ = retry_counters_;
+        cmd->redispatch_ = [weak_self = weak_from_this()](std::shared_ptr<operations::mcbp_command<Request>> command,
+                                                          std::optional<configuration> config) {
+            auto self = weak_self.lock();
+            if (!self) {
+                return command->cancel(std::make_error_code(error::common_errc::request_canceled));
+            }
+            asio::post(self->ctx_, [self, command = std::move(command), config = std::move(config)]() mutable {
+                if (self->closed_) {
+                    return command->cancel(std::make_error_code(error::common_errc::request_canceled));
+                }
+                if (config) {
+                    self->config_store_->update(std::move(config.value()));
+                }
+                self->update_config(self->config_store_->get());
+                self->map_and_send(command);
+            });
+        };
+    }
+
+    /**
+     * Applies newer configuration of the bucket, the sessions follow their nodes (see rebind_sessions()).
+     */
+    void update_config(config_store::config_ptr config)
+    {
+        if (closed_ || !config_ || !config || !config->vbmap || config->rev <= config_->rev) {
+            return;
+        }
+        rebind_sessions(*config_, *config);
+        spdlog::debug("{} applying new configuration: {}", name_, *config);
+        config_ = std::move(config);
+        for (const auto& n : config_->nodes) {
+            connect_node(n);
+        }
+    }
+
+    /**
+     * Moves the sessions from the node indexes of one configuration to the other. Nodes are matched by address, so that the sessions
+     * stay connected when the indexes shift. Sessions of the nodes, which are missing in the new configuration, are stopped.
+     */
+    void rebind_sessions(const configuration& from, const configuration& to)
+    {
+        bool tls = origin_.options().enable_tls;
+        std::map<size_t, std::vector<std::shared_ptr<io::mcbp_session>>> sessions;
+        for (const auto& n : to.nodes) {
+            for (const auto& old : from.nodes) {
+                if (old.hostname == n.hostname && old.port_or(service_type::kv, tls, 0) == n.port_or(service_type::kv, tls, 0)) {
+                    auto it = sessions_.find(old.index);
+                    if (it != sessions_.end()) {
+                        sessions[n.index] = std::move(it->second);
+                        sessions_.erase(it);
+                    }
+                    break;
+                }
+            }
+        }
+        for (auto& node_sessions : sessions_) {
+            for (auto& session : node_sessions.second) {
+                asio::dispatch(session->context(), [session]() { session->stop(); });
+            }
+        }
+        sessions_ = std::move(sessions);
+    }
+
+    template<typename Request>
+    static std::function<void()> make_canceler(const std::shared_ptr<operations::mcbp_command<Request>>& cmd)
+    {
+        if (!cmd) {
+            return {};
+        }
+        return [weak_cmd = std::weak_ptr<operations::mcbp_command<Request>>(cmd)]() {
+            if (auto c = weak_cmd.lock()) {
+                c->cancel(std::make_error_code(error::common_errc::request_canceled));
+            }
+        };
+    }
+
+    template<typename Handler>
+    std::function<void()> read_replicas(const document_id& id, std::chrono::milliseconds timeout, bool first_only, Handler&& handler)
+    {
+        auto state = std::make_shared<replica_reads>();
+        state->first_only = first_only;
+        state->handler = std::forward<Handler>(handler);
+        auto start = [self = shared_from_this(), state, id, timeout]() {
+            if (state->done) {
+                return;
+            }
+            if (self->closed_) {
+                return complete_replica_reads(*state, std::make_error_code(error::common_errc::request_canceled));
+            }
+            std::size_t num_replicas = 0;
+            if (self->config_->vbmap && self->config_->vbmap->num_copies() > 0) {
+                num_replicas = self->config_->vbmap->num_copies() - 1;
+            }
+            state->remaining = num_replicas + 1;
+            state->cancels.resize(state->remaining);
+
+            operations::get_request active_request{ id };
+            active_request.timeout = timeout;
+            state->cancels[0] = make_canceler(self->execute(active_request, [state](operations::get_response resp) {
+                on_replica_read(*state, 0, resp.ec, operations::replica_entry{ std::move(resp.value), resp.cas, resp.flags, false });
+            }));
+            for (std::size_t i = 0; i < num_replicas; ++i) {
+                operations::get_replica_request replica_request{ id };
+                replica_request.replica_index = i;
+                replica_request.timeout = timeout;
+                state->cancels[i + 1] = make_canceler(self->execute(replica_request, [state, i](operations::get_replica_response resp) {
+                    on_replica_read(*state, i + 1, resp.ec, operations::replica_entry{ std::move(resp.value), resp.cas, resp.flags, true });
+                }));
+            }
+        };
+        asio::post(ctx_, [self = shared_from_this(), state, start = std::move(start)]() {
+            if (self->config_) {
+                start();
+            } else if (self->can_defer()) {
+                self->deferred_commands_.emplace(start);
+            } else {
+                complete_replica_reads(*state, std::make_error_code(error::common_errc::request_queue_full));
+            }
+        });
+        return [ctx = std::ref(ctx_), state]() {
+            asio::post(ctx.get(),
+                       [state]() { complete_replica_reads(*state, std::make_error_code(error::common_errc::request_canceled)); });
+        };
+    }
+
+    static void on_replica_read(replica_reads& state, std::size_t index, std::error_code ec, operations::replica_entry&& entry)
+    {
+        if (state.done) {
+            return;
+        }
+        // the command is completing right now, it must not be cancelled from its own handler
+        state.cancels[index] = nullptr;
+        --state.remaining;
+        if (!ec) {
+            state.entries.emplace_back(std::move(entry));
+        }
+        if (state.remaining == 0 || (state.first_only && !state.entries.empty())) {
+            complete_replica_reads(
+              state, state.entries.empty() ? std::make_error_code(error::key_value_errc::document_irretrievable) : std::error_code{});
+        }
+    }
+
+    static void complete_replica_reads(replica_reads& state, std::error_code ec)
+    {
+        if (state.done) {
+            return;
+        }
+        state.done = true;
+        for (auto& cancel : state.cancels) {
+            if (cancel) {
+                std::exchange(cancel, nullptr)();
+            }
+        }
+        state.handler(ec, std::move(state.entries));
+    }
+
+    static void on_hedged_response(hedged_get& state, operations::get_response&& resp, bool from_replica)
+    {
+        if (state.done) {
+            return;
+        }
+        // the command is completing right now, it must not be cancelled from its own handler
+        (from_replica ? state.cancel_replica : state.cancel_active) = nullptr;
+        --state.pending;
+        if (!resp.ec) {
+            return finish_hedged_get(state, std::move(resp));
+        }
+        // if both requests fail, report the error of the active node
+        if (!from_replica || !state.failure) {
+            state.failure = std::move(resp);
+        }
+        if (state.pending == 0) {
+            finish_hedged_get(state, std::move(*state.failure));
+        }
+    }
+
+    static void finish_hedged_get(hedged_get& state, operations::get_response&& resp)
+    {
+        if (state.done) {
+            return;
+        }
+        state.done = true;
+        state.timer.cancel();
+        if (state.cancel_active) {
+            std::exchange(state.cancel_active, nullptr)();
+        }
+        if (state.cancel_replica) {
+            std::exchange(state.cancel_replica, nullptr)();
+        }
+        state.handler(std::move(resp));
+    }
+
+    template<typename Request, typename = void>
+    struct has_value : std::false_type {
+    };
+
+    template<typename Request>
+    struct has_value<Request, std::void_t<decltype(std::declval<Request>().value.size())>> : std::true_type {
+    };
+
+    template<typename Request>
+    static std::size_t value_size(const Request& request)
+    {
+        if constexpr (has_value<Request>::value) {
+            return request.value.size();
+        } else {
+            return 0;
+        }
+    }
+
+    /**
+     * Picks the connection to the node, which has the least amount of outstanding work: bytes not yet written to the socket, and
+     * then requests waiting for response.
+     *
+     * When kv_large_value_threshold is set, the last connection of the node handles only large values, unless it is congested.
+     * Congested connections are only selected when all connections of the node are congested.
+     *
+     * Connections, which have not finished bootstrap, are skipped, because their negotiated features are not known yet. Returns
+     * nullptr when none of the connections of the node is bootstrapped.
+     */
+    std::shared_ptr<io::mcbp_session> select_session(std::size_t index, std::size_t value_bytes)
+    {
+        const auto& node_sessions = sessions_.at(index);
+        std::size_t candidates = node_sessions.size();
+        if (candidates == 1) {
+            return node_sessions.front()->is_bootstrapped() ? node_sessions.front() : nullptr;
+        }
+        std::size_t threshold = origin_.options().kv_large_value_threshold;
+        if (threshold > 0) {
+            const auto& large_values_session = node_sessions.back();
+            if (value_bytes >= threshold && large_values_session->is_bootstrapped() && !large_values_session->is_congested()) {
+                return large_values_session;
+            }
+            --candidates;
+        }
+        // start from the different connection every time, so that idle connections are used evenly
+        std::size_t offset = next_session_offset_++;
+        std::shared_ptr<io::mcbp_session> best{};
+        std::tuple<bool, std::size_t, std::size_t> best_load{};
+        for (std::size_t i = 0; i < candidates; ++i) {
+            const auto& session = node_sessions[(offset + i) % candidates];
+            if (!session->is_bootstrapped()) {
+                continue;
+            }
+            std::tuple<bool, std::size_t, std::size_t> load{ session->is_congested(),
+                                                             session->bytes_pending_write(),
+                                                             session->in_flight_requests() };
+            if (!best || load < best_load) {
+                best = session;
+                best_load = load;
+            }
+        }
+        return best;
+    }
+
+    std::shared_ptr<io::mcbp_session> make_session(const couchbase::origin& origin)
+    {
+        std::shared_ptr<io::mcbp_session> session;
+        if (origin_.options().enable_tls) {
+            session = std::make_shared<io::mcbp_session>(client_id_, io_pool_.next(), tls_, origin, name_, known_features_);
+        } else {
+            session = std::make_shared<io::mcbp_session>(client_id_, io_pool_.next(), origin, name_, known_features_);
+        }
+        session->attach_config_store(config_store_);
+        session->attach_collection_cache(collection_cache_);
+        if (tracer_) {
+            session->attach_tracer(tracer_);
+        }
+        if (errmap_) {
+            session->attach_error_map(errmap_);
+        }
+        session->on_stop([weak_self = weak_from_this(), id = session->id()]() {
+            if (auto self = weak_self.lock()) {
+                asio::post(self->ctx_, [self, id]() { self->on_session_stopped(id); });
+            }
+        });
+        return session;
+    }
+
+    [[nodiscard]] couchbase::origin node_origin(const configuration::node& n)
+    {
+        return { origin_.get_username(),
+                 origin_.get_password(),
+                 n.hostname,
+                 n.port_or(service_type::kv, origin_.options().enable_tls, 0),
+                 origin_.options() };
+    }
+
+    [[nodiscard]] std::string node_address(const configuration::node& n)
+    {
+        return fmt::format("{}:{}", n.hostname, n.port_or(service_type::kv, origin_.options().enable_tls, 0));
+    }
+
+    [[nodiscard]] const configuration::node* find_node(std::size_t index) const
+    {
+        if (config_) {
+            for (const auto& n : config_->nodes) {
+                if (n.index == index) {
+                    return &n;
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    /**
+     * Opens connections to the node, until it has kv_connections_per_node of them.
+     */
+    void connect_node(const configuration::node& n)
+    {
+        auto origin = node_origin(n);
+        auto& node_sessions = sessions_[n.index];
+        while (node_sessions.size() < origin_.options().kv_connections_per_node) {
+            auto s = make_session(origin);
+            start_session(s, node_address(n));
+            node_sessions.emplace_back(std::move(s));
+        }
+    }
+
+    void start_session(const std::shared_ptr<io::mcbp_session>& session, std::string address)
+    {
+        session->bootstrap([weak_self = weak_from_this(), session, address = std::move(address)](std::error_code ec,
+                                                                                                 const configuration& cfg) {
+            if (auto self = weak_self.lock()) {
+                asio::post(self->ctx_, [self, session, address, ec, cfg]() { self->on_node_bootstrap(session, address, ec, cfg); });
+            }
+        });
+    }
+
+    void bootstrap_from_seed()
+    {
+        if (closed_) {
+            std::exchange(bootstrap_handler_, nullptr)(std::make_error_code(error::common_errc::request_canceled), {});
+            return;
+        }
+        for (const auto& n : seed_->nodes) {
+            if (n.port_or(service_type::kv, origin_.options().enable_tls, 0) != 0) {
+                connect_node(n);
+                pending_seed_sessions_ += sessions_[n.index].size();
+            }
+        }
+    }
+
+    /**
+     * Invoked on the context of the bucket for every bootstrapped node session. Failed sessions are reconnected from
+     * on_session_stopped(), once the bucket has its configuration.
+     */
+    void on_node_bootstrap(const std::shared_ptr<io::mcbp_session>& session,
+                           const std::string& address,
+                           std::error_code ec,
+                           const configuration& cfg)
+    {
+        if (closed_) {
+            if (bootstrap_handler_) {
+                std::exchange(bootstrap_handler_, nullptr)(std::make_error_code(error::common_errc::request_canceled), {});
+            }
+            return;
+        }
+        if (ec) {
+            spdlog::warn("unable to bootstrap node {} ({}): {}", address, name_, ec.message());
+            if (!config_ && bootstrap_handler_ && --pending_seed_sessions_ == 0) {
+                std::exchange(bootstrap_handler_, nullptr)(ec, {});
+            }
+            return;
+        }
+        reconnect_attempts_.erase(address);
+        if (!config_ && bootstrap_handler_) {
+            on_bootstrap(ec, cfg, session);
+            std::exchange(bootstrap_handler_, nullptr)(ec, cfg);
+        } else if (config_) {
+            run_deferred_commands();
+        }
+    }
+
+    void on_bootstrap(std::error_code ec, const configuration& cfg, std::shared_ptr<io::mcbp_session> new_session)
+    {
+        if (ec) {
+            return;
+        }
+        config_store_->update(configuration(cfg));
+        config_ = config_store_->get();
+        if (!errmap_) {
+            errmap_ = new_session->errmap();
+        }
+        new_session->refresh_collections_manifest();
+        if (seed_) {
+            rebind_sessions(*seed_, *config_);
+            seed_.reset();
+        } else {
+            sessions_[new_session->index()].emplace_back(std::move(new_session));
+        }
+        for (const auto& n : config_->nodes) {
+            connect_node(n);
+        }
+        // sessions, which have failed before the configuration was known, have not been scheduled for reconnect
+        for (const auto& [index, node_sessions] : sessions_) {
+            for (const auto& session : node_sessions) {
+                if (session->is_stopped()) {
+                    schedule_reconnect(index, session->id());
+                }
+            }
+        }
+        run_deferred_commands();
+    }
+
+    /**
+     * The session has stopped. If it still serves its node, it is replaced with a new one after backoff. Commands mapped to the node
+     * meanwhile fail fast with request_canceled, and once the new session is connecting, they wait in the deferred queue for it to
+     * finish the handshake.
+     */
+    void on_session_stopped(const std::string& session_id)
+    {
+        if (closed_ || !config_) {
+            return;
+        }
+        for (const auto& [index, node_sessions] : sessions_) {
+            for (const auto& session : node_sessions) {
+                if (session->id() == session_id) {
+                    schedule_reconnect(index, session_id);
+                    return;
+                }
+            }
+        }
+    }
+
+    /**
+     * Exponential backoff between kv_reconnect_backoff_min and kv_reconnect_backoff_max, the second half of the delay is random, so
+     * that the connections of many clients to the restarted node are spread in time.
+     */
+    [[nodiscard]] std::chrono::milliseconds reconnect_backoff(std::size_t attempt)
+    {
+        using rep = std::chrono::milliseconds::rep;
+        const auto& options = origin_.options();
+        rep ceiling = std::min(options.kv_reconnect_backoff_min.count() * (rep{ 1 } << std::min<std::size_t>(attempt, 16)),
+                               options.kv_reconnect_backoff_max.count());
+        rep half = std::max<rep>(ceiling, 0) / 2;
+        return std::chrono::milliseconds(half + std::uniform_int_distribution<rep>(0, half)(random_));
+    }
+
+    void schedule_reconnect(std::size_t index, const std::string& session_id)
+    {
+        const auto* node = find_node(index);
+        if (node == nullptr || reconnect_timers_.count(session_id) > 0) {
+            return;
+        }
+        auto address = node_address(*node);
+        auto delay = reconnect_backoff(reconnect_attempts_[address]++);
+        spdlog::debug("{} reconnecting to node {} in {}ms", name_, address, delay.count());
+        auto timer = std::make_shared<asio::steady_timer>(ctx_, delay);
+        timer->async_wait([weak_self = weak_from_this(), session_id](std::error_code ec) {
+            if (ec == asio::error::operation_aborted) {
+                return;
+            }
+            if (auto self = weak_self.lock()) {
+                self->reconnect(session_id);
+            }
+        });
+        reconnect_timers_.emplace(session_id, std::move(timer));
+    }
+
+    void reconnect(const std::string& session_id)
+    {
+        reconnect_timers_.erase(session_id);
+        if (closed_) {
+            return;
+        }
+        for (auto& [index, node_sessions] : sessions_) {
+            for (auto& session : node_sessions) {
+                if (session->id() != session_id) {
+                    continue;
+                }
+                const auto* node = find_node(index);
+                if (node == nullptr) {
+                    return;
+                }
+                session = make_session(node_origin(*node));
+                start_session(session, node_address(*node));
+                return;
+            }
+        }
+    }
+
     std::string client_id_;
     asio::io_context& ctx_;
+    io::io_context_pool& io_pool_;
     asio::ssl::context& tls_;
     std::string name_;
     origin origin_;
 
-    std::optional<configuration> config_{};
+    std::shared_ptr<config_store> config_store_{ std::make_shared<config_store>() };
+    std::shared_ptr<collection_cache> collection_cache_{ std::make_shared<collection_cache>() };
+    config_store::config_ptr config_{};
     std::vector<protocol::hello_feature> known_features_;
 
     std::queue<std::function<void()>> deferred_commands_{};
+    std::uint64_t rejected_deferred_commands_{ 0 };
+
+    std::atomic_bool closed_{ false };
+    std::map<size_t, std::vector<std::shared_ptr<io::mcbp_session>>> sessions_{};
+    std::size_t next_session_offset_{ 0 };
+    std::shared_ptr<io::retry_counters> retry_counters_{ std::make_shared<io::retry_counters>() };
+    std::shared_ptr<tracing::threshold_logging_tracer> tracer_{};
+    std::shared_ptr<compression_policy> compression_{};
 
-    bool closed_{ false };
-    std::map<size_t, std::shared_ptr<io::mcbp_session>> sessions_{};
+    /** configuration of the cluster, until the nodes from it have delivered the configuration of the bucket */
+    std::optional<configuration> seed_{};
+    std::size_t pending_seed_sessions_{ 0 };
+    std::function<void(std::error_code, const configuration&)> bootstrap_handler_{};
+    /** shared by all sessions of the bucket, and fetched only when the cluster has not provided it */
+    std::shared_ptr<const error_map> errmap_{};
+    std::map<std::string, std::size_t> reconnect_attempts_{};
+    std::map<std::string, std::shared_ptr<asio::steady_timer>> reconnect_timers_{};
+    std::mt19937_64 random_{ std::random_device{}() };
 };
 } // namespace couchbase
@@ -27,14 +27,17 @@
 #include <cbsasl/scram-sha/stringutils.h>
 
 #include <cstring>
+#include <deque>
 #include <gsl/gsl>
 #include <iomanip>
 #include <iostream>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <sstream>
 #include <string>
+#include <tuple>
 
 namespace couchbase::sasl::mechanism::scram
 {
@@ -376,11 +379,69 @@ ClientBackend::step(std::string_view input)
     }
 }
 
+/**
+ * Salted passwords of the recently used credentials.
+ *
+ * PBKDF2 with thousands of iterations is the most expensive step of the
+ * handshake, and every connection of the client authenticates with the
+ * same credentials, for which the server sends the same salt and the same
+ * iteration count. The secret is only kept as its digest.
+ */
+class SaltedPasswordCache
+{
+  public:
+    std::string get(couchbase::crypto::Algorithm algorithm, const std::string& secret, const std::string& salt, unsigned int iterationCount)
+    {
+        auto key = makeKey(algorithm, secret, salt, iterationCount);
+        {
+            std::scoped_lock lock(mutex);
+            auto entry = entries.find(key);
+            if (entry != entries.end()) {
+                return entry->second;
+            }
+        }
+        auto salted = couchbase::crypto::PBKDF2_HMAC(algorithm, secret, salt, iterationCount);
+        std::scoped_lock lock(mutex);
+        if (entries.emplace(key, salted).second) {
+            order.push_back(std::move(key));
+            if (order.size() > capacity) {
+                entries.erase(order.front());
+                order.pop_front();
+            }
+        }
+        return salted;
+    }
+
+  private:
+    using Key = std::tuple<couchbase::crypto::Algorithm, std::string, std::string, unsigned int>;
+
+    static Key makeKey(couchbase::crypto::Algorithm algorithm,
+                       const std::string& secret,
+                       const std::string& salt,
+                       unsigned int iterationCount)
+    {
+        return { algorithm, couchbase::crypto::digest(algorithm, secret), salt, iterationCount };
+    }
+
+    static constexpr std::size_t capacity = 16;
+
+    std::mutex mutex;
+    std::map<Key, std::string> entries;
+    std::deque<Key> order;
+};
+
+static SaltedPasswordCache&
+saltedPasswordCache()
+{
+    static SaltedPasswordCache cache;
+    return cache;
+}
+
 bool
 ClientBackend::generateSaltedPassword(const std::string& secret)
 {
     try {
-        saltedPassword = couchbase::crypto::PBKDF2_HMAC(algorithm, secret, salt, iterationCount);
+        saltedPassword = saltedPasswordCache().get(algorithm, secret, salt, iterationCount);
         return true;
     } catch (...) {
         return false;
@@ -23,13 +23,16 @@
 
 #include <asio/ssl.hpp>
 
+#include <io/io_context_pool.hxx>
 #include <io/mcbp_session.hxx>
 #include <io/http_session_manager.hxx>
 #include <io/http_command.hxx>
+#include <io/tls_session_cache.hxx>
 #include <origin.hxx>
 #include <bucket.hxx>
 #include <operations.hxx>
 #include <operations/document_query.hxx>
+#include <query_cache.hxx>
 
 namespace couchbase
 {
@@ -40,6 +43,7 @@ class cluster
       : id_(uuid::to_string(uuid::random()))
       , ctx_(ctx)
       , work_(asio::make_work_guard(ctx_))
+      , io_pool_(ctx_)
       , tls_(asio::ssl::context::tls_client)
       , session_manager_(std::make_shared<io::http_session_manager>(id_, ctx_, tls_))
     {
@@ -49,11 +53,19 @@ class cluster
     void open(const couchbase::origin& origin, Handler&& handler)
     {
         origin_ = origin;
+        io_pool_.start(origin_.options().num_io_threads);
+        if (origin_.options().enable_tracing) {
+            tracer_ = std::make_shared<tracing::threshold_logging_tracer>(ctx_, origin_.options());
+            tracer_->start();
+        }
+        query_cache_.capacity(origin_.options().prepared_statement_cache_size);
+        compression_ = std::make_shared<compression_policy>(origin_.options());
         if (origin_.options().enable_tls) {
             tls_.set_options(asio::ssl::context::default_workarounds | asio::ssl::context::no_sslv2 | asio::ssl::context::no_sslv3);
             if (!origin_.options().trust_certificate.empty()) {
                 tls_.use_certificate_chain_file(origin_.options().trust_certificate);
             }
+            configure_tls();
 #ifdef TLS_KEY_LOG_FILE
             SSL_CTX_set_keylog_callback(tls_.native_handle(), [](const SSL* /* ssl */, const char* line) {
                 std::ofstream keylog(TLS_KEY_LOG_FILE, std::ios::out | std::ios::app | std::ios::binary);
@@ -67,9 +79,13 @@ class cluster
         } else {
             session_ = std::make_shared<io::mcbp_session>(id_, ctx_, origin_);
         }
+        if (tracer_) {
+            session_->attach_tracer(tracer_);
+        }
         session_->bootstrap([this, handler = std::forward<Handler>(handler)](std::error_code ec, const configuration& config) mutable {
             if (!ec) {
-                session_manager_->set_configuration(config, origin_.options());
+                session_manager_->set_configuration(std::make_shared<const configuration>(config), origin_);
+                enhanced_prepared_statements_ = config.supports_enhanced_prepared_statements();
             }
             handler(ec);
         });
@@ -82,9 +98,17 @@ class cluster
             if (session_) {
                 session_->stop();
             }
+            session_manager_->close();
             for (auto& bucket : buckets_) {
                 bucket.second->close();
             }
+            if (tracer_) {
+                tracer_->stop();
+            }
+            if (compression_) {
+                compression_->stop();
+            }
+            io_pool_.stop();
             handler();
             work_.reset();
         }));
@@ -94,51 +118,386 @@ class cluster
     void open_bucket(const std::string& bucket_name, Handler&& handler)
     {
         std::vector<protocol::hello_feature> known_features;
-        if (session_ && session_->has_config()) {
+        std::optional<configuration> seed{};
+        std::shared_ptr<const error_map> errmap{};
+        if (session_ && session_->is_bootstrapped() && session_->has_config()) {
             known_features = session_->supported_features();
+            errmap = session_->errmap();
+            if (session_->supports_gcccp()) {
+                seed = session_->config();
+            }
+        }
+        auto b = std::make_shared<bucket>(
+          id_, ctx_, io_pool_, tls_, bucket_name, origin_, known_features, tracer_, compression_, std::move(seed), std::move(errmap));
+        if (session_ && !session_->supports_gcccp()) {
+            // without cluster-level configuration, HTTP services follow the configuration of the bucket
+            b->on_configuration_update([manager = session_manager_, origin = origin_](config_store::config_ptr config) {
+                manager->set_configuration(std::move(config), origin);
+            });
         }
-        auto b = std::make_shared<bucket>(id_, ctx_, tls_, bucket_name, origin_, known_features);
         b->bootstrap([this, handler = std::forward<Handler>(handler)](std::error_code ec, const configuration& config) mutable {
             if (!ec && !session_->supports_gcccp()) {
-                session_manager_->set_configuration(config, origin_.options());
+                enhanced_prepared_statements_ = config.supports_enhanced_prepared_statements();
             }
             handler(ec);
         });
         buckets_.emplace(bucket_name, b);
     }
 
+    /**
+     * Dispatches the request to the bucket.
+     *
+     * Returns function, that might be used to cancel the operation from any thread. The handler will receive
+     * request_canceled error in this case. Empty function is returned when the handler has been invoked already.
+     */
     template<class Request, class Handler>
-    void execute(Request request, Handler&& handler)
+    std::function<void()> execute(Request request, Handler&& handler)
     {
         auto bucket = buckets_.find(request.id.bucket);
+        if constexpr (std::is_same_v<Request, operations::get_any_replica_request> ||
+                      std::is_same_v<Request, operations::get_all_replicas_request>) {
+            if (bucket == buckets_.end()) {
+                handler(typename Request::response_type{ request.id, std::make_error_code(error::common_errc::bucket_not_found) });
+                return {};
+            }
+            if constexpr (std::is_same_v<Request, operations::get_any_replica_request>) {
+                return bucket->second->execute_get_any_replica(std::move(request), std::forward<Handler>(handler));
+            } else {
+                return bucket->second->execute_get_all_replicas(std::move(request), std::forward<Handler>(handler));
+            }
+        } else {
+            if (bucket == buckets_.end()) {
+                handler(operations::make_response(std::make_error_code(error::common_errc::bucket_not_found), request, {}));
+                return {};
+            }
+            if constexpr (std::is_same_v<Request, operations::get_request>) {
+                if (origin_.options().kv_hedged_read_delay.count() > 0) {
+                    return bucket->second->execute_hedged_get(std::move(request), std::forward<Handler>(handler));
+                }
+            }
+            auto cmd = bucket->second->execute(request, std::forward<Handler>(handler));
+            if (!cmd) {
+                return {};
+            }
+            return [weak_cmd = std::weak_ptr<operations::mcbp_command<Request>>(cmd)]() {
+                if (auto c = weak_cmd.lock()) {
+                    asio::post(c->deadline.get_executor(),
+                               [c]() { c->cancel(std::make_error_code(error::common_errc::request_canceled)); });
+                }
+            };
+        }
+    }
+
+    /**
+     * Dispatches batch of requests to the bucket of the first request. All requests should belong to the same bucket.
+     *
+     * The handler receives vector of responses in the order of the requests. Returns cancellation function for the whole batch.
+     */
+    template<class Request, class Handler>
+    std::function<void()> execute_multi(std::vector<Request> requests, Handler&& handler)
+    {
+        auto bucket = requests.empty() ? buckets_.end() : buckets_.find(requests.front().id.bucket);
         if (bucket == buckets_.end()) {
-            return handler(operations::make_response(std::make_error_code(error::common_errc::bucket_not_found), request, {}));
+            std::vector<decltype(operations::make_response(std::error_code{}, requests.front(), {}))> responses;
+            responses.reserve(requests.size());
+            for (auto& request : requests) {
+                responses.emplace_back(
+                  operations::make_response(std::make_error_code(error::common_errc::bucket_not_found), request, {}));
+            }
+            handler(std::move(responses));
+            return {};
         }
-        return bucket->second->execute(request, std::forward<Handler>(handler));
+        auto cmds = bucket->second->execute_multi(std::move(requests), std::forward<Handler>(handler));
+        std::vector<std::weak_ptr<operations::mcbp_command<Request>>> weak_cmds(cmds.begin(), cmds.end());
+        return [weak_cmds = std::move(weak_cmds)]() {
+            for (const auto& weak_cmd : weak_cmds) {
+                if (auto c = weak_cmd.lock()) {
+                    asio::post(c->deadline.get_executor(),
+                               [c]() { c->cancel(std::make_error_code(error::common_errc::request_canceled)); });
+                }
+            }
+        };
     }
 
+    /**
+     * Dispatches the request to one of the service nodes.
+     *
+     * Returns cancellation function with the same semantics as cluster::execute().
+     */
     template<class Request, class Handler>
-    void execute_http(Request request, Handler&& handler)
+    std::function<void()> execute_http(Request request, Handler&& handler)
     {
-        auto session = session_manager_->check_out(Request::type, origin_.get_username(), origin_.get_password());
-        if (!session) {
-            return handler(operations::make_response(std::make_error_code(error::common_errc::service_not_available), request, {}));
+        if constexpr (std::is_same_v<Request, operations::query_request>) {
+            if (!request.adhoc && origin_.options().prepared_statement_cache_size > 0) {
+                return execute_prepared_query(std::move(request), std::forward<Handler>(handler));
+            }
+            request.adhoc = true;
         }
-        auto cmd = std::make_shared<operations::http_command<Request>>(ctx_, request);
-        cmd->send_to(session, [this, session, handler = std::forward<Handler>(handler)](typename Request::response_type resp) mutable {
-            handler(std::move(resp));
-            session_manager_->check_in(Request::type, session);
-        });
+        return send_http(std::move(request), std::forward<Handler>(handler));
+    }
+
+    [[nodiscard]] query_cache::stats query_cache_stats()
+    {
+        return query_cache_.get_stats();
+    }
+
+    /**
+     * Returns counters of compression of the mutations, shared by all open buckets.
+     */
+    [[nodiscard]] compression_policy::stats compression_stats()
+    {
+        if (!compression_) {
+            return {};
+        }
+        return compression_->get_stats();
+    }
+
+    /**
+     * Returns counters of TLS handshakes of all KV and HTTP sessions.
+     */
+    [[nodiscard]] io::tls_session_cache::stats tls_stats()
+    {
+        if (!tls_session_cache_) {
+            return {};
+        }
+        return tls_session_cache_->get_stats();
+    }
+
+    [[nodiscard]] std::size_t tls_cached_sessions()
+    {
+        if (!tls_session_cache_) {
+            return 0;
+        }
+        return tls_session_cache_->size();
+    }
+
+    /**
+     * Returns number of retried KV requests for every reason, summed over all open buckets.
+     */
+    [[nodiscard]] std::map<io::retry_reason, std::uint64_t> retry_stats()
+    {
+        std::map<io::retry_reason, std::uint64_t> stats;
+        for (auto reason : io::retry_reasons) {
+            stats[reason] = 0;
+            for (const auto& bucket : buckets_) {
+                stats[reason] += bucket.second->retry_counters().count(reason);
+            }
+        }
+        return stats;
+    }
+
+    /**
+     * Collects snapshot of the queues and latencies of all KV sessions and HTTP endpoints on the context of the cluster, and passes
+     * it to the handler.
+     */
+    template<typename Handler>
+    void metrics(Handler&& handler)
+    {
+        asio::post(asio::bind_executor(ctx_, [this, handler = std::forward<Handler>(handler)]() mutable {
+            metrics::cluster_metrics result{};
+            for (const auto& bucket : buckets_) {
+                result.buckets.emplace_back(bucket.second->metrics());
+            }
+            result.endpoints = session_manager_->metrics();
+            handler(std::move(result));
+        }));
     }
 
   private:
+    template<class Request, class Handler>
+    std::function<void()> send_http(Request request, Handler&& handler)
+    {
+        auto cmd = std::make_shared<operations::http_command<Request>>(ctx_, request, tracer_);
+        auto timeout = request.timeout;
+        session_manager_->check_out(
+          Request::type,
+          timeout,
+          [this, cmd, started = std::chrono::steady_clock::now(), handler = std::forward<Handler>(handler)](
+            std::error_code ec, std::shared_ptr<io::http_session> session) mutable {
+              if (!ec && cmd->cancelled_) {
+                  session_manager_->check_in(Request::type, session);
+                  ec = std::make_error_code(error::common_errc::request_canceled);
+              }
+              if (ec) {
+                  return handler(operations::make_response(ec, cmd->request, {}));
+              }
+              /* the time spent waiting for the session counts towards the timeout of the request */
+              auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+              cmd->request.timeout = std::max(cmd->request.timeout - waited, std::chrono::milliseconds(1));
+              cmd->send_to(session, [this, session, handler = std::move(handler)](typename Request::response_type resp) mutable {
+                  handler(std::move(resp));
+                  session_manager_->check_in(Request::type, session);
+              });
+          });
+        return [weak_cmd = std::weak_ptr<operations::http_command<Request>>(cmd)]() {
+            if (auto c = weak_cmd.lock()) {
+                asio::post(c->deadline.get_executor(), [c]() { c->cancel(); });
+            }
+        };
+    }
+
+    /**
+     * Tracks the request, that is currently in flight for the query, which might take several round trips.
+     */
+    struct query_flow {
+        std::mutex mutex{};
+        std::function<void()> cancel_current{};
+        std::uint64_t current_step{ 0 };
+        std::uint64_t next_step{ 0 };
+        bool cancelled{ false };
+    };
+
+    using query_handler = std::function<void(operations::query_response&&)>;
+
+    /**
+     * Executes non-adhoc query using the prepared statements cache.
+     *
+     * Statements missing in the cache are prepared first: with enhanced prepared statements the server executes the query in the
+     * same round trip, otherwise the plan is prepared in separate request. When the server does not recognize cached statement
+     * anymore, the entry is invalidated and the statement is prepared again.
+     */
+    template<class Handler>
+    std::function<void()> execute_prepared_query(operations::query_request request, Handler&& handler)
+    {
+        auto flow = std::make_shared<query_flow>();
+        query_handler on_response = std::forward<Handler>(handler);
+        auto cached = query_cache_.get(request.statement);
+        if (cached) {
+            request.prepared = cached;
+            send_query_step(flow, request, [this, flow, request, on_response](operations::query_response&& resp) mutable {
+                if (resp.ec == std::make_error_code(error::query_errc::prepared_statement_failure)) {
+                    spdlog::debug(R"(prepared statement is not recognized, prepare it again: "{}")", request.statement);
+                    query_cache_.invalidate(request.statement);
+                    request.prepared.reset();
+                    return prepare_query(flow, std::move(request), std::move(on_response));
+                }
+                on_response(std::move(resp));
+            });
+        } else {
+            prepare_query(flow, std::move(request), std::move(on_response));
+        }
+        return [flow]() {
+            std::function<void()> cancel;
+            {
+                std::scoped_lock lock(flow->mutex);
+                flow->cancelled = true;
+                std::swap(cancel, flow->cancel_current);
+            }
+            if (cancel) {
+                cancel();
+            }
+        };
+    }
+
+    void prepare_query(std::shared_ptr<query_flow> flow, operations::query_request request, query_handler&& on_response)
+    {
+        if (enhanced_prepared_statements_) {
+            request.auto_execute = true;
+            send_query_step(flow, request, [this, statement = request.statement, on_response](operations::query_response&& resp) {
+                if (!resp.ec && resp.payload.meta_data.prepared) {
+                    query_cache_.put(statement, { resp.payload.meta_data.prepared.value() });
+                }
+                on_response(std::move(resp));
+            });
+            return;
+        }
+
+        operations::query_request prepare_request = request;
+        prepare_request.positional_parameters.clear();
+        prepare_request.named_parameters.clear();
+        prepare_request.row_callback = nullptr;
+        prepare_request.streaming.reset();
+        send_query_step(flow, prepare_request, [this, flow, request, on_response](operations::query_response&& resp) mutable {
+            if (resp.ec) {
+                return on_response(std::move(resp));
+            }
+            query_cache::entry_type entry{};
+            try {
+                auto plan = tao::json::from_string(resp.payload.rows.at(0));
+                entry.name = plan.at("name").get_string();
+                if (const auto* encoded_plan = plan.find("encoded_plan"); encoded_plan != nullptr) {
+                    entry.encoded_plan = encoded_plan->get_string();
+                }
+            } catch (const std::exception& e) {
+                spdlog::warn(R"(unable to parse result of PREPARE for "{}": {})", request.statement, e.what());
+                resp.ec = std::make_error_code(error::query_errc::prepared_statement_failure);
+                return on_response(std::move(resp));
+            }
+            query_cache_.put(request.statement, entry);
+            request.prepared = entry;
+            send_query_step(flow, request, std::move(on_response));
+        });
+    }
+
+    void send_query_step(const std::shared_ptr<query_flow>& flow, operations::query_request request, query_handler&& on_response)
+    {
+        std::uint64_t step = 0;
+        {
+            std::scoped_lock lock(flow->mutex);
+            if (!flow->cancelled) {
+                step = ++flow->next_step;
+            }
+        }
+        if (step == 0) {
+            return on_response(operations::make_response(std::make_error_code(error::common_errc::request_canceled), request, {}));
+        }
+        auto cancel = send_http(std::move(request), std::move(on_response));
+        std::scoped_lock lock(flow->mutex);
+        if (flow->cancelled) {
+            if (cancel) {
+                cancel();
+            }
+        } else if (step > flow->current_step) {
+            // the previous step might complete and start the next one before its own cancellation function is stored
+            flow->current_step = step;
+            flow->cancel_current = std::move(cancel);
+        }
+    }
+
+    /**
+     * Applies protocol and cipher settings to the shared SSL context, and attaches the session cache. Must be called before any
+     * session has been created.
+     */
+    void configure_tls()
+    {
+        const auto& options = origin_.options();
+        SSL_CTX* native = tls_.native_handle();
+        if (!options.tls_min_version.empty()) {
+            int version = 0;
+            if (options.tls_min_version == "1.2") {
+                version = TLS1_2_VERSION;
+            } else if (options.tls_min_version == "1.3") {
+                version = TLS1_3_VERSION;
+            }
+            if (version == 0 || SSL_CTX_set_min_proto_version(native, version) != 1) {
+                spdlog::warn("[{}]: unable to set minimal TLS version to \"{}\", ignoring", id_, options.tls_min_version);
+            }
+        }
+        if (!options.tls_cipher_list.empty() && SSL_CTX_set_cipher_list(native, options.tls_cipher_list.c_str()) != 1) {
+            spdlog::warn("[{}]: unable to set TLS cipher list \"{}\", ignoring", id_, options.tls_cipher_list);
+        }
+        if (!options.tls_ciphersuites.empty() && SSL_CTX_set_ciphersuites(native, options.tls_ciphersuites.c_str()) != 1) {
+            spdlog::warn("[{}]: unable to set TLS 1.3 cipher suites \"{}\", ignoring", id_, options.tls_ciphersuites);
+        }
+        if (options.tls_session_resumption) {
+            tls_session_cache_ = std::make_shared<io::tls_session_cache>();
+            tls_session_cache_->attach(native);
+        }
+    }
+
     std::string id_;
     asio::io_context& ctx_;
     asio::executor_work_guard<asio::io_context::executor_type> work_;
+    io::io_context_pool io_pool_;
     asio::ssl::context tls_;
     std::shared_ptr<io::http_session_manager> session_manager_;
     std::shared_ptr<io::mcbp_session> session_{};
     std::map<std::string, std::shared_ptr<bucket>> buckets_{};
     couchbase::origin origin_{};
+    query_cache query_cache_{};
+    std::atomic_bool enhanced_prepared_statements_{ false };
+    std::shared_ptr<tracing::threshold_logging_tracer> tracer_{};
+    std::shared_ptr<compression_policy> compression_{};
+    std::shared_ptr<io::tls_session_cache> tls_session_cache_{};
 };
 } // namespace couchbase
@@ -35,17 +35,60 @@ struct cluster_options {
 
     bool enable_tls{ false };
     std::string trust_certificate{};
+    bool tls_session_resumption{ true };
+    std::string tls_min_version{};
+    std::string tls_cipher_list{};
+    std::string tls_ciphersuites{};
     bool enable_mutation_tokens{ true };
     bool enable_tcp_keep_alive{ true };
+    bool enable_unordered_execution{ true };
     bool force_ipv4{ false };
 
+    bool enable_compression{ true };
+    size_t compression_min_size{ 32 };
+    double compression_min_ratio{ 0.83 };
+    bool compression_adaptive{ false };
+    size_t compression_offload_threshold{ 1024 * 1024 };
+
     std::chrono::milliseconds tcp_keep_alive_interval = timeout_defaults::tcp_keep_alive_interval;
     std::chrono::milliseconds config_poll_interval = timeout_defaults::config_poll_interval;
     std::chrono::milliseconds config_poll_floor = timeout_defaults::config_poll_floor;
     std::chrono::milliseconds config_idle_redial_timeout = timeout_defaults::config_idle_redial_timeout;
 
+    size_t num_io_threads{ 1 };
+    size_t kv_connections_per_node{ 1 };
+    size_t kv_large_value_threshold{ 0 };
+    std::chrono::milliseconds kv_hedged_read_delay = timeout_defaults::kv_hedged_read_delay;
+    size_t kv_max_in_flight_requests{ 8192 };
+    size_t kv_max_queued_bytes{ 64 * 1024 * 1024 };
+    size_t kv_max_deferred_commands{ 65536 };
+    bool kv_backpressure_wait{ false };
+    size_t kv_write_chunk_size{ 16384 };
+    std::chrono::microseconds kv_write_cork_delay{ 0 };
+    std::chrono::milliseconds kv_reconnect_backoff_min = timeout_defaults::kv_reconnect_backoff_min;
+    std::chrono::milliseconds kv_reconnect_backoff_max = timeout_defaults::kv_reconnect_backoff_max;
+    size_t prepared_statement_cache_size{ 5000 };
+    size_t socket_receive_buffer_size{ 0 };
+
     size_t max_http_connections{ 0 };
+    size_t http_prewarm_connections{ 0 };
     std::chrono::milliseconds idle_http_connection_timeout = timeout_defaults::idle_http_connection_timeout;
+    bool http_compression_query{ false };
+    bool http_compression_analytics{ false };
+    bool http_compression_search{ false };
+    bool http_compression_views{ false };
+
+    bool enable_tracing{ false };
+    std::chrono::milliseconds tracing_threshold_kv = timeout_defaults::tracing_threshold_kv;
+    std::chrono::milliseconds tracing_threshold_query = timeout_defaults::tracing_threshold_query;
+    std::chrono::milliseconds tracing_threshold_view = timeout_defaults::tracing_threshold_view;
+    std::chrono::milliseconds tracing_threshold_search = timeout_defaults::tracing_threshold_search;
+    std::chrono::milliseconds tracing_threshold_analytics = timeout_defaults::tracing_threshold_analytics;
+    std::chrono::milliseconds tracing_threshold_management = timeout_defaults::tracing_threshold_management;
+    std::chrono::milliseconds tracing_threshold_emit_interval = timeout_defaults::tracing_threshold_emit_interval;
+    size_t tracing_threshold_sample_size{ 10 };
+    std::chrono::milliseconds tracing_orphaned_emit_interval = timeout_defaults::tracing_orphaned_emit_interval;
+    size_t tracing_orphaned_sample_size{ 10 };
 };
 
 } // namespace couchbase
@@ -0,0 +1,143 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include <gsl/gsl_assert>
+
+#include <collections_manifest.hxx>
+
+namespace couchbase
+{
+
+/**
+ * Collection identifiers of the bucket, shared by all its sessions.
+ *
+ * The cache is filled from the collections manifest as a whole, and replaced when a manifest with greater uid arrives. Collections
+ * created after the manifest has been fetched are resolved one by one, and added to the cache until the next manifest.
+ */
+class collection_cache
+{
+  public:
+    collection_cache()
+    {
+        cid_map_.emplace(default_collection, 0);
+    }
+
+    [[nodiscard]] std::optional<std::uint32_t> get(const std::string& path) const
+    {
+        Expects(!path.empty());
+        std::shared_lock lock(mutex_);
+        auto ptr = cid_map_.find(path);
+        if (ptr != cid_map_.end()) {
+            return ptr->second;
+        }
+        return {};
+    }
+
+    void update(const std::string& path, std::uint32_t id)
+    {
+        Expects(!path.empty());
+        std::unique_lock lock(mutex_);
+        cid_map_[path] = id;
+    }
+
+    /**
+     * Replaces all entries with the collections of the manifest, unless its uid is not greater than the uid of the manifest
+     * applied already. Returns true if the manifest has been applied.
+     */
+    bool update(const collections_manifest& manifest)
+    {
+        map_type cid_map;
+        cid_map.emplace(default_collection, 0);
+        for (const auto& scope : manifest.scopes) {
+            for (const auto& collection : scope.collections) {
+                cid_map[scope.name + "." + collection.name] = static_cast<std::uint32_t>(collection.uid);
+            }
+        }
+        std::unique_lock lock(mutex_);
+        if (manifest_uid_ && manifest.uid <= manifest_uid_.value()) {
+            return false;
+        }
+        manifest_uid_ = manifest.uid;
+        cid_map_ = std::move(cid_map);
+        return true;
+    }
+
+    /**
+     * Returns true when the manifest uid, reported by the node, is greater than the uid of the manifest in the cache.
+     */
+    [[nodiscard]] bool is_outdated(std::uint64_t manifest_uid) const
+    {
+        std::shared_lock lock(mutex_);
+        return !manifest_uid_ || manifest_uid > manifest_uid_.value();
+    }
+
+    /**
+     * Marks the refresh of the manifest as started. Returns false if some other session is fetching the manifest already.
+     */
+    [[nodiscard]] bool begin_refresh()
+    {
+        std::unique_lock lock(mutex_);
+        if (refreshing_) {
+            return false;
+        }
+        refreshing_ = true;
+        return true;
+    }
+
+    void end_refresh()
+    {
+        std::unique_lock lock(mutex_);
+        refreshing_ = false;
+    }
+
+  private:
+    /**
+     * FNV-1a, which is cheap for short strings like collection paths.
+     */
+    struct path_hash {
+        std::size_t operator()(std::string_view path) const noexcept
+        {
+            std::uint64_t hash = 0xcbf29ce484222325ULL;
+            for (char c : path) {
+                hash ^= static_cast<std::uint8_t>(c);
+                hash *= 0x100000001b3ULL;
+            }
+            return hash;
+        }
+    };
+
+    using map_type = std::unordered_map<std::string, std::uint32_t, path_hash>;
+
+    static constexpr const char* default_collection = "_default._default";
+
+    mutable std::shared_mutex mutex_{};
+    map_type cid_map_{};
+    std::optional<std::uint64_t> manifest_uid_{};
+    bool refreshing_{ false };
+};
+
+} // namespace couchbase
@@ -0,0 +1,205 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <asio/post.hpp>
+#include <asio/thread_pool.hpp>
+
+#include <spdlog/fmt/fmt.h>
+
+#include <cluster_options.hxx>
+#include <document_id.hxx>
+#include <protocol/compression.hxx>
+
+namespace couchbase
+{
+
+/**
+ * Decides which mutations should be compressed with snappy, and keeps the counters of the compression.
+ *
+ * In adaptive mode the policy tracks rolling ratio of compressed to original size for every collection, and stops attempting
+ * compression for the collection when the ratio stays above compression_min_ratio (e.g. the values are already compressed images).
+ * Every probe_interval-th mutation of such collection is still compressed, so that the policy notices when the data changes.
+ *
+ * Values of at least compression_offload_threshold bytes are compressed on the dedicated thread, to not delay other requests on the
+ * I/O thread.
+ */
+class compression_policy
+{
+  public:
+    struct stats {
+        /** mutations, which have been compressed (including those where compression has not been good enough) */
+        std::uint64_t attempts{ 0 };
+        /** mutations, which have been sent compressed */
+        std::uint64_t compressed{ 0 };
+        /** mutations sent without attempt to compress in adaptive mode */
+        std::uint64_t skipped{ 0 };
+        /** mutations compressed on the dedicated thread */
+        std::uint64_t offloaded{ 0 };
+        /** size of the values seen by the compressor */
+        std::uint64_t bytes_in{ 0 };
+        /** difference between original and compressed size for the values sent compressed */
+        std::uint64_t bytes_saved{ 0 };
+        /** time spent in the compressor */
+        std::uint64_t time_us{ 0 };
+    };
+
+    static constexpr std::uint32_t min_samples = 8;
+    static constexpr std::uint32_t probe_interval = 32;
+    static constexpr double smoothing = 0.1;
+
+    explicit compression_policy(const cluster_options& options)
+      : enabled_(options.enable_compression)
+      , adaptive_(options.compression_adaptive)
+      , offload_threshold_(options.compression_offload_threshold)
+      , parameters_{ options.compression_min_size, options.compression_min_ratio }
+    {
+        if (enabled_ && offload_threshold_ > 0) {
+            pool_ = std::make_unique<asio::thread_pool>(1);
+        }
+    }
+
+    [[nodiscard]] const protocol::compression_parameters& parameters() const
+    {
+        return parameters_;
+    }
+
+    /**
+     * Returns true if the value of the mutation into the collection should be compressed.
+     */
+    [[nodiscard]] bool should_compress(const document_id& id, std::size_t value_size)
+    {
+        if (!enabled_ || value_size <= parameters_.min_size) {
+            return false;
+        }
+        if (!adaptive_) {
+            return true;
+        }
+        std::scoped_lock lock(mutex_);
+        auto& entry = collections_[collection_key(id)];
+        if (entry.samples < min_samples || entry.ratio < parameters_.min_ratio || ++entry.skipped % probe_interval == 0) {
+            return true;
+        }
+        skipped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    /**
+     * Records the outcome of the compression.
+     */
+    void record(const document_id& id, const protocol::compression_result& result, std::chrono::steady_clock::duration elapsed)
+    {
+        attempts_.fetch_add(1, std::memory_order_relaxed);
+        bytes_in_.fetch_add(result.original_size, std::memory_order_relaxed);
+        time_us_.fetch_add(static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()),
+                           std::memory_order_relaxed);
+        if (result.accepted) {
+            compressed_.fetch_add(1, std::memory_order_relaxed);
+            bytes_saved_.fetch_add(result.original_size - result.compressed_size, std::memory_order_relaxed);
+        }
+        if (!adaptive_ || result.original_size == 0) {
+            return;
+        }
+        double ratio = static_cast<double>(result.compressed_size) / static_cast<double>(result.original_size);
+        std::scoped_lock lock(mutex_);
+        auto& entry = collections_[collection_key(id)];
+        entry.ratio = entry.samples == 0 ? ratio : entry.ratio + smoothing * (ratio - entry.ratio);
+        if (entry.samples < min_samples) {
+            ++entry.samples;
+        }
+        entry.skipped = 0;
+    }
+
+    /**
+     * Returns true if the value is large enough to be compressed on the dedicated thread.
+     */
+    [[nodiscard]] bool should_offload(std::size_t value_size) const
+    {
+        return pool_ && value_size >= offload_threshold_;
+    }
+
+    template<typename Function>
+    void offload(Function&& function)
+    {
+        offloaded_.fetch_add(1, std::memory_order_relaxed);
+        asio::post(*pool_, std::forward<Function>(function));
+    }
+
+    /**
+     * Waits for the values, which are being compressed, and stops the thread.
+     */
+    void stop()
+    {
+        if (pool_) {
+            pool_->join();
+        }
+    }
+
+    [[nodiscard]] stats get_stats() const
+    {
+        stats result{};
+        result.attempts = attempts_.load(std::memory_order_relaxed);
+        result.compressed = compressed_.load(std::memory_order_relaxed);
+        result.skipped = skipped_.load(std::memory_order_relaxed);
+        result.offloaded = offloaded_.load(std::memory_order_relaxed);
+        result.bytes_in = bytes_in_.load(std::memory_order_relaxed);
+        result.bytes_saved = bytes_saved_.load(std::memory_order_relaxed);
+        result.time_us = time_us_.load(std::memory_order_relaxed);
+        return result;
+    }
+
+  private:
+    static std::string collection_key(const document_id& id)
+    {
+        return fmt::format("{}/{}", id.bucket, id.collection);
+    }
+
+    struct collection_state {
+        double ratio{ 0 };
+        std::uint32_t samples{ 0 };
+        std::uint32_t skipped{ 0 };
+    };
+
+    bool enabled_;
+    bool adaptive_;
+    std::size_t offload_threshold_;
+    protocol::compression_parameters parameters_;
+    std::unique_ptr<asio::thread_pool> pool_{};
+
+    std::mutex mutex_{};
+    std::unordered_map<std::string, collection_state> collections_{};
+
+    std::atomic<std::uint64_t> attempts_{ 0 };
+    std::atomic<std::uint64_t> compressed_{ 0 };
+    std::atomic<std::uint64_t> skipped_{ 0 };
+    std::atomic<std::uint64_t> offloaded_{ 0 };
+    std::atomic<std::uint64_t> bytes_in_{ 0 };
+    std::atomic<std::uint64_t> bytes_saved_{ 0 };
+    std::atomic<std::uint64_t> time_us_{ 0 };
+};
+
+} // namespace couchbase
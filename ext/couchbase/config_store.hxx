@@ -0,0 +1,212 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <tao/json.hpp>
+
+#include <spdlog/spdlog.h>
+
+#include <configuration.hxx>
+#include <protocol/cmd_get_cluster_config.hxx>
+
+namespace couchbase
+{
+
+/**
+ * Latest configuration of the bucket, shared by all its sessions.
+ *
+ * Every node delivers the same configuration, so the sessions pass the raw JSON here, and it is parsed only when its revision is
+ * newer than the one already known. The parsed configuration is immutable, and listeners (the bucket, HTTP session manager) receive
+ * the same shared instance. The store also elects the session which polls the configuration, so that the cluster is not asked for
+ * it by every connection.
+ */
+class config_store
+{
+  public:
+    using config_ptr = std::shared_ptr<const configuration>;
+    using listener_type = std::function<void(config_ptr)>;
+
+    /**
+     * Extracts top-level "rev" without building the document. Returns empty optional if the field cannot be found.
+     */
+    [[nodiscard]] static std::optional<std::uint64_t> peek_revision(std::string_view json)
+    {
+        int depth = 0;
+        bool in_string = false;
+        bool escape = false;
+        std::size_t string_start = 0;
+        for (std::size_t i = 0; i < json.size(); ++i) {
+            char c = json[i];
+            if (in_string) {
+                if (escape) {
+                    escape = false;
+                } else if (c == '\\') {
+                    escape = true;
+                } else if (c == '"') {
+                    in_string = false;
+                    if (depth == 1 && json.substr(string_start, i - string_start) == "rev") {
+                        std::size_t pos = skip_spaces(json, i + 1);
+                        if (pos < json.size() && json[pos] == ':') {
+                            return parse_number(json, skip_spaces(json, pos + 1));
+                        }
+                    }
+                }
+                continue;
+            }
+            switch (c) {
+                case '"':
+                    in_string = true;
+                    string_start = i + 1;
+                    break;
+                case '{':
+                case '[':
+                    ++depth;
+                    break;
+                case '}':
+                case ']':
+                    --depth;
+                    break;
+                default:
+                    break;
+            }
+        }
+        return {};
+    }
+
+    [[nodiscard]] config_ptr get() const
+    {
+        std::scoped_lock lock(mutex_);
+        return config_;
+    }
+
+    [[nodiscard]] bool is_newer(std::uint64_t rev) const
+    {
+        std::scoped_lock lock(mutex_);
+        return !config_ || rev > config_->rev;
+    }
+
+    /**
+     * Parses the configuration received by the session, unless its revision is not newer than known one.
+     *
+     * The endpoint_address is the address of the node, which has sent the configuration, it is used when the node does not know
+     * its own hostname. Returns the configuration if it has been applied.
+     */
+    config_ptr update(std::string_view json, const std::string& endpoint_address)
+    {
+        if (auto rev = peek_revision(json); rev && !is_newer(rev.value())) {
+            return nullptr;
+        }
+        configuration config;
+        try {
+            config = tao::json::from_string<protocol::deduplicate_keys>(std::string(json)).as<configuration>();
+        } catch (const std::exception& e) {
+            spdlog::warn("unable to parse configuration: {}", e.what());
+            return nullptr;
+        }
+        for (auto& node : config.nodes) {
+            if (node.this_node && node.hostname.empty()) {
+                node.hostname = endpoint_address;
+            }
+        }
+        return update(std::move(config));
+    }
+
+    /**
+     * Stores already parsed configuration, unless its revision is not newer than known one.
+     *
+     * Listeners are invoked under the lock to keep the order of revisions, so they must not call back to the store.
+     */
+    config_ptr update(configuration&& config)
+    {
+        std::scoped_lock lock(mutex_);
+        if (config_ && config.rev <= config_->rev) {
+            return nullptr;
+        }
+        config_ = std::make_shared<const configuration>(std::move(config));
+        for (const auto& listener : listeners_) {
+            listener(config_);
+        }
+        return config_;
+    }
+
+    void subscribe(listener_type&& listener)
+    {
+        std::scoped_lock lock(mutex_);
+        listeners_.emplace_back(std::move(listener));
+    }
+
+    /**
+     * Returns true when the session is responsible for polling of the configuration. The first session asking becomes the poller,
+     * and keeps this role until it releases it.
+     */
+    [[nodiscard]] bool acquire_poller(const std::string& session_id)
+    {
+        std::scoped_lock lock(mutex_);
+        if (poller_.empty()) {
+            poller_ = session_id;
+        }
+        return poller_ == session_id;
+    }
+
+    void release_poller(const std::string& session_id)
+    {
+        std::scoped_lock lock(mutex_);
+        if (poller_ == session_id) {
+            poller_.clear();
+        }
+    }
+
+  private:
+    static std::size_t skip_spaces(std::string_view json, std::size_t pos)
+    {
+        while (pos < json.size() && (json[pos] == ' ' || json[pos] == '\t' || json[pos] == '\n' || json[pos] == '\r')) {
+            ++pos;
+        }
+        return pos;
+    }
+
+    static std::optional<std::uint64_t> parse_number(std::string_view json, std::size_t pos)
+    {
+        std::uint64_t value = 0;
+        std::size_t start = pos;
+        while (pos < json.size() && json[pos] >= '0' && json[pos] <= '9') {
+            value = value * 10 + static_cast<std::uint64_t>(json[pos] - '0');
+            ++pos;
+        }
+        if (pos == start) {
+            return {};
+        }
+        return value;
+    }
+
+    mutable std::mutex mutex_{};
+    config_ptr config_{};
+    std::vector<listener_type> listeners_{};
+    std::string poller_{};
+};
+
+} // namespace couchbase
@@ -17,6 +17,12 @@
 
 #pragma once
 
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string_view>
+#include <vector>
+
 #include <gsl/gsl_util>
 
 #include <tao/json.hpp>
@@ -90,7 +96,56 @@ struct configuration {
         }
     };
 
-    using vbucket_map = typename std::vector<std::vector<std::int16_t>>;
+    /**
+     * Partition map stored as one contiguous table: every row holds index of the active node followed by the indexes of replicas, and
+     * -1 for the copies, which are not assigned to any node.
+     */
+    class vbucket_map
+    {
+      public:
+        vbucket_map() = default;
+
+        vbucket_map(std::size_t num_partitions, std::size_t num_copies)
+          : num_copies_(num_copies)
+          , servers_(num_partitions * num_copies, -1)
+        {
+        }
+
+        [[nodiscard]] std::size_t size() const
+        {
+            return num_copies_ == 0 ? 0 : servers_.size() / num_copies_;
+        }
+
+        [[nodiscard]] std::size_t num_copies() const
+        {
+            return num_copies_;
+        }
+
+        [[nodiscard]] std::int16_t active(std::size_t partition) const
+        {
+            return servers_[partition * num_copies_];
+        }
+
+        /**
+         * Returns node index of the replica (zero-based), or -1 if it is not assigned.
+         */
+        [[nodiscard]] std::int16_t replica(std::size_t partition, std::size_t replica_index) const
+        {
+            if (replica_index + 1 >= num_copies_) {
+                return -1;
+            }
+            return servers_[partition * num_copies_ + replica_index + 1];
+        }
+
+        void set(std::size_t partition, std::size_t copy, std::int16_t server)
+        {
+            servers_[partition * num_copies_ + copy] = server;
+        }
+
+      private:
+        std::size_t num_copies_{ 0 };
+        std::vector<std::int16_t> servers_{};
+    };
 
     std::uint64_t rev{};
     couchbase::uuid::uuid_t id{};
@@ -99,6 +154,13 @@ struct configuration {
     std::optional<std::string> uuid{};
     std::optional<std::string> bucket{};
     std::optional<vbucket_map> vbmap{};
+    std::map<std::string, std::set<std::string>> cluster_capabilities{};
+
+    [[nodiscard]] bool supports_enhanced_prepared_statements() const
+    {
+        auto caps = cluster_capabilities.find("n1ql");
+        return caps != cluster_capabilities.end() && caps->second.count("enhancedPreparedStatements") > 0;
+    }
 
     size_t index_for_endpoint(const asio::ip::tcp::endpoint& endpoint)
     {
@@ -121,14 +183,39 @@ struct configuration {
         throw std::runtime_error("no nodes marked as this_node");
     }
 
-    std::pair<uint16_t, size_t> map_key(const std::string& key)
+    std::pair<uint16_t, size_t> map_key(std::string_view key) const
     {
-        if (!vbmap.has_value()) {
+        if (!vbmap.has_value() || vbmap->size() == 0) {
             throw std::runtime_error("cannot map key: partition map is not available");
         }
-        uint32_t crc = utils::hash_crc32(key.data(), key.size());
-        uint16_t vbucket = uint16_t(crc % vbmap->size());
-        return std::make_pair(vbucket, static_cast<std::size_t>(vbmap->at(vbucket)[0]));
+        return map_key_unchecked(*vbmap, key);
+    }
+
+    /**
+     * Maps the batch of keys, checks availability of the partition map only once.
+     *
+     * Keys is a range of objects convertible to std::string_view.
+     */
+    template<typename Keys>
+    std::vector<std::pair<uint16_t, size_t>> map_keys(const Keys& keys) const
+    {
+        if (!vbmap.has_value() || vbmap->size() == 0) {
+            throw std::runtime_error("cannot map keys: partition map is not available");
+        }
+        std::vector<std::pair<uint16_t, size_t>> result;
+        result.reserve(std::size(keys));
+        for (const auto& key : keys) {
+            result.emplace_back(map_key_unchecked(*vbmap, key));
+        }
+        return result;
+    }
+
+  private:
+    static std::pair<uint16_t, size_t> map_key_unchecked(const vbucket_map& map, std::string_view key)
+    {
+        std::uint32_t crc = utils::hash_crc32(key.data(), key.size());
+        auto vbucket = static_cast<std::uint16_t>(crc % map.size());
+        return std::make_pair(vbucket, static_cast<std::size_t>(map.active(vbucket)));
     }
 };
 
@@ -269,6 +356,17 @@ struct traits<couchbase::configuration> {
                 result.bucket = m->get_string();
             }
         }
+        {
+            const auto m = v.find("clusterCapabilities");
+            if (m != nullptr && m->is_object()) {
+                for (const auto& service : m->get_object()) {
+                    auto& caps = result.cluster_capabilities[service.first];
+                    for (const auto& cap : service.second.get_array()) {
+                        caps.insert(cap.get_string());
+                    }
+                }
+            }
+        }
         {
             const auto m = v.find("vBucketServerMap");
             if (m != nullptr) {
@@ -283,16 +381,18 @@ struct traits<couchbase::configuration> {
                     const auto f = o.find("vBucketMap");
                     if (f != o.end()) {
                         const auto& vb = f->second.get_array();
-                        couchbase::configuration::vbucket_map vbmap;
-                        vbmap.resize(vb.size());
+                        std::size_t num_copies = 0;
+                        for (const auto& p : vb) {
+                            num_copies = std::max(num_copies, p.get_array().size());
+                        }
+                        couchbase::configuration::vbucket_map vbmap(vb.size(), num_copies);
                         for (size_t i = 0; i < vb.size(); i++) {
                             const auto& p = vb[i].get_array();
-                            vbmap[i].resize(p.size());
                             for (size_t n = 0; n < p.size(); n++) {
-                                vbmap[i][n] = p[n].template as<std::int16_t>();
+                                vbmap.set(i, n, p[n].template as<std::int16_t>());
                             }
                         }
-                        result.vbmap = vbmap;
+                        result.vbmap = std::move(vbmap);
                     }
                 }
             }
@@ -35,6 +35,8 @@
 #include <utils/connection_string.hxx>
 
 #include <ruby.h>
+#include <ruby/encoding.h>
+#include <ruby/thread.h>
 #if defined(HAVE_RUBY_VERSION_H)
 #include <ruby/version.h>
 #endif
@@ -98,16 +100,132 @@ struct cb_backend_data {
     std::unique_ptr<asio::io_context> ctx;
     std::unique_ptr<couchbase::cluster> cluster;
     std::thread worker;
+    /** return structs instead of hashes from the hot KV operations, see Backend#open */
+    bool lightweight_results{ false };
 };
 
+/**
+ * Keys of the results of the hot KV operations, resolved once by init_results(). Symbols of rb_intern() are static, so they do not
+ * need to be registered with GC.
+ */
+static struct {
+    VALUE content;
+    VALUE cas;
+    VALUE flags;
+    VALUE mutation_token;
+    VALUE partition_uuid;
+    VALUE sequence_number;
+    VALUE partition_id;
+    VALUE bucket_name;
+    VALUE lightweight_results;
+} cb_sym{};
+
+static VALUE cGetResponse = Qnil;
+static VALUE cMutationResponse = Qnil;
+static VALUE cMutationTokenResponse = Qnil;
+
+/**
+ * Defines the structs, that the backend returns instead of hashes when lightweight results are enabled. Struct is a single object with
+ * embedded members, while hash allocates its table, and both support reading members with [:name].
+ */
+static void
+init_results(VALUE cBackend)
+{
+    cb_sym.content = rb_id2sym(rb_intern("content"));
+    cb_sym.cas = rb_id2sym(rb_intern("cas"));
+    cb_sym.flags = rb_id2sym(rb_intern("flags"));
+    cb_sym.mutation_token = rb_id2sym(rb_intern("mutation_token"));
+    cb_sym.partition_uuid = rb_id2sym(rb_intern("partition_uuid"));
+    cb_sym.sequence_number = rb_id2sym(rb_intern("sequence_number"));
+    cb_sym.partition_id = rb_id2sym(rb_intern("partition_id"));
+    cb_sym.bucket_name = rb_id2sym(rb_intern("bucket_name"));
+    cb_sym.lightweight_results = rb_id2sym(rb_intern("lightweight_results"));
+
+    cGetResponse = rb_struct_define_under(cBackend, "GetResponse", "content", "cas", "flags", nullptr);
+    cMutationResponse = rb_struct_define_under(cBackend, "MutationResponse", "cas", "mutation_token", nullptr);
+    cMutationTokenResponse = rb_struct_define_under(
+      cBackend, "MutationTokenResponse", "partition_uuid", "sequence_number", "partition_id", "bucket_name", nullptr);
+}
+
+/**
+ * Returns frozen deduplicated string for the values, that repeat in every result (e.g. bucket name), so that they are allocated once.
+ */
+static VALUE
+cb__interned_str(const std::string& str)
+{
+#if defined(RUBY_API_VERSION_MAJOR) && RUBY_API_VERSION_MAJOR >= 3
+    return rb_enc_interned_str(str.data(), static_cast<long>(str.size()), rb_utf8_encoding());
+#else
+    return rb_str_new(str.data(), static_cast<long>(str.size()));
+#endif
+}
+
+static VALUE
+cb__extract_get_result(const std::string& value, std::uint64_t cas, std::uint32_t flags, bool lightweight)
+{
+    VALUE content = rb_str_new(value.data(), static_cast<long>(value.size()));
+    if (lightweight) {
+        return rb_struct_new(cGetResponse, content, ULL2NUM(cas), UINT2NUM(flags));
+    }
+    VALUE res = rb_hash_new();
+    rb_hash_aset(res, cb_sym.content, content);
+    rb_hash_aset(res, cb_sym.cas, ULL2NUM(cas));
+    rb_hash_aset(res, cb_sym.flags, UINT2NUM(flags));
+    return res;
+}
+
+template<typename Response>
+static void*
+cb__wait_for_future_without_gvl(void* future)
+{
+    static_cast<std::future<Response>*>(future)->wait();
+    return nullptr;
+}
+
+static void
+cb__cancel_operation(void* cancel)
+{
+    (*static_cast<std::function<void()>*>(cancel))();
+}
+
+/**
+ * Waits for the future without holding GVL, so that other Ruby threads can run while the operation is in flight.
+ *
+ * When the thread is interrupted (Thread#raise, Thread#kill, signals), the operation is cancelled using the given function,
+ * and the future resolves with request_canceled error. Pending interrupts are not checked here, Ruby will handle them
+ * right after the backend method returns control.
+ */
+template<typename Response>
+static Response
+cb__wait_for_future(std::future<Response>& future, std::function<void()> cancel = {})
+{
+    rb_thread_call_without_gvl2(cb__wait_for_future_without_gvl<Response>, &future, cancel ? cb__cancel_operation : nullptr, &cancel);
+    if (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        // the interrupt was already pending, so the GVL has not been released at all
+        if (cancel) {
+            cancel();
+        }
+        future.wait();
+    }
+    return future.get();
+}
+
+/**
+ * Closes the cluster and stops the worker. Backend#close waits without GVL, but the GC free function must not release it (other
+ * threads would run in the middle of GC sweep), so it passes release_gvl=false.
+ */
 static void
-cb__backend_close(cb_backend_data* backend)
+cb__backend_close(cb_backend_data* backend, bool release_gvl = true)
 {
     if (backend->cluster) {
         auto barrier = std::make_shared<std::promise<void>>();
         auto f = barrier->get_future();
         backend->cluster->close([barrier]() { barrier->set_value(); });
-        f.wait();
+        if (release_gvl) {
+            cb__wait_for_future(f);
+        } else {
+            f.wait();
+        }
         if (backend->worker.joinable()) {
             backend->worker.join();
         }
@@ -125,7 +243,7 @@ static void
 cb_Backend_free(void* ptr)
 {
     auto* backend = reinterpret_cast<cb_backend_data*>(ptr);
-    cb__backend_close(backend);
+    cb__backend_close(backend, false);
     ruby_xfree(backend);
 }
 
@@ -212,6 +330,7 @@ static VALUE ePathTooDeep;
 static VALUE ePlanningFailure;
 static VALUE ePreparedStatementFailure;
 static VALUE eRequestCanceled;
+static VALUE eRequestQueueFull;
 static VALUE eScopeExists;
 static VALUE eScopeNotFound;
 static VALUE eServiceNotAvailable;
@@ -281,6 +400,7 @@ init_exceptions(VALUE mCouchbase)
     ePathTooDeep = rb_define_class_under(mError, "PathTooDeep", eCouchbaseError);
     ePlanningFailure = rb_define_class_under(mError, "PlanningFailure", eCouchbaseError);
     ePreparedStatementFailure = rb_define_class_under(mError, "PreparedStatementFailure", eCouchbaseError);
+    eRequestQueueFull = rb_define_class_under(mError, "RequestQueueFull", eCouchbaseError);
     eRequestCanceled = rb_define_class_under(mError, "RequestCanceled", eCouchbaseError);
     eScopeExists = rb_define_class_under(mError, "ScopeExists", eCouchbaseError);
     eScopeNotFound = rb_define_class_under(mError, "ScopeNotFound", eCouchbaseError);
@@ -361,6 +481,9 @@ cb__map_error_code(std::error_code ec, const std::string& message)
 
             case couchbase::error::common_errc::index_exists:
                 return rb_exc_new_cstr(eIndexExists, fmt::format("{}: {}", message, ec.message()).c_str());
+
+            case couchbase::error::common_errc::request_queue_full:
+                return rb_exc_new_cstr(eRequestQueueFull, fmt::format("{}: {}", message, ec.message()).c_str());
         }
     } else if (ec.category() == couchbase::error::detail::get_key_value_category()) {
         switch (static_cast<couchbase::error::key_value_errc>(ec.value())) {
@@ -523,6 +646,7 @@ cb_Backend_open(VALUE self, VALUE connection_string, VALUE username, VALUE passw
     Check_Type(password, T_STRING);
     if (!NIL_P(options)) {
         Check_Type(options, T_HASH);
+        backend->lightweight_results = RTEST(rb_hash_aref(options, cb_sym.lightweight_results));
     }
 
     VALUE exc = Qnil;
@@ -535,7 +659,7 @@ cb_Backend_open(VALUE self, VALUE connection_string, VALUE username, VALUE passw
         auto barrier = std::make_shared<std::promise<std::error_code>>();
         auto f = barrier->get_future();
         backend->cluster->open(origin, [barrier](std::error_code ec) mutable { barrier->set_value(ec); });
-        if (auto ec = f.get()) {
+        if (auto ec = cb__wait_for_future(f)) {
             exc = cb__map_error_code(ec, fmt::format("unable open cluster at {}", origin.next_address().first));
         }
     }
@@ -576,7 +700,7 @@ cb_Backend_open_bucket(VALUE self, VALUE bucket, VALUE wait_until_ready)
             auto barrier = std::make_shared<std::promise<std::error_code>>();
             auto f = barrier->get_future();
             backend->cluster->open_bucket(name, [barrier](std::error_code ec) mutable { barrier->set_value(ec); });
-            if (auto ec = f.get()) {
+            if (auto ec = cb__wait_for_future(f)) {
                 exc = cb__map_error_code(ec, fmt::format("unable open bucket \"{}\"", name));
             }
         } else {
@@ -606,6 +730,33 @@ cb__extract_timeout(Request& req, VALUE timeout)
     }
 }
 
+template<typename Request>
+static void
+cb__extract_durability(Request& req, VALUE options)
+{
+    VALUE durability_level = rb_hash_aref(options, rb_id2sym(rb_intern("durability_level")));
+    if (!NIL_P(durability_level)) {
+        Check_Type(durability_level, T_SYMBOL);
+        ID level = rb_sym2id(durability_level);
+        if (level == rb_intern("none")) {
+            req.durability_level = couchbase::protocol::durability_level::none;
+        } else if (level == rb_intern("majority")) {
+            req.durability_level = couchbase::protocol::durability_level::majority;
+        } else if (level == rb_intern("majority_and_persist_to_active")) {
+            req.durability_level = couchbase::protocol::durability_level::majority_and_persist_to_active;
+        } else if (level == rb_intern("persist_to_majority")) {
+            req.durability_level = couchbase::protocol::durability_level::persist_to_majority;
+        } else {
+            rb_raise(rb_eArgError, "Unknown durability level");
+        }
+        VALUE durability_timeout = rb_hash_aref(options, rb_id2sym(rb_intern("durability_timeout")));
+        if (!NIL_P(durability_timeout)) {
+            Check_Type(durability_timeout, T_FIXNUM);
+            req.durability_timeout = FIX2UINT(durability_timeout);
+        }
+    }
+}
+
 static VALUE
 cb_Backend_document_get(VALUE self, VALUE bucket, VALUE collection, VALUE id, VALUE timeout)
 {
@@ -631,17 +782,105 @@ cb_Backend_document_get(VALUE self, VALUE bucket, VALUE collection, VALUE id, VA
         cb__extract_timeout(req, timeout);
         auto barrier = std::make_shared<std::promise<couchbase::operations::get_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute(req, [barrier](couchbase::operations::get_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute(
+          req, [barrier](couchbase::operations::get_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             exc = cb__map_error_code(resp.ec, fmt::format("unable fetch {} (opaque={})", doc_id, resp.opaque));
             break;
         }
 
-        VALUE res = rb_hash_new();
-        rb_hash_aset(res, rb_id2sym(rb_intern("content")), rb_str_new(resp.value.data(), static_cast<long>(resp.value.size())));
-        rb_hash_aset(res, rb_id2sym(rb_intern("cas")), ULL2NUM(resp.cas));
-        rb_hash_aset(res, rb_id2sym(rb_intern("flags")), UINT2NUM(resp.flags));
+        return cb__extract_get_result(resp.value, resp.cas, resp.flags, backend->lightweight_results);
+    } while (false);
+    rb_exc_raise(exc);
+    return Qnil;
+}
+
+static VALUE
+cb__replica_entry_to_hash(const couchbase::operations::replica_entry& entry)
+{
+    VALUE res = rb_hash_new();
+    rb_hash_aset(res, rb_id2sym(rb_intern("content")), rb_str_new(entry.value.data(), static_cast<long>(entry.value.size())));
+    rb_hash_aset(res, rb_id2sym(rb_intern("cas")), ULL2NUM(entry.cas));
+    rb_hash_aset(res, rb_id2sym(rb_intern("flags")), UINT2NUM(entry.flags));
+    rb_hash_aset(res, rb_id2sym(rb_intern("replica")), entry.replica ? Qtrue : Qfalse);
+    return res;
+}
+
+static VALUE
+cb_Backend_document_get_any_replica(VALUE self, VALUE bucket, VALUE collection, VALUE id, VALUE timeout)
+{
+    cb_backend_data* backend = nullptr;
+    TypedData_Get_Struct(self, cb_backend_data, &cb_backend_type, backend);
+
+    if (!backend->cluster) {
+        rb_raise(rb_eArgError, "Cluster has been closed already");
+    }
+
+    Check_Type(bucket, T_STRING);
+    Check_Type(collection, T_STRING);
+    Check_Type(id, T_STRING);
+
+    VALUE exc = Qnil;
+    do {
+        couchbase::document_id doc_id;
+        doc_id.bucket.assign(RSTRING_PTR(bucket), static_cast<size_t>(RSTRING_LEN(bucket)));
+        doc_id.collection.assign(RSTRING_PTR(collection), static_cast<size_t>(RSTRING_LEN(collection)));
+        doc_id.key.assign(RSTRING_PTR(id), static_cast<size_t>(RSTRING_LEN(id)));
+
+        couchbase::operations::get_any_replica_request req{ doc_id };
+        cb__extract_timeout(req, timeout);
+        auto barrier = std::make_shared<std::promise<couchbase::operations::get_any_replica_response>>();
+        auto f = barrier->get_future();
+        auto cancel = backend->cluster->execute(
+          req, [barrier](couchbase::operations::get_any_replica_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
+        if (resp.ec) {
+            exc = cb__map_error_code(resp.ec, fmt::format("unable to get replica of the document {}", doc_id));
+            break;
+        }
+        return cb__replica_entry_to_hash(resp.entry);
+    } while (false);
+    rb_exc_raise(exc);
+    return Qnil;
+}
+
+static VALUE
+cb_Backend_document_get_all_replicas(VALUE self, VALUE bucket, VALUE collection, VALUE id, VALUE timeout)
+{
+    cb_backend_data* backend = nullptr;
+    TypedData_Get_Struct(self, cb_backend_data, &cb_backend_type, backend);
+
+    if (!backend->cluster) {
+        rb_raise(rb_eArgError, "Cluster has been closed already");
+    }
+
+    Check_Type(bucket, T_STRING);
+    Check_Type(collection, T_STRING);
+    Check_Type(id, T_STRING);
+
+    VALUE exc = Qnil;
+    do {
+        couchbase::document_id doc_id;
+        doc_id.bucket.assign(RSTRING_PTR(bucket), static_cast<size_t>(RSTRING_LEN(bucket)));
+        doc_id.collection.assign(RSTRING_PTR(collection), static_cast<size_t>(RSTRING_LEN(collection)));
+        doc_id.key.assign(RSTRING_PTR(id), static_cast<size_t>(RSTRING_LEN(id)));
+
+        couchbase::operations::get_all_replicas_request req{ doc_id };
+        cb__extract_timeout(req, timeout);
+        auto barrier = std::make_shared<std::promise<couchbase::operations::get_all_replicas_response>>();
+        auto f = barrier->get_future();
+        auto cancel = backend->cluster->execute(
+          req, [barrier](couchbase::operations::get_all_replicas_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
+        if (resp.ec) {
+            exc = cb__map_error_code(resp.ec, fmt::format("unable to get replicas of the document {}", doc_id));
+            break;
+        }
+        VALUE res = rb_ary_new_capa(static_cast<long>(resp.entries.size()));
+        for (const auto& entry : resp.entries) {
+            rb_ary_push(res, cb__replica_entry_to_hash(entry));
+        }
         return res;
     } while (false);
     rb_exc_raise(exc);
@@ -693,8 +932,9 @@ cb_Backend_document_get_projected(VALUE self,
 
         auto barrier = std::make_shared<std::promise<couchbase::operations::get_projected_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute(req, [barrier](couchbase::operations::get_projected_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute(
+          req, [barrier](couchbase::operations::get_projected_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             exc = cb__map_error_code(resp.ec, fmt::format("unable fetch with projections {} (opaque={})", doc_id, resp.opaque));
             break;
@@ -741,18 +981,15 @@ cb_Backend_document_get_and_lock(VALUE self, VALUE bucket, VALUE collection, VAL
 
         auto barrier = std::make_shared<std::promise<couchbase::operations::get_and_lock_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute(req, [barrier](couchbase::operations::get_and_lock_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute(
+          req, [barrier](couchbase::operations::get_and_lock_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             exc = cb__map_error_code(resp.ec, fmt::format("unable lock and fetch {} (opaque={})", doc_id, resp.opaque));
             break;
         }
 
-        VALUE res = rb_hash_new();
-        rb_hash_aset(res, rb_id2sym(rb_intern("content")), rb_str_new(resp.value.data(), static_cast<long>(resp.value.size())));
-        rb_hash_aset(res, rb_id2sym(rb_intern("cas")), ULL2NUM(resp.cas));
-        rb_hash_aset(res, rb_id2sym(rb_intern("flags")), UINT2NUM(resp.flags));
-        return res;
+        return cb__extract_get_result(resp.value, resp.cas, resp.flags, backend->lightweight_results);
     } while (false);
     rb_exc_raise(exc);
     return Qnil;
@@ -786,18 +1023,15 @@ cb_Backend_document_get_and_touch(VALUE self, VALUE bucket, VALUE collection, VA
 
         auto barrier = std::make_shared<std::promise<couchbase::operations::get_and_touch_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute(req, [barrier](couchbase::operations::get_and_touch_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute(
+          req, [barrier](couchbase::operations::get_and_touch_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             exc = cb__map_error_code(resp.ec, fmt::format("unable fetch and touch {} (opaque={})", doc_id, resp.opaque));
             break;
         }
 
-        VALUE res = rb_hash_new();
-        rb_hash_aset(res, rb_id2sym(rb_intern("content")), rb_str_new(resp.value.data(), static_cast<long>(resp.value.size())));
-        rb_hash_aset(res, rb_id2sym(rb_intern("cas")), ULL2NUM(resp.cas));
-        rb_hash_aset(res, rb_id2sym(rb_intern("flags")), UINT2NUM(resp.flags));
-        return res;
+        return cb__extract_get_result(resp.value, resp.cas, resp.flags, backend->lightweight_results);
     } while (false);
     rb_exc_raise(exc);
     return Qnil;
@@ -805,18 +1039,24 @@ cb_Backend_document_get_and_touch(VALUE self, VALUE bucket, VALUE collection, VA
 
 template<typename Response>
 static VALUE
-cb__extract_mutation_result(Response resp)
+cb__extract_mutation_result(const Response& resp, bool lightweight = false)
 {
+    if (lightweight) {
+        VALUE token = rb_struct_new(cMutationTokenResponse,
+                                    ULL2NUM(resp.token.partition_uuid),
+                                    ULL2NUM(resp.token.sequence_number),
+                                    UINT2NUM(resp.token.partition_id),
+                                    cb__interned_str(resp.token.bucket_name));
+        return rb_struct_new(cMutationResponse, ULL2NUM(resp.cas), token);
+    }
     VALUE res = rb_hash_new();
-    rb_hash_aset(res, rb_id2sym(rb_intern("cas")), ULL2NUM(resp.cas));
+    rb_hash_aset(res, cb_sym.cas, ULL2NUM(resp.cas));
     VALUE token = rb_hash_new();
-    rb_hash_aset(token, rb_id2sym(rb_intern("partition_uuid")), ULL2NUM(resp.token.partition_uuid));
-    rb_hash_aset(token, rb_id2sym(rb_intern("sequence_number")), ULONG2NUM(resp.token.sequence_number));
-    rb_hash_aset(token, rb_id2sym(rb_intern("partition_id")), UINT2NUM(resp.token.partition_id));
-    rb_hash_aset(token,
-                 rb_id2sym(rb_intern("bucket_name")),
-                 rb_str_new(resp.token.bucket_name.c_str(), static_cast<long>(resp.token.bucket_name.size())));
-    rb_hash_aset(res, rb_id2sym(rb_intern("mutation_token")), token);
+    rb_hash_aset(token, cb_sym.partition_uuid, ULL2NUM(resp.token.partition_uuid));
+    rb_hash_aset(token, cb_sym.sequence_number, ULL2NUM(resp.token.sequence_number));
+    rb_hash_aset(token, cb_sym.partition_id, UINT2NUM(resp.token.partition_id));
+    rb_hash_aset(token, cb_sym.bucket_name, cb__interned_str(resp.token.bucket_name));
+    rb_hash_aset(res, cb_sym.mutation_token, token);
     return res;
 }
 
@@ -848,8 +1088,9 @@ cb_Backend_document_touch(VALUE self, VALUE bucket, VALUE collection, VALUE id,
 
         auto barrier = std::make_shared<std::promise<couchbase::operations::touch_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute(req, [barrier](couchbase::operations::touch_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute(
+          req, [barrier](couchbase::operations::touch_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             exc = cb__map_error_code(resp.ec, fmt::format("unable to touch {} (opaque={})", doc_id, resp.opaque));
             break;
@@ -889,8 +1130,9 @@ cb_Backend_document_exists(VALUE self, VALUE bucket, VALUE collection, VALUE id,
 
         auto barrier = std::make_shared<std::promise<couchbase::operations::exists_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute(req, [barrier](couchbase::operations::exists_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute(
+          req, [barrier](couchbase::operations::exists_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             exc = cb__map_error_code(resp.ec, fmt::format("unable to exists {} (opaque={})", doc_id, resp.opaque));
             break;
@@ -956,8 +1198,9 @@ cb_Backend_document_unlock(VALUE self, VALUE bucket, VALUE collection, VALUE id,
 
         auto barrier = std::make_shared<std::promise<couchbase::operations::unlock_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute(req, [barrier](couchbase::operations::unlock_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute(
+          req, [barrier](couchbase::operations::unlock_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             exc = cb__map_error_code(resp.ec, fmt::format("unable to unlock {} (opaque={})", doc_id, resp.opaque));
             break;
@@ -1001,27 +1244,7 @@ cb_Backend_document_upsert(VALUE self, VALUE bucket, VALUE collection, VALUE id,
 
         if (!NIL_P(options)) {
             Check_Type(options, T_HASH);
-            VALUE durability_level = rb_hash_aref(options, rb_id2sym(rb_intern("durability_level")));
-            if (!NIL_P(durability_level)) {
-                Check_Type(durability_level, T_SYMBOL);
-                ID level = rb_sym2id(durability_level);
-                if (level == rb_intern("none")) {
-                    req.durability_level = couchbase::protocol::durability_level::none;
-                } else if (level == rb_intern("majority")) {
-                    req.durability_level = couchbase::protocol::durability_level::majority;
-                } else if (level == rb_intern("majority_and_persist_to_active")) {
-                    req.durability_level = couchbase::protocol::durability_level::majority_and_persist_to_active;
-                } else if (level == rb_intern("persist_to_majority")) {
-                    req.durability_level = couchbase::protocol::durability_level::persist_to_majority;
-                } else {
-                    rb_raise(rb_eArgError, "Unknown durability level");
-                }
-                VALUE durability_timeout = rb_hash_aref(options, rb_id2sym(rb_intern("durability_timeout")));
-                if (!NIL_P(durability_timeout)) {
-                    Check_Type(durability_timeout, T_FIXNUM);
-                    req.durability_timeout = FIX2UINT(durability_timeout);
-                }
-            }
+            cb__extract_durability(req, options);
             VALUE expiry = rb_hash_aref(options, rb_id2sym(rb_intern("expiry")));
             if (!NIL_P(expiry)) {
                 Check_Type(expiry, T_FIXNUM);
@@ -1031,14 +1254,15 @@ cb_Backend_document_upsert(VALUE self, VALUE bucket, VALUE collection, VALUE id,
 
         auto barrier = std::make_shared<std::promise<couchbase::operations::upsert_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute(req, [barrier](couchbase::operations::upsert_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute(
+          req, [barrier](couchbase::operations::upsert_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             exc = cb__map_error_code(resp.ec, fmt::format("unable to upsert {} (opaque={})", doc_id, resp.opaque));
             break;
         }
 
-        return cb__extract_mutation_result(resp);
+        return cb__extract_mutation_result(resp, backend->lightweight_results);
     } while (false);
     rb_exc_raise(exc);
     return Qnil;
@@ -1074,27 +1298,7 @@ cb_Backend_document_replace(VALUE self, VALUE bucket, VALUE collection, VALUE id
 
         if (!NIL_P(options)) {
             Check_Type(options, T_HASH);
-            VALUE durability_level = rb_hash_aref(options, rb_id2sym(rb_intern("durability_level")));
-            if (!NIL_P(durability_level)) {
-                Check_Type(durability_level, T_SYMBOL);
-                ID level = rb_sym2id(durability_level);
-                if (level == rb_intern("none")) {
-                    req.durability_level = couchbase::protocol::durability_level::none;
-                } else if (level == rb_intern("majority")) {
-                    req.durability_level = couchbase::protocol::durability_level::majority;
-                } else if (level == rb_intern("majority_and_persist_to_active")) {
-                    req.durability_level = couchbase::protocol::durability_level::majority_and_persist_to_active;
-                } else if (level == rb_intern("persist_to_majority")) {
-                    req.durability_level = couchbase::protocol::durability_level::persist_to_majority;
-                } else {
-                    rb_raise(rb_eArgError, "Unknown durability level");
-                }
-                VALUE durability_timeout = rb_hash_aref(options, rb_id2sym(rb_intern("durability_timeout")));
-                if (!NIL_P(durability_timeout)) {
-                    Check_Type(durability_timeout, T_FIXNUM);
-                    req.durability_timeout = FIX2UINT(durability_timeout);
-                }
-            }
+            cb__extract_durability(req, options);
             VALUE expiry = rb_hash_aref(options, rb_id2sym(rb_intern("expiry")));
             if (!NIL_P(expiry)) {
                 Check_Type(expiry, T_FIXNUM);
@@ -1115,14 +1319,15 @@ cb_Backend_document_replace(VALUE self, VALUE bucket, VALUE collection, VALUE id
 
         auto barrier = std::make_shared<std::promise<couchbase::operations::replace_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute(req, [barrier](couchbase::operations::replace_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute(
+          req, [barrier](couchbase::operations::replace_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             exc = cb__map_error_code(resp.ec, fmt::format("unable to replace {} (opaque={})", doc_id, resp.opaque));
             break;
         }
 
-        return cb__extract_mutation_result(resp);
+        return cb__extract_mutation_result(resp, backend->lightweight_results);
     } while (false);
     rb_exc_raise(exc);
     return Qnil;
@@ -1158,27 +1363,7 @@ cb_Backend_document_insert(VALUE self, VALUE bucket, VALUE collection, VALUE id,
 
         if (!NIL_P(options)) {
             Check_Type(options, T_HASH);
-            VALUE durability_level = rb_hash_aref(options, rb_id2sym(rb_intern("durability_level")));
-            if (!NIL_P(durability_level)) {
-                Check_Type(durability_level, T_SYMBOL);
-                ID level = rb_sym2id(durability_level);
-                if (level == rb_intern("none")) {
-                    req.durability_level = couchbase::protocol::durability_level::none;
-                } else if (level == rb_intern("majority")) {
-                    req.durability_level = couchbase::protocol::durability_level::majority;
-                } else if (level == rb_intern("majority_and_persist_to_active")) {
-                    req.durability_level = couchbase::protocol::durability_level::majority_and_persist_to_active;
-                } else if (level == rb_intern("persist_to_majority")) {
-                    req.durability_level = couchbase::protocol::durability_level::persist_to_majority;
-                } else {
-                    rb_raise(rb_eArgError, "Unknown durability level");
-                }
-                VALUE durability_timeout = rb_hash_aref(options, rb_id2sym(rb_intern("durability_timeout")));
-                if (!NIL_P(durability_timeout)) {
-                    Check_Type(durability_timeout, T_FIXNUM);
-                    req.durability_timeout = FIX2UINT(durability_timeout);
-                }
-            }
+            cb__extract_durability(req, options);
             VALUE expiry = rb_hash_aref(options, rb_id2sym(rb_intern("expiry")));
             if (!NIL_P(expiry)) {
                 Check_Type(expiry, T_FIXNUM);
@@ -1188,14 +1373,15 @@ cb_Backend_document_insert(VALUE self, VALUE bucket, VALUE collection, VALUE id,
 
         auto barrier = std::make_shared<std::promise<couchbase::operations::insert_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute(req, [barrier](couchbase::operations::insert_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute(
+          req, [barrier](couchbase::operations::insert_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             exc = cb__map_error_code(resp.ec, fmt::format("unable to insert {} (opaque={})", doc_id, resp.opaque));
             break;
         }
 
-        return cb__extract_mutation_result(resp);
+        return cb__extract_mutation_result(resp, backend->lightweight_results);
     } while (false);
     rb_exc_raise(exc);
     return Qnil;
@@ -1226,45 +1412,184 @@ cb_Backend_document_remove(VALUE self, VALUE bucket, VALUE collection, VALUE id,
         cb__extract_timeout(req, timeout);
         if (!NIL_P(options)) {
             Check_Type(options, T_HASH);
-            VALUE durability_level = rb_hash_aref(options, rb_id2sym(rb_intern("durability_level")));
-            if (!NIL_P(durability_level)) {
-                Check_Type(durability_level, T_SYMBOL);
-                ID level = rb_sym2id(durability_level);
-                if (level == rb_intern("none")) {
-                    req.durability_level = couchbase::protocol::durability_level::none;
-                } else if (level == rb_intern("majority")) {
-                    req.durability_level = couchbase::protocol::durability_level::majority;
-                } else if (level == rb_intern("majority_and_persist_to_active")) {
-                    req.durability_level = couchbase::protocol::durability_level::majority_and_persist_to_active;
-                } else if (level == rb_intern("persist_to_majority")) {
-                    req.durability_level = couchbase::protocol::durability_level::persist_to_majority;
-                } else {
-                    rb_raise(rb_eArgError, "Unknown durability level");
-                }
-                VALUE durability_timeout = rb_hash_aref(options, rb_id2sym(rb_intern("durability_timeout")));
-                if (!NIL_P(durability_timeout)) {
-                    Check_Type(durability_timeout, T_FIXNUM);
-                    req.durability_timeout = FIX2UINT(durability_timeout);
-                }
-            }
+            cb__extract_durability(req, options);
         }
 
         auto barrier = std::make_shared<std::promise<couchbase::operations::remove_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute(req, [barrier](couchbase::operations::remove_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute(
+          req, [barrier](couchbase::operations::remove_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             exc = cb__map_error_code(resp.ec, fmt::format("unable to remove {} (opaque={})", doc_id, resp.opaque));
             break;
         }
-        return cb__extract_mutation_result(resp);
+        return cb__extract_mutation_result(resp, backend->lightweight_results);
     } while (false);
     rb_exc_raise(exc);
     return Qnil;
 }
 
+/**
+ * Operation, which has been scheduled by one of the *_async methods of the backend and not yet consumed by the application.
+ */
+struct cb_pending_operation {
+    virtual ~cb_pending_operation() = default;
+
+    [[nodiscard]] virtual bool is_ready() const = 0;
+
+    /**
+     * Blocks until the operation completes (without GVL), and returns either result or exception object.
+     */
+    virtual VALUE wait() = 0;
+
+    virtual void cancel() = 0;
+
+    virtual void mark() const = 0;
+};
+
+template<typename Response>
+struct cb_pending_operation_impl : public cb_pending_operation {
+    std::future<Response> future;
+    std::function<void()> canceler;
+    std::function<VALUE(Response&&)> finisher;
+    VALUE result{ Qundef };
+
+    cb_pending_operation_impl(std::future<Response>&& f, std::function<void()>&& c, std::function<VALUE(Response&&)>&& fin)
+      : future(std::move(f))
+      , canceler(std::move(c))
+      , finisher(std::move(fin))
+    {
+    }
+
+    [[nodiscard]] bool is_ready() const override
+    {
+        return result != Qundef || future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    VALUE wait() override
+    {
+        if (result == Qundef) {
+            result = finisher(cb__wait_for_future(future, canceler));
+        }
+        return result;
+    }
+
+    void cancel() override
+    {
+        if (result == Qundef && canceler) {
+            canceler();
+        }
+    }
+
+    void mark() const override
+    {
+        if (result != Qundef) {
+            rb_gc_mark(result);
+        }
+    }
+};
+
+struct cb_pending_result_data {
+    std::shared_ptr<cb_pending_operation> operation;
+    VALUE backend;
+};
+
+static void
+cb_PendingResult_mark(void* ptr)
+{
+    auto* data = reinterpret_cast<cb_pending_result_data*>(ptr);
+    rb_gc_mark(data->backend);
+    if (data->operation) {
+        data->operation->mark();
+    }
+}
+
+static void
+cb_PendingResult_free(void* ptr)
+{
+    auto* data = reinterpret_cast<cb_pending_result_data*>(ptr);
+    data->~cb_pending_result_data();
+    ruby_xfree(data);
+}
+
+static size_t
+cb_PendingResult_memsize(const void* ptr)
+{
+    const auto* data = reinterpret_cast<const cb_pending_result_data*>(ptr);
+    return sizeof(*data);
+}
+
+static const rb_data_type_t cb_pending_result_type{
+    "Couchbase/Backend/PendingResult",
+    { cb_PendingResult_mark,
+      cb_PendingResult_free,
+      cb_PendingResult_memsize,
+// only one reserved field when GC.compact implemented
+#ifdef T_MOVED
+      nullptr,
+#endif
+      {} },
+#ifdef RUBY_TYPED_FREE_IMMEDIATELY
+    nullptr,
+    nullptr,
+    RUBY_TYPED_FREE_IMMEDIATELY,
+#endif
+};
+
+static VALUE cPendingResult;
+
+/**
+ * Wraps future of the scheduled operation into Couchbase::Backend::PendingResult
+ *
+ * The finisher is invoked with GVL held, exactly once, when the application requests the result.
+ */
+template<typename Response>
+static VALUE
+cb__pending_result_new(VALUE backend,
+                       std::future<Response>&& future,
+                       std::function<void()>&& cancel,
+                       std::function<VALUE(Response&&)>&& finisher)
+{
+    cb_pending_result_data* data = nullptr;
+    VALUE obj = TypedData_Make_Struct(cPendingResult, cb_pending_result_data, &cb_pending_result_type, data);
+    new (data) cb_pending_result_data{
+        std::make_shared<cb_pending_operation_impl<Response>>(std::move(future), std::move(cancel), std::move(finisher)), backend
+    };
+    return obj;
+}
+
+static VALUE
+cb_PendingResult_is_ready(VALUE self)
+{
+    cb_pending_result_data* data = nullptr;
+    TypedData_Get_Struct(self, cb_pending_result_data, &cb_pending_result_type, data);
+    return data->operation->is_ready() ? Qtrue : Qfalse;
+}
+
+static VALUE
+cb_PendingResult_wait(VALUE self)
+{
+    cb_pending_result_data* data = nullptr;
+    TypedData_Get_Struct(self, cb_pending_result_data, &cb_pending_result_type, data);
+    VALUE res = data->operation->wait();
+    if (RTEST(rb_obj_is_kind_of(res, rb_eException))) {
+        rb_exc_raise(res);
+    }
+    return res;
+}
+
+static VALUE
+cb_PendingResult_cancel(VALUE self)
+{
+    cb_pending_result_data* data = nullptr;
+    TypedData_Get_Struct(self, cb_pending_result_data, &cb_pending_result_type, data);
+    data->operation->cancel();
+    return Qnil;
+}
+
 static VALUE
-cb_Backend_document_increment(VALUE self, VALUE bucket, VALUE collection, VALUE id, VALUE timeout, VALUE options)
+cb_Backend_document_get_async(VALUE self, VALUE bucket, VALUE collection, VALUE id, VALUE timeout)
 {
     cb_backend_data* backend = nullptr;
     TypedData_Get_Struct(self, cb_backend_data, &cb_backend_type, backend);
@@ -1277,41 +1602,343 @@ cb_Backend_document_increment(VALUE self, VALUE bucket, VALUE collection, VALUE
     Check_Type(collection, T_STRING);
     Check_Type(id, T_STRING);
 
-    VALUE exc = Qnil;
-    do {
-        couchbase::document_id doc_id;
-        doc_id.bucket.assign(RSTRING_PTR(bucket), static_cast<size_t>(RSTRING_LEN(bucket)));
-        doc_id.collection.assign(RSTRING_PTR(collection), static_cast<size_t>(RSTRING_LEN(collection)));
-        doc_id.key.assign(RSTRING_PTR(id), static_cast<size_t>(RSTRING_LEN(id)));
+    couchbase::document_id doc_id;
+    doc_id.bucket.assign(RSTRING_PTR(bucket), static_cast<size_t>(RSTRING_LEN(bucket)));
+    doc_id.collection.assign(RSTRING_PTR(collection), static_cast<size_t>(RSTRING_LEN(collection)));
+    doc_id.key.assign(RSTRING_PTR(id), static_cast<size_t>(RSTRING_LEN(id)));
+
+    couchbase::operations::get_request req{ doc_id };
+    cb__extract_timeout(req, timeout);
+    auto barrier = std::make_shared<std::promise<couchbase::operations::get_response>>();
+    auto f = barrier->get_future();
+    auto cancel =
+      backend->cluster->execute(req, [barrier](couchbase::operations::get_response resp) mutable { barrier->set_value(std::move(resp)); });
+    return cb__pending_result_new<couchbase::operations::get_response>(
+      self,
+      std::move(f),
+      std::move(cancel),
+      [doc_id, lightweight = backend->lightweight_results](couchbase::operations::get_response&& resp) -> VALUE {
+          if (resp.ec) {
+              return cb__map_error_code(resp.ec, fmt::format("unable fetch {} (opaque={})", doc_id, resp.opaque));
+          }
+          return cb__extract_get_result(resp.value, resp.cas, resp.flags, lightweight);
+      });
+}
 
-        couchbase::operations::increment_request req{ doc_id };
-        cb__extract_timeout(req, timeout);
-        if (!NIL_P(options)) {
-            Check_Type(options, T_HASH);
-            VALUE durability_level = rb_hash_aref(options, rb_id2sym(rb_intern("durability_level")));
-            if (!NIL_P(durability_level)) {
-                Check_Type(durability_level, T_SYMBOL);
-                ID level = rb_sym2id(durability_level);
-                if (level == rb_intern("none")) {
-                    req.durability_level = couchbase::protocol::durability_level::none;
-                } else if (level == rb_intern("majority")) {
-                    req.durability_level = couchbase::protocol::durability_level::majority;
-                } else if (level == rb_intern("majority_and_persist_to_active")) {
-                    req.durability_level = couchbase::protocol::durability_level::majority_and_persist_to_active;
-                } else if (level == rb_intern("persist_to_majority")) {
-                    req.durability_level = couchbase::protocol::durability_level::persist_to_majority;
-                } else {
-                    rb_raise(rb_eArgError, "Unknown durability level");
-                }
-                VALUE durability_timeout = rb_hash_aref(options, rb_id2sym(rb_intern("durability_timeout")));
-                if (!NIL_P(durability_timeout)) {
-                    Check_Type(durability_timeout, T_FIXNUM);
-                    req.durability_timeout = FIX2UINT(durability_timeout);
-                }
-            }
-            VALUE delta = rb_hash_aref(options, rb_id2sym(rb_intern("delta")));
-            if (!NIL_P(delta)) {
-                switch (TYPE(delta)) {
+static VALUE
+cb_Backend_document_upsert_async(VALUE self,
+                                 VALUE bucket,
+                                 VALUE collection,
+                                 VALUE id,
+                                 VALUE timeout,
+                                 VALUE content,
+                                 VALUE flags,
+                                 VALUE options)
+{
+    cb_backend_data* backend = nullptr;
+    TypedData_Get_Struct(self, cb_backend_data, &cb_backend_type, backend);
+
+    if (!backend->cluster) {
+        rb_raise(rb_eArgError, "Cluster has been closed already");
+    }
+
+    Check_Type(bucket, T_STRING);
+    Check_Type(collection, T_STRING);
+    Check_Type(id, T_STRING);
+    Check_Type(content, T_STRING);
+    Check_Type(flags, T_FIXNUM);
+
+    couchbase::document_id doc_id;
+    doc_id.bucket.assign(RSTRING_PTR(bucket), static_cast<size_t>(RSTRING_LEN(bucket)));
+    doc_id.collection.assign(RSTRING_PTR(collection), static_cast<size_t>(RSTRING_LEN(collection)));
+    doc_id.key.assign(RSTRING_PTR(id), static_cast<size_t>(RSTRING_LEN(id)));
+    std::string value(RSTRING_PTR(content), static_cast<size_t>(RSTRING_LEN(content)));
+
+    couchbase::operations::upsert_request req{ doc_id, value };
+    cb__extract_timeout(req, timeout);
+    req.flags = FIX2UINT(flags);
+
+    if (!NIL_P(options)) {
+        Check_Type(options, T_HASH);
+        cb__extract_durability(req, options);
+        VALUE expiry = rb_hash_aref(options, rb_id2sym(rb_intern("expiry")));
+        if (!NIL_P(expiry)) {
+            Check_Type(expiry, T_FIXNUM);
+            req.expiry = FIX2UINT(expiry);
+        }
+    }
+
+    auto barrier = std::make_shared<std::promise<couchbase::operations::upsert_response>>();
+    auto f = barrier->get_future();
+    auto cancel = backend->cluster->execute(req, [barrier](couchbase::operations::upsert_response resp) mutable {
+        barrier->set_value(std::move(resp));
+    });
+    return cb__pending_result_new<couchbase::operations::upsert_response>(
+      self,
+      std::move(f),
+      std::move(cancel),
+      [doc_id, lightweight = backend->lightweight_results](couchbase::operations::upsert_response&& resp) -> VALUE {
+          if (resp.ec) {
+              return cb__map_error_code(resp.ec, fmt::format("unable to upsert {} (opaque={})", doc_id, resp.opaque));
+          }
+          return cb__extract_mutation_result(resp, lightweight);
+      });
+}
+
+static VALUE
+cb_Backend_document_remove_async(VALUE self, VALUE bucket, VALUE collection, VALUE id, VALUE timeout, VALUE options)
+{
+    cb_backend_data* backend = nullptr;
+    TypedData_Get_Struct(self, cb_backend_data, &cb_backend_type, backend);
+
+    if (!backend->cluster) {
+        rb_raise(rb_eArgError, "Cluster has been closed already");
+    }
+
+    Check_Type(bucket, T_STRING);
+    Check_Type(collection, T_STRING);
+    Check_Type(id, T_STRING);
+
+    couchbase::document_id doc_id;
+    doc_id.bucket.assign(RSTRING_PTR(bucket), static_cast<size_t>(RSTRING_LEN(bucket)));
+    doc_id.collection.assign(RSTRING_PTR(collection), static_cast<size_t>(RSTRING_LEN(collection)));
+    doc_id.key.assign(RSTRING_PTR(id), static_cast<size_t>(RSTRING_LEN(id)));
+
+    couchbase::operations::remove_request req{ doc_id };
+    cb__extract_timeout(req, timeout);
+    if (!NIL_P(options)) {
+        Check_Type(options, T_HASH);
+        cb__extract_durability(req, options);
+    }
+
+    auto barrier = std::make_shared<std::promise<couchbase::operations::remove_response>>();
+    auto f = barrier->get_future();
+    auto cancel = backend->cluster->execute(req, [barrier](couchbase::operations::remove_response resp) mutable {
+        barrier->set_value(std::move(resp));
+    });
+    return cb__pending_result_new<couchbase::operations::remove_response>(
+      self,
+      std::move(f),
+      std::move(cancel),
+      [doc_id, lightweight = backend->lightweight_results](couchbase::operations::remove_response&& resp) -> VALUE {
+          if (resp.ec) {
+              return cb__map_error_code(resp.ec, fmt::format("unable to remove {} (opaque={})", doc_id, resp.opaque));
+          }
+          return cb__extract_mutation_result(resp, lightweight);
+      });
+}
+
+static VALUE
+cb_Backend_document_get_multi(VALUE self, VALUE bucket, VALUE collection, VALUE ids, VALUE timeout)
+{
+    cb_backend_data* backend = nullptr;
+    TypedData_Get_Struct(self, cb_backend_data, &cb_backend_type, backend);
+
+    if (!backend->cluster) {
+        rb_raise(rb_eArgError, "Cluster has been closed already");
+    }
+
+    Check_Type(bucket, T_STRING);
+    Check_Type(collection, T_STRING);
+    Check_Type(ids, T_ARRAY);
+
+    std::vector<couchbase::operations::get_request> requests;
+    requests.reserve(static_cast<size_t>(RARRAY_LEN(ids)));
+    for (long i = 0; i < RARRAY_LEN(ids); ++i) {
+        VALUE id = rb_ary_entry(ids, i);
+        Check_Type(id, T_STRING);
+        couchbase::document_id doc_id;
+        doc_id.bucket.assign(RSTRING_PTR(bucket), static_cast<size_t>(RSTRING_LEN(bucket)));
+        doc_id.collection.assign(RSTRING_PTR(collection), static_cast<size_t>(RSTRING_LEN(collection)));
+        doc_id.key.assign(RSTRING_PTR(id), static_cast<size_t>(RSTRING_LEN(id)));
+        couchbase::operations::get_request req{ doc_id };
+        cb__extract_timeout(req, timeout);
+        requests.emplace_back(req);
+    }
+
+    auto barrier = std::make_shared<std::promise<std::vector<couchbase::operations::get_response>>>();
+    auto f = barrier->get_future();
+    auto cancel = backend->cluster->execute_multi(
+      std::move(requests),
+      [barrier](std::vector<couchbase::operations::get_response> resp) mutable { barrier->set_value(std::move(resp)); });
+    auto responses = cb__wait_for_future(f, cancel);
+
+    VALUE res = rb_ary_new_capa(static_cast<long>(responses.size()));
+    for (const auto& resp : responses) {
+        VALUE entry = rb_hash_new();
+        if (resp.ec) {
+            rb_hash_aset(entry,
+                         rb_id2sym(rb_intern("error")),
+                         cb__map_error_code(resp.ec, fmt::format("unable fetch {} (opaque={})", resp.id, resp.opaque)));
+        } else {
+            rb_hash_aset(entry, rb_id2sym(rb_intern("content")), rb_str_new(resp.value.data(), static_cast<long>(resp.value.size())));
+            rb_hash_aset(entry, rb_id2sym(rb_intern("cas")), ULL2NUM(resp.cas));
+            rb_hash_aset(entry, rb_id2sym(rb_intern("flags")), UINT2NUM(resp.flags));
+        }
+        rb_ary_push(res, entry);
+    }
+    return res;
+}
+
+static VALUE
+cb_Backend_document_upsert_multi(VALUE self, VALUE bucket, VALUE collection, VALUE timeout, VALUE id_content, VALUE options)
+{
+    cb_backend_data* backend = nullptr;
+    TypedData_Get_Struct(self, cb_backend_data, &cb_backend_type, backend);
+
+    if (!backend->cluster) {
+        rb_raise(rb_eArgError, "Cluster has been closed already");
+    }
+
+    Check_Type(bucket, T_STRING);
+    Check_Type(collection, T_STRING);
+    Check_Type(id_content, T_ARRAY);
+    if (!NIL_P(options)) {
+        Check_Type(options, T_HASH);
+    }
+
+    std::vector<couchbase::operations::upsert_request> requests;
+    requests.reserve(static_cast<size_t>(RARRAY_LEN(id_content)));
+    for (long i = 0; i < RARRAY_LEN(id_content); ++i) {
+        VALUE tuple = rb_ary_entry(id_content, i);
+        Check_Type(tuple, T_ARRAY);
+        if (RARRAY_LEN(tuple) != 3) {
+            rb_raise(rb_eArgError, "id_content entry must be an Array of [id, content, flags]");
+        }
+        VALUE id = rb_ary_entry(tuple, 0);
+        VALUE content = rb_ary_entry(tuple, 1);
+        VALUE flags = rb_ary_entry(tuple, 2);
+        Check_Type(id, T_STRING);
+        Check_Type(content, T_STRING);
+        Check_Type(flags, T_FIXNUM);
+
+        couchbase::document_id doc_id;
+        doc_id.bucket.assign(RSTRING_PTR(bucket), static_cast<size_t>(RSTRING_LEN(bucket)));
+        doc_id.collection.assign(RSTRING_PTR(collection), static_cast<size_t>(RSTRING_LEN(collection)));
+        doc_id.key.assign(RSTRING_PTR(id), static_cast<size_t>(RSTRING_LEN(id)));
+        std::string value(RSTRING_PTR(content), static_cast<size_t>(RSTRING_LEN(content)));
+
+        couchbase::operations::upsert_request req{ doc_id, value };
+        cb__extract_timeout(req, timeout);
+        req.flags = FIX2UINT(flags);
+        if (!NIL_P(options)) {
+            cb__extract_durability(req, options);
+            VALUE expiry = rb_hash_aref(options, rb_id2sym(rb_intern("expiry")));
+            if (!NIL_P(expiry)) {
+                Check_Type(expiry, T_FIXNUM);
+                req.expiry = FIX2UINT(expiry);
+            }
+        }
+        requests.emplace_back(std::move(req));
+    }
+
+    auto barrier = std::make_shared<std::promise<std::vector<couchbase::operations::upsert_response>>>();
+    auto f = barrier->get_future();
+    auto cancel = backend->cluster->execute_multi(
+      std::move(requests),
+      [barrier](std::vector<couchbase::operations::upsert_response> resp) mutable { barrier->set_value(std::move(resp)); });
+    auto responses = cb__wait_for_future(f, cancel);
+
+    VALUE res = rb_ary_new_capa(static_cast<long>(responses.size()));
+    for (const auto& resp : responses) {
+        if (resp.ec) {
+            VALUE entry = rb_hash_new();
+            rb_hash_aset(entry,
+                         rb_id2sym(rb_intern("error")),
+                         cb__map_error_code(resp.ec, fmt::format("unable to upsert {} (opaque={})", resp.id, resp.opaque)));
+            rb_ary_push(res, entry);
+        } else {
+            rb_ary_push(res, cb__extract_mutation_result(resp));
+        }
+    }
+    return res;
+}
+
+static VALUE
+cb_Backend_document_remove_multi(VALUE self, VALUE bucket, VALUE collection, VALUE timeout, VALUE ids, VALUE options)
+{
+    cb_backend_data* backend = nullptr;
+    TypedData_Get_Struct(self, cb_backend_data, &cb_backend_type, backend);
+
+    if (!backend->cluster) {
+        rb_raise(rb_eArgError, "Cluster has been closed already");
+    }
+
+    Check_Type(bucket, T_STRING);
+    Check_Type(collection, T_STRING);
+    Check_Type(ids, T_ARRAY);
+    if (!NIL_P(options)) {
+        Check_Type(options, T_HASH);
+    }
+
+    std::vector<couchbase::operations::remove_request> requests;
+    requests.reserve(static_cast<size_t>(RARRAY_LEN(ids)));
+    for (long i = 0; i < RARRAY_LEN(ids); ++i) {
+        VALUE id = rb_ary_entry(ids, i);
+        Check_Type(id, T_STRING);
+        couchbase::document_id doc_id;
+        doc_id.bucket.assign(RSTRING_PTR(bucket), static_cast<size_t>(RSTRING_LEN(bucket)));
+        doc_id.collection.assign(RSTRING_PTR(collection), static_cast<size_t>(RSTRING_LEN(collection)));
+        doc_id.key.assign(RSTRING_PTR(id), static_cast<size_t>(RSTRING_LEN(id)));
+        couchbase::operations::remove_request req{ doc_id };
+        cb__extract_timeout(req, timeout);
+        if (!NIL_P(options)) {
+            cb__extract_durability(req, options);
+        }
+        requests.emplace_back(req);
+    }
+
+    auto barrier = std::make_shared<std::promise<std::vector<couchbase::operations::remove_response>>>();
+    auto f = barrier->get_future();
+    auto cancel = backend->cluster->execute_multi(
+      std::move(requests),
+      [barrier](std::vector<couchbase::operations::remove_response> resp) mutable { barrier->set_value(std::move(resp)); });
+    auto responses = cb__wait_for_future(f, cancel);
+
+    VALUE res = rb_ary_new_capa(static_cast<long>(responses.size()));
+    for (const auto& resp : responses) {
+        if (resp.ec) {
+            VALUE entry = rb_hash_new();
+            rb_hash_aset(entry,
+                         rb_id2sym(rb_intern("error")),
+                         cb__map_error_code(resp.ec, fmt::format("unable to remove {} (opaque={})", resp.id, resp.opaque)));
+            rb_ary_push(res, entry);
+        } else {
+            rb_ary_push(res, cb__extract_mutation_result(resp));
+        }
+    }
+    return res;
+}
+
+static VALUE
+cb_Backend_document_increment(VALUE self, VALUE bucket, VALUE collection, VALUE id, VALUE timeout, VALUE options)
+{
+    cb_backend_data* backend = nullptr;
+    TypedData_Get_Struct(self, cb_backend_data, &cb_backend_type, backend);
+
+    if (!backend->cluster) {
+        rb_raise(rb_eArgError, "Cluster has been closed already");
+    }
+
+    Check_Type(bucket, T_STRING);
+    Check_Type(collection, T_STRING);
+    Check_Type(id, T_STRING);
+
+    VALUE exc = Qnil;
+    do {
+        couchbase::document_id doc_id;
+        doc_id.bucket.assign(RSTRING_PTR(bucket), static_cast<size_t>(RSTRING_LEN(bucket)));
+        doc_id.collection.assign(RSTRING_PTR(collection), static_cast<size_t>(RSTRING_LEN(collection)));
+        doc_id.key.assign(RSTRING_PTR(id), static_cast<size_t>(RSTRING_LEN(id)));
+
+        couchbase::operations::increment_request req{ doc_id };
+        cb__extract_timeout(req, timeout);
+        if (!NIL_P(options)) {
+            Check_Type(options, T_HASH);
+            cb__extract_durability(req, options);
+            VALUE delta = rb_hash_aref(options, rb_id2sym(rb_intern("delta")));
+            if (!NIL_P(delta)) {
+                switch (TYPE(delta)) {
                     case T_FIXNUM:
                     case T_BIGNUM:
                         req.delta = NUM2ULL(delta);
@@ -1340,8 +1967,9 @@ cb_Backend_document_increment(VALUE self, VALUE bucket, VALUE collection, VALUE
 
         auto barrier = std::make_shared<std::promise<couchbase::operations::increment_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute(req, [barrier](couchbase::operations::increment_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute(
+          req, [barrier](couchbase::operations::increment_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             exc = cb__map_error_code(resp.ec, fmt::format("unable to increment {} by {} (opaque={})", doc_id, req.delta, resp.opaque));
             break;
@@ -1380,27 +2008,7 @@ cb_Backend_document_decrement(VALUE self, VALUE bucket, VALUE collection, VALUE
         cb__extract_timeout(req, timeout);
         if (!NIL_P(options)) {
             Check_Type(options, T_HASH);
-            VALUE durability_level = rb_hash_aref(options, rb_id2sym(rb_intern("durability_level")));
-            if (!NIL_P(durability_level)) {
-                Check_Type(durability_level, T_SYMBOL);
-                ID level = rb_sym2id(durability_level);
-                if (level == rb_intern("none")) {
-                    req.durability_level = couchbase::protocol::durability_level::none;
-                } else if (level == rb_intern("majority")) {
-                    req.durability_level = couchbase::protocol::durability_level::majority;
-                } else if (level == rb_intern("majority_and_persist_to_active")) {
-                    req.durability_level = couchbase::protocol::durability_level::majority_and_persist_to_active;
-                } else if (level == rb_intern("persist_to_majority")) {
-                    req.durability_level = couchbase::protocol::durability_level::persist_to_majority;
-                } else {
-                    rb_raise(rb_eArgError, "Unknown durability level");
-                }
-                VALUE durability_timeout = rb_hash_aref(options, rb_id2sym(rb_intern("durability_timeout")));
-                if (!NIL_P(durability_timeout)) {
-                    Check_Type(durability_timeout, T_FIXNUM);
-                    req.durability_timeout = FIX2UINT(durability_timeout);
-                }
-            }
+            cb__extract_durability(req, options);
             VALUE delta = rb_hash_aref(options, rb_id2sym(rb_intern("delta")));
             if (!NIL_P(delta)) {
                 switch (TYPE(delta)) {
@@ -1432,8 +2040,9 @@ cb_Backend_document_decrement(VALUE self, VALUE bucket, VALUE collection, VALUE
 
         auto barrier = std::make_shared<std::promise<couchbase::operations::decrement_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute(req, [barrier](couchbase::operations::decrement_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute(
+          req, [barrier](couchbase::operations::decrement_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             exc = cb__map_error_code(resp.ec, fmt::format("unable to decrement {} by {} (opaque={})", doc_id, req.delta, resp.opaque));
             break;
@@ -1673,8 +2282,9 @@ cb_Backend_document_lookup_in(VALUE self, VALUE bucket, VALUE collection, VALUE
 
         auto barrier = std::make_shared<std::promise<couchbase::operations::lookup_in_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute(req, [barrier](couchbase::operations::lookup_in_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute(
+          req, [barrier](couchbase::operations::lookup_in_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             exc = cb__map_error_code(resp.ec, fmt::format("unable fetch {} (opaque={})", doc_id, resp.opaque));
             break;
@@ -1736,27 +2346,7 @@ cb_Backend_document_mutate_in(VALUE self, VALUE bucket, VALUE collection, VALUE
         cb__extract_timeout(req, timeout);
         if (!NIL_P(options)) {
             Check_Type(options, T_HASH);
-            VALUE durability_level = rb_hash_aref(options, rb_id2sym(rb_intern("durability_level")));
-            if (!NIL_P(durability_level)) {
-                Check_Type(durability_level, T_SYMBOL);
-                ID level = rb_sym2id(durability_level);
-                if (level == rb_intern("none")) {
-                    req.durability_level = couchbase::protocol::durability_level::none;
-                } else if (level == rb_intern("majority")) {
-                    req.durability_level = couchbase::protocol::durability_level::majority;
-                } else if (level == rb_intern("majority_and_persist_to_active")) {
-                    req.durability_level = couchbase::protocol::durability_level::majority_and_persist_to_active;
-                } else if (level == rb_intern("persist_to_majority")) {
-                    req.durability_level = couchbase::protocol::durability_level::persist_to_majority;
-                } else {
-                    rb_raise(rb_eArgError, "Unknown durability level");
-                }
-                VALUE durability_timeout = rb_hash_aref(options, rb_id2sym(rb_intern("durability_timeout")));
-                if (!NIL_P(durability_timeout)) {
-                    Check_Type(durability_timeout, T_FIXNUM);
-                    req.durability_timeout = FIX2UINT(durability_timeout);
-                }
-            }
+            cb__extract_durability(req, options);
             VALUE access_deleted = rb_hash_aref(options, rb_id2sym(rb_intern("access_deleted")));
             if (!NIL_P(access_deleted)) {
                 req.access_deleted = RTEST(access_deleted);
@@ -1851,8 +2441,9 @@ cb_Backend_document_mutate_in(VALUE self, VALUE bucket, VALUE collection, VALUE
 
         auto barrier = std::make_shared<std::promise<couchbase::operations::mutate_in_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute(req, [barrier](couchbase::operations::mutate_in_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute(
+          req, [barrier](couchbase::operations::mutate_in_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             exc = cb__map_error_code(resp.ec, fmt::format("unable to mutate {} (opaque={})", doc_id, resp.opaque));
             break;
@@ -1891,20 +2482,528 @@ cb_Backend_document_mutate_in(VALUE self, VALUE bucket, VALUE collection, VALUE
     return Qnil;
 }
 
-static int
-cb__for_each_named_param(VALUE key, VALUE value, VALUE arg)
+static int
+cb__for_each_named_param(VALUE key, VALUE value, VALUE arg)
+{
+    auto* preq = reinterpret_cast<couchbase::operations::query_request*>(arg);
+    Check_Type(key, T_STRING);
+    Check_Type(value, T_STRING);
+    preq->named_parameters.emplace(
+      std::string_view(RSTRING_PTR(key), static_cast<std::size_t>(RSTRING_LEN(key))),
+      tao::json::from_string(std::string_view(RSTRING_PTR(value), static_cast<std::size_t>(RSTRING_LEN(value)))));
+    return ST_CONTINUE;
+}
+
+static void
+cb__extract_query_request(couchbase::operations::query_request& req, VALUE statement, VALUE options)
+{
+    Check_Type(statement, T_STRING);
+    Check_Type(options, T_HASH);
+
+    req.statement.assign(RSTRING_PTR(statement), static_cast<size_t>(RSTRING_LEN(statement)));
+    VALUE client_context_id = rb_hash_aref(options, rb_id2sym(rb_intern("client_context_id")));
+    if (!NIL_P(client_context_id)) {
+        Check_Type(client_context_id, T_STRING);
+        req.client_context_id.assign(RSTRING_PTR(client_context_id), static_cast<size_t>(RSTRING_LEN(client_context_id)));
+    }
+    cb__extract_timeout(req, rb_hash_aref(options, rb_id2sym(rb_intern("timeout"))));
+    VALUE adhoc = rb_hash_aref(options, rb_id2sym(rb_intern("adhoc")));
+    if (!NIL_P(adhoc)) {
+        req.adhoc = RTEST(adhoc);
+    }
+    VALUE metrics = rb_hash_aref(options, rb_id2sym(rb_intern("metrics")));
+    if (!NIL_P(metrics)) {
+        req.metrics = RTEST(metrics);
+    }
+    VALUE readonly = rb_hash_aref(options, rb_id2sym(rb_intern("readonly")));
+    if (!NIL_P(readonly)) {
+        req.readonly = RTEST(readonly);
+    }
+    VALUE scan_cap = rb_hash_aref(options, rb_id2sym(rb_intern("scan_cap")));
+    if (!NIL_P(scan_cap)) {
+        req.scan_cap = NUM2ULONG(scan_cap);
+    }
+    VALUE scan_wait = rb_hash_aref(options, rb_id2sym(rb_intern("scan_wait")));
+    if (!NIL_P(scan_wait)) {
+        req.scan_wait = NUM2ULONG(scan_wait);
+    }
+    VALUE max_parallelism = rb_hash_aref(options, rb_id2sym(rb_intern("max_parallelism")));
+    if (!NIL_P(max_parallelism)) {
+        req.max_parallelism = NUM2ULONG(max_parallelism);
+    }
+    VALUE pipeline_cap = rb_hash_aref(options, rb_id2sym(rb_intern("pipeline_cap")));
+    if (!NIL_P(pipeline_cap)) {
+        req.pipeline_cap = NUM2ULONG(pipeline_cap);
+    }
+    VALUE pipeline_batch = rb_hash_aref(options, rb_id2sym(rb_intern("pipeline_batch")));
+    if (!NIL_P(pipeline_batch)) {
+        req.pipeline_batch = NUM2ULONG(pipeline_batch);
+    }
+    VALUE profile = rb_hash_aref(options, rb_id2sym(rb_intern("profile")));
+    if (!NIL_P(profile)) {
+        Check_Type(profile, T_SYMBOL);
+        ID mode = rb_sym2id(profile);
+        if (mode == rb_intern("phases")) {
+            req.profile = couchbase::operations::query_request::profile_mode::phases;
+        } else if (mode == rb_intern("timings")) {
+            req.profile = couchbase::operations::query_request::profile_mode::timings;
+        } else if (mode == rb_intern("off")) {
+            req.profile = couchbase::operations::query_request::profile_mode::off;
+        }
+    }
+    VALUE positional_params = rb_hash_aref(options, rb_id2sym(rb_intern("positional_parameters")));
+    if (!NIL_P(positional_params)) {
+        Check_Type(positional_params, T_ARRAY);
+        auto entries_num = static_cast<size_t>(RARRAY_LEN(positional_params));
+        req.positional_parameters.reserve(entries_num);
+        for (size_t i = 0; i < entries_num; ++i) {
+            VALUE entry = rb_ary_entry(positional_params, static_cast<long>(i));
+            Check_Type(entry, T_STRING);
+            req.positional_parameters.emplace_back(
+              tao::json::from_string(std::string_view(RSTRING_PTR(entry), static_cast<std::size_t>(RSTRING_LEN(entry)))));
+        }
+    }
+    VALUE named_params = rb_hash_aref(options, rb_id2sym(rb_intern("named_parameters")));
+    if (!NIL_P(named_params)) {
+        Check_Type(named_params, T_HASH);
+        rb_hash_foreach(named_params, INT_FUNC(cb__for_each_named_param), reinterpret_cast<VALUE>(&req));
+    }
+    VALUE scan_consistency = rb_hash_aref(options, rb_id2sym(rb_intern("scan_consistency")));
+    if (!NIL_P(scan_consistency)) {
+        Check_Type(scan_consistency, T_SYMBOL);
+        ID type = rb_sym2id(scan_consistency);
+        if (type == rb_intern("not_bounded")) {
+            req.scan_consistency = couchbase::operations::query_request::scan_consistency_type::not_bounded;
+        } else if (type == rb_intern("request_plus")) {
+            req.scan_consistency = couchbase::operations::query_request::scan_consistency_type::request_plus;
+        }
+    }
+    VALUE mutation_state = rb_hash_aref(options, rb_id2sym(rb_intern("mutation_state")));
+    if (!NIL_P(mutation_state)) {
+        Check_Type(mutation_state, T_ARRAY);
+        auto state_size = static_cast<size_t>(RARRAY_LEN(mutation_state));
+        req.mutation_state.reserve(state_size);
+        for (size_t i = 0; i < state_size; ++i) {
+            VALUE token = rb_ary_entry(mutation_state, static_cast<long>(i));
+            Check_Type(token, T_HASH);
+            VALUE bucket_name = rb_hash_aref(token, rb_id2sym(rb_intern("bucket_name")));
+            Check_Type(bucket_name, T_STRING);
+            VALUE partition_id = rb_hash_aref(token, rb_id2sym(rb_intern("partition_id")));
+            Check_Type(partition_id, T_FIXNUM);
+            VALUE partition_uuid = rb_hash_aref(token, rb_id2sym(rb_intern("partition_uuid")));
+            switch (TYPE(partition_uuid)) {
+                case T_FIXNUM:
+                case T_BIGNUM:
+                    break;
+                default:
+                    rb_raise(rb_eArgError, "partition_uuid must be an Integer");
+            }
+            VALUE sequence_number = rb_hash_aref(token, rb_id2sym(rb_intern("sequence_number")));
+            switch (TYPE(sequence_number)) {
+                case T_FIXNUM:
+                case T_BIGNUM:
+                    break;
+                default:
+                    rb_raise(rb_eArgError, "sequence_number must be an Integer");
+            }
+            req.mutation_state.emplace_back(
+              couchbase::mutation_token{ NUM2ULL(partition_uuid),
+                                         NUM2ULL(sequence_number),
+                                         gsl::narrow_cast<std::uint16_t>(NUM2UINT(partition_id)),
+                                         std::string(RSTRING_PTR(bucket_name), static_cast<std::size_t>(RSTRING_LEN(bucket_name))) });
+        }
+    }
+
+    VALUE raw_params = rb_hash_aref(options, rb_id2sym(rb_intern("raw_parameters")));
+    if (!NIL_P(raw_params)) {
+        Check_Type(raw_params, T_HASH);
+        rb_hash_foreach(raw_params, INT_FUNC(cb__for_each_named_param), reinterpret_cast<VALUE>(&req));
+    }
+}
+
+static VALUE
+cb__map_query_error(const couchbase::operations::query_request& req, const couchbase::operations::query_response& resp)
+{
+    if (resp.payload.meta_data.errors && !resp.payload.meta_data.errors->empty()) {
+        const auto& first_error = resp.payload.meta_data.errors->front();
+        return cb__map_error_code(resp.ec,
+                                  fmt::format("unable to query: \"{}{}\" ({}: {})",
+                                              req.statement.substr(0, 50),
+                                              req.statement.size() > 50 ? "..." : "",
+                                              first_error.code,
+                                              first_error.message));
+    }
+    return cb__map_error_code(
+      resp.ec, fmt::format("unable to query: \"{}{}\"", req.statement.substr(0, 50), req.statement.size() > 50 ? "..." : ""));
+}
+
+static VALUE
+cb__extract_query_meta(const couchbase::operations::query_response& resp)
+{
+    VALUE meta = rb_hash_new();
+    rb_hash_aset(meta,
+                 rb_id2sym(rb_intern("status")),
+                 rb_id2sym(rb_intern2(resp.payload.meta_data.status.data(), static_cast<long>(resp.payload.meta_data.status.size()))));
+    rb_hash_aset(meta,
+                 rb_id2sym(rb_intern("request_id")),
+                 rb_str_new(resp.payload.meta_data.request_id.data(), static_cast<long>(resp.payload.meta_data.request_id.size())));
+    rb_hash_aset(
+      meta,
+      rb_id2sym(rb_intern("client_context_id")),
+      rb_str_new(resp.payload.meta_data.client_context_id.data(), static_cast<long>(resp.payload.meta_data.client_context_id.size())));
+    if (resp.payload.meta_data.signature) {
+        rb_hash_aset(meta,
+                     rb_id2sym(rb_intern("signature")),
+                     rb_str_new(resp.payload.meta_data.signature->data(), static_cast<long>(resp.payload.meta_data.signature->size())));
+    }
+    if (resp.payload.meta_data.profile) {
+        rb_hash_aset(meta,
+                     rb_id2sym(rb_intern("profile")),
+                     rb_str_new(resp.payload.meta_data.profile->data(), static_cast<long>(resp.payload.meta_data.profile->size())));
+    }
+    VALUE metrics = rb_hash_new();
+    rb_hash_aset(meta, rb_id2sym(rb_intern("metrics")), metrics);
+    rb_hash_aset(metrics,
+                 rb_id2sym(rb_intern("elapsed_time")),
+                 rb_str_new(resp.payload.meta_data.metrics.elapsed_time.data(),
+                            static_cast<long>(resp.payload.meta_data.metrics.elapsed_time.size())));
+    rb_hash_aset(metrics,
+                 rb_id2sym(rb_intern("execution_time")),
+                 rb_str_new(resp.payload.meta_data.metrics.execution_time.data(),
+                            static_cast<long>(resp.payload.meta_data.metrics.execution_time.size())));
+    rb_hash_aset(metrics, rb_id2sym(rb_intern("result_count")), ULL2NUM(resp.payload.meta_data.metrics.result_count));
+    rb_hash_aset(metrics, rb_id2sym(rb_intern("result_size")), ULL2NUM(resp.payload.meta_data.metrics.result_count));
+    if (resp.payload.meta_data.metrics.sort_count) {
+        rb_hash_aset(metrics, rb_id2sym(rb_intern("sort_count")), ULL2NUM(*resp.payload.meta_data.metrics.sort_count));
+    }
+    if (resp.payload.meta_data.metrics.mutation_count) {
+        rb_hash_aset(metrics, rb_id2sym(rb_intern("mutation_count")), ULL2NUM(*resp.payload.meta_data.metrics.mutation_count));
+    }
+    if (resp.payload.meta_data.metrics.error_count) {
+        rb_hash_aset(metrics, rb_id2sym(rb_intern("error_count")), ULL2NUM(*resp.payload.meta_data.metrics.error_count));
+    }
+    if (resp.payload.meta_data.metrics.warning_count) {
+        rb_hash_aset(metrics, rb_id2sym(rb_intern("warning_count")), ULL2NUM(*resp.payload.meta_data.metrics.warning_count));
+    }
+
+    return meta;
+}
+
+static VALUE
+cb_Backend_document_query(VALUE self, VALUE statement, VALUE options)
+{
+    cb_backend_data* backend = nullptr;
+    TypedData_Get_Struct(self, cb_backend_data, &cb_backend_type, backend);
+
+    if (!backend->cluster) {
+        rb_raise(rb_eArgError, "Cluster has been closed already");
+    }
+
+    VALUE exc = Qnil;
+    do {
+        couchbase::operations::query_request req;
+        cb__extract_query_request(req, statement, options);
+
+        auto barrier = std::make_shared<std::promise<couchbase::operations::query_response>>();
+        auto f = barrier->get_future();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::query_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
+        if (resp.ec) {
+            exc = cb__map_query_error(req, resp);
+            break;
+        }
+        VALUE res = rb_hash_new();
+        VALUE rows = rb_ary_new_capa(static_cast<long>(resp.payload.rows.size()));
+        rb_hash_aset(res, rb_id2sym(rb_intern("rows")), rows);
+        for (auto& row : resp.payload.rows) {
+            rb_ary_push(rows, rb_str_new(row.data(), static_cast<long>(row.size())));
+        }
+        rb_hash_aset(res, rb_id2sym(rb_intern("meta")), cb__extract_query_meta(resp));
+        return res;
+    } while (false);
+    rb_exc_raise(exc);
+    return Qnil;
+}
+
+static VALUE
+cb_Backend_query_cache_stats(VALUE self)
+{
+    cb_backend_data* backend = nullptr;
+    TypedData_Get_Struct(self, cb_backend_data, &cb_backend_type, backend);
+
+    if (!backend->cluster) {
+        rb_raise(rb_eArgError, "Cluster has been closed already");
+    }
+
+    auto stats = backend->cluster->query_cache_stats();
+    VALUE res = rb_hash_new();
+    rb_hash_aset(res, rb_id2sym(rb_intern("hits")), ULL2NUM(stats.hits));
+    rb_hash_aset(res, rb_id2sym(rb_intern("misses")), ULL2NUM(stats.misses));
+    rb_hash_aset(res, rb_id2sym(rb_intern("evictions")), ULL2NUM(stats.evictions));
+    rb_hash_aset(res, rb_id2sym(rb_intern("invalidations")), ULL2NUM(stats.invalidations));
+    rb_hash_aset(res, rb_id2sym(rb_intern("size")), ULL2NUM(stats.size));
+    rb_hash_aset(res, rb_id2sym(rb_intern("capacity")), ULL2NUM(stats.capacity));
+    return res;
+}
+
+static VALUE
+cb_Backend_compression_stats(VALUE self)
+{
+    cb_backend_data* backend = nullptr;
+    TypedData_Get_Struct(self, cb_backend_data, &cb_backend_type, backend);
+
+    if (!backend->cluster) {
+        rb_raise(rb_eArgError, "Cluster has been closed already");
+    }
+
+    auto stats = backend->cluster->compression_stats();
+    VALUE res = rb_hash_new();
+    rb_hash_aset(res, rb_id2sym(rb_intern("attempts")), ULL2NUM(stats.attempts));
+    rb_hash_aset(res, rb_id2sym(rb_intern("compressed")), ULL2NUM(stats.compressed));
+    rb_hash_aset(res, rb_id2sym(rb_intern("skipped")), ULL2NUM(stats.skipped));
+    rb_hash_aset(res, rb_id2sym(rb_intern("offloaded")), ULL2NUM(stats.offloaded));
+    rb_hash_aset(res, rb_id2sym(rb_intern("bytes_in")), ULL2NUM(stats.bytes_in));
+    rb_hash_aset(res, rb_id2sym(rb_intern("bytes_saved")), ULL2NUM(stats.bytes_saved));
+    rb_hash_aset(res, rb_id2sym(rb_intern("time_us")), ULL2NUM(stats.time_us));
+    return res;
+}
+
+static VALUE
+cb_Backend_tls_stats(VALUE self)
+{
+    cb_backend_data* backend = nullptr;
+    TypedData_Get_Struct(self, cb_backend_data, &cb_backend_type, backend);
+
+    if (!backend->cluster) {
+        rb_raise(rb_eArgError, "Cluster has been closed already");
+    }
+
+    auto stats = backend->cluster->tls_stats();
+    VALUE res = rb_hash_new();
+    rb_hash_aset(res, rb_id2sym(rb_intern("handshakes")), ULL2NUM(stats.handshakes));
+    rb_hash_aset(res, rb_id2sym(rb_intern("resumed")), ULL2NUM(stats.resumed));
+    rb_hash_aset(res, rb_id2sym(rb_intern("failures")), ULL2NUM(stats.failures));
+    rb_hash_aset(res, rb_id2sym(rb_intern("total_duration_us")), ULL2NUM(stats.total_duration_us));
+    rb_hash_aset(res, rb_id2sym(rb_intern("max_duration_us")), ULL2NUM(stats.max_duration_us));
+    rb_hash_aset(res, rb_id2sym(rb_intern("cached_sessions")), ULL2NUM(backend->cluster->tls_cached_sessions()));
+    return res;
+}
+
+static VALUE
+cb_Backend_retry_stats(VALUE self)
+{
+    cb_backend_data* backend = nullptr;
+    TypedData_Get_Struct(self, cb_backend_data, &cb_backend_type, backend);
+
+    if (!backend->cluster) {
+        rb_raise(rb_eArgError, "Cluster has been closed already");
+    }
+
+    VALUE res = rb_hash_new();
+    for (const auto& [reason, count] : backend->cluster->retry_stats()) {
+        rb_hash_aset(res, rb_id2sym(rb_intern(fmt::format("{}", reason).c_str())), ULL2NUM(count));
+    }
+    return res;
+}
+
+static VALUE
+cb__histogram_snapshot_to_hash(const couchbase::metrics::histogram_snapshot& snapshot)
+{
+    VALUE res = rb_hash_new();
+    rb_hash_aset(res, rb_id2sym(rb_intern("count")), ULL2NUM(snapshot.count));
+    rb_hash_aset(res, rb_id2sym(rb_intern("min_us")), ULL2NUM(snapshot.min_us));
+    rb_hash_aset(res, rb_id2sym(rb_intern("max_us")), ULL2NUM(snapshot.max_us));
+    rb_hash_aset(res, rb_id2sym(rb_intern("mean_us")), ULL2NUM(snapshot.mean_us));
+    rb_hash_aset(res, rb_id2sym(rb_intern("p50_us")), ULL2NUM(snapshot.p50_us));
+    rb_hash_aset(res, rb_id2sym(rb_intern("p90_us")), ULL2NUM(snapshot.p90_us));
+    rb_hash_aset(res, rb_id2sym(rb_intern("p99_us")), ULL2NUM(snapshot.p99_us));
+    rb_hash_aset(res, rb_id2sym(rb_intern("p999_us")), ULL2NUM(snapshot.p999_us));
+    return res;
+}
+
+static VALUE
+cb_Backend_metrics(VALUE self)
+{
+    cb_backend_data* backend = nullptr;
+    TypedData_Get_Struct(self, cb_backend_data, &cb_backend_type, backend);
+
+    if (!backend->cluster) {
+        rb_raise(rb_eArgError, "Cluster has been closed already");
+    }
+
+    auto barrier = std::make_shared<std::promise<couchbase::metrics::cluster_metrics>>();
+    auto f = barrier->get_future();
+    backend->cluster->metrics([barrier](couchbase::metrics::cluster_metrics&& snapshot) { barrier->set_value(std::move(snapshot)); });
+    auto snapshot = cb__wait_for_future(f);
+
+    VALUE buckets = rb_ary_new_capa(static_cast<long>(snapshot.buckets.size()));
+    for (const auto& bucket : snapshot.buckets) {
+        VALUE sessions = rb_ary_new_capa(static_cast<long>(bucket.sessions.size()));
+        for (const auto& session : bucket.sessions) {
+            VALUE latencies = rb_hash_new();
+            for (const auto& [opcode, latency] : session.latencies) {
+                rb_hash_aset(latencies, rb_id2sym(rb_intern(opcode.c_str())), cb__histogram_snapshot_to_hash(latency));
+            }
+            VALUE entry = rb_hash_new();
+            rb_hash_aset(
+              entry, rb_id2sym(rb_intern("id")), rb_str_new(session.session_id.data(), static_cast<long>(session.session_id.size())));
+            rb_hash_aset(entry, rb_id2sym(rb_intern("node")), rb_str_new(session.node.data(), static_cast<long>(session.node.size())));
+            rb_hash_aset(entry, rb_id2sym(rb_intern("in_flight")), ULL2NUM(session.in_flight));
+            rb_hash_aset(entry, rb_id2sym(rb_intern("write_queue_bytes")), ULL2NUM(session.write_queue_bytes));
+            rb_hash_aset(entry, rb_id2sym(rb_intern("backpressure_events")), ULL2NUM(session.backpressure_events));
+            rb_hash_aset(entry, rb_id2sym(rb_intern("socket_writes")), ULL2NUM(session.socket_writes));
+            rb_hash_aset(entry, rb_id2sym(rb_intern("frames_written")), ULL2NUM(session.frames_written));
+            rb_hash_aset(entry, rb_id2sym(rb_intern("ordering_barriers")), ULL2NUM(session.ordering_barriers));
+            rb_hash_aset(entry, rb_id2sym(rb_intern("ordered_documents")), ULL2NUM(session.ordered_documents));
+            rb_hash_aset(entry, rb_id2sym(rb_intern("buffers_allocated")), ULL2NUM(session.buffers_allocated));
+            rb_hash_aset(entry, rb_id2sym(rb_intern("buffers_reused")), ULL2NUM(session.buffers_reused));
+            rb_hash_aset(entry, rb_id2sym(rb_intern("latencies")), latencies);
+            rb_ary_push(sessions, entry);
+        }
+        VALUE entry = rb_hash_new();
+        rb_hash_aset(entry, rb_id2sym(rb_intern("name")), rb_str_new(bucket.name.data(), static_cast<long>(bucket.name.size())));
+        rb_hash_aset(entry, rb_id2sym(rb_intern("deferred_commands")), ULL2NUM(bucket.deferred_commands));
+        rb_hash_aset(entry, rb_id2sym(rb_intern("rejected_deferred_commands")), ULL2NUM(bucket.rejected_deferred_commands));
+        rb_hash_aset(entry, rb_id2sym(rb_intern("sessions")), sessions);
+        rb_ary_push(buckets, entry);
+    }
+
+    VALUE endpoints = rb_ary_new_capa(static_cast<long>(snapshot.endpoints.size()));
+    for (const auto& endpoint : snapshot.endpoints) {
+        VALUE entry = rb_hash_new();
+        rb_hash_aset(entry, rb_id2sym(rb_intern("service")), rb_id2sym(rb_intern(fmt::format("{}", endpoint.service).c_str())));
+        rb_hash_aset(entry, rb_id2sym(rb_intern("node")), rb_str_new(endpoint.node.data(), static_cast<long>(endpoint.node.size())));
+        rb_hash_aset(entry, rb_id2sym(rb_intern("idle_sessions")), ULL2NUM(endpoint.idle_sessions));
+        rb_hash_aset(entry, rb_id2sym(rb_intern("busy_sessions")), ULL2NUM(endpoint.busy_sessions));
+        rb_hash_aset(entry, rb_id2sym(rb_intern("latency")), cb__histogram_snapshot_to_hash(endpoint.latency));
+        rb_hash_aset(entry, rb_id2sym(rb_intern("responses")), ULL2NUM(endpoint.responses));
+        rb_hash_aset(entry, rb_id2sym(rb_intern("compressed_responses")), ULL2NUM(endpoint.compressed_responses));
+        rb_hash_aset(entry, rb_id2sym(rb_intern("body_wire_bytes")), ULL2NUM(endpoint.body_wire_bytes));
+        rb_hash_aset(entry, rb_id2sym(rb_intern("body_decoded_bytes")), ULL2NUM(endpoint.body_decoded_bytes));
+        rb_ary_push(endpoints, entry);
+    }
+
+    VALUE res = rb_hash_new();
+    rb_hash_aset(res, rb_id2sym(rb_intern("buckets")), buckets);
+    rb_hash_aset(res, rb_id2sym(rb_intern("endpoints")), endpoints);
+    return res;
+}
+
+/**
+ * Rows of the streaming query, that have been received from the network, but not yet consumed by the application.
+ *
+ * The IO thread stops reading the response when the buffer is full, and the consumer resumes it once the buffer has been drained.
+ */
+struct cb_query_stream_state {
+    std::mutex mutex{};
+    std::condition_variable rows_available{};
+    std::deque<std::string> rows{};
+    std::size_t max_buffered_rows{ 1024 };
+    bool paused{ false };
+    std::optional<couchbase::operations::query_response> response{};
+    std::shared_ptr<couchbase::io::http_streaming_body> streaming{ std::make_shared<couchbase::io::http_streaming_body>() };
+    std::function<void()> canceler{};
+    couchbase::operations::query_request request{};
+    bool error_reported{ false };
+
+    bool push_row(std::string&& row)
+    {
+        std::scoped_lock lock(mutex);
+        rows.emplace_back(std::move(row));
+        rows_available.notify_one();
+        if (rows.size() >= max_buffered_rows) {
+            paused = true;
+        }
+        return !paused;
+    }
+
+    void complete(couchbase::operations::query_response&& resp)
+    {
+        std::scoped_lock lock(mutex);
+        response.emplace(std::move(resp));
+        rows_available.notify_one();
+    }
+
+    [[nodiscard]] bool is_complete()
+    {
+        std::scoped_lock lock(mutex);
+        return response.has_value();
+    }
+
+    /**
+     * Takes all buffered rows, and resumes reading of the response if it has been paused.
+     */
+    std::deque<std::string> take_rows()
+    {
+        std::deque<std::string> taken{};
+        bool resume = false;
+        {
+            std::unique_lock lock(mutex);
+            rows_available.wait(lock, [this]() { return !rows.empty() || response.has_value(); });
+            std::swap(taken, rows);
+            resume = paused;
+            paused = false;
+        }
+        if (resume && streaming->resume) {
+            streaming->resume();
+        }
+        return taken;
+    }
+};
+
+struct cb_query_stream_data {
+    std::shared_ptr<cb_query_stream_state> state;
+    VALUE backend;
+};
+
+static void
+cb_QueryStream_mark(void* ptr)
+{
+    auto* data = reinterpret_cast<cb_query_stream_data*>(ptr);
+    rb_gc_mark(data->backend);
+}
+
+static void
+cb_QueryStream_free(void* ptr)
 {
-    auto* preq = reinterpret_cast<couchbase::operations::query_request*>(arg);
-    Check_Type(key, T_STRING);
-    Check_Type(value, T_STRING);
-    preq->named_parameters.emplace(
-      std::string_view(RSTRING_PTR(key), static_cast<std::size_t>(RSTRING_LEN(key))),
-      tao::json::from_string(std::string_view(RSTRING_PTR(value), static_cast<std::size_t>(RSTRING_LEN(value)))));
-    return ST_CONTINUE;
+    auto* data = reinterpret_cast<cb_query_stream_data*>(ptr);
+    if (data->state && data->state->canceler && !data->state->is_complete()) {
+        // the reading might be paused, do not keep the connection busy until the query timeout
+        data->state->canceler();
+    }
+    data->~cb_query_stream_data();
+    ruby_xfree(data);
+}
+
+static size_t
+cb_QueryStream_memsize(const void* ptr)
+{
+    const auto* data = reinterpret_cast<const cb_query_stream_data*>(ptr);
+    return sizeof(*data);
 }
 
+static const rb_data_type_t cb_query_stream_type{
+    "Couchbase/Backend/QueryStream",
+    { cb_QueryStream_mark,
+      cb_QueryStream_free,
+      cb_QueryStream_memsize,
+// only one reserved field when GC.compact implemented
+#ifdef T_MOVED
+      nullptr,
+#endif
+      {} },
+#ifdef RUBY_TYPED_FREE_IMMEDIATELY
+    nullptr,
+    nullptr,
+    RUBY_TYPED_FREE_IMMEDIATELY,
+#endif
+};
+
+static VALUE cQueryStream;
+
 static VALUE
-cb_Backend_document_query(VALUE self, VALUE statement, VALUE options)
+cb_Backend_document_query_stream(VALUE self, VALUE statement, VALUE options)
 {
     cb_backend_data* backend = nullptr;
     TypedData_Get_Struct(self, cb_backend_data, &cb_backend_type, backend);
@@ -1913,210 +3012,107 @@ cb_Backend_document_query(VALUE self, VALUE statement, VALUE options)
         rb_raise(rb_eArgError, "Cluster has been closed already");
     }
 
-    Check_Type(statement, T_STRING);
-    Check_Type(options, T_HASH);
+    cb_query_stream_data* data = nullptr;
+    VALUE obj = TypedData_Make_Struct(cQueryStream, cb_query_stream_data, &cb_query_stream_type, data);
+    new (data) cb_query_stream_data{ std::make_shared<cb_query_stream_state>(), self };
+
+    cb__extract_query_request(data->state->request, statement, options);
+    VALUE max_buffered_rows = rb_hash_aref(options, rb_id2sym(rb_intern("max_buffered_rows")));
+    if (!NIL_P(max_buffered_rows)) {
+        data->state->max_buffered_rows = std::max<std::size_t>(1, NUM2ULONG(max_buffered_rows));
+    }
+
+    auto state = data->state;
+    couchbase::operations::query_request req = state->request;
+    req.streaming = state->streaming;
+    req.row_callback = [state](std::string&& row) { return state->push_row(std::move(row)); };
+    state->canceler = backend->cluster->execute_http(
+      req, [state](couchbase::operations::query_response resp) mutable { state->complete(std::move(resp)); });
+    return obj;
+}
+
+struct cb_query_stream_chunk {
+    cb_query_stream_state* state;
+    std::deque<std::string> rows{};
+    bool taken{ false };
+};
+
+static void*
+cb__query_stream_take_rows_without_gvl(void* arg)
+{
+    auto* chunk = static_cast<cb_query_stream_chunk*>(arg);
+    chunk->rows = chunk->state->take_rows();
+    chunk->taken = true;
+    return nullptr;
+}
+
+/**
+ * Returns next chunk of rows (as array of JSON strings), or nil, when all rows have been consumed.
+ *
+ * Blocks without GVL until at least one row is available, raises exception when the query has failed.
+ */
+static VALUE
+cb_QueryStream_next_rows(VALUE self)
+{
+    cb_query_stream_data* data = nullptr;
+    TypedData_Get_Struct(self, cb_query_stream_data, &cb_query_stream_type, data);
+    cb_query_stream_state* state = data->state.get();
 
     VALUE exc = Qnil;
     do {
-        couchbase::operations::query_request req;
-        req.statement.assign(RSTRING_PTR(statement), static_cast<size_t>(RSTRING_LEN(statement)));
-        VALUE client_context_id = rb_hash_aref(options, rb_id2sym(rb_intern("client_context_id")));
-        if (!NIL_P(client_context_id)) {
-            Check_Type(client_context_id, T_STRING);
-            req.client_context_id.assign(RSTRING_PTR(client_context_id), static_cast<size_t>(RSTRING_LEN(client_context_id)));
-        }
-        cb__extract_timeout(req, rb_hash_aref(options, rb_id2sym(rb_intern("timeout"))));
-        VALUE adhoc = rb_hash_aref(options, rb_id2sym(rb_intern("adhoc")));
-        if (!NIL_P(adhoc)) {
-            req.adhoc = RTEST(adhoc);
-        }
-        VALUE metrics = rb_hash_aref(options, rb_id2sym(rb_intern("metrics")));
-        if (!NIL_P(metrics)) {
-            req.metrics = RTEST(metrics);
-        }
-        VALUE readonly = rb_hash_aref(options, rb_id2sym(rb_intern("readonly")));
-        if (!NIL_P(readonly)) {
-            req.readonly = RTEST(readonly);
-        }
-        VALUE scan_cap = rb_hash_aref(options, rb_id2sym(rb_intern("scan_cap")));
-        if (!NIL_P(scan_cap)) {
-            req.scan_cap = NUM2ULONG(scan_cap);
-        }
-        VALUE scan_wait = rb_hash_aref(options, rb_id2sym(rb_intern("scan_wait")));
-        if (!NIL_P(scan_wait)) {
-            req.scan_wait = NUM2ULONG(scan_wait);
-        }
-        VALUE max_parallelism = rb_hash_aref(options, rb_id2sym(rb_intern("max_parallelism")));
-        if (!NIL_P(max_parallelism)) {
-            req.max_parallelism = NUM2ULONG(max_parallelism);
-        }
-        VALUE pipeline_cap = rb_hash_aref(options, rb_id2sym(rb_intern("pipeline_cap")));
-        if (!NIL_P(pipeline_cap)) {
-            req.pipeline_cap = NUM2ULONG(pipeline_cap);
-        }
-        VALUE pipeline_batch = rb_hash_aref(options, rb_id2sym(rb_intern("pipeline_batch")));
-        if (!NIL_P(pipeline_batch)) {
-            req.pipeline_batch = NUM2ULONG(pipeline_batch);
-        }
-        VALUE profile = rb_hash_aref(options, rb_id2sym(rb_intern("profile")));
-        if (!NIL_P(profile)) {
-            Check_Type(profile, T_SYMBOL);
-            ID mode = rb_sym2id(profile);
-            if (mode == rb_intern("phases")) {
-                req.profile = couchbase::operations::query_request::profile_mode::phases;
-            } else if (mode == rb_intern("timings")) {
-                req.profile = couchbase::operations::query_request::profile_mode::timings;
-            } else if (mode == rb_intern("off")) {
-                req.profile = couchbase::operations::query_request::profile_mode::off;
+        cb_query_stream_chunk chunk{ state };
+        rb_thread_call_without_gvl2(
+          cb__query_stream_take_rows_without_gvl, &chunk, state->canceler ? cb__cancel_operation : nullptr, &state->canceler);
+        if (!chunk.taken) {
+            // the interrupt was already pending, so the GVL has not been released at all
+            if (state->canceler && !state->is_complete()) {
+                state->canceler();
             }
+            chunk.rows = state->take_rows();
         }
-        VALUE positional_params = rb_hash_aref(options, rb_id2sym(rb_intern("positional_parameters")));
-        if (!NIL_P(positional_params)) {
-            Check_Type(positional_params, T_ARRAY);
-            auto entries_num = static_cast<size_t>(RARRAY_LEN(positional_params));
-            req.positional_parameters.reserve(entries_num);
-            for (size_t i = 0; i < entries_num; ++i) {
-                VALUE entry = rb_ary_entry(positional_params, static_cast<long>(i));
-                Check_Type(entry, T_STRING);
-                req.positional_parameters.emplace_back(
-                  tao::json::from_string(std::string_view(RSTRING_PTR(entry), static_cast<std::size_t>(RSTRING_LEN(entry)))));
-            }
-        }
-        VALUE named_params = rb_hash_aref(options, rb_id2sym(rb_intern("named_parameters")));
-        if (!NIL_P(named_params)) {
-            Check_Type(named_params, T_HASH);
-            rb_hash_foreach(named_params, INT_FUNC(cb__for_each_named_param), reinterpret_cast<VALUE>(&req));
-        }
-        VALUE scan_consistency = rb_hash_aref(options, rb_id2sym(rb_intern("scan_consistency")));
-        if (!NIL_P(scan_consistency)) {
-            Check_Type(scan_consistency, T_SYMBOL);
-            ID type = rb_sym2id(scan_consistency);
-            if (type == rb_intern("not_bounded")) {
-                req.scan_consistency = couchbase::operations::query_request::scan_consistency_type::not_bounded;
-            } else if (type == rb_intern("request_plus")) {
-                req.scan_consistency = couchbase::operations::query_request::scan_consistency_type::request_plus;
-            }
-        }
-        VALUE mutation_state = rb_hash_aref(options, rb_id2sym(rb_intern("mutation_state")));
-        if (!NIL_P(mutation_state)) {
-            Check_Type(mutation_state, T_ARRAY);
-            auto state_size = static_cast<size_t>(RARRAY_LEN(mutation_state));
-            req.mutation_state.reserve(state_size);
-            for (size_t i = 0; i < state_size; ++i) {
-                VALUE token = rb_ary_entry(mutation_state, static_cast<long>(i));
-                Check_Type(token, T_HASH);
-                VALUE bucket_name = rb_hash_aref(token, rb_id2sym(rb_intern("bucket_name")));
-                Check_Type(bucket_name, T_STRING);
-                VALUE partition_id = rb_hash_aref(token, rb_id2sym(rb_intern("partition_id")));
-                Check_Type(partition_id, T_FIXNUM);
-                VALUE partition_uuid = rb_hash_aref(token, rb_id2sym(rb_intern("partition_uuid")));
-                switch (TYPE(partition_uuid)) {
-                    case T_FIXNUM:
-                    case T_BIGNUM:
-                        break;
-                    default:
-                        rb_raise(rb_eArgError, "partition_uuid must be an Integer");
-                }
-                VALUE sequence_number = rb_hash_aref(token, rb_id2sym(rb_intern("sequence_number")));
-                switch (TYPE(sequence_number)) {
-                    case T_FIXNUM:
-                    case T_BIGNUM:
-                        break;
-                    default:
-                        rb_raise(rb_eArgError, "sequence_number must be an Integer");
-                }
-                req.mutation_state.emplace_back(
-                  couchbase::mutation_token{ NUM2ULL(partition_uuid),
-                                             NUM2ULL(sequence_number),
-                                             gsl::narrow_cast<std::uint16_t>(NUM2UINT(partition_id)),
-                                             std::string(RSTRING_PTR(bucket_name), static_cast<std::size_t>(RSTRING_LEN(bucket_name))) });
+        if (!chunk.rows.empty()) {
+            VALUE rows = rb_ary_new_capa(static_cast<long>(chunk.rows.size()));
+            for (const auto& row : chunk.rows) {
+                rb_ary_push(rows, rb_str_new(row.data(), static_cast<long>(row.size())));
             }
+            return rows;
         }
-
-        VALUE raw_params = rb_hash_aref(options, rb_id2sym(rb_intern("raw_parameters")));
-        if (!NIL_P(raw_params)) {
-            Check_Type(raw_params, T_HASH);
-            rb_hash_foreach(raw_params, INT_FUNC(cb__for_each_named_param), reinterpret_cast<VALUE>(&req));
-        }
-
-        auto barrier = std::make_shared<std::promise<couchbase::operations::query_response>>();
-        auto f = barrier->get_future();
-        backend->cluster->execute_http(req, [barrier](couchbase::operations::query_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
-        if (resp.ec) {
-            if (resp.payload.meta_data.errors && !resp.payload.meta_data.errors->empty()) {
-                const auto& first_error = resp.payload.meta_data.errors->front();
-                exc = cb__map_error_code(resp.ec,
-                                         fmt::format("unable to query: \"{}{}\" ({}: {})",
-                                                     req.statement.substr(0, 50),
-                                                     req.statement.size() > 50 ? "..." : "",
-                                                     first_error.code,
-                                                     first_error.message));
-            } else {
-                exc = cb__map_error_code(
-                  resp.ec, fmt::format("unable to query: \"{}{}\"", req.statement.substr(0, 50), req.statement.size() > 50 ? "..." : ""));
-            }
+        if (state->response->ec && !state->error_reported) {
+            state->error_reported = true;
+            exc = cb__map_query_error(state->request, state->response.value());
             break;
         }
-        VALUE res = rb_hash_new();
-        VALUE rows = rb_ary_new_capa(static_cast<long>(resp.payload.rows.size()));
-        rb_hash_aset(res, rb_id2sym(rb_intern("rows")), rows);
-        for (auto& row : resp.payload.rows) {
-            rb_ary_push(rows, rb_str_new(row.data(), static_cast<long>(row.size())));
-        }
-        VALUE meta = rb_hash_new();
-        rb_hash_aset(res, rb_id2sym(rb_intern("meta")), meta);
-        rb_hash_aset(meta,
-                     rb_id2sym(rb_intern("status")),
-                     rb_id2sym(rb_intern2(resp.payload.meta_data.status.data(), static_cast<long>(resp.payload.meta_data.status.size()))));
-        rb_hash_aset(meta,
-                     rb_id2sym(rb_intern("request_id")),
-                     rb_str_new(resp.payload.meta_data.request_id.data(), static_cast<long>(resp.payload.meta_data.request_id.size())));
-        rb_hash_aset(
-          meta,
-          rb_id2sym(rb_intern("client_context_id")),
-          rb_str_new(resp.payload.meta_data.client_context_id.data(), static_cast<long>(resp.payload.meta_data.client_context_id.size())));
-        if (resp.payload.meta_data.signature) {
-            rb_hash_aset(meta,
-                         rb_id2sym(rb_intern("signature")),
-                         rb_str_new(resp.payload.meta_data.signature->data(), static_cast<long>(resp.payload.meta_data.signature->size())));
-        }
-        if (resp.payload.meta_data.profile) {
-            rb_hash_aset(meta,
-                         rb_id2sym(rb_intern("profile")),
-                         rb_str_new(resp.payload.meta_data.profile->data(), static_cast<long>(resp.payload.meta_data.profile->size())));
-        }
-        metrics = rb_hash_new();
-        rb_hash_aset(meta, rb_id2sym(rb_intern("metrics")), metrics);
-        rb_hash_aset(metrics,
-                     rb_id2sym(rb_intern("elapsed_time")),
-                     rb_str_new(resp.payload.meta_data.metrics.elapsed_time.data(),
-                                static_cast<long>(resp.payload.meta_data.metrics.elapsed_time.size())));
-        rb_hash_aset(metrics,
-                     rb_id2sym(rb_intern("execution_time")),
-                     rb_str_new(resp.payload.meta_data.metrics.execution_time.data(),
-                                static_cast<long>(resp.payload.meta_data.metrics.execution_time.size())));
-        rb_hash_aset(metrics, rb_id2sym(rb_intern("result_count")), ULL2NUM(resp.payload.meta_data.metrics.result_count));
-        rb_hash_aset(metrics, rb_id2sym(rb_intern("result_size")), ULL2NUM(resp.payload.meta_data.metrics.result_count));
-        if (resp.payload.meta_data.metrics.sort_count) {
-            rb_hash_aset(metrics, rb_id2sym(rb_intern("sort_count")), ULL2NUM(*resp.payload.meta_data.metrics.sort_count));
-        }
-        if (resp.payload.meta_data.metrics.mutation_count) {
-            rb_hash_aset(metrics, rb_id2sym(rb_intern("mutation_count")), ULL2NUM(*resp.payload.meta_data.metrics.mutation_count));
-        }
-        if (resp.payload.meta_data.metrics.error_count) {
-            rb_hash_aset(metrics, rb_id2sym(rb_intern("error_count")), ULL2NUM(*resp.payload.meta_data.metrics.error_count));
-        }
-        if (resp.payload.meta_data.metrics.warning_count) {
-            rb_hash_aset(metrics, rb_id2sym(rb_intern("warning_count")), ULL2NUM(*resp.payload.meta_data.metrics.warning_count));
-        }
-
-        return res;
+        return Qnil;
     } while (false);
     rb_exc_raise(exc);
     return Qnil;
 }
 
+/**
+ * Returns metadata of the query, or nil if the response has not been received completely.
+ */
+static VALUE
+cb_QueryStream_meta(VALUE self)
+{
+    cb_query_stream_data* data = nullptr;
+    TypedData_Get_Struct(self, cb_query_stream_data, &cb_query_stream_type, data);
+    if (!data->state->is_complete() || data->state->response->ec) {
+        return Qnil;
+    }
+    return cb__extract_query_meta(data->state->response.value());
+}
+
+static VALUE
+cb_QueryStream_cancel(VALUE self)
+{
+    cb_query_stream_data* data = nullptr;
+    TypedData_Get_Struct(self, cb_query_stream_data, &cb_query_stream_type, data);
+    if (data->state->canceler) {
+        data->state->canceler();
+    }
+    return Qnil;
+}
+
 static void
 cb__generate_bucket_settings(VALUE bucket, couchbase::operations::bucket_settings& entry, bool is_create)
 {
@@ -2231,9 +3227,9 @@ cb_Backend_bucket_create(VALUE self, VALUE bucket_settings, VALUE timeout)
         cb__generate_bucket_settings(bucket_settings, req.bucket, true);
         auto barrier = std::make_shared<std::promise<couchbase::operations::bucket_create_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(req,
-                                       [barrier](couchbase::operations::bucket_create_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::bucket_create_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             exc = cb__map_error_code(
               resp.ec, fmt::format("unable to create bucket \"{}\" on the cluster ({})", req.bucket.name, resp.error_message));
@@ -2264,9 +3260,9 @@ cb_Backend_bucket_update(VALUE self, VALUE bucket_settings, VALUE timeout)
         cb__generate_bucket_settings(bucket_settings, req.bucket, false);
         auto barrier = std::make_shared<std::promise<couchbase::operations::bucket_update_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(req,
-                                       [barrier](couchbase::operations::bucket_update_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::bucket_update_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             exc = cb__map_error_code(
               resp.ec, fmt::format("unable to update bucket \"{}\" on the cluster ({})", req.bucket.name, resp.error_message));
@@ -2297,9 +3293,9 @@ cb_Backend_bucket_drop(VALUE self, VALUE bucket_name, VALUE timeout)
         req.name.assign(RSTRING_PTR(bucket_name), static_cast<size_t>(RSTRING_LEN(bucket_name)));
         auto barrier = std::make_shared<std::promise<couchbase::operations::bucket_drop_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(req,
-                                       [barrier](couchbase::operations::bucket_drop_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::bucket_drop_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             exc = cb__map_error_code(resp.ec, fmt::format("unable to remove bucket \"{}\" on the cluster", req.name));
             break;
@@ -2329,9 +3325,9 @@ cb_Backend_bucket_flush(VALUE self, VALUE bucket_name, VALUE timeout)
         req.name.assign(RSTRING_PTR(bucket_name), static_cast<size_t>(RSTRING_LEN(bucket_name)));
         auto barrier = std::make_shared<std::promise<couchbase::operations::bucket_flush_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(req,
-                                       [barrier](couchbase::operations::bucket_flush_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::bucket_flush_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             exc = cb__map_error_code(resp.ec, fmt::format("unable to remove bucket \"{}\" on the cluster", req.name));
             break;
@@ -2435,9 +3431,9 @@ cb_Backend_bucket_get_all(VALUE self, VALUE timeout)
         cb__extract_timeout(req, timeout);
         auto barrier = std::make_shared<std::promise<couchbase::operations::bucket_get_all_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(
-          req, [barrier](couchbase::operations::bucket_get_all_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::bucket_get_all_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             exc = cb__map_error_code(resp.ec, "unable to get list of the buckets of the cluster");
             break;
@@ -2475,9 +3471,9 @@ cb_Backend_bucket_get(VALUE self, VALUE bucket_name, VALUE timeout)
         req.name.assign(RSTRING_PTR(bucket_name), static_cast<size_t>(RSTRING_LEN(bucket_name)));
         auto barrier = std::make_shared<std::promise<couchbase::operations::bucket_get_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(req,
-                                       [barrier](couchbase::operations::bucket_get_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::bucket_get_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             exc = cb__map_error_code(resp.ec, fmt::format("unable to locate bucket \"{}\" on the cluster", req.name));
             break;
@@ -2507,9 +3503,11 @@ cb_Backend_cluster_enable_developer_preview(VALUE self)
         couchbase::operations::cluster_developer_preview_enable_request req{};
         auto barrier = std::make_shared<std::promise<couchbase::operations::cluster_developer_preview_enable_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(
-          req, [barrier](couchbase::operations::cluster_developer_preview_enable_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::cluster_developer_preview_enable_response resp) mutable {
+              barrier->set_value(std::move(resp));
+          });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             exc = cb__map_error_code(resp.ec, fmt::format("unable to enable developer preview for this cluster"));
             break;
@@ -2542,9 +3540,9 @@ cb_Backend_scope_get_all(VALUE self, VALUE bucket_name, VALUE timeout)
         req.bucket_name.assign(RSTRING_PTR(bucket_name), static_cast<size_t>(RSTRING_LEN(bucket_name)));
         auto barrier = std::make_shared<std::promise<couchbase::operations::scope_get_all_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(req,
-                                       [barrier](couchbase::operations::scope_get_all_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::scope_get_all_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             exc = cb__map_error_code(resp.ec, fmt::format("unable to get list of the scopes of the bucket \"{}\"", req.bucket_name));
             break;
@@ -2596,9 +3594,9 @@ cb_Backend_scope_create(VALUE self, VALUE bucket_name, VALUE scope_name, VALUE t
         req.scope_name.assign(RSTRING_PTR(scope_name), static_cast<size_t>(RSTRING_LEN(scope_name)));
         auto barrier = std::make_shared<std::promise<couchbase::operations::scope_create_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(req,
-                                       [barrier](couchbase::operations::scope_create_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::scope_create_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             exc = cb__map_error_code(resp.ec, fmt::format("unable to create the scope on the bucket \"{}\"", req.bucket_name));
             break;
@@ -2630,9 +3628,9 @@ cb_Backend_scope_drop(VALUE self, VALUE bucket_name, VALUE scope_name, VALUE tim
         req.scope_name.assign(RSTRING_PTR(scope_name), static_cast<size_t>(RSTRING_LEN(scope_name)));
         auto barrier = std::make_shared<std::promise<couchbase::operations::scope_drop_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(req,
-                                       [barrier](couchbase::operations::scope_drop_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::scope_drop_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             exc = cb__map_error_code(resp.ec,
                                      fmt::format("unable to drop the scope \"{}\" on the bucket \"{}\"", req.scope_name, req.bucket_name));
@@ -2672,9 +3670,9 @@ cb_Backend_collection_create(VALUE self, VALUE bucket_name, VALUE scope_name, VA
         }
         auto barrier = std::make_shared<std::promise<couchbase::operations::collection_create_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(
-          req, [barrier](couchbase::operations::collection_create_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::collection_create_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             exc = cb__map_error_code(
               resp.ec,
@@ -2712,9 +3710,9 @@ cb_Backend_collection_drop(VALUE self, VALUE bucket_name, VALUE scope_name, VALU
 
         auto barrier = std::make_shared<std::promise<couchbase::operations::collection_drop_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(
-          req, [barrier](couchbase::operations::collection_drop_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::collection_drop_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             exc = cb__map_error_code(
               resp.ec,
@@ -2747,9 +3745,9 @@ cb_Backend_query_index_get_all(VALUE self, VALUE bucket_name, VALUE timeout)
         req.bucket_name.assign(RSTRING_PTR(bucket_name), static_cast<size_t>(RSTRING_LEN(bucket_name)));
         auto barrier = std::make_shared<std::promise<couchbase::operations::query_index_get_all_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(
-          req, [barrier](couchbase::operations::query_index_get_all_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::query_index_get_all_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             exc = cb__map_error_code(resp.ec, fmt::format("unable to get list of the indexes of the bucket \"{}\"", req.bucket_name));
             break;
@@ -2844,9 +3842,9 @@ cb_Backend_query_index_create(VALUE self, VALUE bucket_name, VALUE index_name, V
 
         auto barrier = std::make_shared<std::promise<couchbase::operations::query_index_create_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(
-          req, [barrier](couchbase::operations::query_index_create_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::query_index_create_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             if (!resp.errors.empty()) {
                 const auto& first_error = resp.errors.front();
@@ -2911,9 +3909,9 @@ cb_Backend_query_index_drop(VALUE self, VALUE bucket_name, VALUE index_name, VAL
 
         auto barrier = std::make_shared<std::promise<couchbase::operations::query_index_drop_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(
-          req, [barrier](couchbase::operations::query_index_drop_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::query_index_drop_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             if (!resp.errors.empty()) {
                 const auto& first_error = resp.errors.front();
@@ -2994,9 +3992,9 @@ cb_Backend_query_index_create_primary(VALUE self, VALUE bucket_name, VALUE optio
 
         auto barrier = std::make_shared<std::promise<couchbase::operations::query_index_create_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(
-          req, [barrier](couchbase::operations::query_index_create_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::query_index_create_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             if (!resp.errors.empty()) {
                 const auto& first_error = resp.errors.front();
@@ -3065,9 +4063,9 @@ cb_Backend_query_index_drop_primary(VALUE self, VALUE bucket_name, VALUE options
 
         auto barrier = std::make_shared<std::promise<couchbase::operations::query_index_drop_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(
-          req, [barrier](couchbase::operations::query_index_drop_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::query_index_drop_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             if (!resp.errors.empty()) {
                 const auto& first_error = resp.errors.front();
@@ -3117,9 +4115,9 @@ cb_Backend_query_index_build_deferred(VALUE self, VALUE bucket_name, VALUE timeo
         req.bucket_name.assign(RSTRING_PTR(bucket_name), static_cast<size_t>(RSTRING_LEN(bucket_name)));
         auto barrier = std::make_shared<std::promise<couchbase::operations::query_index_build_deferred_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(
-          req, [barrier](couchbase::operations::query_index_build_deferred_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::query_index_build_deferred_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             if (!resp.errors.empty()) {
                 const auto& first_error = resp.errors.front();
@@ -3207,9 +4205,9 @@ cb_Backend_search_index_get_all(VALUE self, VALUE timeout)
         cb__extract_timeout(req, timeout);
         auto barrier = std::make_shared<std::promise<couchbase::operations::search_index_get_all_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(
-          req, [barrier](couchbase::operations::search_index_get_all_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::search_index_get_all_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             exc = cb__map_error_code(resp.ec, "unable to get list of the search indexes");
             break;
@@ -3249,9 +4247,9 @@ cb_Backend_search_index_get(VALUE self, VALUE index_name, VALUE timeout)
         req.index_name.assign(RSTRING_PTR(index_name), static_cast<size_t>(RSTRING_LEN(index_name)));
         auto barrier = std::make_shared<std::promise<couchbase::operations::search_index_get_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(
-          req, [barrier](couchbase::operations::search_index_get_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::search_index_get_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             if (resp.error.empty()) {
                 exc = cb__map_error_code(resp.ec, fmt::format("unable to get search index \"{}\"", req.index_name));
@@ -3334,9 +4332,9 @@ cb_Backend_search_index_upsert(VALUE self, VALUE index_definition, VALUE timeout
 
         auto barrier = std::make_shared<std::promise<couchbase::operations::search_index_upsert_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(
-          req, [barrier](couchbase::operations::search_index_upsert_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::search_index_upsert_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             if (resp.error.empty()) {
                 exc = cb__map_error_code(resp.ec, fmt::format("unable to upsert the search index \"{}\"", req.index.name));
@@ -3371,9 +4369,9 @@ cb_Backend_search_index_drop(VALUE self, VALUE index_name, VALUE timeout)
         req.index_name.assign(RSTRING_PTR(index_name), static_cast<size_t>(RSTRING_LEN(index_name)));
         auto barrier = std::make_shared<std::promise<couchbase::operations::search_index_drop_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(
-          req, [barrier](couchbase::operations::search_index_drop_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::search_index_drop_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             if (resp.error.empty()) {
                 exc = cb__map_error_code(resp.ec, fmt::format("unable to drop the search index \"{}\"", req.index_name));
@@ -3408,9 +4406,11 @@ cb_Backend_search_index_get_documents_count(VALUE self, VALUE index_name, VALUE
         req.index_name.assign(RSTRING_PTR(index_name), static_cast<size_t>(RSTRING_LEN(index_name)));
         auto barrier = std::make_shared<std::promise<couchbase::operations::search_index_get_documents_count_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(
-          req, [barrier](couchbase::operations::search_index_get_documents_count_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::search_index_get_documents_count_response resp) mutable {
+              barrier->set_value(std::move(resp));
+          });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             if (resp.error.empty()) {
                 exc = cb__map_error_code(
@@ -3450,9 +4450,11 @@ cb_Backend_search_index_pause_ingest(VALUE self, VALUE index_name, VALUE timeout
         req.pause = true;
         auto barrier = std::make_shared<std::promise<couchbase::operations::search_index_control_ingest_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(
-          req, [barrier](couchbase::operations::search_index_control_ingest_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::search_index_control_ingest_response resp) mutable {
+              barrier->set_value(std::move(resp));
+          });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             if (resp.error.empty()) {
                 exc = cb__map_error_code(resp.ec, fmt::format("unable to pause ingest for the search index \"{}\"", req.index_name));
@@ -3489,9 +4491,11 @@ cb_Backend_search_index_resume_ingest(VALUE self, VALUE index_name, VALUE timeou
         req.pause = false;
         auto barrier = std::make_shared<std::promise<couchbase::operations::search_index_control_ingest_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(
-          req, [barrier](couchbase::operations::search_index_control_ingest_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::search_index_control_ingest_response resp) mutable {
+              barrier->set_value(std::move(resp));
+          });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             if (resp.error.empty()) {
                 exc = cb__map_error_code(resp.ec, fmt::format("unable to resume ingest for the search index \"{}\"", req.index_name));
@@ -3528,9 +4532,9 @@ cb_Backend_search_index_allow_querying(VALUE self, VALUE index_name, VALUE timeo
         req.allow = true;
         auto barrier = std::make_shared<std::promise<couchbase::operations::search_index_control_query_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(
-          req, [barrier](couchbase::operations::search_index_control_query_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::search_index_control_query_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             if (resp.error.empty()) {
                 exc = cb__map_error_code(resp.ec, fmt::format("unable to allow querying for the search index \"{}\"", req.index_name));
@@ -3567,9 +4571,9 @@ cb_Backend_search_index_disallow_querying(VALUE self, VALUE index_name, VALUE ti
         req.allow = false;
         auto barrier = std::make_shared<std::promise<couchbase::operations::search_index_control_query_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(
-          req, [barrier](couchbase::operations::search_index_control_query_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::search_index_control_query_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             if (resp.error.empty()) {
                 exc = cb__map_error_code(resp.ec, fmt::format("unable to disallow querying for the search index \"{}\"", req.index_name));
@@ -3606,9 +4610,11 @@ cb_Backend_search_index_freeze_plan(VALUE self, VALUE index_name, VALUE timeout)
         req.freeze = true;
         auto barrier = std::make_shared<std::promise<couchbase::operations::search_index_control_plan_freeze_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(
-          req, [barrier](couchbase::operations::search_index_control_plan_freeze_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::search_index_control_plan_freeze_response resp) mutable {
+              barrier->set_value(std::move(resp));
+          });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             if (resp.error.empty()) {
                 exc = cb__map_error_code(resp.ec, fmt::format("unable to freeze for the search index \"{}\"", req.index_name));
@@ -3645,9 +4651,11 @@ cb_Backend_search_index_unfreeze_plan(VALUE self, VALUE index_name, VALUE timeou
         req.freeze = false;
         auto barrier = std::make_shared<std::promise<couchbase::operations::search_index_control_plan_freeze_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(
-          req, [barrier](couchbase::operations::search_index_control_plan_freeze_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::search_index_control_plan_freeze_response resp) mutable {
+              barrier->set_value(std::move(resp));
+          });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             if (resp.error.empty()) {
                 exc = cb__map_error_code(resp.ec, fmt::format("unable to unfreeze plan for the search index \"{}\"", req.index_name));
@@ -3687,9 +4695,11 @@ cb_Backend_search_index_analyze_document(VALUE self, VALUE index_name, VALUE enc
 
         auto barrier = std::make_shared<std::promise<couchbase::operations::search_index_analyze_document_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(
-          req, [barrier](couchbase::operations::search_index_analyze_document_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::search_index_analyze_document_response resp) mutable {
+              barrier->set_value(std::move(resp));
+          });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             if (resp.error.empty()) {
                 exc = cb__map_error_code(resp.ec, fmt::format("unable to analyze document using the search index \"{}\"", req.index_name));
@@ -3865,8 +4875,9 @@ cb_Backend_document_search(VALUE self, VALUE index_name, VALUE query, VALUE opti
 
         auto barrier = std::make_shared<std::promise<couchbase::operations::search_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(req, [barrier](couchbase::operations::search_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::search_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             exc = cb__map_error_code(resp.ec, fmt::format("unable to perform search query for index \"{}\"", req.index_name));
             break;
@@ -4049,7 +5060,9 @@ cb_Backend_dns_srv(VALUE self, VALUE hostname, VALUE service)
         auto barrier = std::make_shared<std::promise<couchbase::io::dns::dns_client::dns_srv_response>>();
         auto f = barrier->get_future();
         client.query_srv(
-          host_name, service_name, [barrier](couchbase::io::dns::dns_client::dns_srv_response resp) mutable { barrier->set_value(resp); });
+          host_name, service_name, [barrier](couchbase::io::dns::dns_client::dns_srv_response resp) mutable {
+              barrier->set_value(std::move(resp));
+          });
         ctx.run();
         auto resp = f.get();
         if (resp.ec) {
@@ -4087,9 +5100,11 @@ cb_Backend_analytics_get_pending_mutations(VALUE self, VALUE timeout)
         cb__extract_timeout(req, timeout);
         auto barrier = std::make_shared<std::promise<couchbase::operations::analytics_get_pending_mutations_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(
-          req, [barrier](couchbase::operations::analytics_get_pending_mutations_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::analytics_get_pending_mutations_response resp) mutable {
+              barrier->set_value(std::move(resp));
+          });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             if (resp.errors.empty()) {
                 exc = cb__map_error_code(resp.ec, "unable to get pending mutations for the analytics service");
@@ -4127,9 +5142,9 @@ cb_Backend_analytics_dataset_get_all(VALUE self, VALUE timeout)
         cb__extract_timeout(req, timeout);
         auto barrier = std::make_shared<std::promise<couchbase::operations::analytics_dataset_get_all_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(
-          req, [barrier](couchbase::operations::analytics_dataset_get_all_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::analytics_dataset_get_all_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             if (resp.errors.empty()) {
                 exc = cb__map_error_code(resp.ec, "unable to fetch all datasets");
@@ -4187,9 +5202,9 @@ cb_Backend_analytics_dataset_drop(VALUE self, VALUE dataset_name, VALUE datavers
         }
         auto barrier = std::make_shared<std::promise<couchbase::operations::analytics_dataset_drop_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(
-          req, [barrier](couchbase::operations::analytics_dataset_drop_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::analytics_dataset_drop_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             if (resp.errors.empty()) {
                 exc = cb__map_error_code(resp.ec, fmt::format("unable to drop dataset `{}`.`{}`", req.dataverse_name, req.dataset_name));
@@ -4252,9 +5267,9 @@ cb_Backend_analytics_dataset_create(VALUE self,
         }
         auto barrier = std::make_shared<std::promise<couchbase::operations::analytics_dataset_create_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(
-          req, [barrier](couchbase::operations::analytics_dataset_create_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::analytics_dataset_create_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             if (resp.errors.empty()) {
                 exc = cb__map_error_code(resp.ec, fmt::format("unable to create dataset `{}`.`{}`", req.dataverse_name, req.dataset_name));
@@ -4297,9 +5312,9 @@ cb_Backend_analytics_dataverse_drop(VALUE self, VALUE dataverse_name, VALUE igno
         }
         auto barrier = std::make_shared<std::promise<couchbase::operations::analytics_dataverse_drop_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(
-          req, [barrier](couchbase::operations::analytics_dataverse_drop_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::analytics_dataverse_drop_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             if (resp.errors.empty()) {
                 exc = cb__map_error_code(resp.ec, fmt::format("unable to drop dataverse `{}`", req.dataverse_name));
@@ -4342,9 +5357,9 @@ cb_Backend_analytics_dataverse_create(VALUE self, VALUE dataverse_name, VALUE ig
         }
         auto barrier = std::make_shared<std::promise<couchbase::operations::analytics_dataverse_create_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(
-          req, [barrier](couchbase::operations::analytics_dataverse_create_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::analytics_dataverse_create_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             if (resp.errors.empty()) {
                 exc = cb__map_error_code(resp.ec, fmt::format("unable to create dataverse `{}`", req.dataverse_name));
@@ -4378,9 +5393,9 @@ cb_Backend_analytics_index_get_all(VALUE self, VALUE timeout)
         cb__extract_timeout(req, timeout);
         auto barrier = std::make_shared<std::promise<couchbase::operations::analytics_index_get_all_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(
-          req, [barrier](couchbase::operations::analytics_index_get_all_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::analytics_index_get_all_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             if (resp.errors.empty()) {
                 exc = cb__map_error_code(resp.ec, "unable to fetch all indexes");
@@ -4457,9 +5472,9 @@ cb_Backend_analytics_index_create(VALUE self,
         }
         auto barrier = std::make_shared<std::promise<couchbase::operations::analytics_index_create_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(
-          req, [barrier](couchbase::operations::analytics_index_create_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::analytics_index_create_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             if (resp.errors.empty()) {
                 exc = cb__map_error_code(
@@ -4517,9 +5532,9 @@ cb_Backend_analytics_index_drop(VALUE self,
         }
         auto barrier = std::make_shared<std::promise<couchbase::operations::analytics_index_drop_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(
-          req, [barrier](couchbase::operations::analytics_index_drop_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::analytics_index_drop_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             if (resp.errors.empty()) {
                 exc = cb__map_error_code(
@@ -4570,9 +5585,9 @@ cb_Backend_analytics_link_connect(VALUE self, VALUE link_name, VALUE force, VALU
         }
         auto barrier = std::make_shared<std::promise<couchbase::operations::analytics_link_connect_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(
-          req, [barrier](couchbase::operations::analytics_link_connect_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::analytics_link_connect_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             if (resp.errors.empty()) {
                 exc = cb__map_error_code(resp.ec, fmt::format("unable to connect link `{}` on `{}`", req.link_name, req.dataverse_name));
@@ -4618,9 +5633,9 @@ cb_Backend_analytics_link_disconnect(VALUE self, VALUE link_name, VALUE datavers
         }
         auto barrier = std::make_shared<std::promise<couchbase::operations::analytics_link_disconnect_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(
-          req, [barrier](couchbase::operations::analytics_link_disconnect_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::analytics_link_disconnect_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             if (resp.errors.empty()) {
                 exc = cb__map_error_code(resp.ec, fmt::format("unable to disconnect link `{}` on `{}`", req.link_name, req.dataverse_name));
@@ -4720,9 +5735,9 @@ cb_Backend_document_analytics(VALUE self, VALUE statement, VALUE options)
 
         auto barrier = std::make_shared<std::promise<couchbase::operations::analytics_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(req,
-                                       [barrier](couchbase::operations::analytics_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::analytics_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             if (resp.payload.meta_data.errors && !resp.payload.meta_data.errors->empty()) {
                 const auto& first_error = resp.payload.meta_data.errors->front();
@@ -4909,9 +5924,9 @@ cb_Backend_view_index_get_all(VALUE self, VALUE bucket_name, VALUE name_space, V
         cb__extract_timeout(req, timeout);
         auto barrier = std::make_shared<std::promise<couchbase::operations::view_index_get_all_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(
-          req, [barrier](couchbase::operations::view_index_get_all_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::view_index_get_all_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             exc = cb__map_error_code(resp.ec, "unable to get list of the design documents");
             break;
@@ -4988,9 +6003,9 @@ cb_Backend_view_index_get(VALUE self, VALUE bucket_name, VALUE document_name, VA
         cb__extract_timeout(req, timeout);
         auto barrier = std::make_shared<std::promise<couchbase::operations::view_index_get_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(
-          req, [barrier](couchbase::operations::view_index_get_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::view_index_get_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             exc = cb__map_error_code(
               resp.ec,
@@ -5066,9 +6081,9 @@ cb_Backend_view_index_drop(VALUE self, VALUE bucket_name, VALUE document_name, V
         cb__extract_timeout(req, timeout);
         auto barrier = std::make_shared<std::promise<couchbase::operations::view_index_drop_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(
-          req, [barrier](couchbase::operations::view_index_drop_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::view_index_drop_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             exc = cb__map_error_code(
               resp.ec,
@@ -5142,9 +6157,9 @@ cb_Backend_view_index_upsert(VALUE self, VALUE bucket_name, VALUE document, VALU
         cb__extract_timeout(req, timeout);
         auto barrier = std::make_shared<std::promise<couchbase::operations::view_index_upsert_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(
-          req, [barrier](couchbase::operations::view_index_upsert_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::view_index_upsert_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             exc = cb__map_error_code(
               resp.ec,
@@ -5287,9 +6302,9 @@ cb_Backend_document_view(VALUE self, VALUE bucket_name, VALUE design_document_na
 
         auto barrier = std::make_shared<std::promise<couchbase::operations::document_view_response>>();
         auto f = barrier->get_future();
-        backend->cluster->execute_http(req,
-                                       [barrier](couchbase::operations::document_view_response resp) mutable { barrier->set_value(resp); });
-        auto resp = f.get();
+        auto cancel = backend->cluster->execute_http(
+          req, [barrier](couchbase::operations::document_view_response resp) mutable { barrier->set_value(std::move(resp)); });
+        auto resp = cb__wait_for_future(f, cancel);
         if (resp.ec) {
             if (resp.error) {
                 exc = cb__map_error_code(
@@ -5347,11 +6362,14 @@ init_backend(VALUE mCouchbase)
 {
     VALUE cBackend = rb_define_class_under(mCouchbase, "Backend", rb_cBasicObject);
     rb_define_alloc_func(cBackend, cb_Backend_allocate);
+    init_results(cBackend);
     rb_define_method(cBackend, "open", VALUE_FUNC(cb_Backend_open), 4);
     rb_define_method(cBackend, "close", VALUE_FUNC(cb_Backend_close), 0);
     rb_define_method(cBackend, "open_bucket", VALUE_FUNC(cb_Backend_open_bucket), 2);
 
     rb_define_method(cBackend, "document_get", VALUE_FUNC(cb_Backend_document_get), 4);
+    rb_define_method(cBackend, "document_get_any_replica", VALUE_FUNC(cb_Backend_document_get_any_replica), 4);
+    rb_define_method(cBackend, "document_get_all_replicas", VALUE_FUNC(cb_Backend_document_get_all_replicas), 4);
     rb_define_method(cBackend, "document_get_projected", VALUE_FUNC(cb_Backend_document_get_projected), 7);
     rb_define_method(cBackend, "document_get_and_lock", VALUE_FUNC(cb_Backend_document_get_and_lock), 5);
     rb_define_method(cBackend, "document_get_and_touch", VALUE_FUNC(cb_Backend_document_get_and_touch), 5);
@@ -5359,9 +6377,21 @@ init_backend(VALUE mCouchbase)
     rb_define_method(cBackend, "document_replace", VALUE_FUNC(cb_Backend_document_replace), 7);
     rb_define_method(cBackend, "document_upsert", VALUE_FUNC(cb_Backend_document_upsert), 7);
     rb_define_method(cBackend, "document_remove", VALUE_FUNC(cb_Backend_document_remove), 5);
+    rb_define_method(cBackend, "document_get_async", VALUE_FUNC(cb_Backend_document_get_async), 4);
+    rb_define_method(cBackend, "document_upsert_async", VALUE_FUNC(cb_Backend_document_upsert_async), 7);
+    rb_define_method(cBackend, "document_remove_async", VALUE_FUNC(cb_Backend_document_remove_async), 5);
+    rb_define_method(cBackend, "document_get_multi", VALUE_FUNC(cb_Backend_document_get_multi), 4);
+    rb_define_method(cBackend, "document_upsert_multi", VALUE_FUNC(cb_Backend_document_upsert_multi), 5);
+    rb_define_method(cBackend, "document_remove_multi", VALUE_FUNC(cb_Backend_document_remove_multi), 5);
     rb_define_method(cBackend, "document_lookup_in", VALUE_FUNC(cb_Backend_document_lookup_in), 6);
     rb_define_method(cBackend, "document_mutate_in", VALUE_FUNC(cb_Backend_document_mutate_in), 6);
     rb_define_method(cBackend, "document_query", VALUE_FUNC(cb_Backend_document_query), 2);
+    rb_define_method(cBackend, "document_query_stream", VALUE_FUNC(cb_Backend_document_query_stream), 2);
+    rb_define_method(cBackend, "query_cache_stats", VALUE_FUNC(cb_Backend_query_cache_stats), 0);
+    rb_define_method(cBackend, "retry_stats", VALUE_FUNC(cb_Backend_retry_stats), 0);
+    rb_define_method(cBackend, "compression_stats", VALUE_FUNC(cb_Backend_compression_stats), 0);
+    rb_define_method(cBackend, "tls_stats", VALUE_FUNC(cb_Backend_tls_stats), 0);
+    rb_define_method(cBackend, "metrics", VALUE_FUNC(cb_Backend_metrics), 0);
     rb_define_method(cBackend, "document_touch", VALUE_FUNC(cb_Backend_document_touch), 5);
     rb_define_method(cBackend, "document_exists", VALUE_FUNC(cb_Backend_document_exists), 4);
     rb_define_method(cBackend, "document_unlock", VALUE_FUNC(cb_Backend_document_unlock), 5);
@@ -5426,6 +6456,18 @@ init_backend(VALUE mCouchbase)
 
     rb_define_singleton_method(cBackend, "dns_srv", VALUE_FUNC(cb_Backend_dns_srv), 2);
     rb_define_singleton_method(cBackend, "parse_connection_string", VALUE_FUNC(cb_Backend_parse_connection_string), 1);
+
+    cPendingResult = rb_define_class_under(cBackend, "PendingResult", rb_cObject);
+    rb_undef_alloc_func(cPendingResult);
+    rb_define_method(cPendingResult, "ready?", VALUE_FUNC(cb_PendingResult_is_ready), 0);
+    rb_define_method(cPendingResult, "wait", VALUE_FUNC(cb_PendingResult_wait), 0);
+    rb_define_method(cPendingResult, "cancel", VALUE_FUNC(cb_PendingResult_cancel), 0);
+
+    cQueryStream = rb_define_class_under(cBackend, "QueryStream", rb_cObject);
+    rb_undef_alloc_func(cQueryStream);
+    rb_define_method(cQueryStream, "next_rows", VALUE_FUNC(cb_QueryStream_next_rows), 0);
+    rb_define_method(cQueryStream, "meta", VALUE_FUNC(cb_QueryStream_meta), 0);
+    rb_define_method(cQueryStream, "cancel", VALUE_FUNC(cb_QueryStream_cancel), 0);
 }
 
 void
@@ -102,6 +102,10 @@ enum class common_errc {
 
     /// Raised when decoding of the data into the user object failed
     decoding_failure,
+
+    /// The request has not been sent, because the connections to the node have too many requests in flight or queued, or too many
+    /// requests are waiting for the bucket configuration. Nothing has been written, so it is safe to retry.
+    request_queue_full,
 };
 
 /// Errors for related to KeyValue service (kv_engine)
@@ -350,6 +354,8 @@ struct common_error_category : std::error_category {
                 return "index_not_found";
             case common_errc::index_exists:
                 return "index_exists";
+            case common_errc::request_queue_full:
+                return "request_queue_full";
         }
         return "FIXME: unknown error code common (recompile with newer library)";
     }
@@ -0,0 +1,95 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace couchbase::io
+{
+
+/**
+ * Free list of byte buffers, that are used to encode requests.
+ *
+ * The buffer is acquired when the request is being encoded, moved through the output queue of the session, and released back when
+ * the socket write completes. The pool keeps at most max_pooled_bytes of capacity, bigger buffers are just freed.
+ */
+class buffer_pool
+{
+  public:
+    static constexpr std::size_t max_pooled_buffers = 64;
+    static constexpr std::size_t max_pooled_bytes = 4 * 1024 * 1024;
+
+    [[nodiscard]] std::vector<std::uint8_t> acquire()
+    {
+        {
+            std::scoped_lock lock(mutex_);
+            if (!buffers_.empty()) {
+                std::vector<std::uint8_t> buf = std::move(buffers_.back());
+                buffers_.pop_back();
+                pooled_bytes_ -= buf.capacity();
+                ++reused_;
+                return buf;
+            }
+        }
+        ++allocated_;
+        return {};
+    }
+
+    void release(std::vector<std::uint8_t>&& buf)
+    {
+        std::size_t capacity = buf.capacity();
+        if (capacity == 0) {
+            return;
+        }
+        std::scoped_lock lock(mutex_);
+        if (buffers_.size() >= max_pooled_buffers || pooled_bytes_ + capacity > max_pooled_bytes) {
+            return;
+        }
+        buf.clear();
+        pooled_bytes_ += capacity;
+        buffers_.emplace_back(std::move(buf));
+    }
+
+    /**
+     * Number of buffers, that have been created because the pool was empty.
+     */
+    [[nodiscard]] std::uint64_t allocated() const
+    {
+        return allocated_;
+    }
+
+    /**
+     * Number of buffers, that have been taken from the pool.
+     */
+    [[nodiscard]] std::uint64_t reused() const
+    {
+        return reused_;
+    }
+
+  private:
+    std::mutex mutex_{};
+    std::vector<std::vector<std::uint8_t>> buffers_{};
+    std::size_t pooled_bytes_{ 0 };
+    std::atomic<std::uint64_t> allocated_{ 0 };
+    std::atomic<std::uint64_t> reused_{ 0 };
+};
+
+} // namespace couchbase::io
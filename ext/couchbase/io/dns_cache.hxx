@@ -0,0 +1,136 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace couchbase::io::dns
+{
+struct srv_target {
+    std::string hostname;
+    std::uint16_t port;
+};
+
+/**
+ * Process-wide cache of SRV answers, so that short-lived processes and repeated bootstraps do not wait for the nameserver.
+ *
+ * Entries are fresh for the smallest TTL of their records. After that they are still served for max_stale, while a single caller
+ * refreshes them in background (stale-while-revalidate). The stale entry stays in place if the refresh fails.
+ */
+class dns_srv_cache
+{
+  public:
+    using clock = std::chrono::steady_clock;
+
+    static constexpr std::chrono::seconds max_stale{ 3600 };
+    /** the refresh, which has not finished in this time, is considered lost (e.g. its io context has been stopped meanwhile) */
+    static constexpr std::chrono::seconds refresh_timeout{ 30 };
+
+    enum class lookup_state {
+        miss,
+        fresh,
+        stale,
+    };
+
+    struct lookup_result {
+        lookup_state state{ lookup_state::miss };
+        std::vector<srv_target> targets{};
+        /** the caller is responsible to refresh the stale entry, and report the outcome with store() or refresh_failed() */
+        bool refresh{ false };
+    };
+
+    /**
+     * The instance is never destroyed, because background refreshes might still be pending on io contexts when the process exits.
+     */
+    static dns_srv_cache& get()
+    {
+        static auto* instance = new dns_srv_cache();
+        return *instance;
+    }
+
+    [[nodiscard]] lookup_result lookup(const std::string& name)
+    {
+        std::scoped_lock lock(mutex_);
+        auto it = entries_.find(name);
+        if (it == entries_.end()) {
+            return {};
+        }
+        auto now = clock::now();
+        auto& entry = it->second;
+        if (now < entry.expires_at) {
+            return { lookup_state::fresh, entry.targets, false };
+        }
+        if (now >= entry.expires_at + max_stale) {
+            entries_.erase(it);
+            return {};
+        }
+        bool refresh = !entry.refreshing || now >= entry.refresh_started + refresh_timeout;
+        if (refresh) {
+            entry.refreshing = true;
+            entry.refresh_started = now;
+        }
+        return { lookup_state::stale, entry.targets, refresh };
+    }
+
+    /**
+     * Remembers the answer. Answers with zero TTL are not cached, as RFC 1035 requires.
+     */
+    void store(const std::string& name, const std::vector<srv_target>& targets, std::chrono::seconds ttl)
+    {
+        std::scoped_lock lock(mutex_);
+        if (ttl.count() == 0) {
+            entries_.erase(name);
+            return;
+        }
+        auto& entry = entries_[name];
+        entry.targets = targets;
+        entry.expires_at = clock::now() + ttl;
+        entry.refreshing = false;
+    }
+
+    void refresh_failed(const std::string& name)
+    {
+        std::scoped_lock lock(mutex_);
+        if (auto it = entries_.find(name); it != entries_.end()) {
+            it->second.refreshing = false;
+        }
+    }
+
+    void clear()
+    {
+        std::scoped_lock lock(mutex_);
+        entries_.clear();
+    }
+
+  private:
+    struct cache_entry {
+        std::vector<srv_target> targets{};
+        clock::time_point expires_at{};
+        bool refreshing{ false };
+        clock::time_point refresh_started{};
+    };
+
+    std::mutex mutex_{};
+    std::map<std::string, cache_entry> entries_{};
+};
+} // namespace couchbase::io::dns
@@ -18,8 +18,12 @@
 #pragma once
 
 #include <memory>
+#include <random>
 #include <sstream>
 
+#include <spdlog/spdlog.h>
+
+#include <io/dns_cache.hxx>
 #include <io/dns_codec.hxx>
 #include <io/dns_config.hxx>
 
@@ -31,30 +35,35 @@ class dns_client
 {
   public:
     struct dns_srv_response {
-        struct address {
-            std::string hostname;
-            std::uint16_t port;
-        };
+        using address = srv_target;
         std::error_code ec;
         std::vector<address> targets{};
+        /** the smallest TTL of the answers */
+        std::chrono::seconds ttl{ 0 };
     };
 
+    /**
+     * Sends the query to all nameservers at once and takes the first answer. If the answer has been truncated, the query is repeated
+     * over TCP to the same nameserver, within the same deadline.
+     */
     class dns_srv_command : public std::enable_shared_from_this<dns_srv_command>
     {
       public:
         dns_srv_command(asio::io_context& ctx,
                         const std::string& name,
                         const std::string& service,
-                        const asio::ip::address& address,
+                        const std::vector<asio::ip::address>& nameservers,
                         std::uint16_t port)
           : deadline_(ctx)
-          , udp_(ctx)
           , tcp_(ctx)
-          , address_(address)
           , port_(port)
         {
             static std::string protocol{ "_tcp" };
             dns_message request{};
+            std::random_device rd;
+            std::uniform_int_distribution<std::uint16_t> dis;
+            id_ = dis(rd);
+            request.header.id = id_;
             question_record qr;
             qr.klass = resource_class::in;
             qr.type = resource_type::srv;
@@ -67,130 +76,212 @@ class dns_client
             }
             request.questions.emplace_back(qr);
             send_buf_ = dns_codec::encode(request);
+            for (const auto& address : nameservers) {
+                udp_.emplace_back(std::make_unique<udp_query>(ctx, asio::ip::udp::endpoint(address, port_)));
+            }
         }
 
         template<class Handler>
         void execute(std::chrono::milliseconds timeout, Handler&& handler)
         {
-            asio::ip::udp::endpoint endpoint(address_, port_);
-            udp_.open(endpoint.protocol());
-            udp_.async_send_to(
-              asio::buffer(send_buf_),
-              endpoint,
-              [self = shared_from_this(), handler = std::forward<Handler>(handler)](std::error_code ec1,
-                                                                                    std::size_t /* bytes_transferred */) mutable {
-                  if (ec1 == asio::error::operation_aborted) {
-                      self->deadline_.cancel();
-                      return handler({ std::make_error_code(error::common_errc::ambiguous_timeout) });
-                  }
-                  if (ec1) {
-                      self->deadline_.cancel();
-                      return handler({ ec1 });
-                  }
-
-                  asio::ip::udp::endpoint sender_endpoint;
-                  self->recv_buf_.resize(512);
-                  self->udp_.async_receive_from(
-                    asio::buffer(self->recv_buf_),
-                    sender_endpoint,
-                    [self, handler = std::forward<Handler>(handler)](std::error_code ec2, std::size_t bytes_transferred) mutable {
-                        self->deadline_.cancel();
-                        if (ec2) {
-                            return handler({ ec2 });
-                        }
-                        self->recv_buf_.resize(bytes_transferred);
-                        dns_message message = dns_codec::decode(self->recv_buf_);
-                        if (message.header.flags.tc == truncation::yes) {
-                            self->udp_.close();
-                            return self->retry_with_tcp(std::forward<Handler>(handler));
-                        }
-                        dns_srv_response resp{ ec2 };
-                        resp.targets.reserve(message.answers.size());
-                        for (const auto& answer : message.answers) {
-                            resp.targets.emplace_back(
-                              dns_srv_response::address{ fmt::format("{}", fmt::join(answer.target.labels, ".")), answer.port });
-                        }
-                        return handler(resp);
-                    });
-              });
+            handler_ = std::forward<Handler>(handler);
+            pending_ = udp_.size();
             deadline_.expires_after(timeout);
             deadline_.async_wait([self = shared_from_this()](std::error_code ec) {
                 if (ec == asio::error::operation_aborted) {
                     return;
                 }
-                self->udp_.cancel();
-                self->tcp_.cancel();
+                self->fail(std::make_error_code(error::common_errc::ambiguous_timeout));
             });
+            if (udp_.empty()) {
+                return fail(std::make_error_code(error::common_errc::service_not_available));
+            }
+            for (auto& query : udp_) {
+                send_udp(*query);
+            }
         }
 
       private:
-        template<class Handler>
-        void retry_with_tcp(Handler&& handler)
+        struct udp_query {
+            asio::ip::udp::socket socket;
+            asio::ip::udp::endpoint endpoint;
+            asio::ip::udp::endpoint sender{};
+            std::vector<std::uint8_t> recv_buf{};
+
+            udp_query(asio::io_context& ctx, asio::ip::udp::endpoint ep)
+              : socket(ctx)
+              , endpoint(std::move(ep))
+            {
+            }
+        };
+
+        void send_udp(udp_query& query)
         {
-            asio::ip::tcp::no_delay no_delay(true);
-            std::error_code ignore_ec;
-            tcp_.set_option(no_delay, ignore_ec);
-            asio::ip::tcp::endpoint endpoint(address_, port_);
-            tcp_.async_connect(
-              endpoint, [self = shared_from_this(), handler = std::forward<Handler>(handler)](std::error_code ec1) mutable {
+            std::error_code ec;
+            query.socket.open(query.endpoint.protocol(), ec);
+            if (ec) {
+                return on_udp_failure(ec);
+            }
+            query.socket.async_send_to(
+              asio::buffer(send_buf_), query.endpoint, [self = shared_from_this(), &query](std::error_code ec1, std::size_t /* bytes */) {
+                  if (self->completed_ || ec1 == asio::error::operation_aborted) {
+                      return;
+                  }
                   if (ec1) {
-                      self->deadline_.cancel();
-                      return handler({ ec1 });
+                      return self->on_udp_failure(ec1);
+                  }
+                  self->receive_udp(query);
+              });
+        }
+
+        void receive_udp(udp_query& query)
+        {
+            query.recv_buf.resize(512);
+            query.socket.async_receive_from(
+              asio::buffer(query.recv_buf),
+              query.sender,
+              [self = shared_from_this(), &query](std::error_code ec2, std::size_t bytes_transferred) {
+                  if (self->completed_ || self->tcp_started_ || ec2 == asio::error::operation_aborted) {
+                      return;
+                  }
+                  if (ec2) {
+                      return self->on_udp_failure(ec2);
+                  }
+                  query.recv_buf.resize(bytes_transferred);
+                  dns_message message = dns_codec::decode(query.recv_buf);
+                  if (message.header.id != self->id_ || message.header.flags.qr != message_type::response) {
+                      /* not the answer for this query, keep waiting */
+                      return self->receive_udp(query);
                   }
-                  auto send_size = static_cast<uint16_t>(self->send_buf_.size());
-                  self->send_buf_.insert(self->send_buf_.begin(), std::uint8_t(send_size & 0xffU));
-                  self->send_buf_.insert(self->send_buf_.begin(), std::uint8_t(send_size >> 8U));
-                  asio::async_write(
-                    self->tcp_,
-                    asio::buffer(self->send_buf_),
-                    [self, handler = std::forward<Handler>(handler)](std::error_code ec2, std::size_t /* bytes_transferred */) mutable {
-                        if (ec2) {
-                            self->deadline_.cancel();
-                            if (ec2 == asio::error::operation_aborted) {
-                                ec2 = std::make_error_code(error::common_errc::ambiguous_timeout);
-                            }
-                            return handler({ ec2 });
-                        }
-                        asio::async_read(self->tcp_,
-                                         asio::buffer(&self->recv_buf_size_, sizeof(self->recv_buf_size_)),
-                                         [self, handler = std::forward<Handler>(handler)](std::error_code ec3,
-                                                                                          std::size_t /* bytes_transferred */) mutable {
-                                             if (ec3) {
-                                                 self->deadline_.cancel();
-                                                 return handler({ ec3 });
-                                             }
-                                             self->recv_buf_size_ = ntohs(self->recv_buf_size_);
-                                             self->recv_buf_.resize(self->recv_buf_size_);
-                                             asio::async_read(
-                                               self->tcp_,
-                                               asio::buffer(self->recv_buf_),
-                                               [self, handler = std::forward<Handler>(handler)](std::error_code ec4,
-                                                                                                std::size_t bytes_transferred) mutable {
-                                                   self->deadline_.cancel();
-                                                   if (ec4) {
-                                                       return handler({ ec4 });
-                                                   }
-                                                   self->recv_buf_.resize(bytes_transferred);
-                                                   dns_message message = dns_codec::decode(self->recv_buf_);
-                                                   dns_srv_response resp{ ec4 };
-                                                   resp.targets.reserve(message.answers.size());
-                                                   for (const auto& answer : message.answers) {
-                                                       resp.targets.emplace_back(dns_srv_response::address{
-                                                         fmt::format("{}", fmt::join(answer.target.labels, ".")), answer.port });
-                                                   }
-                                                   return handler(resp);
-                                               });
-                                         });
-                    });
+                  if (message.header.flags.tc == truncation::yes) {
+                      return self->retry_with_tcp(query.endpoint.address());
+                  }
+                  if (message.header.flags.rcode == response_code::server_failure ||
+                      message.header.flags.rcode == response_code::refused) {
+                      return self->on_udp_failure(std::make_error_code(error::common_errc::service_not_available));
+                  }
+                  self->complete(make_response(message));
               });
         }
 
+        void on_udp_failure(std::error_code ec)
+        {
+            last_error_ = ec;
+            if (--pending_ == 0 && !tcp_started_) {
+                fail(last_error_);
+            }
+        }
+
+        void retry_with_tcp(const asio::ip::address& address)
+        {
+            tcp_started_ = true;
+            for (auto& query : udp_) {
+                std::error_code ignore_ec;
+                query->socket.close(ignore_ec);
+            }
+            asio::ip::tcp::endpoint endpoint(address, port_);
+            std::error_code ec;
+            tcp_.open(endpoint.protocol(), ec);
+            if (ec) {
+                return fail(ec);
+            }
+            tcp_.set_option(asio::ip::tcp::no_delay(true), ec);
+            tcp_.async_connect(endpoint, [self = shared_from_this()](std::error_code ec1) mutable {
+                if (self->completed_) {
+                    return;
+                }
+                if (ec1) {
+                    return self->fail(ec1);
+                }
+                auto send_size = static_cast<uint16_t>(self->send_buf_.size());
+                self->send_buf_.insert(self->send_buf_.begin(), std::uint8_t(send_size & 0xffU));
+                self->send_buf_.insert(self->send_buf_.begin(), std::uint8_t(send_size >> 8U));
+                asio::async_write(self->tcp_, asio::buffer(self->send_buf_), [self](std::error_code ec2, std::size_t /* bytes */) mutable {
+                    if (self->completed_) {
+                        return;
+                    }
+                    if (ec2) {
+                        return self->fail(ec2);
+                    }
+                    asio::async_read(self->tcp_,
+                                     asio::buffer(&self->recv_buf_size_, sizeof(self->recv_buf_size_)),
+                                     [self](std::error_code ec3, std::size_t /* bytes_transferred */) mutable {
+                                         if (self->completed_) {
+                                             return;
+                                         }
+                                         if (ec3) {
+                                             return self->fail(ec3);
+                                         }
+                                         self->recv_buf_size_ = ntohs(self->recv_buf_size_);
+                                         self->recv_buf_.resize(self->recv_buf_size_);
+                                         asio::async_read(self->tcp_,
+                                                          asio::buffer(self->recv_buf_),
+                                                          [self](std::error_code ec4, std::size_t bytes_transferred) mutable {
+                                                              if (self->completed_) {
+                                                                  return;
+                                                              }
+                                                              if (ec4) {
+                                                                  return self->fail(ec4);
+                                                              }
+                                                              self->recv_buf_.resize(bytes_transferred);
+                                                              self->complete(make_response(dns_codec::decode(self->recv_buf_)));
+                                                          });
+                                     });
+                });
+            });
+        }
+
+        static dns_srv_response make_response(const dns_message& message)
+        {
+            dns_srv_response resp{};
+            resp.targets.reserve(message.answers.size());
+            for (const auto& answer : message.answers) {
+                resp.targets.emplace_back(
+                  dns_srv_response::address{ fmt::format("{}", fmt::join(answer.target.labels, ".")), answer.port });
+                if (resp.targets.size() == 1 || std::chrono::seconds(answer.ttl) < resp.ttl) {
+                    resp.ttl = std::chrono::seconds(answer.ttl);
+                }
+            }
+            return resp;
+        }
+
+        void fail(std::error_code ec)
+        {
+            dns_srv_response resp{};
+            resp.ec = ec;
+            complete(std::move(resp));
+        }
+
+        /**
+         * Invokes the handler once, and cancels the queries, which are still in flight.
+         */
+        void complete(dns_srv_response&& resp)
+        {
+            if (completed_) {
+                return;
+            }
+            completed_ = true;
+            deadline_.cancel();
+            std::error_code ignore_ec;
+            for (auto& query : udp_) {
+                query->socket.close(ignore_ec);
+            }
+            tcp_.close(ignore_ec);
+            auto handler = std::move(handler_);
+            handler(std::move(resp));
+        }
+
         asio::steady_timer deadline_;
-        asio::ip::udp::socket udp_;
+        std::vector<std::unique_ptr<udp_query>> udp_{};
         asio::ip::tcp::socket tcp_;
-
-        asio::ip::address address_;
         std::uint16_t port_;
+        std::uint16_t id_{ 0 };
+
+        std::function<void(dns_srv_response&&)> handler_{};
+        std::size_t pending_{ 0 };
+        std::error_code last_error_{};
+        bool tcp_started_{ false };
+        bool completed_{ false };
 
         std::vector<uint8_t> send_buf_;
         std::uint16_t recv_buf_size_{ 0 };
@@ -202,14 +293,52 @@ class dns_client
     {
     }
 
+    /**
+     * Resolves the SRV record using the process-wide cache. Stale answers are returned immediately and refreshed asynchronously on
+     * the same io context, so that the caller does not wait for the nameserver.
+     */
     template<class Handler>
     void query_srv(const std::string& name, const std::string& service, Handler&& handler)
     {
+        auto key = fmt::format("{}._tcp.{}", service, name);
+        auto cached = dns_srv_cache::get().lookup(key);
+        if (cached.state != dns_srv_cache::lookup_state::miss) {
+            if (cached.refresh) {
+                refresh_in_background(name, service, key);
+            }
+            dns_srv_response resp{};
+            resp.targets = std::move(cached.targets);
+            return asio::post(ctx_, [handler = std::forward<Handler>(handler), resp = std::move(resp)]() mutable {
+                handler(std::move(resp));
+            });
+        }
         dns_config& config = dns_config::get();
-        auto cmd = std::make_shared<dns_srv_command>(ctx_, name, service, config.address(), config.port());
-        cmd->execute(config.timeout(), std::forward<Handler>(handler));
+        auto cmd = std::make_shared<dns_srv_command>(ctx_, name, service, config.nameservers(), config.port());
+        cmd->execute(config.timeout(), [key, handler = std::forward<Handler>(handler)](dns_srv_response&& resp) mutable {
+            if (!resp.ec) {
+                dns_srv_cache::get().store(key, resp.targets, resp.ttl);
+            }
+            handler(std::move(resp));
+        });
     }
 
     asio::io_context& ctx_;
+
+  private:
+    /**
+     * Refreshes the stale entry on the io context of the client, while the caller is answered with the stale targets.
+     */
+    void refresh_in_background(const std::string& name, const std::string& service, const std::string& key)
+    {
+        dns_config& config = dns_config::get();
+        auto cmd = std::make_shared<dns_srv_command>(ctx_, name, service, config.nameservers(), config.port());
+        cmd->execute(config.timeout(), [key](dns_srv_response&& resp) {
+            if (resp.ec) {
+                spdlog::debug("unable to refresh DNS SRV record \"{}\", keep using stale one: {}", key, resp.ec.message());
+                return dns_srv_cache::get().refresh_failed(key);
+            }
+            dns_srv_cache::get().store(key, resp.targets, resp.ttl);
+        });
+    }
 };
 } // namespace couchbase::io::dns
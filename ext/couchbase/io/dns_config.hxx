@@ -21,6 +21,8 @@
 
 #include <string>
 #include <fstream>
+#include <mutex>
+#include <vector>
 
 #include <asio/ip/address.hpp>
 
@@ -34,12 +36,22 @@ class dns_config
     static inline constexpr auto default_resolv_conf_path = "/etc/resolv.conf";
     static inline constexpr auto default_host = "8.8.8.8";
     static inline constexpr std::uint16_t default_port = 53;
+    /** the same limit as MAXNS of the system resolver */
+    static inline constexpr std::size_t max_nameservers = 3;
 
     [[nodiscard]] const asio::ip::address& address() const
     {
         return address_;
     }
 
+    /**
+     * All nameservers from resolv.conf in order of appearance, the first one is the same as address().
+     */
+    [[nodiscard]] const std::vector<asio::ip::address>& nameservers() const
+    {
+        return nameservers_;
+    }
+
     [[nodiscard]] std::uint16_t port() const
     {
         return port_;
@@ -62,16 +74,24 @@ class dns_config
   private:
     void initialize()
     {
-        if (!initialized_) {
+        std::call_once(initialized_, [this]() {
             load_resolv_conf(default_resolv_conf_path);
-            std::error_code ec;
-            address_ = asio::ip::address::from_string(host_, ec);
-            if (ec) {
+            for (const auto& host : hosts_) {
+                std::error_code ec;
+                auto address = asio::ip::address::from_string(host, ec);
+                if (!ec) {
+                    nameservers_.emplace_back(address);
+                }
+            }
+            if (nameservers_.empty()) {
                 host_ = default_host;
-                address_ = asio::ip::address::from_string(host_, ec);
+                std::error_code ec;
+                nameservers_.emplace_back(asio::ip::address::from_string(host_, ec));
+            } else {
+                host_ = nameservers_.front().to_string();
             }
-            initialized_ = true;
-        }
+            address_ = nameservers_.front();
+        });
     }
 
     void load_resolv_conf(const char* conf_path)
@@ -95,21 +115,25 @@ class dns_config
                 if (space == std::string::npos || space == offset || line.size() < space + 2) {
                     continue;
                 }
-                std::string keyword = line.substr(offset, space);
+                std::string keyword = line.substr(offset, space - offset);
                 if (keyword != "nameserver") {
                     continue;
                 }
                 offset = space + 1;
                 space = line.find(' ', offset);
-                host_ = line.substr(offset, space);
-                break;
+                hosts_.emplace_back(line.substr(offset, space == std::string::npos ? std::string::npos : space - offset));
+                if (hosts_.size() == max_nameservers) {
+                    break;
+                }
             }
         }
     }
 
-    std::atomic_bool initialized_{ false };
+    std::once_flag initialized_{};
     std::string host_{ default_host };
     asio::ip::address address_{};
+    std::vector<std::string> hosts_{};
+    std::vector<asio::ip::address> nameservers_{};
     std::uint16_t port_{ default_port };
     std::chrono::milliseconds timeout_{ timeout_defaults::dns_srv_timeout };
 };
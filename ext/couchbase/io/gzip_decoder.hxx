@@ -0,0 +1,133 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+#include <zlib.h>
+
+namespace couchbase::io
+{
+/**
+ * Incremental decoder of gzip-encoded (RFC 1952) HTTP bodies. Every chunk of compressed data is inflated into fixed-size buffer as
+ * soon as it arrives, and the decoded pieces are passed to the sink, so that neither compressed nor decoded body has to be buffered
+ * by the decoder. Concatenated gzip members are decoded as one stream.
+ */
+class gzip_decoder
+{
+  public:
+    static constexpr std::size_t output_buffer_size = 16 * 1024;
+
+    gzip_decoder()
+    {
+        // 16 tells zlib to expect gzip header and trailer instead of zlib wrapper
+        initialized_ = ::inflateInit2(&stream_, 16 + MAX_WBITS) == Z_OK;
+    }
+
+    gzip_decoder(const gzip_decoder&) = delete;
+    gzip_decoder& operator=(const gzip_decoder&) = delete;
+
+    ~gzip_decoder()
+    {
+        if (initialized_) {
+            ::inflateEnd(&stream_);
+        }
+    }
+
+    /**
+     * Decodes next chunk of the compressed body, the sink has signature void(std::string_view) and might be invoked several times.
+     * Returns false if the data is corrupted (the decoder cannot be used after that).
+     */
+    template<typename Sink>
+    bool decode(std::string_view chunk, Sink&& sink)
+    {
+        if (!initialized_ || failed_) {
+            return false;
+        }
+        wire_bytes_ += chunk.size();
+        // zlib does not modify the input, the pointer is not const only for compatibility with old compilers
+        stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(chunk.data()));
+        stream_.avail_in = static_cast<uInt>(chunk.size());
+        while (true) {
+            if (end_of_member_) {
+                if (stream_.avail_in == 0) {
+                    break;
+                }
+                // another gzip member follows
+                if (::inflateReset(&stream_) != Z_OK) {
+                    failed_ = true;
+                    return false;
+                }
+                end_of_member_ = false;
+            }
+            stream_.next_out = reinterpret_cast<Bytef*>(output_.data());
+            stream_.avail_out = static_cast<uInt>(output_.size());
+            int rc = ::inflate(&stream_, Z_NO_FLUSH);
+            if (std::size_t produced = output_.size() - stream_.avail_out; produced > 0) {
+                decoded_bytes_ += produced;
+                sink(std::string_view(output_.data(), produced));
+            }
+            if (rc == Z_STREAM_END) {
+                end_of_member_ = true;
+                continue;
+            }
+            if (rc == Z_BUF_ERROR) {
+                break; // no progress without more input
+            }
+            if (rc != Z_OK) {
+                failed_ = true;
+                return false;
+            }
+            if (stream_.avail_in == 0 && stream_.avail_out > 0) {
+                break; // the input is consumed, and the output is flushed
+            }
+        }
+        return true;
+    }
+
+    /**
+     * True when the last gzip member has been decoded completely, i.e. the body is not truncated.
+     */
+    [[nodiscard]] bool finished() const
+    {
+        return end_of_member_;
+    }
+
+    [[nodiscard]] std::uint64_t wire_bytes() const
+    {
+        return wire_bytes_;
+    }
+
+    [[nodiscard]] std::uint64_t decoded_bytes() const
+    {
+        return decoded_bytes_;
+    }
+
+  private:
+    z_stream stream_{};
+    bool initialized_{ false };
+    bool failed_{ false };
+    bool end_of_member_{ false };
+    std::uint64_t wire_bytes_{ 0 };
+    std::uint64_t decoded_bytes_{ 0 };
+    std::array<char, output_buffer_size> output_{};
+};
+} // namespace couchbase::io
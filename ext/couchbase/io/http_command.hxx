@@ -18,6 +18,7 @@
 #pragma once
 
 #include <io/http_session.hxx>
+#include <tracing/threshold_logging_tracer.hxx>
 
 namespace couchbase::operations
 {
@@ -30,21 +31,47 @@ struct http_command : public std::enable_shared_from_this<http_command<Request>>
     asio::steady_timer retry_backoff;
     Request request;
     encoded_request_type encoded;
+    std::shared_ptr<io::http_session> session_{};
+    bool cancelled_{ false };
+    std::shared_ptr<tracing::threshold_logging_tracer> tracer_{};
+    std::shared_ptr<tracing::request_span> span_{};
 
-    http_command(asio::io_context& ctx, Request req)
+    http_command(asio::io_context& ctx, Request req, std::shared_ptr<tracing::threshold_logging_tracer> tracer = {})
       : deadline(ctx)
       , retry_backoff(ctx)
       , request(req)
+      , tracer_(std::move(tracer))
     {
+        if (tracer_) {
+            span_ = std::make_shared<tracing::request_span>();
+            span_->service = Request::type;
+            span_->mark(tracing::point::created);
+        }
+    }
+
+    void cancel()
+    {
+        cancelled_ = true;
+        deadline.cancel();
+        if (session_) {
+            session_->stop();
+        }
     }
 
     template<typename Handler>
     void send_to(std::shared_ptr<io::http_session> session, Handler&& handler)
     {
+        session_ = session;
         encoded.type = Request::type;
         request.encode_to(encoded);
         encoded.headers["client-context-id"] = request.client_context_id;
         auto log_prefix = session->log_prefix();
+        if (span_) {
+            span_->operation = fmt::format("{} {}", encoded.method, encoded.path);
+            span_->operation_id = request.client_context_id;
+            span_->local_id = log_prefix;
+            span_->mark(tracing::point::dispatched);
+        }
         spdlog::debug("{} HTTP request: {}, method={}, path={}, client_context_id={}, timeout={}ms",
                       log_prefix,
                       encoded.type,
@@ -64,6 +91,12 @@ struct http_command : public std::enable_shared_from_this<http_command<Request>>
                                      [self = this->shared_from_this(), log_prefix, handler = std::forward<Handler>(handler)](
                                        std::error_code ec, io::http_response&& msg) mutable {
                                          self->deadline.cancel();
+                                         if (self->span_) {
+                                             self->span_->mark(tracing::point::received);
+                                         }
+                                         if (self->cancelled_) {
+                                             ec = std::make_error_code(error::common_errc::request_canceled);
+                                         }
                                          encoded_response_type resp(msg);
                                          spdlog::debug("{} HTTP response: {}, client_context_id={}, status={}",
                                                        log_prefix,
@@ -77,6 +110,10 @@ struct http_command : public std::enable_shared_from_this<http_command<Request>>
                                                       resp.status_code,
                                                       spdlog::to_hex(resp.body));
                                          handler(make_response(ec, self->request, resp));
+                                         if (self->span_) {
+                                             self->span_->mark(tracing::point::completed);
+                                             self->tracer_->report(*self->span_);
+                                         }
                                      });
         deadline.expires_after(request.timeout);
         deadline.async_wait([session](std::error_code ec) {
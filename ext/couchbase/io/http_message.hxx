@@ -17,16 +17,37 @@
 
 #pragma once
 
+#include <functional>
+#include <memory>
+#include <string_view>
+
 #include <service_type.hxx>
 
 namespace couchbase::io
 {
+/**
+ * Lets the command consume the body of the HTTP response while it is being received.
+ */
+struct http_streaming_body {
+    /**
+     * Invoked on the session's thread for every chunk of the body. Whatever the handler appends to body, will be available in
+     * http_response::body once the response is complete. Returning false pauses reading from the socket until resume() is called.
+     */
+    std::function<bool(std::string_view chunk, std::string& body)> on_chunk{};
+
+    /**
+     * Assigned by the session, before the response is being read. Might be called from any thread.
+     */
+    std::function<void()> resume{};
+};
+
 struct http_request {
     service_type type;
     std::string method;
     std::string path;
     std::map<std::string, std::string> headers;
     std::string body;
+    std::shared_ptr<http_streaming_body> streaming{};
 };
 
 struct http_response {
@@ -17,7 +17,15 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
 #include <http_parser.h>
+#include <io/gzip_decoder.hxx>
 #include <io/http_message.hxx>
 
 namespace couchbase::io
@@ -26,11 +34,22 @@ struct http_parser {
 
     enum class status { ok, failure };
 
+    static constexpr std::uint64_t max_reserved_body_size = 64 * 1024 * 1024;
+
     http_parser_settings settings_{};
     ::http_parser parser_{};
     http_response response;
     std::string header_field;
+    std::shared_ptr<http_streaming_body> streaming{};
     bool complete{ false };
+    bool paused{ false };
+    /** the connection could be reused for the next request, valid when the response is complete */
+    bool keep_alive{ false };
+    /** set when the server has sent "Content-Encoding: gzip", the body is decoded before it is appended or streamed */
+    std::unique_ptr<gzip_decoder> decoder{};
+    /** size of the body as received from the socket and after decoding, equal for uncompressed responses */
+    std::uint64_t body_wire_bytes{ 0 };
+    std::uint64_t body_decoded_bytes{ 0 };
 
     http_parser()
     {
@@ -51,6 +70,12 @@ struct http_parser {
     void reset()
     {
         complete = false;
+        paused = false;
+        keep_alive = false;
+        decoder.reset();
+        body_wire_bytes = 0;
+        body_decoded_bytes = 0;
+        streaming.reset();
         response = {};
         header_field = {};
         ::http_parser_init(&parser_, HTTP_RESPONSE);
@@ -65,8 +90,20 @@ struct http_parser {
         return status::ok;
     }
 
+    /**
+     * Reserves the body for the declared content length, so that large responses are not reallocated on every chunk. The
+     * reservation is limited, because the length comes from the network. For compressed body the length is the lower bound.
+     */
     int on_headers_complete()
     {
+        if (auto encoding = response.headers.find("content-encoding"); encoding != response.headers.end()) {
+            if (equals_ignore_case(encoding->second, "gzip") || equals_ignore_case(encoding->second, "x-gzip")) {
+                decoder = std::make_unique<gzip_decoder>();
+            }
+        }
+        if (!streaming && (parser_.flags & F_CHUNKED) == 0 && parser_.content_length > 0 && parser_.content_length != ULLONG_MAX) {
+            response.body.reserve(static_cast<std::size_t>(std::min<std::uint64_t>(parser_.content_length, max_reserved_body_size)));
+        }
         return 0;
     }
 
@@ -87,7 +124,11 @@ struct http_parser {
 
     int on_message_complete()
     {
+        if (decoder && body_wire_bytes > 0 && !decoder->finished()) {
+            return 1; // truncated gzip stream
+        }
         complete = true;
+        keep_alive = ::http_should_keep_alive(&parser_) != 0;
         return 0;
     }
 
@@ -103,9 +144,15 @@ struct http_parser {
         return 0;
     }
 
+    /**
+     * Header names are case-insensitive, those the client looks at are stored in lower case.
+     */
     int on_header_field(const char* at, std::size_t length)
     {
         header_field.assign(at, length);
+        if (equals_ignore_case(header_field, "content-encoding")) {
+            header_field = "content-encoding";
+        }
         return 0;
     }
 
@@ -115,12 +162,39 @@ struct http_parser {
         return 0;
     }
 
+    /**
+     * Compressed body is inflated chunk by chunk as it arrives, so that the streaming handler (e.g. the row lexer of the query)
+     * receives decoded data without waiting for the whole response.
+     */
     int on_body(const char* at, std::size_t length)
     {
-        response.body.append(at, length);
+        body_wire_bytes += length;
+        if (decoder) {
+            return decoder->decode(std::string_view(at, length), [this](std::string_view decoded) { append_body(decoded); }) ? 0 : 1;
+        }
+        append_body(std::string_view(at, length));
         return 0;
     }
 
+    void append_body(std::string_view data)
+    {
+        body_decoded_bytes += data.size();
+        if (streaming) {
+            if (!streaming->on_chunk(data, response.body)) {
+                paused = true;
+            }
+            return;
+        }
+        response.body.append(data);
+    }
+
+    static bool equals_ignore_case(std::string_view lhs, std::string_view rhs)
+    {
+        return lhs.size() == rhs.size() && std::equal(lhs.begin(), lhs.end(), rhs.begin(), [](unsigned char a, unsigned char b) {
+                   return std::tolower(a) == std::tolower(b);
+               });
+    }
+
     static inline int static_on_url(::http_parser* parser, const char* at, std::size_t length)
     {
         return static_cast<couchbase::io::http_parser*>(parser->data)->on_url(at, length);
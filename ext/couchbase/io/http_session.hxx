@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <utility>
 #include <memory>
 
@@ -33,6 +34,8 @@
 #include <io/http_parser.hxx>
 #include <io/http_message.hxx>
 #include <platform/base64.h>
+#include <metrics/http_transfer_counters.hxx>
+#include <metrics/latency_histogram.hxx>
 #include <timeout_defaults.hxx>
 
 namespace couchbase::io
@@ -41,6 +44,9 @@ namespace couchbase::io
 class http_session : public std::enable_shared_from_this<http_session>
 {
   public:
+    static constexpr std::size_t default_read_size = 16384;
+    static constexpr std::size_t max_read_size = 1024 * 1024;
+
     http_session(const std::string& client_id,
                  asio::io_context& ctx,
                  const std::string& username,
@@ -131,6 +137,9 @@ class http_session : public std::enable_shared_from_this<http_session>
 
     void stop()
     {
+        if (stopped_) {
+            return;
+        }
         stopped_ = true;
         if (stream_->is_open()) {
             stream_->close();
@@ -148,6 +157,55 @@ class http_session : public std::enable_shared_from_this<http_session>
         }
     }
 
+    /**
+     * Address of the node in form "hostname:port".
+     */
+    [[nodiscard]] std::string node_address() const
+    {
+        return fmt::format("{}:{}", hostname_, service_);
+    }
+
+    /**
+     * Makes the session record latencies of its requests into the histogram shared by all sessions of the endpoint.
+     */
+    void attach_latency_histogram(std::shared_ptr<metrics::latency_histogram> latency)
+    {
+        latency_ = std::move(latency);
+    }
+
+    /**
+     * Makes the session count the sizes of response bodies into the counters shared by all sessions of the endpoint.
+     */
+    void attach_transfer_counters(std::shared_ptr<metrics::http_transfer_counters> counters)
+    {
+        transfer_counters_ = std::move(counters);
+    }
+
+    /**
+     * Asks the server to compress the responses with gzip. The responses are decoded by the parser, whether they have been
+     * requested compressed or not.
+     */
+    void set_accept_gzip(bool enabled)
+    {
+        accept_gzip_ = enabled;
+    }
+
+    /**
+     * Size of SO_RCVBUF for the socket, 0 keeps the size chosen by the operating system. Must be set before start().
+     */
+    void set_receive_buffer_size(std::size_t size)
+    {
+        receive_buffer_size_ = size;
+    }
+
+    /**
+     * Duration of the last completed request.
+     */
+    [[nodiscard]] std::chrono::microseconds last_latency() const
+    {
+        return last_latency_;
+    }
+
     bool keep_alive()
     {
         return keep_alive_;
@@ -196,12 +254,24 @@ class http_session : public std::enable_shared_from_this<http_session>
         if (!request.body.empty()) {
             request.headers["content-length"] = std::to_string(request.body.size());
         }
+        if (accept_gzip_) {
+            request.headers.try_emplace("accept-encoding", "gzip");
+        }
         for (auto& header : request.headers) {
             write(fmt::format("{}: {}\r\n", header.first, header.second));
         }
         write("\r\n");
         write(request.body);
+        if (request.streaming) {
+            request.streaming->resume = [weak_self = weak_from_this()]() {
+                if (auto self = weak_self.lock()) {
+                    asio::post(self->ctx_, [self]() { self->resume_reading(); });
+                }
+            };
+            parser_.streaming = request.streaming;
+        }
         command_handlers_.push_back(std::move(handler));
+        request_started_ = std::chrono::steady_clock::now();
         flush();
     }
 
@@ -210,7 +280,7 @@ class http_session : public std::enable_shared_from_this<http_session>
     {
         if (ec) {
             spdlog::error("{} error on resolve: {}", log_prefix_, ec.message());
-            return;
+            return stop();
         }
         endpoints_ = endpoints;
         do_connect(endpoints_.begin());
@@ -240,6 +310,7 @@ class http_session : public std::enable_shared_from_this<http_session>
             do_connect(++it);
         } else {
             connected_ = true;
+            stream_->set_options(receive_buffer_size_);
             endpoint_ = it->endpoint();
             spdlog::debug("{} connected to {}:{}", log_prefix_, it->endpoint().address().to_string(), it->endpoint().port());
             log_prefix_ = fmt::format("[{}/{}] <{}:{}>", client_id_, id_, endpoint_.address().to_string(), endpoint_.port());
@@ -264,31 +335,69 @@ class http_session : public std::enable_shared_from_this<http_session>
         deadline_timer_.async_wait(std::bind(&http_session::check_deadline, shared_from_this(), std::placeholders::_1));
     }
 
+    /**
+     * Reads the response. Idle keep-alive sessions also keep the read pending, so that they notice when the server closes the
+     * connection.
+     *
+     * The read size doubles every time the read fills the whole buffer (i.e. large body is arriving). Once the response is complete,
+     * it drops to the high-water mark of the recent responses, see shrink_input_buffer().
+     */
     void do_read()
     {
-        if (stopped_) {
+        if (stopped_ || reading_) {
             return;
         }
+        reading_ = true;
+        if (input_buffer_.size() < read_size_) {
+            input_buffer_.resize(read_size_);
+        }
         stream_->async_read_some(
-          asio::buffer(input_buffer_), [self = shared_from_this()](std::error_code ec, std::size_t bytes_transferred) {
+          asio::buffer(input_buffer_.data(), read_size_), [self = shared_from_this()](std::error_code ec, std::size_t bytes_transferred) {
+              self->reading_ = false;
               if (ec == asio::error::operation_aborted || self->stopped_) {
                   return;
               }
               if (ec) {
-                  spdlog::error("{} IO error while reading from the socket: {}", self->log_prefix_, ec.message());
+                  if (self->command_handlers_.empty()) {
+                      spdlog::debug("{} idle HTTP session has been closed: {}", self->log_prefix_, ec.message());
+                  } else {
+                      spdlog::error("{} IO error while reading from the socket: {}", self->log_prefix_, ec.message());
+                  }
                   return self->stop();
               }
 
+              if (bytes_transferred == self->read_size_ && self->read_size_ < max_read_size) {
+                  self->read_size_ = std::min(self->read_size_ * 2, max_read_size);
+              }
               switch (self->parser_.feed(reinterpret_cast<const char*>(self->input_buffer_.data()), bytes_transferred)) {
                   case http_parser::status::ok:
                       if (self->parser_.complete) {
+                          self->keep_alive_ = self->parser_.keep_alive;
+                          if (self->transfer_counters_) {
+                              self->transfer_counters_->record(
+                                self->parser_.decoder != nullptr, self->parser_.body_wire_bytes, self->parser_.body_decoded_bytes);
+                          }
+                          auto response = std::move(self->parser_.response);
+                          self->parser_.reset();
+                          self->shrink_input_buffer();
                           if (!self->command_handlers_.empty()) {
-                              auto handler = self->command_handlers_.front();
+                              auto handler = std::move(self->command_handlers_.front());
                               self->command_handlers_.pop_front();
-                              handler({}, std::move(self->parser_.response));
+                              self->last_latency_ = std::chrono::duration_cast<std::chrono::microseconds>(
+                                std::chrono::steady_clock::now() - self->request_started_);
+                              if (self->latency_) {
+                                  self->latency_->record(self->last_latency_);
+                              }
+                              handler({}, std::move(response));
                           }
-                          self->parser_.reset();
-                          return self->stop();
+                          if (!self->keep_alive_) {
+                              return self->stop();
+                          }
+                          return self->do_read();
+                      }
+                      if (self->parser_.paused) {
+                          self->reading_paused_ = true;
+                          return;
                       }
                       return self->do_read();
                   case http_parser::status::failure:
@@ -298,6 +407,33 @@ class http_session : public std::enable_shared_from_this<http_session>
           });
     }
 
+    /**
+     * Updates the high-water mark of the read size, which decays by 1/8 per response, and releases the memory of the input buffer,
+     * if it is more than twice the mark. So a stream of large responses does not reallocate the buffer for each of them.
+     */
+    void shrink_input_buffer()
+    {
+        read_high_water_ = std::max(read_size_, read_high_water_ - read_high_water_ / 8);
+        read_size_ = std::max(read_high_water_, default_read_size);
+        if (input_buffer_.size() > 2 * read_size_) {
+            input_buffer_.resize(read_size_);
+            input_buffer_.shrink_to_fit();
+        }
+    }
+
+    /**
+     * Continues reading of the response, that has been paused by the streaming body handler.
+     */
+    void resume_reading()
+    {
+        if (!reading_paused_ || stopped_) {
+            return;
+        }
+        reading_paused_ = false;
+        parser_.paused = false;
+        do_read();
+    }
+
     void do_write()
     {
         if (stopped_) {
@@ -344,12 +480,22 @@ class http_session : public std::enable_shared_from_this<http_session>
     bool stopped_{ false };
     bool connected_{ false };
     bool keep_alive_{ false };
+    bool reading_paused_{ false };
+    bool reading_{ false };
 
     std::function<void()> on_stop_handler_{ nullptr };
 
     std::list<std::function<void(std::error_code, io::http_response&&)>> command_handlers_{};
+    std::shared_ptr<metrics::latency_histogram> latency_{};
+    std::shared_ptr<metrics::http_transfer_counters> transfer_counters_{};
+    bool accept_gzip_{ false };
+    std::chrono::steady_clock::time_point request_started_{};
+    std::chrono::microseconds last_latency_{ 0 };
     http_parser parser_{};
-    std::array<std::uint8_t, 16384> input_buffer_{};
+    std::vector<std::uint8_t> input_buffer_{};
+    std::size_t read_size_{ default_read_size };
+    std::size_t read_high_water_{ 0 };
+    std::size_t receive_buffer_size_{ 0 };
     std::vector<std::vector<std::uint8_t>> output_buffer_{};
     std::vector<std::vector<std::uint8_t>> writing_buffer_{};
     asio::ip::tcp::endpoint endpoint_{}; // connected endpoint
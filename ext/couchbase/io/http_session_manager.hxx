@@ -18,105 +18,500 @@
 #pragma once
 
 #include <io/http_session.hxx>
+#include <metrics/snapshot.hxx>
+#include <origin.hxx>
 #include <service_type.hxx>
 
+#include <algorithm>
+#include <optional>
 #include <random>
 
 namespace couchbase::io
 {
 
+/**
+ * Pool of HTTP sessions of the cluster.
+ *
+ * The number of sessions to every node of the service is limited by max_http_connections, requests, which do not get a session,
+ * wait in the queue of the service until a session is checked in or closed. The node for the request is selected by the number of
+ * requests in flight and the recent latency of the node, so that slow nodes get less traffic. Idle sessions are closed after
+ * idle_http_connection_timeout, except http_prewarm_connections of every node, which are opened with the configuration.
+ */
 class http_session_manager : public std::enable_shared_from_this<http_session_manager>
 {
   public:
+    using checkout_handler = std::function<void(std::error_code, std::shared_ptr<http_session>)>;
+
+    /**
+     * Weight of the latest request in the latency estimate of the node.
+     */
+    static constexpr double latency_smoothing = 0.2;
+
     http_session_manager(const std::string& client_id, asio::io_context& ctx, asio::ssl::context& tls)
       : client_id_(client_id)
       , ctx_(ctx)
       , tls_(tls)
+      , idle_timer_(ctx)
     {
     }
 
-    void set_configuration(const configuration& config, const cluster_options& options)
+    /**
+     * Replaces the configuration used to select nodes for new sessions, and opens pre-warmed sessions to the new nodes. Might be
+     * called from any thread.
+     */
+    void set_configuration(std::shared_ptr<const configuration> config, const couchbase::origin& origin)
     {
-        options_ = options;
-        config_ = config;
-        next_index_ = 0;
-        if (config_.nodes.size() > 1) {
-            std::random_device rd;
-            std::mt19937 gen(rd());
-            std::uniform_int_distribution<std::size_t> dis(0, config_.nodes.size() - 1);
-            next_index_ = dis(gen);
+        {
+            std::scoped_lock lock(sessions_mutex_);
+            options_ = origin.options();
+            username_ = origin.get_username();
+            password_ = origin.get_password();
+            config_ = std::move(config);
+            next_index_ = 0;
+            if (config_ && config_->nodes.size() > 1) {
+                std::random_device rd;
+                std::mt19937 gen(rd());
+                std::uniform_int_distribution<std::size_t> dis(0, config_->nodes.size() - 1);
+                next_index_ = dis(gen);
+            }
+            if (closed_) {
+                return;
+            }
+            prewarm();
+            if (!idle_timer_started_ && options_.idle_http_connection_timeout.count() > 0) {
+                idle_timer_started_ = true;
+                schedule_idle_check();
+            }
+        }
+        for (auto type :
+             { service_type::query, service_type::analytics, service_type::search, service_type::views, service_type::management }) {
+            serve_waiters(type);
         }
     }
 
-    std::shared_ptr<http_session> check_out(service_type type, const std::string& username, const std::string& password)
+    /**
+     * Passes idle or new session to the handler, or puts the handler into the queue if all nodes of the service have reached
+     * max_http_connections. The handler might be invoked before the function returns.
+     */
+    void check_out(service_type type, std::chrono::milliseconds timeout, checkout_handler handler)
     {
-        std::scoped_lock lock(sessions_mutex_);
-        if (idle_sessions_[type].empty()) {
-            std::string hostname;
-            std::uint16_t port = 0;
-            std::tie(hostname, port) = next_node(type);
-            if (port == 0) {
-                return nullptr;
+        std::shared_ptr<http_session> session;
+        {
+            std::scoped_lock lock(sessions_mutex_);
+            if (closed_) {
+                return handler(std::make_error_code(error::common_errc::request_canceled), nullptr);
             }
-            config_.nodes.size();
-            std::shared_ptr<http_session> session;
-            if (options_.enable_tls) {
-                session = std::make_shared<http_session>(client_id_, ctx_, tls_, username, password, hostname, std::to_string(port));
-            } else {
-                session = std::make_shared<http_session>(client_id_, ctx_, username, password, hostname, std::to_string(port));
+            if (session = take_idle(type); !session) {
+                bool has_nodes = false;
+                session = open_session(type, has_nodes);
+                if (!session && has_nodes) {
+                    auto entry = std::make_shared<waiter>(waiter{ std::make_unique<asio::steady_timer>(ctx_), std::move(handler) });
+                    entry->timer->expires_after(timeout);
+                    entry->timer->async_wait([self = shared_from_this(), type, entry](std::error_code ec) {
+                        if (ec == asio::error::operation_aborted) {
+                            return;
+                        }
+                        if (self->remove_waiter(type, entry)) {
+                            entry->handler(std::make_error_code(error::common_errc::unambiguous_timeout), nullptr);
+                        }
+                    });
+                    waiters_[type].push_back(entry);
+                    return;
+                }
             }
-            session->start();
-            session->on_stop([type, id = session->id(), self = this->shared_from_this()]() {
-                std::scoped_lock inner_lock(self->sessions_mutex_);
-                self->busy_sessions_[type].remove_if([id](const auto& s) -> bool { return s->id() == id; });
-                self->idle_sessions_[type].remove_if([id](const auto& s) -> bool { return s->id() == id; });
-            });
-            busy_sessions_[type].push_back(session);
-            return session;
         }
-        auto session = idle_sessions_[type].front();
-        idle_sessions_[type].pop_front();
-        busy_sessions_[type].push_back(session);
-        return session;
+        if (!session) {
+            return handler(std::make_error_code(error::common_errc::service_not_available), nullptr);
+        }
+        handler({}, session);
     }
 
     void check_in(service_type type, std::shared_ptr<http_session> session)
     {
-        if (!session->keep_alive()) {
+        bool reuse = false;
+        {
+            std::scoped_lock lock(sessions_mutex_);
+            if (auto latency = session->last_latency(); latency.count() > 0) {
+                auto& estimate = endpoints_[{ type, session->node_address() }].latency_estimate_us;
+                auto sample = static_cast<double>(latency.count());
+                estimate = estimate == 0 ? sample : estimate + latency_smoothing * (sample - estimate);
+            }
+            reuse = session->keep_alive() && !session->is_stopped() && !closed_;
+            if (reuse) {
+                spdlog::debug("{} put HTTP session back to idle connections", session->log_prefix());
+                busy_sessions_[type].remove(session);
+                idle_sessions_[type].push_back({ session, std::chrono::steady_clock::now() });
+            }
+        }
+        if (!reuse) {
             return session->stop();
         }
-        if (!session->is_stopped()) {
+        serve_waiters(type);
+    }
+
+    /**
+     * Closes all sessions and fails the requests waiting for them.
+     */
+    void close()
+    {
+        std::vector<std::shared_ptr<http_session>> sessions;
+        std::vector<std::shared_ptr<waiter>> waiters;
+        {
             std::scoped_lock lock(sessions_mutex_);
-            spdlog::debug("{} put HTTP session back to idle connections", session->log_prefix());
-            idle_sessions_[type].push_back(session);
+            closed_ = true;
+            idle_timer_.cancel();
+            for (auto& [type, entries] : idle_sessions_) {
+                for (auto& entry : entries) {
+                    sessions.emplace_back(std::move(entry.session));
+                }
+            }
+            idle_sessions_.clear();
+            for (auto& [type, entries] : busy_sessions_) {
+                sessions.insert(sessions.end(), entries.begin(), entries.end());
+            }
+            busy_sessions_.clear();
+            for (auto& [type, entries] : waiters_) {
+                waiters.insert(waiters.end(), entries.begin(), entries.end());
+            }
+            waiters_.clear();
+        }
+        for (const auto& session : sessions) {
+            session->stop();
+        }
+        for (const auto& entry : waiters) {
+            entry->timer->cancel();
+            entry->handler(std::make_error_code(error::common_errc::request_canceled), nullptr);
         }
     }
 
+    /**
+     * Number of idle and busy sessions, and latencies of the requests for every service endpoint, which has been used.
+     */
+    [[nodiscard]] std::vector<metrics::http_endpoint_metrics> metrics()
+    {
+        std::scoped_lock lock(sessions_mutex_);
+        std::map<std::pair<service_type, std::string>, metrics::http_endpoint_metrics> endpoints;
+        for (const auto& [key, state] : endpoints_) {
+            if (state.latency) {
+                endpoints[key].latency = state.latency->snapshot();
+            }
+            if (state.transfer) {
+                auto& entry = endpoints[key];
+                entry.responses = state.transfer->responses.load(std::memory_order_relaxed);
+                entry.compressed_responses = state.transfer->compressed_responses.load(std::memory_order_relaxed);
+                entry.body_wire_bytes = state.transfer->wire_bytes.load(std::memory_order_relaxed);
+                entry.body_decoded_bytes = state.transfer->decoded_bytes.load(std::memory_order_relaxed);
+            }
+        }
+        for (const auto& [type, entries] : idle_sessions_) {
+            for (const auto& entry : entries) {
+                ++endpoints[{ type, entry.session->node_address() }].idle_sessions;
+            }
+        }
+        for (const auto& [type, sessions] : busy_sessions_) {
+            for (const auto& session : sessions) {
+                ++endpoints[{ type, session->node_address() }].busy_sessions;
+            }
+        }
+        std::vector<metrics::http_endpoint_metrics> result;
+        result.reserve(endpoints.size());
+        for (auto& [key, entry] : endpoints) {
+            entry.service = key.first;
+            entry.node = key.second;
+            result.emplace_back(std::move(entry));
+        }
+        return result;
+    }
+
   private:
-    std::pair<std::string, std::uint16_t> next_node(service_type type)
+    struct idle_session {
+        std::shared_ptr<http_session> session;
+        std::chrono::steady_clock::time_point since;
+    };
+
+    struct waiter {
+        std::unique_ptr<asio::steady_timer> timer;
+        checkout_handler handler;
+    };
+
+    struct endpoint_state {
+        std::shared_ptr<metrics::latency_histogram> latency{};
+        std::shared_ptr<metrics::http_transfer_counters> transfer{};
+        double latency_estimate_us{ 0 };
+    };
+
+    /**
+     * Lower is better: requests in flight on the node multiplied by the recent latency. Nodes without requests so far have zero
+     * latency, so they are tried first.
+     */
+    [[nodiscard]] double score(service_type type, const std::string& address) const
+    {
+        std::size_t in_flight = 0;
+        if (auto busy = busy_sessions_.find(type); busy != busy_sessions_.end()) {
+            in_flight = static_cast<std::size_t>(
+              std::count_if(busy->second.begin(), busy->second.end(), [&address](const auto& s) { return s->node_address() == address; }));
+        }
+        double latency = 0;
+        if (auto state = endpoints_.find({ type, address }); state != endpoints_.end()) {
+            latency = state->second.latency_estimate_us;
+        }
+        return static_cast<double>(in_flight + 1) * (latency + 1);
+    }
+
+    [[nodiscard]] std::size_t count_sessions(service_type type, const std::string& address) const
+    {
+        std::size_t count = 0;
+        if (auto idle = idle_sessions_.find(type); idle != idle_sessions_.end()) {
+            count += static_cast<std::size_t>(std::count_if(
+              idle->second.begin(), idle->second.end(), [&address](const auto& e) { return e.session->node_address() == address; }));
+        }
+        if (auto busy = busy_sessions_.find(type); busy != busy_sessions_.end()) {
+            count += static_cast<std::size_t>(
+              std::count_if(busy->second.begin(), busy->second.end(), [&address](const auto& s) { return s->node_address() == address; }));
+        }
+        return count;
+    }
+
+    /**
+     * Moves the idle session of the best node to the busy list. Ties are broken in favour of the most recently used session.
+     */
+    std::shared_ptr<http_session> take_idle(service_type type)
+    {
+        auto& idle = idle_sessions_[type];
+        auto best = idle.end();
+        double best_score = 0;
+        for (auto it = idle.begin(); it != idle.end(); ++it) {
+            if (it->session->is_stopped()) {
+                continue;
+            }
+            if (double current = score(type, it->session->node_address()); best == idle.end() || current <= best_score) {
+                best = it;
+                best_score = current;
+            }
+        }
+        if (best == idle.end()) {
+            return nullptr;
+        }
+        auto session = std::move(best->session);
+        idle.erase(best);
+        busy_sessions_[type].push_back(session);
+        return session;
+    }
+
+    /**
+     * Opens session to the best node, which has not reached max_http_connections. has_nodes is set when the service exists in the
+     * configuration.
+     */
+    std::shared_ptr<http_session> open_session(service_type type, bool& has_nodes)
     {
-        auto candidates = config_.nodes.size();
-        while (candidates > 0) {
-            --candidates;
-            auto& node = config_.nodes[next_index_];
-            next_index_ = (next_index_ + 1) % config_.nodes.size();
+        has_nodes = false;
+        if (!config_ || config_->nodes.empty()) {
+            return nullptr;
+        }
+        std::optional<std::pair<std::string, std::uint16_t>> best{};
+        double best_score = 0;
+        for (std::size_t i = 0; i < config_->nodes.size(); ++i) {
+            const auto& node = config_->nodes[(next_index_ + i) % config_->nodes.size()];
             std::uint16_t port = node.port_or(type, options_.enable_tls, 0);
-            if (port != 0) {
-                return { node.hostname, port };
+            if (port == 0) {
+                continue;
             }
+            has_nodes = true;
+            auto address = fmt::format("{}:{}", node.hostname, port);
+            if (options_.max_http_connections > 0 && count_sessions(type, address) >= options_.max_http_connections) {
+                continue;
+            }
+            if (double current = score(type, address); !best || current < best_score) {
+                best = { node.hostname, port };
+                best_score = current;
+            }
+        }
+        next_index_ = (next_index_ + 1) % config_->nodes.size();
+        if (!best) {
+            return nullptr;
+        }
+        auto session = make_session(type, best->first, best->second);
+        busy_sessions_[type].push_back(session);
+        session->start();
+        return session;
+    }
+
+    /**
+     * Compression of the responses is opt-in per service, because it trades CPU of both sides for the bandwidth.
+     */
+    [[nodiscard]] bool accept_gzip(service_type type) const
+    {
+        switch (type) {
+            case service_type::query:
+                return options_.http_compression_query;
+            case service_type::analytics:
+                return options_.http_compression_analytics;
+            case service_type::search:
+                return options_.http_compression_search;
+            case service_type::views:
+                return options_.http_compression_views;
+            case service_type::kv:
+            case service_type::management:
+                break;
+        }
+        return false;
+    }
+
+    std::shared_ptr<http_session> make_session(service_type type, const std::string& hostname, std::uint16_t port)
+    {
+        std::shared_ptr<http_session> session;
+        if (options_.enable_tls) {
+            session = std::make_shared<http_session>(client_id_, ctx_, tls_, username_, password_, hostname, std::to_string(port));
+        } else {
+            session = std::make_shared<http_session>(client_id_, ctx_, username_, password_, hostname, std::to_string(port));
+        }
+        auto& state = endpoints_[{ type, session->node_address() }];
+        if (!state.latency) {
+            state.latency = std::make_shared<metrics::latency_histogram>();
+        }
+        session->attach_latency_histogram(state.latency);
+        if (!state.transfer) {
+            state.transfer = std::make_shared<metrics::http_transfer_counters>();
+        }
+        session->attach_transfer_counters(state.transfer);
+        session->set_accept_gzip(accept_gzip(type));
+        session->set_receive_buffer_size(options_.socket_receive_buffer_size);
+        session->on_stop([type, id = session->id(), self = this->shared_from_this()]() {
+            {
+                std::scoped_lock inner_lock(self->sessions_mutex_);
+                self->busy_sessions_[type].remove_if([id](const auto& s) -> bool { return s->id() == id; });
+                self->idle_sessions_[type].remove_if([id](const auto& e) -> bool { return e.session->id() == id; });
+            }
+            self->serve_waiters(type);
+        });
+        return session;
+    }
+
+    /**
+     * Opens missing pre-warmed sessions for every node of query, analytics and search services.
+     */
+    void prewarm()
+    {
+        if (!config_ || options_.http_prewarm_connections == 0) {
+            return;
+        }
+        for (const auto& node : config_->nodes) {
+            for (auto type : { service_type::query, service_type::analytics, service_type::search }) {
+                std::uint16_t port = node.port_or(type, options_.enable_tls, 0);
+                if (port == 0) {
+                    continue;
+                }
+                auto existing = count_sessions(type, fmt::format("{}:{}", node.hostname, port));
+                for (auto i = existing; i < options_.http_prewarm_connections; ++i) {
+                    auto session = make_session(type, node.hostname, port);
+                    idle_sessions_[type].push_back({ session, std::chrono::steady_clock::now() });
+                    session->start();
+                }
+            }
+        }
+    }
+
+    /**
+     * Hands idle or new sessions to the waiting requests of the service, as long as the limits allow.
+     */
+    void serve_waiters(service_type type)
+    {
+        std::vector<std::pair<std::shared_ptr<waiter>, std::shared_ptr<http_session>>> ready;
+        {
+            std::scoped_lock lock(sessions_mutex_);
+            auto& queue = waiters_[type];
+            while (!queue.empty()) {
+                auto session = take_idle(type);
+                if (!session) {
+                    bool has_nodes = false;
+                    session = open_session(type, has_nodes);
+                }
+                if (!session) {
+                    break;
+                }
+                ready.emplace_back(queue.front(), std::move(session));
+                queue.pop_front();
+            }
+        }
+        for (auto& [entry, session] : ready) {
+            entry->timer->cancel();
+            entry->handler({}, std::move(session));
+        }
+    }
+
+    bool remove_waiter(service_type type, const std::shared_ptr<waiter>& entry)
+    {
+        std::scoped_lock lock(sessions_mutex_);
+        auto& queue = waiters_[type];
+        auto it = std::find(queue.begin(), queue.end(), entry);
+        if (it == queue.end()) {
+            return false;
+        }
+        queue.erase(it);
+        return true;
+    }
+
+    void schedule_idle_check()
+    {
+        idle_timer_.expires_after(std::max(options_.idle_http_connection_timeout / 2, std::chrono::milliseconds(100)));
+        idle_timer_.async_wait([self = shared_from_this()](std::error_code ec) {
+            if (ec == asio::error::operation_aborted) {
+                return;
+            }
+            self->close_idle_sessions();
+        });
+    }
+
+    /**
+     * Closes sessions, which have been idle longer than idle_http_connection_timeout, keeping http_prewarm_connections of the most
+     * recently used sessions of every node.
+     */
+    void close_idle_sessions()
+    {
+        std::vector<std::shared_ptr<http_session>> expired;
+        {
+            std::scoped_lock lock(sessions_mutex_);
+            if (closed_) {
+                return;
+            }
+            auto deadline = std::chrono::steady_clock::now() - options_.idle_http_connection_timeout;
+            for (auto& [type, entries] : idle_sessions_) {
+                std::map<std::string, std::size_t> kept;
+                for (auto it = entries.rbegin(); it != entries.rend();) {
+                    auto& count = kept[it->session->node_address()];
+                    if (it->since > deadline || count < options_.http_prewarm_connections) {
+                        ++count;
+                        ++it;
+                        continue;
+                    }
+                    expired.emplace_back(std::move(it->session));
+                    it = std::make_reverse_iterator(entries.erase(std::next(it).base()));
+                }
+            }
+            schedule_idle_check();
+        }
+        for (const auto& session : expired) {
+            spdlog::debug("{} closing idle HTTP session", session->log_prefix());
+            session->stop();
         }
-        return { "", 0 };
     }
 
     std::string client_id_;
     asio::io_context& ctx_;
     asio::ssl::context& tls_;
     cluster_options options_;
+    std::string username_{};
+    std::string password_{};
 
-    configuration config_{};
+    std::shared_ptr<const configuration> config_{};
     std::map<service_type, std::list<std::shared_ptr<http_session>>> busy_sessions_{};
-    std::map<service_type, std::list<std::shared_ptr<http_session>>> idle_sessions_{};
+    std::map<service_type, std::list<idle_session>> idle_sessions_{};
+    std::map<service_type, std::list<std::shared_ptr<waiter>>> waiters_{};
+    std::map<std::pair<service_type, std::string>, endpoint_state> endpoints_{};
     std::size_t next_index_{ 0 };
+    asio::steady_timer idle_timer_;
+    bool idle_timer_started_{ false };
+    bool closed_{ false };
     std::mutex sessions_mutex_{};
 };
 } // namespace couchbase::io
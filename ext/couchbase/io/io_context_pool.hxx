@@ -0,0 +1,114 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <asio.hpp>
+
+namespace couchbase::io
+{
+
+/**
+ * Set of io_context objects, where each context is being served by its own thread.
+ *
+ * The primary context (owned by the caller) is always part of the pool, so the pool with single thread does not spawn any threads
+ * and behaves exactly like plain io_context.
+ */
+class io_context_pool
+{
+  public:
+    explicit io_context_pool(asio::io_context& primary)
+      : primary_(primary)
+    {
+    }
+
+    io_context_pool(const io_context_pool&) = delete;
+    io_context_pool& operator=(const io_context_pool&) = delete;
+
+    ~io_context_pool()
+    {
+        stop();
+    }
+
+    /**
+     * Spawns (num_threads - 1) additional contexts with their worker threads.
+     */
+    void start(std::size_t num_threads)
+    {
+        if (!contexts_.empty() || num_threads < 2) {
+            return;
+        }
+        contexts_.reserve(num_threads - 1);
+        guards_.reserve(num_threads - 1);
+        workers_.reserve(num_threads - 1);
+        for (std::size_t i = 1; i < num_threads; ++i) {
+            auto& ctx = contexts_.emplace_back(std::make_unique<asio::io_context>());
+            guards_.emplace_back(asio::make_work_guard(*ctx));
+            workers_.emplace_back([ctx = ctx.get()]() { ctx->run(); });
+        }
+    }
+
+    /**
+     * Releases the contexts and waits until all worker threads complete outstanding work.
+     *
+     * Does not affect primary context.
+     */
+    void stop()
+    {
+        guards_.clear();
+        for (auto& worker : workers_) {
+            if (worker.joinable()) {
+                worker.join();
+            }
+        }
+        workers_.clear();
+    }
+
+    [[nodiscard]] std::size_t size() const
+    {
+        return contexts_.size() + 1;
+    }
+
+    /**
+     * Picks the context in round-robin fashion, so that long-living objects (like sessions) are spread evenly between the threads.
+     */
+    asio::io_context& next()
+    {
+        if (contexts_.empty()) {
+            return primary_;
+        }
+        std::size_t index = next_index_++ % size();
+        if (index == 0) {
+            return primary_;
+        }
+        return *contexts_[index - 1];
+    }
+
+  private:
+    asio::io_context& primary_;
+    std::vector<std::unique_ptr<asio::io_context>> contexts_{};
+    std::vector<asio::executor_work_guard<asio::io_context::executor_type>> guards_{};
+    std::vector<std::thread> workers_{};
+    std::atomic<std::size_t> next_index_{ 0 };
+};
+
+} // namespace couchbase::io
@@ -17,7 +17,10 @@
 
 #pragma once
 
+#include <compression_policy.hxx>
 #include <io/mcbp_session.hxx>
+#include <io/retry_reason.hxx>
+#include <tracing/threshold_logging_tracer.hxx>
 #include <protocol/cmd_get_collection_id.hxx>
 #include <functional>
 #include <utility>
@@ -38,6 +41,18 @@ struct mcbp_command : public std::enable_shared_from_this<mcbp_command<Request>>
     std::optional<std::uint32_t> opaque_{};
     std::shared_ptr<io::mcbp_session> session_{};
     mcbp_command_handler handler_{};
+    std::size_t retries_{ 0 };
+    std::shared_ptr<io::retry_counters> retry_counters_{};
+    std::shared_ptr<tracing::threshold_logging_tracer> tracer_{};
+    std::shared_ptr<tracing::request_span> span_{};
+    std::shared_ptr<compression_policy> compression_{};
+    io::request_ordering ordering_{};
+
+    /**
+     * Sends the command again to the node, that owns the partition, optionally applying new configuration first.
+     * Installed by the bucket, without it not_my_vbucket responses fail the command.
+     */
+    std::function<void(std::shared_ptr<mcbp_command>, std::optional<configuration>)> redispatch_{};
 
     mcbp_command(asio::io_context& ctx, Request req)
       : deadline(ctx)
@@ -48,6 +63,11 @@ struct mcbp_command : public std::enable_shared_from_this<mcbp_command<Request>>
 
     void start(mcbp_command_handler&& handler)
     {
+        if (tracer_) {
+            span_ = std::make_shared<tracing::request_span>();
+            span_->operation = fmt::format("{}", encoded_request_type::body_type::opcode);
+            span_->mark(tracing::point::created);
+        }
         handler_ = handler;
         deadline.expires_after(request.timeout);
         deadline.async_wait([self = this->shared_from_this()](std::error_code ec) {
@@ -58,30 +78,56 @@ struct mcbp_command : public std::enable_shared_from_this<mcbp_command<Request>>
         });
     }
 
-    void cancel()
+    /**
+     * Cancels the command. Without explicit reason it is treated as expired deadline.
+     *
+     * The handler is always invoked, even if the command has not been dispatched to the session yet.
+     */
+    void cancel(std::error_code reason = asio::error::operation_aborted)
     {
         if (opaque_ && session_) {
-            session_->cancel(opaque_.value(), asio::error::operation_aborted);
+            session_->cancel(opaque_.value(), reason);
         }
-        handler_ = nullptr;
+        if (reason == asio::error::operation_aborted) {
+            reason = std::make_error_code(error::common_errc::unambiguous_timeout);
+        }
+        invoke_handler(reason);
     }
 
     void invoke_handler(std::error_code ec, std::optional<io::mcbp_message> msg = {})
     {
         if (handler_) {
             handler_(ec, std::move(msg));
+            if (span_) {
+                span_->mark(tracing::point::completed);
+                tracer_->report(*span_);
+            }
         }
         handler_ = nullptr;
     }
 
+    /**
+     * Session might be running on another thread, so the response has to be processed on the context of the command, where its
+     * timers live.
+     */
+    template<typename Handler>
+    auto on_response(Handler&& handler)
+    {
+        return [executor = deadline.get_executor(), handler = std::forward<Handler>(handler)](std::error_code ec,
+                                                                                             io::mcbp_message&& msg) mutable {
+            asio::dispatch(executor, [handler, ec, msg = std::move(msg)]() mutable { handler(ec, std::move(msg)); });
+        };
+    }
+
     void request_collection_id()
     {
         protocol::client_request<protocol::get_collection_id_request_body> req;
         req.opaque(session_->next_opaque());
         req.body().collection_path(request.id.collection);
+        req.payload_storage(session_->acquire_buffer());
         session_->write_and_subscribe(req.opaque(),
-                                      req.data(session_->supports_feature(protocol::hello_feature::snappy)),
-                                      [self = this->shared_from_this()](std::error_code ec, io::mcbp_message&& msg) mutable {
+                                      std::move(req.data(session_->supports_feature(protocol::hello_feature::snappy))),
+                                      on_response([self = this->shared_from_this()](std::error_code ec, io::mcbp_message&& msg) mutable {
                                           if (ec == asio::error::operation_aborted) {
                                               return self->invoke_handler(std::make_error_code(error::common_errc::ambiguous_timeout));
                                           }
@@ -95,14 +141,82 @@ struct mcbp_command : public std::enable_shared_from_this<mcbp_command<Request>>
                                               return self->invoke_handler(ec);
                                           }
                                           protocol::client_response<protocol::get_collection_id_response_body> resp(msg);
-                                          self->session_->update_collection_uid(self->request.id.collection, resp.body().collection_uid());
+                                          self->session_->update_collection_uid(
+                                            self->request.id.collection, resp.body().collection_uid(), resp.body().manifest_uid());
                                           self->request.id.collection_uid = resp.body().collection_uid();
                                           return self->send();
-                                      });
+                                      }));
+    }
+
+    void record_retry(io::retry_reason reason)
+    {
+        ++retries_;
+        if (retry_counters_) {
+            retry_counters_->record(reason);
+        }
+    }
+
+    /**
+     * The node does not own the partition anymore, most likely because of rebalance. The response carries newer configuration, so
+     * the request is dispatched again after small backoff, which grows with every retry. The configuration is applied by the bucket
+     * when it redispatches the request.
+     */
+    void handle_not_my_vbucket(io::mcbp_message&& msg)
+    {
+        record_retry(io::retry_reason::not_my_vbucket);
+        auto config = session_->parse_not_my_vbucket_config(msg);
+        if (!redispatch_) {
+            return invoke_handler(std::make_error_code(error::common_errc::request_canceled));
+        }
+        auto backoff = std::chrono::milliseconds(std::min<std::uint64_t>(1ULL << std::min<std::size_t>(retries_ - 1, 7), 100));
+        auto time_left = deadline.expiry() - std::chrono::steady_clock::now();
+        spdlog::debug("{} not_my_vbucket response for \"{}/{}/{}\", partition={}, retries={}, time_left={}ms",
+                      session_->log_prefix(),
+                      request.id.bucket,
+                      request.id.collection,
+                      request.id.key,
+                      request.partition,
+                      retries_,
+                      std::chrono::duration_cast<std::chrono::milliseconds>(time_left).count());
+        if (time_left < backoff) {
+            return invoke_handler(std::make_error_code(error::common_errc::unambiguous_timeout));
+        }
+        retry_backoff.expires_after(backoff);
+        retry_backoff.async_wait([self = this->shared_from_this(), config = std::move(config)](std::error_code ec) mutable {
+            if (ec == asio::error::operation_aborted) {
+                return;
+            }
+            self->redispatch_(self, std::move(config));
+        });
+    }
+
+    /**
+     * All connections to the node are congested. The request has not been written anywhere, so it is mapped again after small
+     * backoff, until the deadline.
+     */
+    void handle_backpressure()
+    {
+        record_retry(io::retry_reason::kv_backpressure);
+        if (!redispatch_) {
+            return invoke_handler(std::make_error_code(error::common_errc::request_queue_full));
+        }
+        auto backoff = std::chrono::milliseconds(std::min<std::uint64_t>(1ULL << std::min<std::size_t>(retries_ - 1, 7), 100));
+        auto time_left = deadline.expiry() - std::chrono::steady_clock::now();
+        if (time_left < backoff) {
+            return invoke_handler(std::make_error_code(error::common_errc::unambiguous_timeout));
+        }
+        retry_backoff.expires_after(backoff);
+        retry_backoff.async_wait([self = this->shared_from_this()](std::error_code ec) mutable {
+            if (ec == asio::error::operation_aborted) {
+                return;
+            }
+            self->redispatch_(self, {});
+        });
     }
 
     void handle_unknown_collection()
     {
+        record_retry(io::retry_reason::unknown_collection);
         auto backoff = std::chrono::milliseconds(500);
         auto time_left = deadline.expiry() - std::chrono::steady_clock::now();
         spdlog::debug("{} unknown collection response for \"{}/{}/{}\", time_left={}ms",
@@ -123,10 +237,15 @@ struct mcbp_command : public std::enable_shared_from_this<mcbp_command<Request>>
         });
     }
 
-    void send()
+    void send(bool flush_now = true)
     {
         opaque_ = session_->next_opaque();
         request.opaque = *opaque_;
+        if (span_) {
+            span_->mark_once(tracing::point::dispatched);
+            span_->operation_id = fmt::format("0x{:x}", request.opaque);
+            span_->local_id = session_->log_prefix();
+        }
         if (!request.id.collection_uid) {
             if (session_->supports_feature(protocol::hello_feature::collections)) {
                 auto collection_id = session_->get_collection_uid(request.id.collection);
@@ -148,32 +267,106 @@ struct mcbp_command : public std::enable_shared_from_this<mcbp_command<Request>>
             }
         }
         request.encode_to(encoded);
+        encoded.payload_storage(session_->acquire_buffer());
+        ordering_ = ordering();
+        encoded.barrier(session_->requires_barrier(ordering_));
 
-        session_->write_and_subscribe(request.opaque,
-                                      encoded.data(session_->supports_feature(protocol::hello_feature::snappy)),
-                                      [self = this->shared_from_this()](std::error_code ec, io::mcbp_message&& msg) mutable {
-                                          self->retry_backoff.cancel();
-                                          if (ec == asio::error::operation_aborted) {
-                                              return self->invoke_handler(std::make_error_code(error::common_errc::ambiguous_timeout));
-                                          }
-                                          if (ec == std::make_error_code(error::common_errc::request_canceled)) {
-                                              return self->invoke_handler(ec);
-                                          }
-                                          if (msg.header.status() == static_cast<std::uint16_t>(protocol::status::unknown_collection)) {
-                                              return self->handle_unknown_collection();
-                                          }
-                                          self->deadline.cancel();
-                                          self->invoke_handler(ec, msg);
-                                      });
+        bool snappy = session_->supports_feature(protocol::hello_feature::snappy);
+        if (snappy && compression_ && compression_->should_offload(encoded.value_size())) {
+            // the place in the session is taken before compression, so that requests issued later (e.g. for the same document) are
+            // not written before this one
+            session_->reserve_write(request.opaque, response_handler(), span_, ordering_);
+            return compression_->offload([self = this->shared_from_this(), session = session_]() {
+                auto payload = self->encode_payload(true);
+                asio::post(self->deadline.get_executor(), [self, session, payload = std::move(payload)]() mutable {
+                    if (!self->handler_) {
+                        payload.clear();
+                    }
+                    session->complete_write(self->request.opaque, std::move(payload));
+                });
+            });
+        }
+        write_payload(encode_payload(snappy), flush_now);
+    }
+
+    /**
+     * Builds the frame of the encoded request, compressing the value when the policy allows it.
+     */
+    std::vector<std::uint8_t> encode_payload(bool snappy)
+    {
+        if (!compression_) {
+            return std::move(encoded.data(snappy));
+        }
+        if (!snappy || !compression_->should_compress(request.id, encoded.value_size())) {
+            return std::move(encoded.data(false));
+        }
+        auto start = std::chrono::steady_clock::now();
+        auto& payload = encoded.data(true, compression_->parameters());
+        if (encoded.compression().attempted) {
+            compression_->record(request.id, encoded.compression(), std::chrono::steady_clock::now() - start);
+        }
+        return std::move(payload);
+    }
+
+    /**
+     * Reads are only ordered after the mutations of the same document, while mutations are ordered after any request for the
+     * document, so that the server executes them in the order the application has issued them. Without unordered execution the
+     * server keeps the order of the connection, so the request is not tracked at all.
+     */
+    [[nodiscard]] io::request_ordering ordering() const
+    {
+        if (request.id.key.empty() || !session_->supports_feature(protocol::hello_feature::unordered_execution)) {
+            return {};
+        }
+        io::request_ordering result{};
+        result.key = io::request_ordering::key_of(request.partition, request.id.collection_uid.value_or(0), request.id.key);
+        switch (encoded_request_type::body_type::opcode) {
+            case protocol::client_opcode::get:
+            case protocol::client_opcode::get_replica:
+            case protocol::client_opcode::observe:
+            case protocol::client_opcode::subdoc_multi_lookup:
+                result.type = io::request_ordering::kind::read;
+                break;
+            default:
+                result.type = io::request_ordering::kind::mutation;
+                break;
+        }
+        return result;
+    }
+
+    auto response_handler()
+    {
+        return on_response([self = this->shared_from_this()](std::error_code ec, io::mcbp_message&& msg) mutable {
+            self->retry_backoff.cancel();
+            if (ec == asio::error::operation_aborted) {
+                return self->invoke_handler(std::make_error_code(error::common_errc::ambiguous_timeout));
+            }
+            if (ec && msg.header.status() == static_cast<std::uint16_t>(protocol::status::not_my_vbucket)) {
+                return self->handle_not_my_vbucket(std::move(msg));
+            }
+            if (ec == std::make_error_code(error::common_errc::request_canceled)) {
+                return self->invoke_handler(ec);
+            }
+            if (msg.header.status() == static_cast<std::uint16_t>(protocol::status::unknown_collection)) {
+                return self->handle_unknown_collection();
+            }
+            self->deadline.cancel();
+            self->invoke_handler(ec, std::move(msg));
+        });
+    }
+
+    void write_payload(std::vector<std::uint8_t>&& payload, bool flush_now)
+    {
+        session_->write_and_subscribe(request.opaque, std::move(payload), response_handler(), flush_now, span_, ordering_);
     }
 
-    void send_to(std::shared_ptr<io::mcbp_session> session)
+    void send_to(std::shared_ptr<io::mcbp_session> session, bool flush_now = true)
     {
         if (!handler_) {
             return;
         }
         session_ = std::move(session);
-        send();
+        send(flush_now);
     }
 };
 
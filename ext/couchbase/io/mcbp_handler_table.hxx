@@ -0,0 +1,435 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <system_error>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <io/mcbp_message.hxx>
+#include <tracing/request_span.hxx>
+
+namespace couchbase::io
+{
+
+/**
+ * Move-only type-erased handler of the MCBP response.
+ *
+ * Unlike std::function it keeps callables up to inline_capacity bytes in place, so subscribing for the response does not allocate.
+ */
+class mcbp_response_handler
+{
+  public:
+    static constexpr std::size_t inline_capacity = 64;
+
+    mcbp_response_handler() = default;
+
+    template<typename Handler, typename = std::enable_if_t<!std::is_same_v<std::decay_t<Handler>, mcbp_response_handler>>>
+    mcbp_response_handler(Handler&& handler) // NOLINT(google-explicit-constructor)
+    {
+        using handler_type = std::decay_t<Handler>;
+        if constexpr (fits_inline<handler_type>()) {
+            new (&storage_) handler_type(std::forward<Handler>(handler));
+            operations_ = &inline_operations<handler_type>;
+        } else {
+            new (&storage_) handler_type*(new handler_type(std::forward<Handler>(handler)));
+            operations_ = &heap_operations<handler_type>;
+        }
+    }
+
+    mcbp_response_handler(const mcbp_response_handler&) = delete;
+    mcbp_response_handler& operator=(const mcbp_response_handler&) = delete;
+
+    mcbp_response_handler(mcbp_response_handler&& other) noexcept
+    {
+        move_from(other);
+    }
+
+    mcbp_response_handler& operator=(mcbp_response_handler&& other) noexcept
+    {
+        if (this != &other) {
+            reset();
+            move_from(other);
+        }
+        return *this;
+    }
+
+    ~mcbp_response_handler()
+    {
+        reset();
+    }
+
+    explicit operator bool() const
+    {
+        return operations_ != nullptr;
+    }
+
+    void operator()(std::error_code ec, mcbp_message&& msg)
+    {
+        operations_->invoke(&storage_, ec, std::move(msg));
+    }
+
+    void reset()
+    {
+        if (operations_ != nullptr) {
+            operations_->destroy(&storage_);
+            operations_ = nullptr;
+        }
+    }
+
+  private:
+    struct operations {
+        void (*invoke)(void* storage, std::error_code ec, mcbp_message&& msg);
+        void (*move)(void* destination, void* source) noexcept;
+        void (*destroy)(void* storage) noexcept;
+    };
+
+    template<typename Handler>
+    static constexpr bool fits_inline()
+    {
+        return sizeof(Handler) <= inline_capacity && alignof(Handler) <= alignof(std::max_align_t) &&
+               std::is_nothrow_move_constructible_v<Handler>;
+    }
+
+    template<typename Handler>
+    static constexpr operations inline_operations{
+        [](void* storage, std::error_code ec, mcbp_message&& msg) { (*static_cast<Handler*>(storage))(ec, std::move(msg)); },
+        [](void* destination, void* source) noexcept {
+            new (destination) Handler(std::move(*static_cast<Handler*>(source)));
+            static_cast<Handler*>(source)->~Handler();
+        },
+        [](void* storage) noexcept { static_cast<Handler*>(storage)->~Handler(); },
+    };
+
+    template<typename Handler>
+    static constexpr operations heap_operations{
+        [](void* storage, std::error_code ec, mcbp_message&& msg) { (**static_cast<Handler**>(storage))(ec, std::move(msg)); },
+        [](void* destination, void* source) noexcept { new (destination) Handler*(*static_cast<Handler**>(source)); },
+        [](void* storage) noexcept { delete *static_cast<Handler**>(storage); },
+    };
+
+    void move_from(mcbp_response_handler& other) noexcept
+    {
+        if (other.operations_ != nullptr) {
+            other.operations_->move(&storage_, &other.storage_);
+            operations_ = other.operations_;
+            other.operations_ = nullptr;
+        }
+    }
+
+    std::aligned_storage_t<inline_capacity, alignof(std::max_align_t)> storage_;
+    const operations* operations_{ nullptr };
+};
+
+/**
+ * Relation of the request to other requests for the same document, when the server is allowed to reorder them (unordered execution).
+ */
+struct request_ordering {
+    enum class kind : std::uint8_t {
+        /** might be executed in any order */
+        none,
+        /** must not be executed before the mutations of the document sent earlier */
+        read,
+        /** must not be executed before any request for the document sent earlier */
+        mutation,
+    };
+
+    std::uint64_t key{ 0 };
+    kind type{ kind::none };
+
+    /**
+     * Identifies the document. Collisions only add unnecessary barriers.
+     */
+    static std::uint64_t key_of(std::uint16_t partition, std::uint32_t collection_uid, std::string_view document_key)
+    {
+        return std::hash<std::string_view>{}(document_key) ^ ((static_cast<std::uint64_t>(collection_uid) << 16U) | partition);
+    }
+};
+
+/**
+ * Table of in-flight requests of the session, indexed by opaque.
+ *
+ * Opaques are allocated monotonically, so the slot is selected by the lower bits of the opaque, and the full opaque stored in the
+ * slot works as generation: late responses for cancelled or already completed requests do not match, and reported as orphans.
+ * When the slot is still occupied by another in-flight request, the table doubles its size if it is at least half full, otherwise the
+ * occupant (a long-lived request, e.g. slow durable write, which is a whole table of opaques behind) moves to the overflow map. So the
+ * capacity follows the number of requests in flight rather than the distance between their opaques, and it halves again when the
+ * table becomes mostly empty.
+ *
+ * The table also counts in-flight reads and mutations of every document, so that the session can tell when the request has to be
+ * sent with barrier to keep the order of requests for the same document.
+ */
+class mcbp_handler_table
+{
+  public:
+    explicit mcbp_handler_table(std::size_t initial_capacity = 256)
+    {
+        std::size_t capacity = 1;
+        while (capacity < initial_capacity) {
+            capacity <<= 1U;
+        }
+        slots_.resize(capacity);
+        mask_ = capacity - 1;
+        min_capacity_ = capacity;
+    }
+
+    void insert(std::uint32_t opaque,
+                mcbp_response_handler&& handler,
+                std::shared_ptr<tracing::request_span> span = {},
+                request_ordering ordering = {})
+    {
+        if (!overflow_.empty()) {
+            if (auto parked = overflow_.find(opaque); parked != overflow_.end()) {
+                release(parked->second.ordering);
+                overflow_.erase(parked);
+                --size_;
+            }
+        }
+        if (slots_[opaque & mask_].handler && slots_[opaque & mask_].opaque != opaque) {
+            if (size_ >= slots_.size() / 2) {
+                rehash(slots_.size() * 2);
+            }
+            if (auto& occupied = slots_[opaque & mask_]; occupied.handler && occupied.opaque != opaque) {
+                auto parked_opaque = occupied.opaque;
+                overflow_.emplace(parked_opaque, std::move(occupied));
+                occupied = {};
+            }
+        }
+        auto& slot = slots_[opaque & mask_];
+        if (slot.handler) {
+            release(slot.ordering);
+        } else {
+            ++size_;
+        }
+        slot.opaque = opaque;
+        slot.handler = std::move(handler);
+        slot.span = std::move(span);
+        slot.started = std::chrono::steady_clock::now();
+        slot.ordering = ordering;
+        if (ordering.type != request_ordering::kind::none) {
+            auto& usage = documents_[ordering.key];
+            if (ordering.type == request_ordering::kind::read) {
+                ++usage.reads;
+            } else {
+                ++usage.mutations;
+            }
+        }
+    }
+
+    /**
+     * Returns true if the request has to wait until the server completes in-flight requests for the same document.
+     */
+    [[nodiscard]] bool requires_barrier(const request_ordering& ordering) const
+    {
+        if (ordering.type == request_ordering::kind::none || documents_.empty()) {
+            return false;
+        }
+        auto usage = documents_.find(ordering.key);
+        if (usage == documents_.end()) {
+            return false;
+        }
+        return usage->second.mutations > 0 || (ordering.type == request_ordering::kind::mutation && usage->second.reads > 0);
+    }
+
+    /**
+     * Returns time when the request has been put into the table, or default time point if there is no such request in flight.
+     */
+    [[nodiscard]] std::chrono::steady_clock::time_point started(std::uint32_t opaque) const
+    {
+        const auto* slot = find(opaque);
+        if (slot == nullptr) {
+            return {};
+        }
+        return slot->started;
+    }
+
+    /**
+     * Returns the span of the request in flight, or nullptr if the request is not traced.
+     */
+    [[nodiscard]] tracing::request_span* span(std::uint32_t opaque)
+    {
+        const auto* slot = find(opaque);
+        if (slot == nullptr) {
+            return nullptr;
+        }
+        return slot->span.get();
+    }
+
+    /**
+     * Removes the handler from the table. Returns empty handler if there is no request with such opaque in flight.
+     */
+    [[nodiscard]] mcbp_response_handler take(std::uint32_t opaque)
+    {
+        mcbp_response_handler handler{};
+        if (auto& slot = slots_[opaque & mask_]; slot.handler && slot.opaque == opaque) {
+            slot.span.reset();
+            release(slot.ordering);
+            slot.ordering = {};
+            handler = std::move(slot.handler);
+        } else if (auto parked = overflow_.find(opaque); parked != overflow_.end()) {
+            release(parked->second.ordering);
+            handler = std::move(parked->second.handler);
+            overflow_.erase(parked);
+        } else {
+            return {};
+        }
+        --size_;
+        if (slots_.size() > min_capacity_ && size_ < slots_.size() / 8) {
+            rehash(slots_.size() / 2);
+        }
+        return handler;
+    }
+
+    /**
+     * Removes all handlers from the table.
+     */
+    [[nodiscard]] std::vector<std::pair<std::uint32_t, mcbp_response_handler>> take_all()
+    {
+        std::vector<std::pair<std::uint32_t, mcbp_response_handler>> handlers;
+        handlers.reserve(size_);
+        for (auto& slot : slots_) {
+            if (slot.handler) {
+                handlers.emplace_back(slot.opaque, std::move(slot.handler));
+                slot.span.reset();
+                slot.ordering = {};
+            }
+        }
+        for (auto& [opaque, parked] : overflow_) {
+            handlers.emplace_back(opaque, std::move(parked.handler));
+        }
+        overflow_.clear();
+        size_ = 0;
+        documents_.clear();
+        return handlers;
+    }
+
+    [[nodiscard]] std::size_t size() const
+    {
+        return size_;
+    }
+
+    [[nodiscard]] bool empty() const
+    {
+        return size_ == 0;
+    }
+
+    [[nodiscard]] std::size_t capacity() const
+    {
+        return slots_.size();
+    }
+
+    /**
+     * Number of documents with requests in flight, which are tracked for ordering.
+     */
+    [[nodiscard]] std::size_t ordered_documents() const
+    {
+        return documents_.size();
+    }
+
+  private:
+    struct entry {
+        std::uint32_t opaque{ 0 };
+        mcbp_response_handler handler{};
+        std::shared_ptr<tracing::request_span> span{};
+        std::chrono::steady_clock::time_point started{};
+        request_ordering ordering{};
+    };
+
+    struct document_usage {
+        std::uint32_t reads{ 0 };
+        std::uint32_t mutations{ 0 };
+    };
+
+    void release(const request_ordering& ordering)
+    {
+        if (ordering.type == request_ordering::kind::none) {
+            return;
+        }
+        auto usage = documents_.find(ordering.key);
+        if (usage == documents_.end()) {
+            return;
+        }
+        if (ordering.type == request_ordering::kind::read) {
+            --usage->second.reads;
+        } else {
+            --usage->second.mutations;
+        }
+        if (usage->second.reads == 0 && usage->second.mutations == 0) {
+            documents_.erase(usage);
+        }
+    }
+
+    [[nodiscard]] const entry* find(std::uint32_t opaque) const
+    {
+        if (const auto& slot = slots_[opaque & mask_]; slot.handler && slot.opaque == opaque) {
+            return &slot;
+        }
+        if (overflow_.empty()) {
+            return nullptr;
+        }
+        auto parked = overflow_.find(opaque);
+        return parked == overflow_.end() ? nullptr : &parked->second;
+    }
+
+    /**
+     * Moves the requests into the table of the new capacity (power of two). Requests, which collide in the new table, stay in the
+     * overflow map.
+     */
+    void rehash(std::size_t capacity)
+    {
+        std::vector<entry> slots(capacity);
+        std::unordered_map<std::uint32_t, entry> overflow;
+        std::size_t mask = capacity - 1;
+        auto place = [&slots, &overflow, mask](entry&& e) {
+            if (auto& target = slots[e.opaque & mask]; !target.handler) {
+                target = std::move(e);
+            } else {
+                auto opaque = e.opaque;
+                overflow.emplace(opaque, std::move(e));
+            }
+        };
+        for (auto& s : slots_) {
+            if (s.handler) {
+                place(std::move(s));
+            }
+        }
+        for (auto& [opaque, parked] : overflow_) {
+            place(std::move(parked));
+        }
+        mask_ = mask;
+        std::swap(slots_, slots);
+        std::swap(overflow_, overflow);
+    }
+
+    std::vector<entry> slots_{};
+    std::unordered_map<std::uint32_t, entry> overflow_{};
+    std::size_t mask_{ 0 };
+    std::size_t min_capacity_{ 0 };
+    std::size_t size_{ 0 };
+    std::unordered_map<std::uint64_t, document_usage> documents_{};
+};
+
+} // namespace couchbase::io
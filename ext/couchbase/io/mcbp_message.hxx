@@ -52,7 +52,7 @@ struct mcbp_message {
     binary_header header;
     std::vector<std::uint8_t> body;
 
-    protocol::header_buffer header_data()
+    [[nodiscard]] protocol::header_buffer header_data() const
     {
         protocol::header_buffer buf;
         std::memcpy(buf.data(), &header, sizeof(header));
@@ -17,8 +17,15 @@
 
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <vector>
+
 #include <snappy.h>
 
+#include <asio/buffer.hpp>
+
 #include <gsl/gsl_assert>
 #include <protocol/magic.hxx>
 #include <protocol/datatype.hxx>
@@ -27,75 +34,245 @@
 
 namespace couchbase::io
 {
+/**
+ * Incremental parser of MCBP frames.
+ *
+ * The socket reads directly into the free space at the tail of the buffer (see prepare() and commit()), and parsed frames are
+ * consumed by moving the read position, so the bytes are never shifted for every frame. The only remaining copy is the body
+ * into the final storage of the message (or the decompressed body, when the frame is compressed), which is then owned by
+ * the response object. Unparsed tail is moved to the beginning of the buffer only when the free space is exhausted.
+ *
+ * The buffer grows to fit the rest of the pending frame, so that it is read with as few reads as the socket allows. Bodies of at
+ * least direct_read_threshold bytes are read straight into the storage of the message instead. Every time the buffer is drained,
+ * it is compared with the high-water mark, which decays by 1/8 per drain, and shrinks only when it has grown twice beyond the
+ * mark. So a stream of large values keeps the buffer, while the session, that has switched to small values, releases it soon.
+ */
 struct mcbp_parser {
     enum result { ok, need_data, failure };
 
+    static constexpr std::size_t header_size = 24;
+    static constexpr std::size_t default_read_size = 16384;
+    static constexpr std::size_t direct_read_threshold = 256 * 1024;
+
+    /**
+     * Returns writable region for the next read: the rest of the large body when it is read directly, otherwise the tail of the
+     * buffer, that has at least min_size bytes and fits the rest of the pending frame.
+     */
+    asio::mutable_buffer prepare(std::size_t min_size = default_read_size)
+    {
+        if (direct_) {
+            return asio::buffer(direct_body_.data() + direct_filled_, direct_body_.size() - direct_filled_);
+        }
+        std::size_t pending = write_pos_ - read_pos_;
+        if (pending >= header_size) {
+            std::size_t frame_size = header_size + body_size(buf_.data() + read_pos_);
+            if (frame_size > pending) {
+                if (frame_size - header_size >= direct_read_threshold) {
+                    return start_direct_read();
+                }
+                min_size = std::max(min_size, frame_size - pending);
+            }
+        }
+        return reserve(min_size);
+    }
+
+    /**
+     * Marks bytes_written bytes of the region returned by prepare() as ready for parsing.
+     */
+    void commit(std::size_t bytes_written)
+    {
+        if (direct_) {
+            Expects(direct_filled_ + bytes_written <= direct_body_.size());
+            direct_filled_ += bytes_written;
+            return;
+        }
+        Expects(write_pos_ + bytes_written <= buf_.size());
+        write_pos_ += bytes_written;
+        peak_fill_ = std::max(peak_fill_, write_pos_);
+    }
+
+    /**
+     * Appends the bytes to the buffer, large bodies are not read directly in this case.
+     */
     template<typename Iterator>
     void feed(Iterator begin, Iterator end)
     {
-        buf.reserve(buf.size() + static_cast<size_t>(std::distance(begin, end)));
-        std::copy(begin, end, std::back_inserter(buf));
+        Expects(!direct_);
+        auto size = static_cast<size_t>(std::distance(begin, end));
+        auto region = reserve(size);
+        std::copy(begin, end, static_cast<std::uint8_t*>(region.data()));
+        commit(size);
     }
 
     void reset()
     {
-        buf.clear();
+        read_pos_ = 0;
+        write_pos_ = 0;
+        direct_ = false;
+        direct_filled_ = 0;
+        direct_body_.clear();
+    }
+
+    /**
+     * Capacity of the read buffer, for diagnostics.
+     */
+    [[nodiscard]] std::size_t buffer_size() const
+    {
+        return buf_.size() + direct_body_.size();
     }
 
     result next(mcbp_message& msg)
     {
-        static const size_t header_size = 24;
-        if (buf.size() < header_size) {
+        if (direct_) {
+            if (direct_filled_ < direct_body_.size()) {
+                return need_data;
+            }
+            std::memcpy(&msg.header, direct_header_.data(), header_size);
+            if (!decompress(msg, direct_body_.data(), direct_body_.size())) {
+                msg.body = std::move(direct_body_);
+            }
+            direct_ = false;
+            direct_filled_ = 0;
+            direct_body_ = {};
+            return ok;
+        }
+        std::size_t available = write_pos_ - read_pos_;
+        if (available < header_size) {
             return need_data;
         }
-        std::memcpy(&msg.header, buf.data(), header_size);
+        const std::uint8_t* frame = buf_.data() + read_pos_;
+        std::memcpy(&msg.header, frame, header_size);
         uint32_t body_size = ntohl(msg.header.bodylen);
-        if (body_size > 0 && buf.size() - header_size < body_size) {
+        if (body_size > 0 && available - header_size < body_size) {
             return need_data;
         }
-        msg.body.clear();
-        msg.body.reserve(body_size);
-        uint32_t key_size = ntohs(msg.header.keylen);
-        uint32_t prefix_size = uint32_t(msg.header.extlen) + key_size;
-        if (msg.header.magic == static_cast<uint8_t>(protocol::magic::alt_client_response)) {
-            uint8_t framing_extras_size = msg.header.keylen & 0xfU;
-            key_size = (msg.header.keylen & 0xf0U) >> 8U;
-            prefix_size = uint32_t(framing_extras_size) + uint32_t(msg.header.extlen) + key_size;
-        }
-        std::copy(buf.begin() + header_size, buf.begin() + header_size + prefix_size, std::back_inserter(msg.body));
-
-        bool is_compressed = (msg.header.datatype & static_cast<uint8_t>(protocol::datatype::snappy)) != 0;
-        bool use_raw_value = true;
-        if (is_compressed) {
-            std::string uncompressed;
-            size_t offset = header_size + prefix_size;
-            bool success = snappy::Uncompress(reinterpret_cast<const char*>(buf.data() + offset), body_size - prefix_size, &uncompressed);
-            if (success) {
-                std::copy(uncompressed.begin(), uncompressed.end(), std::back_inserter(msg.body));
-                use_raw_value = false;
-                // patch header with new body size
-                msg.header.bodylen = htonl(static_cast<std::uint32_t>(prefix_size + uncompressed.size()));
-            }
-        }
-        if (use_raw_value) {
-            std::copy(buf.begin() + header_size + prefix_size, buf.begin() + header_size + body_size, std::back_inserter(msg.body));
+        const std::uint8_t* body = frame + header_size;
+        if (!decompress(msg, body, body_size)) {
+            msg.body.assign(body, body + body_size);
         }
-        buf.erase(buf.begin(), buf.begin() + header_size + body_size);
-        if (!protocol::is_valid_magic(buf[0])) {
+
+        read_pos_ += header_size + body_size;
+        if (read_pos_ == write_pos_) {
+            reset();
+            drained();
+        } else if (!protocol::is_valid_magic(buf_[read_pos_])) {
             spdlog::warn("parsed frame for magic={:x}, opcode={:x}, opaque={}, body_len={}. Invalid magic of the next frame: {:x}, {} "
                          "bytes to parse{}",
                          msg.header.magic,
                          msg.header.opcode,
                          msg.header.opaque,
                          body_size,
-                         buf[0],
-                         buf.size(),
-                         spdlog::to_hex(buf));
+                         buf_[read_pos_],
+                         write_pos_ - read_pos_,
+                         spdlog::to_hex(buf_.begin() + static_cast<std::ptrdiff_t>(read_pos_),
+                                        buf_.begin() + static_cast<std::ptrdiff_t>(write_pos_)));
             reset();
         }
         return ok;
     }
 
-    std::vector<std::uint8_t> buf;
+  private:
+    asio::mutable_buffer reserve(std::size_t min_size)
+    {
+        if (buf_.size() - write_pos_ < min_size) {
+            std::size_t pending = write_pos_ - read_pos_;
+            if (read_pos_ > 0) {
+                std::memmove(buf_.data(), buf_.data() + read_pos_, pending);
+                read_pos_ = 0;
+                write_pos_ = pending;
+            }
+            if (buf_.size() - write_pos_ < min_size) {
+                buf_.resize(std::max(buf_.size() * 2, write_pos_ + min_size));
+            }
+        }
+        return asio::buffer(buf_.data() + write_pos_, buf_.size() - write_pos_);
+    }
+
+    static std::size_t body_size(const std::uint8_t* header)
+    {
+        std::uint32_t size = 0;
+        std::memcpy(&size, header + 8, sizeof(size));
+        return ntohl(size);
+    }
+
+    /**
+     * Moves the header and the part of the body, that has been read already, out of the buffer, and returns the rest of the body.
+     */
+    asio::mutable_buffer start_direct_read()
+    {
+        const std::uint8_t* frame = buf_.data() + read_pos_;
+        std::memcpy(direct_header_.data(), frame, header_size);
+        direct_body_.resize(body_size(frame));
+        direct_filled_ = write_pos_ - read_pos_ - header_size;
+        std::memcpy(direct_body_.data(), frame + header_size, direct_filled_);
+        read_pos_ = 0;
+        write_pos_ = 0;
+        direct_ = true;
+        drained();
+        return asio::buffer(direct_body_.data() + direct_filled_, direct_body_.size() - direct_filled_);
+    }
+
+    /**
+     * Updates the high-water mark with the fill of the buffer since the previous drain, and releases the memory of the buffer, if
+     * it is more than twice the mark.
+     */
+    void drained()
+    {
+        high_water_ = std::max(peak_fill_, high_water_ - high_water_ / 8);
+        peak_fill_ = 0;
+        std::size_t keep = std::max(high_water_, default_read_size);
+        if (buf_.size() > 2 * keep) {
+            buf_.resize(keep);
+            buf_.shrink_to_fit();
+        }
+    }
+
+    /**
+     * Decompresses the body of the frame into the message, if it is compressed with snappy. Returns false if the body has to be
+     * used as is.
+     */
+    static bool decompress(mcbp_message& msg, const std::uint8_t* body, std::size_t body_size)
+    {
+        if ((msg.header.datatype & static_cast<uint8_t>(protocol::datatype::snappy)) == 0) {
+            return false;
+        }
+        uint32_t key_size = ntohs(msg.header.keylen);
+        uint32_t prefix_size = uint32_t(msg.header.extlen) + key_size;
+        if (msg.header.magic == static_cast<uint8_t>(protocol::magic::alt_client_response)) {
+            uint8_t framing_extras_size = msg.header.keylen & 0xfU;
+            key_size = (msg.header.keylen & 0xf0U) >> 8U;
+            prefix_size = uint32_t(framing_extras_size) + uint32_t(msg.header.extlen) + key_size;
+        }
+        if (prefix_size > body_size) {
+            return false;
+        }
+        const auto* compressed = reinterpret_cast<const char*>(body + prefix_size);
+        size_t compressed_size = body_size - prefix_size;
+        size_t uncompressed_size = 0;
+        if (!snappy::GetUncompressedLength(compressed, compressed_size, &uncompressed_size)) {
+            return false;
+        }
+        msg.body.resize(prefix_size + uncompressed_size);
+        std::copy(body, body + prefix_size, msg.body.begin());
+        if (!snappy::RawUncompress(compressed, compressed_size, reinterpret_cast<char*>(msg.body.data() + prefix_size))) {
+            return false;
+        }
+        // patch header with new body size
+        msg.header.bodylen = htonl(static_cast<std::uint32_t>(prefix_size + uncompressed_size));
+        return true;
+    }
+
+    std::vector<std::uint8_t> buf_{};
+    std::size_t read_pos_{ 0 };
+    std::size_t write_pos_{ 0 };
+    /** the largest write position since the buffer has been drained last time */
+    std::size_t peak_fill_{ 0 };
+    /** decaying maximum of peak_fill_ over the drains */
+    std::size_t high_water_{ 0 };
+
+    bool direct_{ false };
+    std::array<std::uint8_t, header_size> direct_header_{};
+    std::vector<std::uint8_t> direct_body_{};
+    std::size_t direct_filled_{ 0 };
 };
 } // namespace couchbase::io
@@ -17,6 +17,10 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <mutex>
 #include <utility>
 
 #include <tao/json.hpp>
@@ -25,9 +29,12 @@
 
 #include <platform/uuid.h>
 
+#include <io/buffer_pool.hxx>
+#include <io/mcbp_handler_table.hxx>
 #include <io/mcbp_message.hxx>
 #include <io/mcbp_parser.hxx>
 #include <io/streams.hxx>
+#include <io/write_queue.hxx>
 
 #include <timeout_defaults.hxx>
 
@@ -41,6 +48,7 @@
 #include <protocol/cmd_sasl_step.hxx>
 #include <protocol/cmd_select_bucket.hxx>
 #include <protocol/cmd_get_cluster_config.hxx>
+#include <protocol/cmd_get_collections_manifest.hxx>
 #include <protocol/cmd_get_error_map.hxx>
 #include <protocol/cmd_get.hxx>
 #include <protocol/cmd_cluster_map_change_notification.hxx>
@@ -49,6 +57,10 @@
 
 #include <spdlog/fmt/bin_to_hex.h>
 
+#include <collection_cache.hxx>
+#include <config_store.hxx>
+#include <metrics/snapshot.hxx>
+#include <tracing/threshold_logging_tracer.hxx>
 #include <origin.hxx>
 #include <errors.hxx>
 #include <version.hxx>
@@ -58,35 +70,6 @@ namespace couchbase::io
 
 class mcbp_session : public std::enable_shared_from_this<mcbp_session>
 {
-    class collection_cache
-    {
-      private:
-        std::map<std::string, std::uint32_t> cid_map_{ { "_default._default", 0 } };
-
-      public:
-        [[nodiscard]] std::optional<std::uint32_t> get(const std::string& path)
-        {
-            Expects(!path.empty());
-            auto ptr = cid_map_.find(path);
-            if (ptr != cid_map_.end()) {
-                return ptr->second;
-            }
-            return {};
-        }
-
-        void update(const std::string& path, std::uint32_t id)
-        {
-            Expects(!path.empty());
-            cid_map_[path] = id;
-        }
-
-        void reset()
-        {
-            cid_map_.clear();
-            cid_map_["_default._default"] = 0;
-        }
-    };
-
     class message_handler
     {
       public:
@@ -133,6 +116,7 @@ class mcbp_session : public std::enable_shared_from_this<mcbp_session>
             protocol::client_request<protocol::hello_request_body> hello_req;
             hello_req.opaque(session_->next_opaque());
             hello_req.body().user_agent(tao::json::to_string(user_agent));
+            hello_req.body().enable_unordered_execution(session_->origin_.options().enable_unordered_execution);
             spdlog::debug("{} user_agent={}, requested_features=[{}]",
                           session_->log_prefix_,
                           hello_req.body().user_agent(),
@@ -164,7 +148,7 @@ class mcbp_session : public std::enable_shared_from_this<mcbp_session>
         void auth_success()
         {
             session_->authenticated_ = true;
-            if (session_->supports_feature(protocol::hello_feature::xerror)) {
+            if (session_->negotiated(protocol::hello_feature::xerror) && !session_->errmap_) {
                 protocol::client_request<protocol::get_error_map_request_body> errmap_req;
                 errmap_req.opaque(session_->next_opaque());
                 session_->write(errmap_req.data());
@@ -246,7 +230,7 @@ class mcbp_session : public std::enable_shared_from_this<mcbp_session>
                 case protocol::client_opcode::get_error_map: {
                     protocol::client_response<protocol::get_error_map_response_body> resp(msg);
                     if (resp.status() == protocol::status::success) {
-                        session_->errmap_.emplace(resp.body().errmap());
+                        session_->errmap_ = std::make_shared<const error_map>(resp.body().errmap());
                     } else {
                         spdlog::warn("{} unexpected message status during bootstrap: {} (opcode={})",
                                      session_->log_prefix_,
@@ -313,7 +297,7 @@ class mcbp_session : public std::enable_shared_from_this<mcbp_session>
           : session_(session)
           , heartbeat_timer_(session_->ctx_)
         {
-            if (session_->supports_gcccp_) {
+            if (session_->supports_gcccp()) {
                 fetch_config({});
             }
         }
@@ -343,14 +327,16 @@ class mcbp_session : public std::enable_shared_from_this<mcbp_session>
                             protocol::client_response<protocol::get_cluster_config_response_body> resp(msg);
                             if (resp.status() == protocol::status::success) {
                                 if (session_) {
-                                    session_->update_configuration(resp.body().config());
+                                    session_->update_configuration(resp.body().config_text());
                                 }
                             } else {
                                 spdlog::warn("{} unexpected message status: {}", session_->log_prefix_, resp.error_message());
                             }
                         } break;
                         case protocol::client_opcode::get_collection_id:
+                        case protocol::client_opcode::get_collections_manifest:
                         case protocol::client_opcode::get:
+                        case protocol::client_opcode::get_replica:
                         case protocol::client_opcode::get_and_lock:
                         case protocol::client_opcode::get_and_touch:
                         case protocol::client_opcode::touch:
@@ -366,22 +352,43 @@ class mcbp_session : public std::enable_shared_from_this<mcbp_session>
                         case protocol::client_opcode::subdoc_multi_mutation: {
                             std::uint32_t opaque = msg.header.opaque;
                             std::uint16_t status = ntohs(msg.header.specific);
-                            auto handler = session_->command_handlers_.find(opaque);
-                            if (handler != session_->command_handlers_.end()) {
+                            mcbp_response_handler fun{};
+                            std::chrono::steady_clock::time_point started{};
+                            std::optional<std::chrono::microseconds> server_duration{};
+                            if (session_->tracer_) {
+                                server_duration = tracing::parse_server_duration(msg.body, framing_extras_size(msg));
+                            }
+                            {
+                                std::scoped_lock lock(session_->command_handlers_mutex_);
+                                if (auto* span = session_->tracer_ ? session_->command_handlers_.span(opaque) : nullptr; span != nullptr) {
+                                    span->mark(tracing::point::received);
+                                    if (server_duration) {
+                                        span->server_duration(server_duration.value());
+                                    }
+                                }
+                                started = session_->command_handlers_.started(opaque);
+                                fun = session_->command_handlers_.take(opaque);
+                            }
+                            if (fun) {
+                                session_->latencies_.record(
+                                  msg.header.opcode,
+                                  std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started));
                                 auto ec = session_->map_status_code(opcode, status);
                                 spdlog::debug("{} MCBP invoke operation handler, opaque={}, status={}, ec={}",
                                               session_->log_prefix_,
                                               opaque,
                                               status,
                                               ec.message());
-                                auto fun = handler->second;
-                                session_->command_handlers_.erase(handler);
                                 fun(ec, std::move(msg));
                             } else {
                                 spdlog::debug("{} unexpected orphan response opcode={}, opaque={}",
                                               session_->log_prefix_,
                                               msg.header.opcode,
                                               msg.header.opaque);
+                                if (session_->tracer_) {
+                                    session_->tracer_->report_orphan(
+                                      fmt::format("{}", opcode), opaque, session_->log_prefix_, server_duration);
+                                }
                             }
                         } break;
                         default:
@@ -394,10 +401,10 @@ class mcbp_session : public std::enable_shared_from_this<mcbp_session>
                         case protocol::server_opcode::cluster_map_change_notification: {
                             protocol::server_request<protocol::cluster_map_change_notification_request_body> req(msg);
                             if (session_) {
-                                if ((!req.body().config().bucket.has_value() && req.body().bucket().empty()) ||
-                                    (session_->bucket_name_.has_value() && !req.body().bucket().empty() &&
-                                     session_->bucket_name_.value() == req.body().bucket())) {
-                                    session_->update_configuration(req.body().config());
+                                // the notification without bucket name carries global configuration
+                                if (req.body().bucket().empty() ? !session_->bucket_name_.has_value()
+                                                                : session_->bucket_name_ == req.body().bucket()) {
+                                    session_->update_configuration(req.body().config_text());
                                 }
                             }
                         } break;
@@ -414,15 +421,26 @@ class mcbp_session : public std::enable_shared_from_this<mcbp_session>
             }
         }
 
+        static std::size_t framing_extras_size(const mcbp_message& msg)
+        {
+            if (msg.header.magic == static_cast<std::uint8_t>(protocol::magic::alt_client_response)) {
+                return msg.header_data()[2];
+            }
+            return 0;
+        }
+
         void fetch_config(std::error_code ec)
         {
             if (ec == asio::error::operation_aborted || stopped_ || !session_) {
                 return;
             }
-            protocol::client_request<protocol::get_cluster_config_request_body> req;
-            req.opaque(session_->next_opaque());
-            session_->write_and_flush(req.data());
-            heartbeat_timer_.expires_after(std::chrono::milliseconds(2500));
+            // sessions of the bucket share the configuration, so only one of them polls
+            if (!session_->config_store_ || session_->config_store_->acquire_poller(session_->id_)) {
+                protocol::client_request<protocol::get_cluster_config_request_body> req;
+                req.opaque(session_->next_opaque());
+                session_->write_and_flush(req.data());
+            }
+            heartbeat_timer_.expires_after(session_->origin_.options().config_poll_interval);
             heartbeat_timer_.async_wait(std::bind(&normal_handler::fetch_config, this, std::placeholders::_1));
         }
     };
@@ -442,9 +460,11 @@ class mcbp_session : public std::enable_shared_from_this<mcbp_session>
       , bootstrap_deadline_(ctx_)
       , connection_deadline_(ctx_)
       , retry_backoff_(ctx_)
+      , cork_timer_(ctx_)
       , origin_(origin)
       , bucket_name_(std::move(bucket_name))
       , supported_features_(known_features)
+      , initial_state_{ known_features, true, {} }
     {
         log_prefix_ = fmt::format("[{}/{}/{}/{}]", stream_->log_prefix(), client_id_, id_, bucket_name_.value_or("-"));
     }
@@ -463,9 +483,11 @@ class mcbp_session : public std::enable_shared_from_this<mcbp_session>
       , bootstrap_deadline_(ctx_)
       , connection_deadline_(ctx_)
       , retry_backoff_(ctx_)
+      , cork_timer_(ctx_)
       , origin_(origin)
       , bucket_name_(std::move(bucket_name))
       , supported_features_(known_features)
+      , initial_state_{ known_features, true, {} }
     {
         log_prefix_ = fmt::format("[{}/{}/{}/{}]", stream_->log_prefix(), client_id_, id_, bucket_name_.value_or("-"));
     }
@@ -529,15 +551,82 @@ class mcbp_session : public std::enable_shared_from_this<mcbp_session>
         return id_;
     }
 
+    /**
+     * Makes the session deliver received configurations to the store shared by all sessions of the bucket.
+     *
+     * Must be called before bootstrap.
+     */
+    void attach_config_store(std::shared_ptr<couchbase::config_store> store)
+    {
+        config_store_ = std::move(store);
+    }
+
+    /**
+     * Replaces collection cache of the session with the one shared by all sessions of the bucket.
+     *
+     * Must be called before bootstrap.
+     */
+    void attach_collection_cache(std::shared_ptr<couchbase::collection_cache> cache)
+    {
+        collection_cache_ = std::move(cache);
+    }
+
+    /**
+     * Enables recording of the request stages and reporting of orphaned responses. Must be called before bootstrap.
+     */
+    void attach_tracer(std::shared_ptr<tracing::threshold_logging_tracer> tracer)
+    {
+        tracer_ = std::move(tracer);
+    }
+
+    /**
+     * Reuses error map fetched by another session to the same cluster, so that the session does not request it during bootstrap.
+     *
+     * Must be called before bootstrap.
+     */
+    void attach_error_map(std::shared_ptr<const error_map> errmap)
+    {
+        errmap_ = std::move(errmap);
+    }
+
+    /**
+     * Error map received during bootstrap (or attached), empty when the server does not support extended errors, or the session
+     * has not been bootstrapped yet.
+     */
+    [[nodiscard]] std::shared_ptr<const error_map> errmap() const
+    {
+        return state().errmap;
+    }
+
+    /**
+     * Registers function, which is invoked once the session has stopped: by stop(), because of IO error, or because the bootstrap has
+     * failed. It is called on the thread, which has stopped the session, and should not capture the session itself.
+     *
+     * Must be called before bootstrap.
+     */
+    void on_stop(std::function<void()> handler)
+    {
+        stop_handler_ = std::move(handler);
+    }
+
+    [[nodiscard]] bool is_stopped() const
+    {
+        return stopped_;
+    }
+
     void stop()
     {
         if (stopped_) {
             return;
         }
         stopped_ = true;
+        if (config_store_) {
+            config_store_->release_poller(id_);
+        }
         bootstrap_deadline_.cancel();
         connection_deadline_.cancel();
         retry_backoff_.cancel();
+        cork_timer_.cancel();
         resolver_.cancel();
         if (stream_->is_open()) {
             stream_->close();
@@ -550,11 +639,23 @@ class mcbp_session : public std::enable_shared_from_this<mcbp_session>
         if (handler_) {
             handler_->stop();
         }
-        for (auto& handler : command_handlers_) {
+        std::vector<std::pair<std::uint32_t, mcbp_response_handler>> handlers{};
+        {
+            std::scoped_lock lock(command_handlers_mutex_);
+            handlers = command_handlers_.take_all();
+        }
+        for (auto& handler : handlers) {
             spdlog::debug("{} MCBP cancel operation during session close, opaque={}, ec={}", log_prefix_, handler.first, ec.message());
             handler.second(ec, {});
         }
-        command_handlers_.clear();
+        {
+            std::scoped_lock lock(reserved_writes_mutex_);
+            reserved_writes_.clear();
+            reserved_writes_pending_ = 0;
+        }
+        if (auto stop_handler = std::move(stop_handler_); stop_handler) {
+            stop_handler();
+        }
     }
 
     void write(const std::vector<uint8_t>& buf)
@@ -566,16 +667,108 @@ class mcbp_session : public std::enable_shared_from_this<mcbp_session>
         std::memcpy(&opaque, buf.data() + 12, sizeof(opaque));
         spdlog::debug("{} MCBP send, opaque={}, {:n}", log_prefix_, opaque, spdlog::to_hex(buf.begin(), buf.begin() + 24));
         SPDLOG_TRACE("{} MCBP send, opaque={}{:a}", log_prefix_, opaque, spdlog::to_hex(data));
-        std::scoped_lock lock(output_buffer_mutex_);
-        output_buffer_.push_back(buf);
+        bytes_pending_write_ += buf.size();
+        output_queue_.push(std::vector<std::uint8_t>(buf));
     }
 
+    void write(std::vector<uint8_t>&& buf)
+    {
+        if (stopped_) {
+            return;
+        }
+        std::uint32_t opaque{ 0 };
+        std::memcpy(&opaque, buf.data() + 12, sizeof(opaque));
+        spdlog::debug("{} MCBP send, opaque={}, {:n}", log_prefix_, opaque, spdlog::to_hex(buf.begin(), buf.begin() + 24));
+        bytes_pending_write_ += buf.size();
+        output_queue_.push(std::move(buf));
+    }
+
+    /**
+     * Number of requests waiting for response (including those, which are not written yet).
+     */
+    [[nodiscard]] std::size_t in_flight_requests()
+    {
+        std::scoped_lock lock(command_handlers_mutex_);
+        return command_handlers_.size();
+    }
+
+    [[nodiscard]] std::size_t ordered_documents()
+    {
+        std::scoped_lock lock(command_handlers_mutex_);
+        return command_handlers_.ordered_documents();
+    }
+
+    /**
+     * Number of bytes queued for the socket, but not yet written.
+     */
+    [[nodiscard]] std::size_t bytes_pending_write() const
+    {
+        return bytes_pending_write_;
+    }
+
+    /**
+     * Returns true when the session has reached the limit of in-flight requests or queued bytes, so that new requests should be sent
+     * to other connection, or wait.
+     */
+    [[nodiscard]] bool is_congested()
+    {
+        const auto& options = origin_.options();
+        return (options.kv_max_in_flight_requests > 0 && in_flight_requests() >= options.kv_max_in_flight_requests) ||
+               (options.kv_max_queued_bytes > 0 && bytes_pending_write() >= options.kv_max_queued_bytes);
+    }
+
+    /**
+     * Counts the request, which has not been sent to the session, because it was congested.
+     */
+    void record_backpressure()
+    {
+        backpressure_events_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * Snapshot of the queues and latencies of the session. The node is not filled, as the session only knows the bootstrap address.
+     */
+    [[nodiscard]] metrics::kv_session_metrics metrics()
+    {
+        metrics::kv_session_metrics result{};
+        result.session_id = id_;
+        result.in_flight = in_flight_requests();
+        result.write_queue_bytes = bytes_pending_write();
+        result.backpressure_events = backpressure_events_.load(std::memory_order_relaxed);
+        result.socket_writes = socket_writes_.load(std::memory_order_relaxed);
+        result.frames_written = frames_written_.load(std::memory_order_relaxed);
+        result.ordering_barriers = ordering_barriers_.load(std::memory_order_relaxed);
+        result.ordered_documents = ordered_documents();
+        result.buffers_allocated = buffer_pool_.allocated();
+        result.buffers_reused = buffer_pool_.reused();
+        latencies_.visit([&result](std::size_t opcode, const metrics::histogram_snapshot& snapshot) {
+            result.latencies.emplace(fmt::format("{}", static_cast<protocol::client_opcode>(opcode)), snapshot);
+        });
+        return result;
+    }
+
+    /**
+     * Returns buffer for encoding of the request. The buffer goes back to the pool once it has been written to the socket.
+     */
+    [[nodiscard]] std::vector<std::uint8_t> acquire_buffer()
+    {
+        return buffer_pool_.acquire();
+    }
+
+    [[nodiscard]] const buffer_pool& buffers() const
+    {
+        return buffer_pool_;
+    }
+
+    /**
+     * Might be called from any thread, the socket is only touched from the thread of the session's context.
+     */
     void flush()
     {
         if (stopped_) {
             return;
         }
-        do_write();
+        asio::dispatch(ctx_, [self = shared_from_this()]() { self->do_write(); });
     }
 
     void write_and_flush(const std::vector<uint8_t>& buf)
@@ -587,22 +780,131 @@ class mcbp_session : public std::enable_shared_from_this<mcbp_session>
         flush();
     }
 
+    /**
+     * When flush_now is false, the caller is responsible for calling flush() after it has written all the requests.
+     */
     void write_and_subscribe(uint32_t opaque,
-                             std::vector<std::uint8_t>& data,
-                             std::function<void(std::error_code, io::mcbp_message&&)> handler)
+                             std::vector<std::uint8_t>&& data,
+                             mcbp_response_handler handler,
+                             bool flush_now = true,
+                             std::shared_ptr<tracing::request_span> span = {},
+                             request_ordering ordering = {})
     {
         if (stopped_) {
             spdlog::warn("{} MCBP cancel operation, while trying to write to closed session opaque={}", log_prefix_, opaque);
             handler(std::make_error_code(error::common_errc::request_canceled), {});
             return;
         }
-        command_handlers_.emplace(opaque, std::move(handler));
-        if (bootstrapped_ && stream_->is_open()) {
-            write_and_flush(data);
-        } else {
+        {
+            std::scoped_lock lock(command_handlers_mutex_);
+            command_handlers_.insert(opaque, std::move(handler), span, ordering);
+        }
+        if (reserved_writes_pending_.load(std::memory_order_acquire) > 0) {
+            std::scoped_lock lock(reserved_writes_mutex_);
+            if (!reserved_writes_.empty()) {
+                // a frame issued earlier is still being encoded, this one has to wait for it
+                reserved_writes_.push_back({ opaque, true, std::move(data), std::move(span) });
+                return;
+            }
+        }
+        enqueue(std::move(data), span.get(), flush_now);
+    }
+
+    /**
+     * Takes the place of the request in the session (opaque, response handler and ordering entry), when its frame is encoded off the
+     * I/O thread (e.g. large value is being compressed). Frames of the requests issued later are held back until complete_write()
+     * delivers this one, so that the session writes the requests in the order they have been issued.
+     */
+    void reserve_write(uint32_t opaque,
+                       mcbp_response_handler handler,
+                       std::shared_ptr<tracing::request_span> span = {},
+                       request_ordering ordering = {})
+    {
+        if (stopped_) {
+            handler(std::make_error_code(error::common_errc::request_canceled), {});
+            return;
+        }
+        {
+            std::scoped_lock lock(command_handlers_mutex_);
+            command_handlers_.insert(opaque, std::move(handler), span, ordering);
+        }
+        std::scoped_lock lock(reserved_writes_mutex_);
+        reserved_writes_.push_back({ opaque, false, {}, std::move(span) });
+        reserved_writes_pending_.fetch_add(1, std::memory_order_release);
+    }
+
+    /**
+     * Delivers the frame for the place reserved with reserve_write() and writes all frames, which have been waiting for it. Empty
+     * frame releases the place without writing anything (the request has been cancelled meanwhile).
+     */
+    void complete_write(uint32_t opaque, std::vector<std::uint8_t>&& data)
+    {
+        {
+            // the frames are queued under the lock, so that concurrent write_and_subscribe() cannot get in front of them
+            std::scoped_lock lock(reserved_writes_mutex_);
+            auto it = std::find_if(reserved_writes_.begin(), reserved_writes_.end(), [opaque](const auto& entry) {
+                return !entry.ready && entry.opaque == opaque;
+            });
+            if (it == reserved_writes_.end()) {
+                return;
+            }
+            it->ready = true;
+            it->data = std::move(data);
+            if (!reserved_writes_.front().ready) {
+                return;
+            }
+            while (!reserved_writes_.empty() && reserved_writes_.front().ready) {
+                auto& entry = reserved_writes_.front();
+                if (!entry.data.empty()) {
+                    enqueue(std::move(entry.data), entry.span.get(), false);
+                }
+                reserved_writes_.pop_front();
+            }
+            reserved_writes_pending_.store(reserved_writes_.size(), std::memory_order_release);
+        }
+        flush();
+    }
+
+    /**
+     * Writes the frame, or keeps it in the pending buffer until the session is bootstrapped.
+     */
+    void enqueue(std::vector<std::uint8_t>&& data, tracing::request_span* traced, bool flush_now)
+    {
+        {
             std::scoped_lock lock(pending_buffer_mutex_);
-            pending_buffer_.push_back(data);
+            if (!bootstrapped_ || !stream_->is_open()) {
+                bytes_pending_write_ += data.size();
+                pending_buffer_.emplace_back(std::move(data));
+                return;
+            }
+        }
+        if (traced != nullptr) {
+            traced->mark(tracing::point::queued);
+        }
+        write(std::move(data));
+        if (flush_now) {
+            flush();
+        }
+    }
+
+    /**
+     * Returns true if the request has to be sent with barrier, because the server might execute it before the in-flight requests for
+     * the same document otherwise. Without unordered execution the server keeps the order anyway.
+     */
+    [[nodiscard]] bool requires_barrier(const request_ordering& ordering)
+    {
+        if (ordering.type == request_ordering::kind::none || !supports_feature(protocol::hello_feature::unordered_execution)) {
+            return false;
+        }
+        bool required = false;
+        {
+            std::scoped_lock lock(command_handlers_mutex_);
+            required = command_handlers_.requires_barrier(ordering);
+        }
+        if (required) {
+            ordering_barriers_.fetch_add(1, std::memory_order_relaxed);
         }
+        return required;
     }
 
     void cancel(uint32_t opaque, std::error_code ec)
@@ -610,41 +912,66 @@ class mcbp_session : public std::enable_shared_from_this<mcbp_session>
         if (stopped_) {
             return;
         }
-        auto handler = command_handlers_.find(opaque);
-        if (handler != command_handlers_.end()) {
-            spdlog::debug("{} MCBP cancel operation, opaque={}, ec={}", log_prefix_, opaque, ec.message());
-            handler->second(ec, {});
-            command_handlers_.erase(handler);
+        mcbp_response_handler fun{};
+        {
+            std::scoped_lock lock(command_handlers_mutex_);
+            fun = command_handlers_.take(opaque);
+        }
+        if (!fun) {
+            return;
         }
+        spdlog::debug("{} MCBP cancel operation, opaque={}, ec={}", log_prefix_, opaque, ec.message());
+        fun(ec, {});
     }
 
-    [[nodiscard]] bool supports_feature(protocol::hello_feature feature)
+    [[nodiscard]] asio::io_context& context()
     {
-        return std::find(supported_features_.begin(), supported_features_.end(), feature) != supported_features_.end();
+        return ctx_;
+    }
+
+    /**
+     * True once the session has published the features negotiated during bootstrap. Until then the features are the ones known
+     * from another session (see constructor), and the bucket does not send commands to the session.
+     */
+    [[nodiscard]] bool is_bootstrapped() const
+    {
+        return state_.load(std::memory_order_acquire) == &negotiated_state_;
+    }
+
+    /**
+     * Might be called from any thread, the negotiated features never change after they have been published.
+     */
+    [[nodiscard]] bool supports_feature(protocol::hello_feature feature) const
+    {
+        const auto& features = state().supported_features;
+        return std::find(features.begin(), features.end(), feature) != features.end();
     }
 
     [[nodiscard]] std::vector<protocol::hello_feature> supported_features() const
     {
-        return supported_features_;
+        return state().supported_features;
     }
 
-    [[nodiscard]] bool supports_gcccp()
+    [[nodiscard]] bool supports_gcccp() const
     {
-        return supports_gcccp_;
+        return state().supports_gcccp;
     }
 
     [[nodiscard]] bool has_config() const
     {
+        std::scoped_lock lock(config_mutex_);
         return config_.has_value();
     }
 
     [[nodiscard]] configuration config() const
     {
+        std::scoped_lock lock(config_mutex_);
         return config_.value();
     }
 
     [[nodiscard]] size_t index() const
     {
+        std::scoped_lock lock(config_mutex_);
         Expects(config_.has_value());
         return config_->index_for_this_node();
     }
@@ -775,8 +1102,11 @@ class mcbp_session : public std::enable_shared_from_this<mcbp_session>
             case protocol::status::subdoc_xattr_cannot_modify_vattr:
                 return std::make_error_code(error::key_value_errc::xattr_cannot_modify_virtual_attribute);
 
-            case protocol::status::subdoc_invalid_xattr_order:
             case protocol::status::not_my_vbucket:
+                // normally the command redispatches the request using configuration from the response body
+                return std::make_error_code(error::common_errc::request_canceled);
+
+            case protocol::status::subdoc_invalid_xattr_order:
             case protocol::status::auth_continue:
             case protocol::status::range_error:
             case protocol::status::rollback:
@@ -803,27 +1133,170 @@ class mcbp_session : public std::enable_shared_from_this<mcbp_session>
                     node.hostname = endpoint_address_;
                 }
             }
-            config_.emplace(config);
+            {
+                std::scoped_lock lock(config_mutex_);
+                config_.emplace(config);
+            }
             spdlog::debug("{} received new configuration: {}", log_prefix_, config_.value());
+            if (config_store_) {
+                config_store_->update(configuration(config_.value()));
+            }
+        }
+    }
+
+    /**
+     * Applies configuration received from the node as JSON text.
+     *
+     * When the session belongs to the bucket, the text goes to the configuration store, which parses it once for all sessions.
+     * Otherwise the revision is checked before parsing, so that repeated configurations are not parsed at all.
+     */
+    void update_configuration(const std::string& text)
+    {
+        if (stopped_) {
+            return;
+        }
+        if (config_store_) {
+            config_store_->update(text, endpoint_address_);
+            return;
+        }
+        if (auto rev = couchbase::config_store::peek_revision(text); rev && config_ && rev.value() <= config_->rev) {
+            return;
+        }
+        try {
+            update_configuration(tao::json::from_string<protocol::deduplicate_keys>(text).as<configuration>());
+        } catch (const std::exception& e) {
+            spdlog::warn("{} unable to parse configuration: {}", log_prefix_, e.what());
+        }
+    }
+
+    /**
+     * Extracts configuration carried in the body of not_my_vbucket response.
+     *
+     * Does not modify the session, so it is safe to call from the context of the command. The configuration is not parsed, when
+     * the store of the bucket knows its revision already.
+     */
+    [[nodiscard]] std::optional<configuration> parse_not_my_vbucket_config(const io::mcbp_message& msg) const
+    {
+        auto header = msg.header_data();
+        std::size_t offset = header[4];
+        if (header[0] == static_cast<std::uint8_t>(protocol::magic::alt_client_response)) {
+            offset += static_cast<std::size_t>(header[2]) + header[3];
+        } else {
+            offset += (static_cast<std::size_t>(header[2]) << 8U) | header[3];
+        }
+        if (offset >= msg.body.size()) {
+            return {};
+        }
+        std::string text(msg.body.begin() + static_cast<std::ptrdiff_t>(offset), msg.body.end());
+        if (auto rev = couchbase::config_store::peek_revision(text); rev && config_store_ && !config_store_->is_newer(rev.value())) {
+            return {};
+        }
+        try {
+            auto config = tao::json::from_string<protocol::deduplicate_keys>(text).as<configuration>();
+            for (auto& node : config.nodes) {
+                if (node.this_node && node.hostname.empty()) {
+                    node.hostname = endpoint_address_;
+                }
+            }
+            return config;
+        } catch (const std::exception& e) {
+            spdlog::debug("{} unable to parse configuration from not_my_vbucket response: {}", log_prefix_, e.what());
         }
+        return {};
     }
 
     std::optional<std::uint32_t> get_collection_uid(const std::string& collection_path)
     {
-        return collection_cache_.get(collection_path);
+        return collection_cache_->get(collection_path);
     }
 
-    void update_collection_uid(const std::string& path, std::uint32_t uid)
+    /**
+     * Caches collection id resolved by get_collection_id. When the node reports newer manifest, than the cache has, the whole
+     * manifest is fetched again.
+     */
+    void update_collection_uid(const std::string& path, std::uint32_t uid, std::uint64_t manifest_uid)
     {
         if (stopped_) {
             return;
         }
-        collection_cache_.update(path, uid);
+        collection_cache_->update(path, uid);
+        if (collection_cache_->is_outdated(manifest_uid)) {
+            refresh_collections_manifest();
+        }
+    }
+
+    /**
+     * Fills the collection cache from the collections manifest of the bucket. Only one session of the bucket fetches the manifest
+     * at a time.
+     */
+    void refresh_collections_manifest()
+    {
+        if (stopped_ || !bucket_name_ || !supports_feature(protocol::hello_feature::collections) || !collection_cache_->begin_refresh()) {
+            return;
+        }
+        protocol::client_request<protocol::get_collections_manifest_request_body> req;
+        req.opaque(next_opaque());
+        write_and_subscribe(req.opaque(), std::move(req.data()), [self = shared_from_this()](std::error_code ec, io::mcbp_message&& msg) {
+            if (!ec) {
+                try {
+                    protocol::client_response<protocol::get_collections_manifest_response_body> resp(msg);
+                    auto manifest = resp.body().manifest();
+                    if (self->collection_cache_->update(manifest)) {
+                        spdlog::debug("{} collection cache updated from manifest: {}", self->log_prefix_, manifest);
+                    }
+                } catch (const std::exception& e) {
+                    spdlog::warn("{} unable to parse collections manifest: {}", self->log_prefix_, e.what());
+                }
+            } else {
+                spdlog::debug("{} unable to fetch collections manifest: {}", self->log_prefix_, ec.message());
+            }
+            self->collection_cache_->end_refresh();
+        });
     }
 
   private:
+    /**
+     * State of the HELLO negotiation, which is shared with other threads once the session has been bootstrapped.
+     */
+    struct negotiated_state {
+        std::vector<protocol::hello_feature> supported_features{};
+        bool supports_gcccp{ true };
+        std::shared_ptr<const error_map> errmap{};
+    };
+
+    [[nodiscard]] const negotiated_state& state() const
+    {
+        return *state_.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Checks the features received in HELLO, while the session is still bootstrapping on its own context.
+     */
+    [[nodiscard]] bool negotiated(protocol::hello_feature feature) const
+    {
+        return std::find(supported_features_.begin(), supported_features_.end(), feature) != supported_features_.end();
+    }
+
+    /**
+     * Publishes the result of bootstrap. Called once on the context of the session, before the bootstrap handler notifies the
+     * bucket, so that the commands dispatched to the session see the complete state.
+     */
+    void publish_negotiated_state()
+    {
+        if (is_bootstrapped()) {
+            return;
+        }
+        negotiated_state_.supported_features = supported_features_;
+        negotiated_state_.supports_gcccp = supports_gcccp_;
+        negotiated_state_.errmap = errmap_;
+        state_.store(&negotiated_state_, std::memory_order_release);
+    }
+
     void invoke_bootstrap_handler(std::error_code ec)
     {
+        if (!ec) {
+            publish_negotiated_state();
+        }
         if (!bootstrapped_ && bootstrap_handler_) {
             bootstrap_deadline_.cancel();
             bootstrap_handler_(ec, config_.value_or(configuration{}));
@@ -832,18 +1305,53 @@ class mcbp_session : public std::enable_shared_from_this<mcbp_session>
         if (ec) {
             return stop();
         }
-        bootstrapped_ = true;
         handler_ = std::make_unique<normal_handler>(shared_from_this());
         std::scoped_lock lock(pending_buffer_mutex_);
+        bootstrapped_ = true;
         if (!pending_buffer_.empty()) {
-            for (const auto& buf : pending_buffer_) {
-                write(buf);
+            if (tracer_) {
+                trace_requests(pending_buffer_, tracing::point::queued);
+            }
+            for (auto& buf : pending_buffer_) {
+                bytes_pending_write_ -= buf.size();
+                write(std::move(buf));
             }
             pending_buffer_.clear();
             flush();
         }
     }
 
+    /**
+     * Records the stage for the traced requests in the buffers, every buffer is the encoded request with the opaque in the header.
+     */
+    void trace_requests(const std::vector<std::vector<std::uint8_t>>& buffers, tracing::point stage)
+    {
+        std::scoped_lock lock(command_handlers_mutex_);
+        for (const auto& buf : buffers) {
+            if (buf.size() < protocol::header_size) {
+                continue;
+            }
+            std::uint32_t opaque = 0;
+            std::memcpy(&opaque, buf.data() + 12, sizeof(opaque));
+            if (auto* span = command_handlers_.span(opaque); span != nullptr) {
+                span->mark(stage);
+            }
+        }
+    }
+
+    /**
+     * Records the stage for the traced requests with the given opaques.
+     */
+    void trace_requests(const std::vector<std::uint32_t>& opaques, tracing::point stage)
+    {
+        std::scoped_lock lock(command_handlers_mutex_);
+        for (auto opaque : opaques) {
+            if (auto* span = command_handlers_.span(opaque); span != nullptr) {
+                span->mark(stage);
+            }
+        }
+    }
+
     void on_resolve(std::error_code ec, const asio::ip::tcp::resolver::results_type& endpoints)
     {
         if (stopped_) {
@@ -884,7 +1392,7 @@ class mcbp_session : public std::enable_shared_from_this<mcbp_session>
               "{} unable to connect to {}:{}: {}", log_prefix_, it->endpoint().address().to_string(), it->endpoint().port(), ec.message());
             do_connect(++it);
         } else {
-            stream_->set_options();
+            stream_->set_options(origin_.options().socket_receive_buffer_size);
             endpoint_ = it->endpoint();
             endpoint_address_ = endpoint_.address().to_string();
             spdlog::debug("{} connected to {}:{}", log_prefix_, endpoint_address_, it->endpoint().port());
@@ -918,7 +1426,7 @@ class mcbp_session : public std::enable_shared_from_this<mcbp_session>
         }
         reading_ = true;
         stream_->async_read_some(
-          asio::buffer(input_buffer_), [self = shared_from_this()](std::error_code ec, std::size_t bytes_transferred) {
+          parser_.prepare(), [self = shared_from_this()](std::error_code ec, std::size_t bytes_transferred) {
               if (ec == asio::error::operation_aborted || self->stopped_) {
                   return;
               }
@@ -926,7 +1434,7 @@ class mcbp_session : public std::enable_shared_from_this<mcbp_session>
                   spdlog::error("{} IO error while reading from the socket: {}", self->log_prefix_, ec.message());
                   return self->stop();
               }
-              self->parser_.feed(self->input_buffer_.data(), self->input_buffer_.data() + ssize_t(bytes_transferred));
+              self->parser_.commit(bytes_transferred);
 
               for (;;) {
                   mcbp_message msg{};
@@ -957,34 +1465,84 @@ class mcbp_session : public std::enable_shared_from_this<mcbp_session>
           });
     }
 
+    /**
+     * Starts writing of the queued frames unless the socket is busy. With kv_write_cork_delay the session waits a little for more
+     * frames before writing to the idle socket, unless a full chunk is already queued.
+     */
     void do_write()
     {
-        if (stopped_) {
+        if (stopped_ || writing_) {
+            return;
+        }
+        const auto& options = origin_.options();
+        if (options.kv_write_cork_delay.count() > 0) {
+            std::size_t threshold = options.kv_write_chunk_size > 0 ? options.kv_write_chunk_size : 16384;
+            if (bytes_pending_write_ < threshold) {
+                if (!corked_ && !output_queue_.empty()) {
+                    corked_ = true;
+                    cork_timer_.expires_after(options.kv_write_cork_delay);
+                    cork_timer_.async_wait([self = shared_from_this()](std::error_code ec) {
+                        if (ec == asio::error::operation_aborted || self->stopped_) {
+                            return;
+                        }
+                        self->corked_ = false;
+                        self->write_queued();
+                    });
+                }
+                return;
+            }
+            if (corked_) {
+                corked_ = false;
+                cork_timer_.cancel();
+            }
+        }
+        write_queued();
+    }
+
+    /**
+     * Takes everything from the output queue and writes it to the socket with single call. Must only be called on the context of the
+     * session.
+     */
+    void write_queued()
+    {
+        if (stopped_ || writing_) {
             return;
         }
-        std::scoped_lock lock(writing_buffer_mutex_, output_buffer_mutex_);
-        if (!writing_buffer_.empty() || output_buffer_.empty()) {
+        taken_frames_.clear();
+        output_queue_.take_all(taken_frames_);
+        if (taken_frames_.empty()) {
             return;
         }
-        std::swap(writing_buffer_, output_buffer_);
-        std::vector<asio::const_buffer> buffers;
-        buffers.reserve(writing_buffer_.size());
-        for (auto& buf : writing_buffer_) {
-            buffers.emplace_back(asio::buffer(buf));
+        const auto chunk_size = origin_.options().kv_write_chunk_size;
+        for (auto& frame : taken_frames_) {
+            if (tracer_ && frame.size() >= protocol::header_size) {
+                std::uint32_t opaque = 0;
+                std::memcpy(&opaque, frame.data() + 12, sizeof(opaque));
+                writing_opaques_.push_back(opaque);
+            }
+            writing_batch_.add(std::move(frame), chunk_size, buffer_pool_);
         }
-        stream_->async_write(buffers, [self = shared_from_this()](std::error_code ec, std::size_t /*unused*/) {
+        taken_frames_.clear();
+        writing_ = true;
+        socket_writes_.fetch_add(1, std::memory_order_relaxed);
+        frames_written_.fetch_add(writing_batch_.frames(), std::memory_order_relaxed);
+        stream_->async_write(writing_batch_.buffers(), [self = shared_from_this()](std::error_code ec, std::size_t bytes_transferred) {
             if (ec == asio::error::operation_aborted || self->stopped_) {
                 return;
             }
+            self->bytes_pending_write_ -= bytes_transferred;
             if (ec) {
                 spdlog::error("{} IO error while writing to the socket: {}", self->log_prefix_, ec.message());
                 return self->stop();
             }
-            {
-                std::scoped_lock inner_lock(self->writing_buffer_mutex_);
-                self->writing_buffer_.clear();
+            if (!self->writing_opaques_.empty()) {
+                self->trace_requests(self->writing_opaques_, tracing::point::written);
+                self->writing_opaques_.clear();
             }
-            self->do_write();
+            self->writing_batch_.release(self->buffer_pool_);
+            self->writing_ = false;
+            /* the frames queued during the write are sent right away, the batching has already happened */
+            self->write_queued();
             self->do_read();
         });
     }
@@ -997,14 +1555,16 @@ class mcbp_session : public std::enable_shared_from_this<mcbp_session>
     asio::steady_timer bootstrap_deadline_;
     asio::steady_timer connection_deadline_;
     asio::steady_timer retry_backoff_;
+    asio::steady_timer cork_timer_;
     couchbase::origin origin_;
     std::optional<std::string> bucket_name_;
     mcbp_parser parser_;
     std::unique_ptr<message_handler> handler_;
     std::function<void(std::error_code, const configuration&)> bootstrap_handler_{};
-    std::map<uint32_t, std::function<void(std::error_code, io::mcbp_message&&)>> command_handlers_{};
+    mcbp_handler_table command_handlers_{};
+    std::mutex command_handlers_mutex_{};
 
-    bool bootstrapped_{ false };
+    std::atomic_bool bootstrapped_{ false };
     std::atomic_bool stopped_{ false };
     bool authenticated_{ false };
     bool bucket_selected_{ false };
@@ -1012,23 +1572,54 @@ class mcbp_session : public std::enable_shared_from_this<mcbp_session>
 
     std::atomic<std::uint32_t> opaque_{ 0 };
 
-    std::array<std::uint8_t, 16384> input_buffer_{};
-    std::vector<std::vector<std::uint8_t>> output_buffer_{};
+    write_queue output_queue_{};
     std::vector<std::vector<std::uint8_t>> pending_buffer_{};
-    std::vector<std::vector<std::uint8_t>> writing_buffer_{};
-    std::mutex output_buffer_mutex_{};
     std::mutex pending_buffer_mutex_{};
-    std::mutex writing_buffer_mutex_{};
+
+    struct reserved_write {
+        std::uint32_t opaque{ 0 };
+        bool ready{ false };
+        std::vector<std::uint8_t> data{};
+        std::shared_ptr<tracing::request_span> span{};
+    };
+    /** not empty only while some frame is encoded off the I/O thread, see reserve_write() */
+    std::deque<reserved_write> reserved_writes_{};
+    std::mutex reserved_writes_mutex_{};
+    /** size of reserved_writes_, so that writes do not take the lock when nothing is reserved */
+    std::atomic<std::size_t> reserved_writes_pending_{ 0 };
+    /** owned by the context of the session */
+    std::vector<std::vector<std::uint8_t>> taken_frames_{};
+    write_batch writing_batch_{};
+    std::vector<std::uint32_t> writing_opaques_{};
+    bool writing_{ false };
+    bool corked_{ false };
+    std::atomic<std::uint64_t> socket_writes_{ 0 };
+    std::atomic<std::uint64_t> frames_written_{ 0 };
+    std::atomic<std::uint64_t> ordering_barriers_{ 0 };
+    buffer_pool buffer_pool_{};
+    std::atomic<std::size_t> bytes_pending_write_{ 0 };
     asio::ip::tcp::endpoint endpoint_{}; // connected endpoint
     std::string endpoint_address_{};     // cached string with endpoint address
     asio::ip::tcp::resolver::results_type endpoints_;
+    /** written only on the context of the session during bootstrap, other threads use the published state */
     std::vector<protocol::hello_feature> supported_features_;
+    negotiated_state initial_state_;
+    negotiated_state negotiated_state_{};
+    std::atomic<const negotiated_state*> state_{ &initial_state_ };
+    /** written only on the context of the session, the lock protects readers on other threads */
     std::optional<configuration> config_;
-    std::optional<error_map> errmap_;
-    collection_cache collection_cache_;
+    mutable std::mutex config_mutex_{};
+    std::shared_ptr<couchbase::config_store> config_store_{};
+    std::shared_ptr<const error_map> errmap_{};
+    std::shared_ptr<couchbase::collection_cache> collection_cache_{ std::make_shared<couchbase::collection_cache>() };
+    std::shared_ptr<tracing::threshold_logging_tracer> tracer_{};
+    metrics::latency_histogram_set<256> latencies_{};
+    std::atomic<std::uint64_t> backpressure_events_{ 0 };
 
     std::atomic_bool reading_{ false };
 
+    std::function<void()> stop_handler_{};
+
     std::string log_prefix_{};
 };
 } // namespace couchbase::io
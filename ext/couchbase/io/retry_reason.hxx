@@ -0,0 +1,86 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include <spdlog/spdlog.h>
+
+namespace couchbase::io
+{
+
+enum class retry_reason : std::uint8_t {
+    /// the node does not own the partition anymore, usually during rebalance
+    not_my_vbucket,
+
+    /// the collection identifier was not known, or has been changed on the server
+    unknown_collection,
+
+    /// all connections to the node have reached the limit of in-flight requests or queued bytes
+    kv_backpressure,
+};
+
+constexpr std::array<retry_reason, 3> retry_reasons{ retry_reason::not_my_vbucket,
+                                                     retry_reason::unknown_collection,
+                                                     retry_reason::kv_backpressure };
+
+/**
+ * Number of KV requests retried by the client, for every reason. Shared by the bucket with its commands, updated from any thread.
+ */
+class retry_counters
+{
+  public:
+    void record(retry_reason reason)
+    {
+        counters_[static_cast<std::size_t>(reason)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] std::uint64_t count(retry_reason reason) const
+    {
+        return counters_[static_cast<std::size_t>(reason)].load(std::memory_order_relaxed);
+    }
+
+  private:
+    std::array<std::atomic_uint64_t, retry_reasons.size()> counters_{};
+};
+
+} // namespace couchbase::io
+
+template<>
+struct fmt::formatter<couchbase::io::retry_reason> : formatter<string_view> {
+    template<typename FormatContext>
+    auto format(couchbase::io::retry_reason reason, FormatContext& ctx)
+    {
+        string_view name = "unknown";
+        switch (reason) {
+            case couchbase::io::retry_reason::not_my_vbucket:
+                name = "not_my_vbucket";
+                break;
+            case couchbase::io::retry_reason::unknown_collection:
+                name = "unknown_collection";
+                break;
+            case couchbase::io::retry_reason::kv_backpressure:
+                name = "kv_backpressure";
+                break;
+        }
+        return formatter<string_view>::format(name, ctx);
+    }
+};
@@ -17,11 +17,16 @@
 
 #pragma once
 
+#include <chrono>
 #include <functional>
 
 #include <asio.hpp>
 #include <asio/ssl.hpp>
 
+#include <spdlog/spdlog.h>
+
+#include <io/tls_session_cache.hxx>
+
 namespace couchbase::io
 {
 
@@ -49,7 +54,10 @@ class stream_impl
 
     virtual void close() = 0;
 
-    virtual void set_options() = 0;
+    /**
+     * Sets the options of the connected socket. The receive buffer size of 0 keeps the size chosen by the operating system.
+     */
+    virtual void set_options(std::size_t receive_buffer_size) = 0;
 
     virtual void async_connect(const asio::ip::tcp::resolver::results_type::endpoint_type& endpoint,
                                std::function<void(std::error_code)>&& handler) = 0;
@@ -57,6 +65,20 @@ class stream_impl
     virtual void async_write(std::vector<asio::const_buffer>& buffers, std::function<void(std::error_code, std::size_t)>&& handler) = 0;
 
     virtual void async_read_some(asio::mutable_buffer buffer, std::function<void(std::error_code, std::size_t)>&& handler) = 0;
+
+  protected:
+    template<typename Socket>
+    void set_receive_buffer_size(Socket& socket, std::size_t size)
+    {
+        if (size == 0) {
+            return;
+        }
+        std::error_code ec;
+        socket.set_option(asio::socket_base::receive_buffer_size{ static_cast<int>(size) }, ec);
+        if (ec) {
+            spdlog::warn("{} unable to set receive buffer size to {} bytes: {}", log_prefix(), size, ec.message());
+        }
+    }
 };
 
 class plain_stream_impl : public stream_impl
@@ -81,10 +103,11 @@ class plain_stream_impl : public stream_impl
         stream_.close();
     }
 
-    void set_options() override
+    void set_options(std::size_t receive_buffer_size) override
     {
         stream_.set_option(asio::ip::tcp::no_delay{ true });
         stream_.set_option(asio::socket_base::keep_alive{ true });
+        set_receive_buffer_size(stream_, receive_buffer_size);
     }
 
     void async_connect(const asio::ip::tcp::resolver::results_type::endpoint_type& endpoint,
@@ -108,11 +131,14 @@ class tls_stream_impl : public stream_impl
 {
   private:
     asio::ssl::stream<asio::ip::tcp::socket> stream_;
+    std::shared_ptr<tls_session_cache> session_cache_;
+    tls_session_cache::binding binding_{};
 
   public:
     tls_stream_impl(asio::io_context& ctx, asio::ssl::context& tls)
       : stream_impl(ctx, true)
       , stream_(ctx, tls)
+      , session_cache_(tls_session_cache::from(tls.native_handle()))
     {
     }
 
@@ -126,26 +152,35 @@ class tls_stream_impl : public stream_impl
         stream_.lowest_layer().close();
     }
 
-    void set_options() override
+    void set_options(std::size_t receive_buffer_size) override
     {
         stream_.lowest_layer().set_option(asio::ip::tcp::no_delay{ true });
         stream_.lowest_layer().set_option(asio::socket_base::keep_alive{ true });
+        set_receive_buffer_size(stream_.lowest_layer(), receive_buffer_size);
     }
 
     void async_connect(const asio::ip::tcp::resolver::results_type::endpoint_type& endpoint,
                        std::function<void(std::error_code)>&& handler) override
     {
-        return stream_.lowest_layer().async_connect(endpoint, [this, handler](std::error_code ec_connect) mutable {
+        return stream_.lowest_layer().async_connect(endpoint, [this, endpoint, handler](std::error_code ec_connect) mutable {
             if (ec_connect == asio::error::operation_aborted) {
                 return;
             }
             if (ec_connect) {
                 return handler(ec_connect);
             }
-            stream_.async_handshake(asio::ssl::stream_base::client, [handler](std::error_code ec_handshake) mutable {
+            if (session_cache_) {
+                session_cache_->prepare(
+                  stream_.native_handle(), binding_, fmt::format("{}:{}", endpoint.address().to_string(), endpoint.port()));
+            }
+            auto start = std::chrono::steady_clock::now();
+            stream_.async_handshake(asio::ssl::stream_base::client, [this, handler, start](std::error_code ec_handshake) mutable {
                 if (ec_handshake == asio::error::operation_aborted) {
                     return;
                 }
+                if (session_cache_) {
+                    session_cache_->record_handshake(stream_.native_handle(), std::chrono::steady_clock::now() - start, ec_handshake);
+                }
                 return handler(ec_handshake);
             });
         });
@@ -0,0 +1,197 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+
+#include <openssl/ssl.h>
+
+namespace couchbase::io
+{
+
+/**
+ * TLS sessions of the nodes, so that reconnecting KV and HTTP sessions resume the TLS session instead of doing full handshake.
+ *
+ * The cache is attached to the SSL context shared by the cluster, and every TLS stream binds its connection to the endpoint before
+ * the handshake. OpenSSL reports new sessions through the callback, including TLS 1.3 tickets, which arrive after the handshake.
+ */
+class tls_session_cache : public std::enable_shared_from_this<tls_session_cache>
+{
+  public:
+    struct stats {
+        std::uint64_t handshakes{ 0 };
+        /** handshakes, which have resumed cached session */
+        std::uint64_t resumed{ 0 };
+        std::uint64_t failures{ 0 };
+        std::uint64_t total_duration_us{ 0 };
+        std::uint64_t max_duration_us{ 0 };
+    };
+
+    /**
+     * Association of the connection with the endpoint, stored in the SSL object. Owned by the stream, so it lives as long as the
+     * connection.
+     */
+    struct binding {
+        std::shared_ptr<tls_session_cache> cache{};
+        std::string endpoint{};
+    };
+
+    tls_session_cache() = default;
+    tls_session_cache(const tls_session_cache&) = delete;
+    tls_session_cache& operator=(const tls_session_cache&) = delete;
+
+    ~tls_session_cache()
+    {
+        for (auto& entry : sessions_) {
+            SSL_SESSION_free(entry.second);
+        }
+    }
+
+    /**
+     * Makes the context keep client sessions in this cache. The cache must be owned by shared_ptr and outlive the context.
+     */
+    void attach(SSL_CTX* ctx)
+    {
+        SSL_CTX_set_ex_data(ctx, context_index(), this);
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(ctx, &on_new_session);
+    }
+
+    /**
+     * Returns the cache attached to the context, or nullptr.
+     */
+    [[nodiscard]] static std::shared_ptr<tls_session_cache> from(SSL_CTX* ctx)
+    {
+        if (auto* cache = static_cast<tls_session_cache*>(SSL_CTX_get_ex_data(ctx, context_index())); cache != nullptr) {
+            return cache->shared_from_this();
+        }
+        return nullptr;
+    }
+
+    /**
+     * Binds the connection to the endpoint, and offers the cached session of the endpoint for resumption.
+     */
+    void prepare(SSL* ssl, binding& b, std::string endpoint)
+    {
+        b.cache = shared_from_this();
+        b.endpoint = std::move(endpoint);
+        SSL_set_ex_data(ssl, connection_index(), &b);
+        std::scoped_lock lock(mutex_);
+        auto entry = sessions_.find(b.endpoint);
+        if (entry == sessions_.end()) {
+            return;
+        }
+        SSL_SESSION* session = entry->second;
+        if (std::time(nullptr) >= SSL_SESSION_get_time(session) + SSL_SESSION_get_timeout(session)) {
+            SSL_SESSION_free(session);
+            sessions_.erase(entry);
+            return;
+        }
+        SSL_set_session(ssl, session);
+    }
+
+    void record_handshake(SSL* ssl, std::chrono::steady_clock::duration duration, std::error_code ec)
+    {
+        auto us = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+        handshakes_.fetch_add(1, std::memory_order_relaxed);
+        total_duration_us_.fetch_add(us, std::memory_order_relaxed);
+        auto current_max = max_duration_us_.load(std::memory_order_relaxed);
+        while (us > current_max && !max_duration_us_.compare_exchange_weak(current_max, us, std::memory_order_relaxed)) {
+        }
+        if (ec) {
+            failures_.fetch_add(1, std::memory_order_relaxed);
+        } else if (SSL_session_reused(ssl) == 1) {
+            resumed_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    [[nodiscard]] stats get_stats() const
+    {
+        stats result{};
+        result.handshakes = handshakes_.load(std::memory_order_relaxed);
+        result.resumed = resumed_.load(std::memory_order_relaxed);
+        result.failures = failures_.load(std::memory_order_relaxed);
+        result.total_duration_us = total_duration_us_.load(std::memory_order_relaxed);
+        result.max_duration_us = max_duration_us_.load(std::memory_order_relaxed);
+        return result;
+    }
+
+    [[nodiscard]] std::size_t size() const
+    {
+        std::scoped_lock lock(mutex_);
+        return sessions_.size();
+    }
+
+  private:
+    /**
+     * Keeps the copy of the session, because OpenSSL marks the original as not resumable when the connection is closed without
+     * close_notify, which is how the sessions are usually torn down.
+     */
+    static int on_new_session(SSL* ssl, SSL_SESSION* session)
+    {
+        auto* b = static_cast<binding*>(SSL_get_ex_data(ssl, connection_index()));
+        if (b == nullptr || !b->cache || SSL_SESSION_is_resumable(session) != 1) {
+            return 0;
+        }
+        if (SSL_SESSION* copy = SSL_SESSION_dup(session); copy != nullptr) {
+            b->cache->store(b->endpoint, copy);
+        }
+        return 0;
+    }
+
+    void store(const std::string& endpoint, SSL_SESSION* session)
+    {
+        std::scoped_lock lock(mutex_);
+        auto& entry = sessions_[endpoint];
+        if (entry != nullptr) {
+            SSL_SESSION_free(entry);
+        }
+        entry = session;
+    }
+
+    static int context_index()
+    {
+        static int index = SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+        return index;
+    }
+
+    static int connection_index()
+    {
+        static int index = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+        return index;
+    }
+
+    mutable std::mutex mutex_{};
+    std::map<std::string, SSL_SESSION*> sessions_{};
+
+    std::atomic<std::uint64_t> handshakes_{ 0 };
+    std::atomic<std::uint64_t> resumed_{ 0 };
+    std::atomic<std::uint64_t> failures_{ 0 };
+    std::atomic<std::uint64_t> total_duration_us_{ 0 };
+    std::atomic<std::uint64_t> max_duration_us_{ 0 };
+};
+
+} // namespace couchbase::io
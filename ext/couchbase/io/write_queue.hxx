@@ -0,0 +1,223 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <asio/buffer.hpp>
+
+#include <io/buffer_pool.hxx>
+
+namespace couchbase::io
+{
+
+/**
+ * Multi-producer single-consumer queue of the frames waiting to be written to the socket.
+ *
+ * Producers push with a single CAS on the head of an intrusive stack. The consumer takes the whole stack with one exchange and
+ * reverses it, so that the frames are written in the order they have been pushed.
+ *
+ * The consumer returns the nodes to the free stack, and producers reuse them instead of allocating a node per frame. Only one
+ * producer at a time pops from the free stack, which makes the pop safe from ABA, and a producer that finds the free stack busy
+ * allocates a fresh node instead of waiting.
+ */
+class write_queue
+{
+  public:
+    /** the consumer deletes the nodes instead of keeping them, when the free stack already has that many */
+    static constexpr std::size_t max_free_nodes{ 256 };
+
+    write_queue() = default;
+    write_queue(const write_queue&) = delete;
+    write_queue& operator=(const write_queue&) = delete;
+
+    ~write_queue()
+    {
+        delete_all(head_.exchange(nullptr));
+        delete_all(free_.exchange(nullptr));
+    }
+
+    /**
+     * Might be called from any thread.
+     */
+    void push(std::vector<std::uint8_t>&& frame)
+    {
+        node* fresh = acquire_node();
+        fresh->frame = std::move(frame);
+        fresh->next = head_.load(std::memory_order_relaxed);
+        while (!head_.compare_exchange_weak(fresh->next, fresh, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+    }
+
+    [[nodiscard]] bool empty() const
+    {
+        return head_.load(std::memory_order_acquire) == nullptr;
+    }
+
+    /**
+     * Appends all queued frames to the vector in the order they have been pushed. Must only be called by the consumer.
+     */
+    void take_all(std::vector<std::vector<std::uint8_t>>& frames)
+    {
+        node* current = head_.exchange(nullptr, std::memory_order_acquire);
+        node* reversed = nullptr;
+        while (current != nullptr) {
+            node* next = current->next;
+            current->next = reversed;
+            reversed = current;
+            current = next;
+        }
+        while (reversed != nullptr) {
+            frames.emplace_back(std::move(reversed->frame));
+            node* next = reversed->next;
+            release_node(reversed);
+            reversed = next;
+        }
+    }
+
+  private:
+    struct node {
+        std::vector<std::uint8_t> frame{};
+        node* next{ nullptr };
+    };
+
+    node* acquire_node()
+    {
+        if (free_popping_.test_and_set(std::memory_order_acquire)) {
+            return new node{};
+        }
+        node* top = free_.load(std::memory_order_acquire);
+        while (top != nullptr && !free_.compare_exchange_weak(top, top->next, std::memory_order_acquire, std::memory_order_acquire)) {
+        }
+        free_popping_.clear(std::memory_order_release);
+        if (top == nullptr) {
+            return new node{};
+        }
+        free_count_.fetch_sub(1, std::memory_order_relaxed);
+        return top;
+    }
+
+    void release_node(node* released)
+    {
+        if (free_count_.load(std::memory_order_relaxed) >= max_free_nodes) {
+            delete released;
+            return;
+        }
+        free_count_.fetch_add(1, std::memory_order_relaxed);
+        released->next = free_.load(std::memory_order_relaxed);
+        while (!free_.compare_exchange_weak(released->next, released, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+    }
+
+    static void delete_all(node* current)
+    {
+        while (current != nullptr) {
+            node* next = current->next;
+            delete current;
+            current = next;
+        }
+    }
+
+    std::atomic<node*> head_{ nullptr };
+    std::atomic<node*> free_{ nullptr };
+    std::atomic<std::size_t> free_count_{ 0 };
+    std::atomic_flag free_popping_ = ATOMIC_FLAG_INIT;
+};
+
+/**
+ * Frames of the single write to the socket.
+ *
+ * Frames smaller than the chunk size are copied into contiguous chunks of up to chunk size, larger frames (e.g. big values) are
+ * referenced as separate buffers, so that the socket gets a few large buffers instead of one buffer per request.
+ */
+class write_batch
+{
+  public:
+    /**
+     * Takes the frame into the batch. The chunk size of 0 disables coalescing.
+     */
+    void add(std::vector<std::uint8_t>&& frame, std::size_t chunk_size, buffer_pool& pool)
+    {
+        bytes_ += frame.size();
+        ++frames_;
+        if (chunk_size == 0 || frame.size() >= chunk_size) {
+            buffers_.emplace_back(std::move(frame));
+            chunk_open_ = false;
+            return;
+        }
+        if (!chunk_open_ || buffers_.back().size() + frame.size() > chunk_size) {
+            auto chunk = pool.acquire();
+            chunk.reserve(chunk_size);
+            buffers_.emplace_back(std::move(chunk));
+            chunk_open_ = true;
+        }
+        auto& chunk = buffers_.back();
+        chunk.insert(chunk.end(), frame.begin(), frame.end());
+        pool.release(std::move(frame));
+    }
+
+    [[nodiscard]] std::vector<asio::const_buffer> buffers() const
+    {
+        std::vector<asio::const_buffer> result;
+        result.reserve(buffers_.size());
+        for (const auto& buf : buffers_) {
+            result.emplace_back(asio::buffer(buf));
+        }
+        return result;
+    }
+
+    [[nodiscard]] bool empty() const
+    {
+        return frames_ == 0;
+    }
+
+    [[nodiscard]] std::size_t frames() const
+    {
+        return frames_;
+    }
+
+    [[nodiscard]] std::size_t bytes() const
+    {
+        return bytes_;
+    }
+
+    /**
+     * Returns the buffers to the pool once they have been written.
+     */
+    void release(buffer_pool& pool)
+    {
+        for (auto& buf : buffers_) {
+            pool.release(std::move(buf));
+        }
+        buffers_.clear();
+        chunk_open_ = false;
+        frames_ = 0;
+        bytes_ = 0;
+    }
+
+  private:
+    std::vector<std::vector<std::uint8_t>> buffers_{};
+    bool chunk_open_{ false };
+    std::size_t frames_{ 0 };
+    std::size_t bytes_{ 0 };
+};
+
+} // namespace couchbase::io
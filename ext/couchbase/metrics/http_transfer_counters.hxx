@@ -0,0 +1,46 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace couchbase::metrics
+{
+/**
+ * Sizes of HTTP response bodies on the wire and after decoding, shared by all sessions of the endpoint. The ratio shows how much
+ * the compression of the responses saves.
+ */
+struct http_transfer_counters {
+    std::atomic<std::uint64_t> responses{ 0 };
+    std::atomic<std::uint64_t> compressed_responses{ 0 };
+    std::atomic<std::uint64_t> wire_bytes{ 0 };
+    std::atomic<std::uint64_t> decoded_bytes{ 0 };
+
+    void record(bool compressed, std::uint64_t wire, std::uint64_t decoded)
+    {
+        responses.fetch_add(1, std::memory_order_relaxed);
+        if (compressed) {
+            compressed_responses.fetch_add(1, std::memory_order_relaxed);
+        }
+        wire_bytes.fetch_add(wire, std::memory_order_relaxed);
+        decoded_bytes.fetch_add(decoded, std::memory_order_relaxed);
+    }
+};
+} // namespace couchbase::metrics
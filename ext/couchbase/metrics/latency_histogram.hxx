@@ -0,0 +1,197 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace couchbase::metrics
+{
+
+struct histogram_snapshot {
+    std::uint64_t count{ 0 };
+    std::uint64_t min_us{ 0 };
+    std::uint64_t max_us{ 0 };
+    std::uint64_t mean_us{ 0 };
+    std::uint64_t p50_us{ 0 };
+    std::uint64_t p90_us{ 0 };
+    std::uint64_t p99_us{ 0 };
+    std::uint64_t p999_us{ 0 };
+};
+
+/**
+ * Latency histogram with log-linear buckets in the spirit of HdrHistogram: every power of two is split into 16 linear buckets, so
+ * that values are kept with ~6% precision from one microsecond to hours in fixed amount of memory.
+ *
+ * Recording is lock-free, so that it could be done on the I/O thread for every request. Snapshots taken concurrently with recording
+ * might be off by the values recorded in the meantime.
+ */
+class latency_histogram
+{
+  public:
+    static constexpr std::size_t sub_bucket_bits = 4;
+    static constexpr std::size_t sub_buckets = 1U << sub_bucket_bits;
+    static constexpr std::size_t max_exponent = 36;
+    static constexpr std::size_t number_of_buckets = (max_exponent - sub_bucket_bits + 2) * sub_buckets;
+
+    void record(std::chrono::microseconds latency)
+    {
+        auto value = latency.count() > 0 ? static_cast<std::uint64_t>(latency.count()) : 0;
+        buckets_[bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(value, std::memory_order_relaxed);
+        auto current_min = min_.load(std::memory_order_relaxed);
+        while (value < current_min && !min_.compare_exchange_weak(current_min, value, std::memory_order_relaxed)) {
+        }
+        auto current_max = max_.load(std::memory_order_relaxed);
+        while (value > current_max && !max_.compare_exchange_weak(current_max, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    [[nodiscard]] histogram_snapshot snapshot() const
+    {
+        histogram_snapshot result{};
+        std::array<std::uint64_t, number_of_buckets> counts{};
+        std::uint64_t total = 0;
+        for (std::size_t i = 0; i < number_of_buckets; ++i) {
+            counts[i] = buckets_[i].load(std::memory_order_relaxed);
+            total += counts[i];
+        }
+        if (total == 0) {
+            return result;
+        }
+        result.count = total;
+        result.min_us = min_.load(std::memory_order_relaxed);
+        result.max_us = max_.load(std::memory_order_relaxed);
+        result.mean_us = sum_.load(std::memory_order_relaxed) / std::max<std::uint64_t>(count_.load(std::memory_order_relaxed), 1);
+        result.p50_us = percentile(counts, total, 500);
+        result.p90_us = percentile(counts, total, 900);
+        result.p99_us = percentile(counts, total, 990);
+        result.p999_us = percentile(counts, total, 999);
+        return result;
+    }
+
+    /**
+     * Index of the bucket for the value: values below 2 * sub_buckets are exact, then every power of two has sub_buckets buckets.
+     */
+    static std::size_t bucket_index(std::uint64_t value)
+    {
+        if (value < 2 * sub_buckets) {
+            return value;
+        }
+        std::size_t msb = 63 - static_cast<std::size_t>(__builtin_clzll(value));
+        if (msb > max_exponent) {
+            return number_of_buckets - 1;
+        }
+        std::size_t shift = msb - sub_bucket_bits;
+        std::size_t top = value >> shift;
+        return (shift + 1) * sub_buckets + (top - sub_buckets);
+    }
+
+    /**
+     * The highest value, that falls into the bucket.
+     */
+    static std::uint64_t bucket_value(std::size_t index)
+    {
+        if (index < 2 * sub_buckets) {
+            return index;
+        }
+        std::size_t shift = index / sub_buckets - 1;
+        std::uint64_t top = index % sub_buckets + sub_buckets;
+        return ((top + 1) << shift) - 1;
+    }
+
+  private:
+    static std::uint64_t percentile(const std::array<std::uint64_t, number_of_buckets>& counts, std::uint64_t total, std::uint64_t per_mille)
+    {
+        std::uint64_t rank = (total * per_mille + 999) / 1000;
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < number_of_buckets; ++i) {
+            seen += counts[i];
+            if (seen >= rank) {
+                return bucket_value(i);
+            }
+        }
+        return bucket_value(number_of_buckets - 1);
+    }
+
+    std::array<std::atomic<std::uint64_t>, number_of_buckets> buckets_{};
+    std::atomic<std::uint64_t> count_{ 0 };
+    std::atomic<std::uint64_t> sum_{ 0 };
+    std::atomic<std::uint64_t> min_{ std::numeric_limits<std::uint64_t>::max() };
+    std::atomic<std::uint64_t> max_{ 0 };
+};
+
+/**
+ * Histograms indexed by small integer key (e.g. opcode), allocated on first use, so that the idle keys do not take memory.
+ */
+template<std::size_t Size>
+class latency_histogram_set
+{
+  public:
+    latency_histogram_set() = default;
+    latency_histogram_set(const latency_histogram_set&) = delete;
+    latency_histogram_set& operator=(const latency_histogram_set&) = delete;
+
+    ~latency_histogram_set()
+    {
+        for (auto& histogram : histograms_) {
+            delete histogram.load(std::memory_order_relaxed);
+        }
+    }
+
+    void record(std::size_t key, std::chrono::microseconds latency)
+    {
+        if (key >= Size) {
+            return;
+        }
+        auto* histogram = histograms_[key].load(std::memory_order_acquire);
+        if (histogram == nullptr) {
+            auto* fresh = new latency_histogram();
+            if (histograms_[key].compare_exchange_strong(histogram, fresh, std::memory_order_acq_rel)) {
+                histogram = fresh;
+            } else {
+                delete fresh;
+            }
+        }
+        histogram->record(latency);
+    }
+
+    /**
+     * Calls visitor(key, snapshot) for every histogram, that has been used.
+     */
+    template<typename Visitor>
+    void visit(Visitor&& visitor) const
+    {
+        for (std::size_t key = 0; key < Size; ++key) {
+            if (const auto* histogram = histograms_[key].load(std::memory_order_acquire); histogram != nullptr) {
+                visitor(key, histogram->snapshot());
+            }
+        }
+    }
+
+  private:
+    std::array<std::atomic<latency_histogram*>, Size> histograms_{};
+};
+
+} // namespace couchbase::metrics
@@ -0,0 +1,83 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <metrics/latency_histogram.hxx>
+#include <service_type.hxx>
+
+namespace couchbase::metrics
+{
+
+struct kv_session_metrics {
+    std::string session_id{};
+    std::string node{};
+    /** requests waiting for response */
+    std::size_t in_flight{ 0 };
+    /** bytes queued for the socket */
+    std::size_t write_queue_bytes{ 0 };
+    /** requests, which have not been sent to the session, because it has reached kv_max_in_flight_requests or kv_max_queued_bytes */
+    std::uint64_t backpressure_events{ 0 };
+    /** writes to the socket (roughly system calls), together with frames_written shows how well requests are coalesced */
+    std::uint64_t socket_writes{ 0 };
+    std::uint64_t frames_written{ 0 };
+    /** requests sent with barrier to keep the order of requests for the same document under unordered execution */
+    std::uint64_t ordering_barriers{ 0 };
+    /** documents with requests in flight, that are tracked for ordering (only under unordered execution) */
+    std::size_t ordered_documents{ 0 };
+    /** encoding buffers, which have been allocated because the pool was empty, and which have been taken from the pool */
+    std::uint64_t buffers_allocated{ 0 };
+    std::uint64_t buffers_reused{ 0 };
+    /** latencies by opcode name */
+    std::map<std::string, histogram_snapshot> latencies{};
+};
+
+struct bucket_metrics {
+    std::string name{};
+    /** commands waiting for the configuration of the bucket */
+    std::size_t deferred_commands{ 0 };
+    /** commands rejected, because kv_max_deferred_commands has been reached */
+    std::uint64_t rejected_deferred_commands{ 0 };
+    std::vector<kv_session_metrics> sessions{};
+};
+
+struct http_endpoint_metrics {
+    service_type service{};
+    std::string node{};
+    std::size_t idle_sessions{ 0 };
+    std::size_t busy_sessions{ 0 };
+    histogram_snapshot latency{};
+    std::uint64_t responses{ 0 };
+    /** responses, which have been received with "Content-Encoding: gzip" */
+    std::uint64_t compressed_responses{ 0 };
+    /** sizes of the response bodies as received and after decoding */
+    std::uint64_t body_wire_bytes{ 0 };
+    std::uint64_t body_decoded_bytes{ 0 };
+};
+
+struct cluster_metrics {
+    std::vector<bucket_metrics> buckets{};
+    std::vector<http_endpoint_metrics> endpoints{};
+};
+
+} // namespace couchbase::metrics
@@ -19,6 +19,7 @@
 
 #include <document_id.hxx>
 #include <protocol/cmd_lookup_in.hxx>
+#include <utils/json_projection.hxx>
 
 namespace couchbase::operations
 {
@@ -44,6 +45,7 @@ struct get_projected_request {
     bool with_expiry{ false };
     std::vector<std::string> effective_projections{};
     bool preserve_array_indexes{ false };
+    std::optional<utils::json_projection> compiled_projections{};
     std::chrono::milliseconds timeout{ timeout_defaults::key_value_timeout };
 
     void encode_to(encoded_request_type& encoded)
@@ -52,6 +54,9 @@ struct get_projected_request {
         encoded.partition(partition);
         encoded.body().id(id);
 
+        if (!compiled_projections) {
+            compiled_projections.emplace(projections);
+        }
         effective_projections = projections;
         std::size_t num_projections = effective_projections.size();
         if (with_expiry) {
@@ -77,123 +82,6 @@ struct get_projected_request {
     }
 };
 
-namespace priv
-{
-
-std::optional<tao::json::value>
-subdoc_lookup(tao::json::value& root, const std::string& path)
-{
-    std::string::size_type offset = 0;
-    tao::json::value* cur = &root;
-
-    while (offset < path.size()) {
-        std::string::size_type idx = path.find_first_of(".[]", offset);
-
-        if (idx == std::string::npos) {
-            std::string key = path.substr(offset);
-            auto* val = cur->find(key);
-            if (val != nullptr) {
-                return *val;
-            }
-            break;
-        }
-
-        if (path[idx] == '.' || path[idx] == '[') {
-            std::string key = path.substr(offset, idx - offset);
-            auto* val = cur->find(key);
-            if (val == nullptr) {
-                break;
-            }
-            cur = val;
-        } else if (path[idx] == ']') {
-            if (!cur->is_array()) {
-                break;
-            }
-            std::string key = path.substr(offset, idx - offset);
-            int array_index = std::stoi(key);
-            if (array_index == -1) {
-                cur = &cur->get_array().back();
-            } else if (static_cast<std::size_t>(array_index) < cur->get_array().size()) {
-                cur = &cur->get_array().back();
-            } else {
-                break;
-            }
-            if (idx < path.size() - 1) {
-                return *cur;
-            }
-            idx += 1;
-        }
-        offset = idx + 1;
-    }
-
-    return {};
-}
-
-void
-subdoc_apply_projection(tao::json::value& root, const std::string& path, tao::json::value& value, bool preserve_array_indexes)
-{
-    std::string::size_type offset = 0;
-    tao::json::value* cur = &root;
-
-    while (offset < path.size()) {
-        std::string::size_type idx = path.find_first_of(".[]", offset);
-
-        if (idx == std::string::npos) {
-            cur->operator[](path.substr(offset)) = value;
-            break;
-        }
-
-        if (path[idx] == '.') {
-            std::string key = path.substr(offset, idx - offset);
-            tao::json::value* child = cur->find(key);
-            if (child == nullptr) {
-                cur->operator[](key) = tao::json::empty_object;
-                child = cur->find(key);
-            }
-            cur = child;
-        } else if (path[idx] == '[') {
-            std::string key = path.substr(offset, idx - offset);
-            tao::json::value* child = cur->find(key);
-            if (child == nullptr) {
-                cur->operator[](key) = tao::json::empty_array;
-                child = cur->find(key);
-            }
-            cur = child;
-        } else if (path[idx] == ']') {
-            tao::json::value child;
-            if (idx == path.size() - 1) {
-                child = value;
-            } else if (path[idx + 1] == '.') {
-                child = tao::json::empty_object;
-            } else if (path[idx + 1] == '[') {
-                child = tao::json::empty_array;
-            } else {
-                Expects(false);
-            }
-            if (preserve_array_indexes) {
-                int array_index = std::stoi(path.substr(offset, idx - offset));
-                if (array_index >= 0) {
-                    if (static_cast<std::size_t>(array_index) >= cur->get_array().size()) {
-                        cur->get_array().resize(static_cast<std::size_t>(array_index + 1), tao::json::null);
-                    }
-                    cur->at(static_cast<std::size_t>(array_index)) = child;
-                    cur = &cur->at(static_cast<std::size_t>(array_index));
-                } else {
-                    // index is negative, just append and let user decide what it means
-                    cur->get_array().push_back(child);
-                    cur = &cur->get_array().back();
-                }
-            } else {
-                cur->get_array().push_back(child);
-                cur = &cur->get_array().back();
-            }
-            ++idx;
-        }
-        offset = idx + 1;
-    }
-}
-} // namespace priv
-
 get_projected_response
 make_response(std::error_code ec, get_projected_request& request, get_projected_request::encoded_response_type encoded)
 {
@@ -206,39 +94,39 @@ make_response(std::error_code ec, get_projected_request& request, get_projected_
         if (request.with_expiry) {
             response.expiry = gsl::narrow_cast<std::uint32_t>(std::stoul(encoded.body().fields()[0].value));
         }
+        std::size_t offset = request.with_expiry ? 1 : 0;
+        if (request.projections.empty()) {
+            // special case when user only wanted full+expiration
+            response.value = encoded.body().fields()[offset].value;
+            return response;
+        }
+        if (!request.compiled_projections) {
+            request.compiled_projections.emplace(request.projections);
+        }
+        const auto& projection = *request.compiled_projections;
+        if (!projection.valid()) {
+            response.ec = std::make_error_code(error::key_value_errc::path_invalid);
+            return response;
+        }
+        auto fragments = projection.make_fragments();
         if (request.effective_projections.empty()) {
             // from full document
-            if (request.projections.empty() && request.with_expiry) {
-                // special case when user only wanted full+expiration
-                response.value = encoded.body().fields()[1].value;
-            } else {
-                tao::json::value full_doc = tao::json::from_string(encoded.body().fields()[request.with_expiry ? 1 : 0].value);
-                tao::json::value new_doc;
-                for (const auto& projection : request.projections) {
-                    auto value_to_apply = priv::subdoc_lookup(full_doc, projection);
-                    if (value_to_apply) {
-                        priv::subdoc_apply_projection(new_doc, projection, *value_to_apply, request.preserve_array_indexes);
-                    } else {
-                        response.ec = std::make_error_code(error::key_value_errc::path_not_found);
-                        return response;
-                    }
-                }
-                response.value = tao::json::to_string(new_doc);
+            if (!projection.extract(encoded.body().fields()[offset].value, fragments)) {
+                response.ec = std::make_error_code(error::common_errc::parsing_failure);
+                return response;
             }
         } else {
-            tao::json::value new_doc = tao::json::empty_object;
-            std::size_t offset = request.with_expiry ? 1 : 0;
-            for (const auto& projection : request.projections) {
-                auto& field = encoded.body().fields()[offset++];
-                if (field.status == protocol::status::success && !field.value.empty()) {
-                    auto value_to_apply = tao::json::from_string(field.value);
-                    priv::subdoc_apply_projection(new_doc, projection, value_to_apply, request.preserve_array_indexes);
-                } else {
+            for (std::size_t i = 0; i < request.projections.size(); ++i) {
+                const auto& field = encoded.body().fields()[offset + i];
+                if (field.status != protocol::status::success || field.value.empty()) {
                     response.ec = std::make_error_code(error::key_value_errc::path_not_found);
                     return response;
                 }
+                projection.assign(fragments, i, field.value);
             }
-            response.value = tao::json::to_string(new_doc);
+        }
+        if (!projection.write(fragments, request.preserve_array_indexes, response.value)) {
+            response.ec = std::make_error_code(error::key_value_errc::path_not_found);
         }
     }
     return response;
@@ -0,0 +1,116 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <document_id.hxx>
+#include <protocol/cmd_get_replica.hxx>
+
+namespace couchbase::operations
+{
+
+struct get_replica_response {
+    document_id id;
+    std::uint32_t opaque;
+    std::error_code ec{};
+    std::string value{};
+    std::uint64_t cas{};
+    std::uint32_t flags{};
+};
+
+/**
+ * Reads the document from the replica. The bucket routes the request to the node, which holds replica_index copy of the partition
+ * (zero-based, i.e. first replica has index 0).
+ */
+struct get_replica_request {
+    using encoded_request_type = protocol::client_request<protocol::get_replica_request_body>;
+    using encoded_response_type = protocol::client_response<protocol::get_replica_response_body>;
+
+    document_id id;
+    uint16_t partition{};
+    uint32_t opaque{};
+    std::size_t replica_index{};
+    std::chrono::milliseconds timeout{ timeout_defaults::key_value_timeout };
+
+    void encode_to(encoded_request_type& encoded)
+    {
+        encoded.opaque(opaque);
+        encoded.partition(partition);
+        encoded.body().id(id);
+    }
+};
+
+get_replica_response
+make_response(std::error_code ec, get_replica_request& request, get_replica_request::encoded_response_type encoded)
+{
+    get_replica_response response{ request.id, encoded.opaque(), ec };
+    if (ec && response.opaque == 0) {
+        response.opaque = request.opaque;
+    }
+    if (!ec) {
+        response.value = std::move(encoded.body().value());
+        response.cas = encoded.cas();
+        response.flags = encoded.body().flags();
+    }
+    return response;
+}
+
+/**
+ * Copy of the document read by get_any_replica_request or get_all_replicas_request.
+ */
+struct replica_entry {
+    std::string value{};
+    std::uint64_t cas{};
+    std::uint32_t flags{};
+    bool replica{ false };
+};
+
+struct get_any_replica_response {
+    document_id id;
+    std::error_code ec{};
+    replica_entry entry{};
+};
+
+/**
+ * Reads the document from the active node and all replicas at once, and completes with the first copy received. Other reads are
+ * cancelled. Fails with document_irretrievable when none of the nodes returned the document.
+ */
+struct get_any_replica_request {
+    using response_type = get_any_replica_response;
+
+    document_id id;
+    std::chrono::milliseconds timeout{ timeout_defaults::key_value_timeout };
+};
+
+struct get_all_replicas_response {
+    document_id id;
+    std::error_code ec{};
+    std::vector<replica_entry> entries{};
+};
+
+/**
+ * Reads the document from the active node and all replicas, and completes with every copy received before the timeout. Fails with
+ * document_irretrievable when none of the nodes returned the document.
+ */
+struct get_all_replicas_request {
+    using response_type = get_all_replicas_response;
+
+    document_id id;
+    std::chrono::milliseconds timeout{ timeout_defaults::key_value_timeout };
+};
+
+} // namespace couchbase::operations
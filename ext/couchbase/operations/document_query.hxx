@@ -31,6 +31,7 @@
 #include <platform/uuid.h>
 #include <timeout_defaults.hxx>
 #include <io/http_message.hxx>
+#include <utils/json_streaming_lexer.hxx>
 
 namespace couchbase::operations
 {
@@ -56,6 +57,7 @@ struct query_response_payload {
         std::string client_context_id;
         std::string status;
         query_metrics metrics;
+        std::optional<std::string> prepared;
         std::optional<std::string> signature;
         std::optional<std::string> profile;
         std::optional<std::vector<query_problem>> warnings;
@@ -83,6 +85,11 @@ struct traits<couchbase::operations::query_response_payload> {
             result.meta_data.signature = tao::json::to_string(*s);
         }
 
+        const auto n = v.find("prepared");
+        if (n != nullptr && n->is_string()) {
+            result.meta_data.prepared = n->get_string();
+        }
+
         const auto p = v.find("profile");
         if (p != nullptr) {
             result.meta_data.profile = tao::json::to_string(*p);
@@ -125,7 +132,7 @@ struct traits<couchbase::operations::query_response_payload> {
         }
         const auto r = v.find("results");
         if (r != nullptr) {
-            result.rows.reserve(result.meta_data.metrics.result_count);
+            result.rows.reserve(r->get_array().size());
             for (auto& row : r->get_array()) {
                 result.rows.emplace_back(tao::json::to_string(row));
             }
@@ -176,15 +183,50 @@ struct query_request {
     };
     profile_mode profile{ profile_mode::off };
 
+    /**
+     * Name (and plan for servers without enhanced prepared statements) of the non-adhoc query, filled by the cluster from its
+     * prepared statements cache.
+     */
+    struct prepared_statement {
+        std::string name;
+        std::optional<std::string> encoded_plan{};
+    };
+    std::optional<prepared_statement> prepared{};
+
+    /**
+     * When the non-adhoc query is not prepared yet, asks the server to execute the query right after PREPARE, so that the
+     * statement is prepared and executed in single round trip (requires enhanced prepared statements).
+     */
+    bool auto_execute{ false };
+
     std::map<std::string, tao::json::value> raw{};
     std::vector<tao::json::value> positional_parameters{};
     std::map<std::string, tao::json::value> named_parameters{};
 
+    /**
+     * When set, the rows are not accumulated in the response payload, but passed to the callback (on the IO thread) as raw JSON
+     * as soon as they have been received. The callback returns false to pause reading of the response, in this case the consumer
+     * has to call streaming->resume() once it is ready for more rows.
+     */
+    std::function<bool(std::string&& row)> row_callback{};
+    std::shared_ptr<io::http_streaming_body> streaming{};
+
     void encode_to(encoded_request_type& encoded)
     {
-        tao::json::value body{ { "statement", statement },
-                               { "client_context_id", client_context_id },
-                               { "timeout", fmt::format("{}ms", timeout.count()) } };
+        tao::json::value body{ { "client_context_id", client_context_id }, { "timeout", fmt::format("{}ms", timeout.count()) } };
+        if (adhoc) {
+            body["statement"] = statement;
+        } else if (prepared) {
+            body["prepared"] = prepared->name;
+            if (prepared->encoded_plan) {
+                body["encoded_plan"] = prepared->encoded_plan.value();
+            }
+        } else {
+            body["statement"] = "PREPARE " + statement;
+            if (auto_execute) {
+                body["auto_execute"] = true;
+            }
+        }
         if (positional_parameters.empty()) {
             for (auto& param : named_parameters) {
                 Expects(param.first.empty() == false);
@@ -263,6 +305,16 @@ struct query_request {
         encoded.method = "POST";
         encoded.path = "/query/service";
         encoded.body = tao::json::to_string(body);
+        if (row_callback) {
+            if (!streaming) {
+                streaming = std::make_shared<io::http_streaming_body>();
+            }
+            streaming->on_chunk = [lexer = std::make_shared<utils::json_streaming_lexer>("results"),
+                                   callback = row_callback](std::string_view chunk, std::string& meta) {
+                return lexer->feed(chunk, meta, callback);
+            };
+            encoded.streaming = streaming;
+        }
     }
 };
 
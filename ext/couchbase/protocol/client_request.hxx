@@ -21,10 +21,15 @@
 #include <arpa/inet.h>
 #endif
 
+#include <algorithm>
+#include <cstddef>
+
 #include <snappy.h>
 
 #include <gsl/gsl_util>
 #include <protocol/client_opcode.hxx>
+#include <protocol/compression.hxx>
+#include <protocol/frame_info_id.hxx>
 #include <protocol/magic.hxx>
 #include <protocol/client_response.hxx>
 
@@ -45,8 +50,10 @@ class client_request
     std::uint16_t partition_{ 0 };
     std::uint32_t opaque_{ 0 };
     std::uint64_t cas_{ 0 };
+    bool barrier_{ false };
     Body body_;
     std::vector<std::uint8_t> payload_;
+    compression_result compression_{};
 
   public:
     client_opcode opcode()
@@ -79,43 +86,84 @@ class client_request
         partition_ = val;
     }
 
+    /**
+     * Adds barrier frame info, so that the server does not execute the request before the requests received earlier, and does not
+     * start the requests received later until this one completes. Only meaningful with unordered execution.
+     */
+    void barrier(bool val)
+    {
+        barrier_ = val;
+    }
+
     Body& body()
     {
         return body_;
     }
 
-    std::vector<std::uint8_t>& data(bool try_to_compress = false)
+    /**
+     * Provides storage for the encoded frame (e.g. from the buffer pool of the session), so that data() does not need to allocate.
+     */
+    void payload_storage(std::vector<std::uint8_t>&& storage)
     {
+        payload_ = std::move(storage);
+        payload_.clear();
+    }
+
+    std::vector<std::uint8_t>& data(bool try_to_compress = false, const compression_parameters& parameters = {})
+    {
+        compression_ = {};
         switch (opcode_) {
             case protocol::client_opcode::insert:
             case protocol::client_opcode::upsert:
             case protocol::client_opcode::replace:
-                write_payload(try_to_compress);
+                write_payload(try_to_compress, parameters);
                 break;
             default:
-                write_payload(false);
+                write_payload(false, parameters);
                 break;
         }
         return payload_;
     }
 
+    /**
+     * Size of the value, that data() might compress.
+     */
+    [[nodiscard]] std::size_t value_size()
+    {
+        return body_.value().size();
+    }
+
+    /**
+     * Outcome of the compression during the last call of data().
+     */
+    [[nodiscard]] const compression_result& compression() const
+    {
+        return compression_;
+    }
+
   private:
-    void write_payload(bool try_to_compress)
+    void write_payload(bool try_to_compress, const compression_parameters& parameters)
     {
-        payload_.resize(header_size + body_.size(), 0);
+        // the barrier frame info has no value, so it takes single byte with zero id and zero length
+        const std::size_t barrier_size = barrier_ ? 1 : 0;
+        const std::size_t total_body_size = body_.size() + barrier_size;
+        payload_.resize(header_size + total_body_size, 0);
         payload_[0] = static_cast<uint8_t>(magic_);
         payload_[1] = static_cast<uint8_t>(opcode_);
 
         auto framing_extras = body_.framing_extras();
 
         uint16_t key_size = gsl::narrow_cast<uint16_t>(body_.key().size());
-        if (framing_extras.size() == 0) {
+        if (framing_extras.size() + barrier_size == 0) {
+            // the request might be encoded again without framing extras, e.g. without the barrier after retry
+            magic_ = protocol::magic::client_request;
+            payload_[0] = static_cast<uint8_t>(magic_);
             key_size = htons(key_size);
             memcpy(payload_.data() + 2, &key_size, sizeof(key_size));
         } else {
             magic_ = protocol::magic::alt_client_request;
             payload_[0] = static_cast<uint8_t>(magic_);
-            payload_[2] = gsl::narrow_cast<std::uint8_t>(framing_extras.size());
+            payload_[2] = gsl::narrow_cast<std::uint8_t>(framing_extras.size() + barrier_size);
             payload_[3] = gsl::narrow_cast<std::uint8_t>(key_size);
         }
 
@@ -125,34 +173,45 @@ class client_request
         uint16_t vbucket = ntohs(gsl::narrow_cast<uint16_t>(partition_));
         memcpy(payload_.data() + 6, &vbucket, sizeof(vbucket));
 
-        uint32_t body_size = htonl(gsl::narrow_cast<uint32_t>(body_.size()));
+        uint32_t body_size = htonl(gsl::narrow_cast<uint32_t>(total_body_size));
         memcpy(payload_.data() + 8, &body_size, sizeof(body_size));
 
         memcpy(payload_.data() + 12, &opaque_, sizeof(opaque_));
         memcpy(payload_.data() + 16, &cas_, sizeof(cas_));
 
         auto body_itr = payload_.begin() + header_size;
+        if (barrier_) {
+            *body_itr++ = static_cast<std::uint8_t>(static_cast<std::uint32_t>(request_frame_info_id::barrier) << 4U);
+        }
         if (framing_extras.size() > 0) {
             body_itr = std::copy(framing_extras.begin(), framing_extras.end(), body_itr);
         }
         body_itr = std::copy(body_.extras().begin(), body_.extras().end(), body_itr);
         body_itr = std::copy(body_.key().begin(), body_.key().end(), body_itr);
 
-        static const std::size_t min_size_to_compress = 32;
-        static const double min_ratio = 0.83;
-        if (try_to_compress && body_.value().size() > min_size_to_compress) {
-            std::string compressed;
-            std::size_t compressed_size =
-              snappy::Compress(reinterpret_cast<const char*>(body_.value().data()), body_.value().size(), &compressed);
-            if (gsl::narrow_cast<double>(compressed_size) / gsl::narrow_cast<double>(body().value().size()) < min_ratio) {
-                std::copy(compressed.begin(), compressed.end(), body_itr);
+        if (try_to_compress && body_.value().size() > parameters.min_size) {
+            // compress straight into the frame, and patch the header if the result is good enough
+            auto value_offset = static_cast<std::size_t>(std::distance(payload_.begin(), body_itr));
+            payload_.resize(std::max(payload_.size(), value_offset + snappy::MaxCompressedLength(body_.value().size())));
+            std::size_t compressed_size = 0;
+            snappy::RawCompress(reinterpret_cast<const char*>(body_.value().data()),
+                                body_.value().size(),
+                                reinterpret_cast<char*>(payload_.data() + value_offset),
+                                &compressed_size);
+            compression_.attempted = true;
+            compression_.original_size = body_.value().size();
+            compression_.compressed_size = compressed_size;
+            if (gsl::narrow_cast<double>(compressed_size) / gsl::narrow_cast<double>(body().value().size()) < parameters.min_ratio) {
+                compression_.accepted = true;
                 payload_[5] |= static_cast<uint8_t>(protocol::datatype::snappy);
-                size_t new_body_size = body_.size() - (body_.value().size() - compressed_size);
+                size_t new_body_size = total_body_size - (body_.value().size() - compressed_size);
                 body_size = htonl(gsl::narrow_cast<uint32_t>(new_body_size));
                 memcpy(payload_.data() + 8, &body_size, sizeof(body_size));
                 payload_.resize(header_size + new_body_size);
                 return;
             }
+            payload_.resize(header_size + total_body_size);
+            body_itr = payload_.begin() + static_cast<std::ptrdiff_t>(value_offset);
         }
         std::copy(body_.value().begin(), body_.value().end(), body_itr);
     }
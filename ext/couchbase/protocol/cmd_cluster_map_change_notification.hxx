@@ -35,7 +35,7 @@ class cluster_map_change_notification_request_body
   private:
     uint32_t protocol_revision_;
     std::string bucket_;
-    configuration config_;
+    std::string config_text_;
 
   public:
     [[nodiscard]] uint32_t protocol_revision()
@@ -48,9 +48,14 @@ class cluster_map_change_notification_request_body
         return bucket_;
     }
 
-    [[nodiscard]] configuration config()
+    [[nodiscard]] configuration config() const
     {
-        return config_;
+        return tao::json::from_string<deduplicate_keys>(config_text_).as<configuration>();
+    }
+
+    [[nodiscard]] const std::string& config_text() const
+    {
+        return config_text_;
     }
 
     bool parse(const header_buffer& header, const std::vector<uint8_t>& body, const cmd_info&)
@@ -68,7 +73,7 @@ class cluster_map_change_notification_request_body
         key_size = ntohs(key_size);
         bucket_.assign(body.begin() + offset, body.begin() + offset + key_size);
         offset += key_size;
-        config_ = tao::json::from_string<deduplicate_keys>(std::string(body.begin() + offset, body.end())).as<configuration>();
+        config_text_.assign(body.begin() + offset, body.end());
         return true;
     }
 };
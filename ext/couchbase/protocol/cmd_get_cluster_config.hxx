@@ -53,12 +53,20 @@ class get_cluster_config_response_body
     static const inline client_opcode opcode = client_opcode::get_cluster_config;
 
   private:
-    configuration config_;
+    std::string config_text_;
 
   public:
-    [[nodiscard]] configuration config()
+    /**
+     * Parses the configuration. The text is kept as is during decoding, so that the receiver could check the revision first.
+     */
+    [[nodiscard]] configuration config() const
     {
-        return config_;
+        return tao::json::from_string<deduplicate_keys>(config_text_).as<configuration>();
+    }
+
+    [[nodiscard]] const std::string& config_text() const
+    {
+        return config_text_;
     }
 
     bool parse(protocol::status status,
@@ -72,7 +80,7 @@ class get_cluster_config_response_body
         Expects(header[1] == static_cast<uint8_t>(opcode));
         if (status == protocol::status::success) {
             std::vector<uint8_t>::difference_type offset = framing_extras_size + key_size + extras_size;
-            config_ = tao::json::from_string<deduplicate_keys>(std::string(body.begin() + offset, body.end())).as<configuration>();
+            config_text_.assign(body.begin() + offset, body.end());
             return true;
         }
         return false;
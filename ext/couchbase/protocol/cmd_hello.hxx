@@ -17,6 +17,8 @@
 
 #pragma once
 
+#include <algorithm>
+
 #include <protocol/hello_feature.hxx>
 
 namespace couchbase::protocol
@@ -109,6 +111,16 @@ class hello_request_body
         return features_;
     }
 
+    /**
+     * Allows the server to execute requests of the connection out of order, which is requested by default.
+     */
+    void enable_unordered_execution(bool enabled)
+    {
+        if (!enabled) {
+            features_.erase(std::remove(features_.begin(), features_.end(), hello_feature::unordered_execution), features_.end());
+        }
+    }
+
     const std::string& key()
     {
         return key_;
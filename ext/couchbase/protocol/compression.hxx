@@ -0,0 +1,40 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace couchbase::protocol
+{
+/**
+ * Values not larger than min_size are never compressed, and the compressed value is only sent when compressed_size / original_size
+ * is less than min_ratio.
+ */
+struct compression_parameters {
+    std::size_t min_size{ 32 };
+    double min_ratio{ 0.83 };
+};
+
+struct compression_result {
+    bool attempted{ false };
+    bool accepted{ false };
+    std::size_t original_size{ 0 };
+    std::size_t compressed_size{ 0 };
+};
+
+} // namespace couchbase::protocol
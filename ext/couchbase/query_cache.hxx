@@ -0,0 +1,132 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include <operations/document_query.hxx>
+
+namespace couchbase
+{
+
+/**
+ * LRU cache of prepared statements, which maps statement text to the name of the prepared statement on the query service.
+ */
+class query_cache
+{
+  public:
+    using entry_type = operations::query_request::prepared_statement;
+
+    struct stats {
+        std::uint64_t hits{ 0 };
+        std::uint64_t misses{ 0 };
+        std::uint64_t evictions{ 0 };
+        std::uint64_t invalidations{ 0 };
+        std::size_t size{ 0 };
+        std::size_t capacity{ 0 };
+    };
+
+    explicit query_cache(std::size_t capacity = 5000)
+      : capacity_(capacity)
+    {
+    }
+
+    void capacity(std::size_t capacity)
+    {
+        std::scoped_lock lock(mutex_);
+        capacity_ = capacity;
+        evict();
+    }
+
+    [[nodiscard]] std::optional<entry_type> get(const std::string& statement)
+    {
+        std::scoped_lock lock(mutex_);
+        auto it = index_.find(statement);
+        if (it == index_.end()) {
+            ++stats_.misses;
+            return {};
+        }
+        ++stats_.hits;
+        entries_.splice(entries_.begin(), entries_, it->second);
+        return it->second->second;
+    }
+
+    void put(const std::string& statement, entry_type entry)
+    {
+        std::scoped_lock lock(mutex_);
+        if (capacity_ == 0) {
+            return;
+        }
+        auto it = index_.find(statement);
+        if (it != index_.end()) {
+            it->second->second = std::move(entry);
+            entries_.splice(entries_.begin(), entries_, it->second);
+            return;
+        }
+        entries_.emplace_front(statement, std::move(entry));
+        index_.emplace(statement, entries_.begin());
+        evict();
+    }
+
+    /**
+     * Forgets the statement, e.g. when the server does not recognize the prepared name anymore.
+     */
+    void invalidate(const std::string& statement)
+    {
+        std::scoped_lock lock(mutex_);
+        auto it = index_.find(statement);
+        if (it == index_.end()) {
+            return;
+        }
+        ++stats_.invalidations;
+        entries_.erase(it->second);
+        index_.erase(it);
+    }
+
+    [[nodiscard]] stats get_stats()
+    {
+        std::scoped_lock lock(mutex_);
+        stats result = stats_;
+        result.size = index_.size();
+        result.capacity = capacity_;
+        return result;
+    }
+
+  private:
+    void evict()
+    {
+        while (index_.size() > capacity_) {
+            index_.erase(entries_.back().first);
+            entries_.pop_back();
+            ++stats_.evictions;
+        }
+    }
+
+    std::mutex mutex_{};
+    std::size_t capacity_;
+    std::list<std::pair<std::string, entry_type>> entries_{};
+    std::unordered_map<std::string, std::list<std::pair<std::string, entry_type>>::iterator> index_{};
+    stats stats_{};
+};
+
+} // namespace couchbase
@@ -38,4 +38,16 @@ constexpr std::chrono::milliseconds config_poll_interval{ 2'500 };
 constexpr std::chrono::milliseconds config_poll_floor{ 50'000 };
 constexpr std::chrono::milliseconds config_idle_redial_timeout{ 5 * 60'000 };
 constexpr std::chrono::milliseconds idle_http_connection_timeout{ 4'500 };
+constexpr std::chrono::milliseconds kv_hedged_read_delay{ 0 };
+constexpr std::chrono::milliseconds kv_reconnect_backoff_min{ 50 };
+constexpr std::chrono::milliseconds kv_reconnect_backoff_max{ 5'000 };
+
+constexpr std::chrono::milliseconds tracing_threshold_kv{ 500 };
+constexpr std::chrono::milliseconds tracing_threshold_query{ 1'000 };
+constexpr std::chrono::milliseconds tracing_threshold_view{ 1'000 };
+constexpr std::chrono::milliseconds tracing_threshold_search{ 1'000 };
+constexpr std::chrono::milliseconds tracing_threshold_analytics{ 1'000 };
+constexpr std::chrono::milliseconds tracing_threshold_management{ 1'000 };
+constexpr std::chrono::milliseconds tracing_threshold_emit_interval{ 10'000 };
+constexpr std::chrono::milliseconds tracing_orphaned_emit_interval{ 10'000 };
 } // namespace couchbase::timeout_defaults
@@ -0,0 +1,147 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <protocol/frame_info_id.hxx>
+#include <service_type.hxx>
+
+namespace couchbase::tracing
+{
+
+/**
+ * Moments in the life of the request, in the order they normally happen.
+ */
+enum class point : std::uint8_t {
+    /** the command has been created */
+    created,
+    /** the command has left the queue of the bucket (e.g. waiting for configuration) and is handed to the session */
+    dispatched,
+    /** the request has been put into the write queue of the connected session */
+    queued,
+    /** the request has been written to the socket */
+    written,
+    /** the response has been read from the socket */
+    received,
+    /** the response has been decoded and passed to the handler */
+    completed,
+};
+
+constexpr std::size_t number_of_points = static_cast<std::size_t>(point::completed) + 1;
+
+/**
+ * Timestamps of the request at each stage of its processing.
+ *
+ * The stages might be recorded from different threads (the command and the session), so the timestamps are atomic. Spans are only
+ * allocated when tracing is enabled.
+ */
+struct request_span {
+    using clock = std::chrono::steady_clock;
+
+    service_type service{ service_type::kv };
+    std::string operation{};
+    std::string operation_id{};
+    std::string local_id{};
+
+    void mark(point p)
+    {
+        points_[static_cast<std::size_t>(p)].store(clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+    }
+
+    /**
+     * Records the stage unless it has been recorded already, e.g. when the request is sent again after retry.
+     */
+    void mark_once(point p)
+    {
+        clock::rep expected = 0;
+        points_[static_cast<std::size_t>(p)].compare_exchange_strong(
+          expected, clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] bool has(point p) const
+    {
+        return points_[static_cast<std::size_t>(p)].load(std::memory_order_relaxed) != 0;
+    }
+
+    /**
+     * Time between two stages, or zero if any of them has not been recorded.
+     */
+    [[nodiscard]] std::chrono::microseconds between(point from, point to) const
+    {
+        auto a = points_[static_cast<std::size_t>(from)].load(std::memory_order_relaxed);
+        auto b = points_[static_cast<std::size_t>(to)].load(std::memory_order_relaxed);
+        if (a == 0 || b == 0 || b < a) {
+            return std::chrono::microseconds::zero();
+        }
+        return std::chrono::duration_cast<std::chrono::microseconds>(clock::duration(b - a));
+    }
+
+    void server_duration(std::chrono::microseconds duration)
+    {
+        server_duration_.store(duration.count(), std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] std::chrono::microseconds server_duration() const
+    {
+        return std::chrono::microseconds(server_duration_.load(std::memory_order_relaxed));
+    }
+
+  private:
+    std::array<std::atomic<clock::rep>, number_of_points> points_{};
+    std::atomic<std::chrono::microseconds::rep> server_duration_{ 0 };
+};
+
+/**
+ * Decodes the value of server_duration frame info, which the server sends when "tracing" feature has been negotiated.
+ */
+inline std::chrono::microseconds
+decode_server_duration(std::uint16_t encoded)
+{
+    return std::chrono::microseconds(static_cast<std::chrono::microseconds::rep>(std::pow(encoded, 1.74) / 2));
+}
+
+/**
+ * Looks for server_duration in the framing extras of the response body.
+ */
+inline std::optional<std::chrono::microseconds>
+parse_server_duration(const std::vector<std::uint8_t>& body, std::size_t framing_extras_size)
+{
+    std::size_t offset = 0;
+    while (offset < framing_extras_size && offset < body.size()) {
+        auto id = static_cast<std::uint8_t>(body[offset] >> 4U);
+        auto size = static_cast<std::size_t>(body[offset] & 0x0fU);
+        ++offset;
+        if (id == static_cast<std::uint8_t>(protocol::response_frame_info_id::server_duration) && size == 2 &&
+            offset + 2 <= body.size()) {
+            return decode_server_duration(static_cast<std::uint16_t>((body[offset] << 8U) | body[offset + 1]));
+        }
+        offset += size;
+    }
+    return {};
+}
+
+} // namespace couchbase::tracing
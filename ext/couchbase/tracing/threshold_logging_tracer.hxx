@@ -0,0 +1,236 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <asio.hpp>
+#include <tao/json.hpp>
+#include <spdlog/spdlog.h>
+
+#include <cluster_options.hxx>
+#include <service_type.hxx>
+#include <tracing/request_span.hxx>
+
+namespace couchbase::tracing
+{
+
+/**
+ * Collects the slowest requests of every service and the responses, which have arrived after their requests were gone (e.g. timed
+ * out), and periodically writes the top of them into the log with the breakdown by stage.
+ *
+ * Reporting takes the lock only for the requests above the threshold of their service, which should be rare.
+ */
+class threshold_logging_tracer : public std::enable_shared_from_this<threshold_logging_tracer>
+{
+  public:
+    threshold_logging_tracer(asio::io_context& ctx, const cluster_options& options)
+      : threshold_timer_(ctx)
+      , orphan_timer_(ctx)
+      , options_(options)
+    {
+    }
+
+    void start()
+    {
+        schedule_threshold_report();
+        schedule_orphan_report();
+    }
+
+    void stop()
+    {
+        threshold_timer_.cancel();
+        orphan_timer_.cancel();
+    }
+
+    [[nodiscard]] std::chrono::microseconds threshold(service_type service) const
+    {
+        switch (service) {
+            case service_type::kv:
+                return options_.tracing_threshold_kv;
+            case service_type::query:
+                return options_.tracing_threshold_query;
+            case service_type::views:
+                return options_.tracing_threshold_view;
+            case service_type::search:
+                return options_.tracing_threshold_search;
+            case service_type::analytics:
+                return options_.tracing_threshold_analytics;
+            case service_type::management:
+                return options_.tracing_threshold_management;
+        }
+        return options_.tracing_threshold_kv;
+    }
+
+    /**
+     * Records completed request.
+     */
+    void report(const request_span& span)
+    {
+        auto total = span.between(point::created, point::completed);
+        if (total < threshold(span.service)) {
+            return;
+        }
+        auto server = span.server_duration();
+        auto network = span.between(span.has(point::written) ? point::written : point::dispatched, point::received);
+        network = network > server ? network - server : std::chrono::microseconds::zero();
+        tao::json::value entry{
+            { "operation_name", span.operation },
+            { "last_operation_id", span.operation_id },
+            { "last_local_id", span.local_id },
+            { "total_duration_us", total.count() },
+            { "dispatch_queue_us", span.between(point::created, point::dispatched).count() },
+            { "bootstrap_queue_us", span.between(point::dispatched, point::queued).count() },
+            { "write_queue_us", span.between(point::queued, point::written).count() },
+            { "network_us", network.count() },
+            { "decode_us", span.between(point::received, point::completed).count() },
+        };
+        if (server.count() > 0) {
+            entry["server_duration_us"] = server.count();
+        }
+        std::scoped_lock lock(mutex_);
+        requests_[span.service].push(total, std::move(entry), options_.tracing_threshold_sample_size);
+    }
+
+    /**
+     * Records response, which does not have the request waiting for it anymore.
+     */
+    void report_orphan(const std::string& operation,
+                       std::uint32_t opaque,
+                       const std::string& local_id,
+                       std::optional<std::chrono::microseconds> server_duration)
+    {
+        tao::json::value entry{
+            { "operation_name", operation },
+            { "last_operation_id", fmt::format("0x{:x}", opaque) },
+            { "last_local_id", local_id },
+        };
+        if (server_duration) {
+            entry["server_duration_us"] = server_duration->count();
+        }
+        auto duration = server_duration.value_or(std::chrono::microseconds::zero());
+        std::scoped_lock lock(mutex_);
+        orphans_.push(duration, std::move(entry), options_.tracing_orphaned_sample_size);
+    }
+
+  private:
+    /**
+     * Keeps at most N entries with the greatest durations, smallest one is on the top of the heap.
+     */
+    struct top_entries {
+        using value_type = std::pair<std::chrono::microseconds, tao::json::value>;
+
+        std::uint64_t total_count{ 0 };
+        std::vector<value_type> entries{};
+
+        void push(std::chrono::microseconds duration, tao::json::value&& entry, std::size_t capacity)
+        {
+            ++total_count;
+            if (capacity == 0) {
+                return;
+            }
+            if (entries.size() == capacity) {
+                if (entries.front().first >= duration) {
+                    return;
+                }
+                std::pop_heap(entries.begin(), entries.end(), by_duration);
+                entries.pop_back();
+            }
+            entries.emplace_back(duration, std::move(entry));
+            std::push_heap(entries.begin(), entries.end(), by_duration);
+        }
+
+        [[nodiscard]] tao::json::value to_json()
+        {
+            std::sort_heap(entries.begin(), entries.end(), by_duration);
+            tao::json::value top = tao::json::empty_array;
+            for (auto& entry : entries) {
+                top.get_array().emplace_back(std::move(entry.second));
+            }
+            return tao::json::value{
+                { "total_count", total_count },
+                { "top_requests", std::move(top) },
+            };
+        }
+
+        static bool by_duration(const value_type& lhs, const value_type& rhs)
+        {
+            return lhs.first > rhs.first;
+        }
+    };
+
+    void schedule_threshold_report()
+    {
+        threshold_timer_.expires_after(options_.tracing_threshold_emit_interval);
+        threshold_timer_.async_wait([self = shared_from_this()](std::error_code ec) {
+            if (ec == asio::error::operation_aborted) {
+                return;
+            }
+            std::map<service_type, top_entries> requests;
+            {
+                std::scoped_lock lock(self->mutex_);
+                std::swap(requests, self->requests_);
+            }
+            if (!requests.empty()) {
+                tao::json::value report = tao::json::empty_object;
+                for (auto& service : requests) {
+                    report[fmt::format("{}", service.first)] = service.second.to_json();
+                }
+                spdlog::warn("Operations over threshold: {}", tao::json::to_string(report));
+            }
+            self->schedule_threshold_report();
+        });
+    }
+
+    void schedule_orphan_report()
+    {
+        orphan_timer_.expires_after(options_.tracing_orphaned_emit_interval);
+        orphan_timer_.async_wait([self = shared_from_this()](std::error_code ec) {
+            if (ec == asio::error::operation_aborted) {
+                return;
+            }
+            top_entries orphans;
+            {
+                std::scoped_lock lock(self->mutex_);
+                std::swap(orphans, self->orphans_);
+            }
+            if (orphans.total_count > 0) {
+                tao::json::value report{ { "kv", orphans.to_json() } };
+                spdlog::warn("Orphan responses observed: {}", tao::json::to_string(report));
+            }
+            self->schedule_orphan_report();
+        });
+    }
+
+    asio::steady_timer threshold_timer_;
+    asio::steady_timer orphan_timer_;
+    cluster_options options_;
+    std::mutex mutex_{};
+    std::map<service_type, top_entries> requests_{};
+    top_entries orphans_{};
+};
+
+} // namespace couchbase::tracing
@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <string>
 
 #include <tao/json/external/pegtl.hpp>
@@ -254,6 +255,31 @@ extract_options(connection_string& connstr)
                 connstr.options.management_timeout = std::chrono::milliseconds(std::stoull(param.second));
             } else if (param.first == "trust_certificate") {
                 connstr.options.trust_certificate = param.second;
+            } else if (param.first == "tls_session_resumption") {
+                /**
+                 * Cache TLS sessions of the nodes, so that reconnecting sessions resume them instead of doing full handshake.
+                 */
+                if (param.second == "true" || param.second == "yes" || param.second == "on") {
+                    connstr.options.tls_session_resumption = true;
+                } else if (param.second == "false" || param.second == "no" || param.second == "off") {
+                    connstr.options.tls_session_resumption = false;
+                }
+            } else if (param.first == "tls_min_version") {
+                /**
+                 * The lowest TLS version to negotiate ("1.2" or "1.3"). The highest version supported by both sides is always preferred,
+                 * so "1.3" only disables fallback to older protocols.
+                 */
+                connstr.options.tls_min_version = param.second;
+            } else if (param.first == "tls_cipher_list") {
+                /**
+                 * Cipher list for TLS 1.2 and below in OpenSSL format (e.g. "ECDHE+AESGCM").
+                 */
+                connstr.options.tls_cipher_list = param.second;
+            } else if (param.first == "tls_ciphersuites") {
+                /**
+                 * Colon-separated list of TLS 1.3 cipher suites in order of preference (e.g. "TLS_AES_128_GCM_SHA256").
+                 */
+                connstr.options.tls_ciphersuites = param.second;
             } else if (param.first == "enable_mutation_tokens") {
                 /**
                  * Request mutation tokens at connection negotiation time. Turning this off will save 16 bytes per operation response.
@@ -263,6 +289,16 @@ extract_options(connection_string& connstr)
                 } else if (param.second == "false" || param.second == "no" || param.second == "off") {
                     connstr.options.enable_mutation_tokens = false;
                 }
+            } else if (param.first == "enable_unordered_execution") {
+                /**
+                 * Allow the server to execute KV requests of the connection out of order, so that slow requests (e.g. reads from disk or
+                 * durable writes) do not delay the requests sent after them. Requests for the same document keep their order.
+                 */
+                if (param.second == "true" || param.second == "yes" || param.second == "on") {
+                    connstr.options.enable_unordered_execution = true;
+                } else if (param.second == "false" || param.second == "no" || param.second == "off") {
+                    connstr.options.enable_unordered_execution = false;
+                }
             } else if (param.first == "enable_tcp_keep_alive") {
                 /**
                  * Gets or sets a value indicating whether enable TCP keep-alive.
@@ -288,21 +324,217 @@ extract_options(connection_string& connstr)
                 } else if (param.second == "false" || param.second == "no" || param.second == "off") {
                     connstr.options.force_ipv4 = false;
                 }
+            } else if (param.first == "enable_compression") {
+                /**
+                 * Compress values of the mutations with snappy, when the server supports it.
+                 */
+                if (param.second == "true" || param.second == "yes" || param.second == "on") {
+                    connstr.options.enable_compression = true;
+                } else if (param.second == "false" || param.second == "no" || param.second == "off") {
+                    connstr.options.enable_compression = false;
+                }
+            } else if (param.first == "compression_min_size") {
+                /**
+                 * Values of this size or smaller are sent as is.
+                 */
+                connstr.options.compression_min_size = std::stoul(param.second);
+            } else if (param.first == "compression_min_ratio") {
+                /**
+                 * The compressed value is only sent when its size divided by the original size is less than this number.
+                 */
+                connstr.options.compression_min_ratio = std::stod(param.second);
+            } else if (param.first == "compression_adaptive") {
+                /**
+                 * Stop compressing values of the collection, when the compression has been ineffective for its recent mutations.
+                 */
+                if (param.second == "true" || param.second == "yes" || param.second == "on") {
+                    connstr.options.compression_adaptive = true;
+                } else if (param.second == "false" || param.second == "no" || param.second == "off") {
+                    connstr.options.compression_adaptive = false;
+                }
+            } else if (param.first == "compression_offload_threshold") {
+                /**
+                 * Values of at least this number of bytes are compressed on the dedicated thread, instead of the I/O thread. 0 keeps
+                 * compression of all values on the I/O thread.
+                 */
+                connstr.options.compression_offload_threshold = std::stoul(param.second);
             } else if (param.first == "config_poll_interval") {
                 connstr.options.config_poll_interval = std::chrono::milliseconds(std::stoull(param.second));
             } else if (param.first == "config_poll_floor") {
                 connstr.options.config_poll_floor = std::chrono::milliseconds(std::stoull(param.second));
+            } else if (param.first == "num_io_threads") {
+                /**
+                 * Number of threads serving KV connections. Sessions of the bucket are spread between the threads, the first one is
+                 * shared with HTTP services and cluster-level operations.
+                 */
+                connstr.options.num_io_threads = std::max<size_t>(1, std::stoul(param.second));
+            } else if (param.first == "kv_connections_per_node") {
+                /**
+                 * Number of KV connections to every node of the bucket. Requests are dispatched to the connection with the least
+                 * amount of outstanding work.
+                 */
+                connstr.options.kv_connections_per_node = std::max<size_t>(1, std::stoul(param.second));
+            } else if (param.first == "kv_large_value_threshold") {
+                /**
+                 * When greater than zero and there are several KV connections per node, the last connection of the node is dedicated
+                 * to requests with values of at least this number of bytes, so that large uploads do not block small requests.
+                 */
+                connstr.options.kv_large_value_threshold = std::stoul(param.second);
+            } else if (param.first == "kv_hedged_read_delay") {
+                /**
+                 * When greater than zero, a get which has not been answered by the active node within this number of milliseconds is
+                 * also sent to the first replica, and the first successful response wins. Set it to the p99 latency of the reads.
+                 */
+                connstr.options.kv_hedged_read_delay = std::chrono::milliseconds(std::stoull(param.second));
+            } else if (param.first == "kv_max_in_flight_requests") {
+                /**
+                 * The maximum number of requests waiting for response on a single KV connection. When all connections to the node
+                 * have reached it, new requests fail with request_queue_full (or wait, see kv_backpressure_wait). 0 disables the limit.
+                 */
+                connstr.options.kv_max_in_flight_requests = std::stoul(param.second);
+            } else if (param.first == "kv_max_queued_bytes") {
+                /**
+                 * The maximum number of bytes queued for writing on a single KV connection, works together with
+                 * kv_max_in_flight_requests. 0 disables the limit.
+                 */
+                connstr.options.kv_max_queued_bytes = std::stoul(param.second);
+            } else if (param.first == "kv_max_deferred_commands") {
+                /**
+                 * The maximum number of requests waiting for the configuration of the bucket, before the bucket is bootstrapped. New
+                 * requests fail with request_queue_full beyond it. 0 disables the limit.
+                 */
+                connstr.options.kv_max_deferred_commands = std::stoul(param.second);
+            } else if (param.first == "kv_backpressure_wait") {
+                /**
+                 * When the connections to the node are congested, retry the request with small backoff until its timeout, instead of
+                 * failing it immediately with request_queue_full.
+                 */
+                if (param.second == "true" || param.second == "yes" || param.second == "on") {
+                    connstr.options.kv_backpressure_wait = true;
+                } else if (param.second == "false" || param.second == "no" || param.second == "off") {
+                    connstr.options.kv_backpressure_wait = false;
+                }
+            } else if (param.first == "kv_write_chunk_size") {
+                /**
+                 * Requests smaller than this number of bytes are copied into contiguous chunks of up to this size before writing to the
+                 * socket, larger ones (e.g. big values) are written as separate buffers. 0 writes every request as separate buffer.
+                 */
+                connstr.options.kv_write_chunk_size = std::stoul(param.second);
+            } else if (param.first == "kv_write_cork_delay") {
+                /**
+                 * Number of microseconds the idle KV connection waits for more requests before writing, unless a full chunk has been
+                 * queued. Trades a little latency for fewer system calls under heavy load. 0 (default) writes immediately.
+                 */
+                connstr.options.kv_write_cork_delay = std::chrono::microseconds(std::stoull(param.second));
+            } else if (param.first == "kv_reconnect_backoff_min") {
+                /**
+                 * Number of milliseconds before the first attempt to reconnect the failed KV connection. The delay doubles with every
+                 * failed attempt up to kv_reconnect_backoff_max, and is randomized, so that the connections do not reconnect at once.
+                 */
+                connstr.options.kv_reconnect_backoff_min = std::chrono::milliseconds(std::stoull(param.second));
+            } else if (param.first == "kv_reconnect_backoff_max") {
+                /**
+                 * The maximum number of milliseconds between attempts to reconnect the failed KV connection.
+                 */
+                connstr.options.kv_reconnect_backoff_max = std::chrono::milliseconds(std::stoull(param.second));
+            } else if (param.first == "prepared_statement_cache_size") {
+                /**
+                 * The maximum number of prepared statements (non-adhoc queries) remembered by the cluster. The least recently used
+                 * statements are evicted when the limit is reached. 0 disables the cache, so that all queries are executed as adhoc.
+                 */
+                connstr.options.prepared_statement_cache_size = std::stoul(param.second);
+            } else if (param.first == "socket_receive_buffer_size") {
+                /**
+                 * Size of the receive buffer (SO_RCVBUF) of KV and HTTP sockets in bytes. Larger buffers help to fetch large documents
+                 * over links with high latency. 0 (default) keeps the size chosen by the operating system.
+                 */
+                connstr.options.socket_receive_buffer_size = std::stoul(param.second);
             } else if (param.first == "max_http_connections") {
                 /**
                  * The maximum number of HTTP connections allowed on a per-host and per-port basis.  0 indicates an unlimited number of
-                 * connections are permitted.
+                 * connections are permitted. When the limit is reached on all nodes of the service, requests wait for a connection to
+                 * become available until their timeout.
                  */
                 connstr.options.max_http_connections = std::stoul(param.second);
+            } else if (param.first == "http_prewarm_connections") {
+                /**
+                 * Number of HTTP connections opened to every query, analytics and search node when the configuration is received, so
+                 * that the first requests do not pay for connect and TLS handshake. Idle connection timeout does not close these.
+                 */
+                connstr.options.http_prewarm_connections = std::stoul(param.second);
             } else if (param.first == "idle_http_connection_timeout") {
                 /**
                  * The period of time an HTTP connection can be idle before it is forcefully disconnected.
                  */
                 connstr.options.idle_http_connection_timeout = std::chrono::milliseconds(std::stoull(param.second));
+            } else if (param.first == "http_compression_query") {
+                /**
+                 * Send "Accept-Encoding: gzip" with the requests of the service (query, analytics, search and views are configured
+                 * separately), responses are decompressed incrementally as they are received. Saves bandwidth for large results at
+                 * the cost of CPU on both sides.
+                 */
+                if (param.second == "true" || param.second == "yes" || param.second == "on") {
+                    connstr.options.http_compression_query = true;
+                } else if (param.second == "false" || param.second == "no" || param.second == "off") {
+                    connstr.options.http_compression_query = false;
+                }
+            } else if (param.first == "http_compression_analytics") {
+                if (param.second == "true" || param.second == "yes" || param.second == "on") {
+                    connstr.options.http_compression_analytics = true;
+                } else if (param.second == "false" || param.second == "no" || param.second == "off") {
+                    connstr.options.http_compression_analytics = false;
+                }
+            } else if (param.first == "http_compression_search") {
+                if (param.second == "true" || param.second == "yes" || param.second == "on") {
+                    connstr.options.http_compression_search = true;
+                } else if (param.second == "false" || param.second == "no" || param.second == "off") {
+                    connstr.options.http_compression_search = false;
+                }
+            } else if (param.first == "http_compression_views") {
+                if (param.second == "true" || param.second == "yes" || param.second == "on") {
+                    connstr.options.http_compression_views = true;
+                } else if (param.second == "false" || param.second == "no" || param.second == "off") {
+                    connstr.options.http_compression_views = false;
+                }
+            } else if (param.first == "enable_tracing") {
+                /**
+                 * Record timestamps of every stage of the requests, and periodically log the slowest requests of each service and
+                 * orphaned responses.
+                 */
+                if (param.second == "true" || param.second == "yes" || param.second == "on") {
+                    connstr.options.enable_tracing = true;
+                } else if (param.second == "false" || param.second == "no" || param.second == "off") {
+                    connstr.options.enable_tracing = false;
+                }
+            } else if (param.first == "tracing_threshold_kv") {
+                /**
+                 * Number of milliseconds, after which KV request is reported as slow.
+                 */
+                connstr.options.tracing_threshold_kv = std::chrono::milliseconds(std::stoull(param.second));
+            } else if (param.first == "tracing_threshold_query") {
+                connstr.options.tracing_threshold_query = std::chrono::milliseconds(std::stoull(param.second));
+            } else if (param.first == "tracing_threshold_view") {
+                connstr.options.tracing_threshold_view = std::chrono::milliseconds(std::stoull(param.second));
+            } else if (param.first == "tracing_threshold_search") {
+                connstr.options.tracing_threshold_search = std::chrono::milliseconds(std::stoull(param.second));
+            } else if (param.first == "tracing_threshold_analytics") {
+                connstr.options.tracing_threshold_analytics = std::chrono::milliseconds(std::stoull(param.second));
+            } else if (param.first == "tracing_threshold_management") {
+                connstr.options.tracing_threshold_management = std::chrono::milliseconds(std::stoull(param.second));
+            } else if (param.first == "tracing_threshold_emit_interval") {
+                /**
+                 * How often, in milliseconds, the slowest requests are written to the log.
+                 */
+                connstr.options.tracing_threshold_emit_interval = std::chrono::milliseconds(std::stoull(param.second));
+            } else if (param.first == "tracing_threshold_sample_size") {
+                /**
+                 * How many of the slowest requests of every service are kept for the report.
+                 */
+                connstr.options.tracing_threshold_sample_size = std::stoul(param.second);
+            } else if (param.first == "tracing_orphaned_emit_interval") {
+                connstr.options.tracing_orphaned_emit_interval = std::chrono::milliseconds(std::stoull(param.second));
+            } else if (param.first == "tracing_orphaned_sample_size") {
+                connstr.options.tracing_orphaned_sample_size = std::stoul(param.second);
             } else {
                 spdlog::warn(R"(unknown parameter "{}" in connection string (value "{}"))", param.first, param.second);
             }
@@ -0,0 +1,551 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace couchbase::utils
+{
+
+/**
+ * Set of sub-document paths (like "name", "tags[0]" or "`dotted.key`.details[-1].city") compiled into a trie.
+ *
+ * The projection never builds DOM. The values are collected as raw JSON fragments, either from sub-document lookup results or
+ * from full document in single pass, and the projected document is written directly from those fragments. Paths that share prefix
+ * are merged, so that "a[0].b" and "a[0].c" produce one array element with both fields.
+ */
+class json_projection
+{
+  public:
+    /**
+     * Raw JSON value for every node of the trie, empty view means the value has not been found.
+     */
+    using fragments = std::vector<std::string_view>;
+
+    explicit json_projection(const std::vector<std::string>& paths)
+    {
+        nodes_.emplace_back();
+        leaves_.reserve(paths.size());
+        for (const auto& path : paths) {
+            if (!insert(path)) {
+                valid_ = false;
+                return;
+            }
+        }
+    }
+
+    /**
+     * @return false if any of the paths cannot be parsed, or if it addresses the root document as an array
+     */
+    [[nodiscard]] bool valid() const
+    {
+        return valid_;
+    }
+
+    [[nodiscard]] fragments make_fragments() const
+    {
+        return fragments(nodes_.size());
+    }
+
+    /**
+     * Records value of the path with given index, as it was returned by sub-document lookup.
+     */
+    void assign(fragments& values, std::size_t path_index, std::string_view raw) const
+    {
+        values[leaves_[path_index]] = raw;
+    }
+
+    /**
+     * Collects values of all paths from the full document in single pass.
+     *
+     * Only containers on the paths are descended into, everything else is skipped without decoding.
+     *
+     * @return false if the document is not valid JSON
+     */
+    bool extract(std::string_view document, fragments& values) const
+    {
+        std::size_t pos = skip_whitespace(document, 0);
+        std::size_t end = skip_value(document, pos);
+        if (end == std::string_view::npos || skip_whitespace(document, end) != document.size()) {
+            return false;
+        }
+        return extract(document.substr(pos, end - pos), 0, values);
+    }
+
+    /**
+     * Writes projected document.
+     *
+     * @return false if value of some path is missing
+     */
+    bool write(const fragments& values, bool preserve_array_indexes, std::string& out) const
+    {
+        std::size_t size_hint = 2;
+        for (const auto& value : values) {
+            size_hint += value.size();
+        }
+        out.clear();
+        out.reserve(size_hint + 8 * nodes_.size());
+        return write(0, values, preserve_array_indexes, out);
+    }
+
+  private:
+    static constexpr std::size_t root = 0;
+
+    struct node {
+        bool leaf{ false };
+        bool array{ false };
+        std::vector<std::size_t> children{};
+        std::map<std::string, std::size_t, std::less<>> keys{};
+        std::map<std::int64_t, std::size_t> indexes{};
+        std::string key{};
+        std::int64_t index{};
+    };
+
+    bool insert(std::string_view path)
+    {
+        std::size_t current = root;
+        std::size_t pos = 0;
+        if (path.empty()) {
+            return false;
+        }
+        while (pos < path.size()) {
+            if (path[pos] == '[') {
+                std::size_t close = path.find(']', pos);
+                if (close == std::string_view::npos || current == root) {
+                    return false;
+                }
+                std::int64_t index{};
+                auto [ptr, ec] = std::from_chars(path.data() + pos + 1, path.data() + close, index);
+                if (ec != std::errc{} || ptr != path.data() + close) {
+                    return false;
+                }
+                current = child(current, index);
+                pos = close + 1;
+            } else {
+                std::string key{};
+                if (path[pos] == '`') {
+                    ++pos;
+                    while (true) {
+                        std::size_t quote = path.find('`', pos);
+                        if (quote == std::string_view::npos) {
+                            return false;
+                        }
+                        key.append(path.substr(pos, quote - pos));
+                        pos = quote + 1;
+                        if (pos < path.size() && path[pos] == '`') {
+                            key.push_back('`');
+                            ++pos;
+                        } else {
+                            break;
+                        }
+                    }
+                } else {
+                    std::size_t stop = path.find_first_of(".[", pos);
+                    if (stop == std::string_view::npos) {
+                        stop = path.size();
+                    }
+                    key.assign(path.substr(pos, stop - pos));
+                    pos = stop;
+                }
+                if (key.empty()) {
+                    return false;
+                }
+                current = child(current, std::move(key));
+            }
+            if (pos < path.size()) {
+                if (path[pos] == '.') {
+                    if (++pos == path.size()) {
+                        return false;
+                    }
+                } else if (path[pos] != '[') {
+                    return false;
+                }
+            }
+        }
+        nodes_[current].leaf = true;
+        leaves_.push_back(current);
+        return true;
+    }
+
+    std::size_t child(std::size_t parent, std::string&& key)
+    {
+        if (auto it = nodes_[parent].keys.find(key); it != nodes_[parent].keys.end()) {
+            return it->second;
+        }
+        std::size_t id = nodes_.size();
+        nodes_.emplace_back().key = key;
+        nodes_[parent].keys.emplace(std::move(key), id);
+        nodes_[parent].children.push_back(id);
+        return id;
+    }
+
+    std::size_t child(std::size_t parent, std::int64_t index)
+    {
+        if (auto it = nodes_[parent].indexes.find(index); it != nodes_[parent].indexes.end()) {
+            return it->second;
+        }
+        std::size_t id = nodes_.size();
+        nodes_.emplace_back().index = index;
+        nodes_[parent].array = true;
+        nodes_[parent].indexes.emplace(index, id);
+        nodes_[parent].children.push_back(id);
+        return id;
+    }
+
+    /**
+     * @param value trimmed raw JSON value, already checked by skip_value()
+     */
+    bool extract(std::string_view value, std::size_t id, fragments& values) const
+    {
+        const node& current = nodes_[id];
+        if (current.leaf) {
+            values[id] = value;
+            return true;
+        }
+        std::size_t remaining = current.children.size();
+        if (value.front() == '{' && !current.keys.empty()) {
+            std::string unescaped{};
+            std::size_t pos = skip_whitespace(value, 1);
+            while (remaining > 0 && pos < value.size() && value[pos] == '"') {
+                std::size_t key_end = skip_value(value, pos);
+                if (key_end == std::string_view::npos) {
+                    return false;
+                }
+                std::size_t colon = skip_whitespace(value, key_end);
+                if (colon == value.size() || value[colon] != ':') {
+                    return false;
+                }
+                std::size_t value_start = skip_whitespace(value, colon + 1);
+                std::size_t value_end = skip_value(value, value_start);
+                if (value_end == std::string_view::npos) {
+                    return false;
+                }
+                std::string_view key = value.substr(pos + 1, key_end - pos - 2);
+                if (key.find('\\') != std::string_view::npos) {
+                    if (!unescape(key, unescaped)) {
+                        return false;
+                    }
+                    key = unescaped;
+                }
+                if (auto it = current.keys.find(key); it != current.keys.end()) {
+                    if (!extract(value.substr(value_start, value_end - value_start), it->second, values)) {
+                        return false;
+                    }
+                    --remaining;
+                }
+                pos = skip_whitespace(value, value_end);
+                if (pos < value.size() && value[pos] == ',') {
+                    pos = skip_whitespace(value, pos + 1);
+                }
+            }
+        } else if (value.front() == '[' && !current.indexes.empty()) {
+            bool needs_all = current.indexes.begin()->first < -1;
+            std::vector<std::string_view> elements{};
+            std::string_view last{};
+            std::int64_t index = 0;
+            std::size_t pos = skip_whitespace(value, 1);
+            while (remaining > 0 && pos < value.size() && value[pos] != ']') {
+                std::size_t element_end = skip_value(value, pos);
+                if (element_end == std::string_view::npos) {
+                    return false;
+                }
+                last = value.substr(pos, element_end - pos);
+                if (needs_all) {
+                    elements.push_back(last);
+                }
+                if (auto it = current.indexes.find(index++); it != current.indexes.end()) {
+                    if (!extract(last, it->second, values)) {
+                        return false;
+                    }
+                    --remaining;
+                }
+                pos = skip_whitespace(value, element_end);
+                if (pos < value.size() && value[pos] == ',') {
+                    pos = skip_whitespace(value, pos + 1);
+                }
+            }
+            for (auto [child_index, child_id] : current.indexes) {
+                if (child_index >= 0) {
+                    break;
+                }
+                if (child_index == -1) {
+                    if (!last.empty() && !extract(last, child_id, values)) {
+                        return false;
+                    }
+                } else if (static_cast<std::size_t>(-child_index) <= elements.size()) {
+                    if (!extract(elements[elements.size() - static_cast<std::size_t>(-child_index)], child_id, values)) {
+                        return false;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    bool write(std::size_t id, const fragments& values, bool preserve_array_indexes, std::string& out) const
+    {
+        const node& current = nodes_[id];
+        if (current.leaf) {
+            if (values[id].empty()) {
+                return false;
+            }
+            out.append(values[id]);
+            return true;
+        }
+        if (!current.array) {
+            out.push_back('{');
+            for (std::size_t child_id : current.children) {
+                if (out.back() != '{') {
+                    out.push_back(',');
+                }
+                write_string(nodes_[child_id].key, out);
+                out.push_back(':');
+                if (!write(child_id, values, preserve_array_indexes, out)) {
+                    return false;
+                }
+            }
+            out.push_back('}');
+            return true;
+        }
+        out.push_back('[');
+        if (preserve_array_indexes) {
+            std::int64_t next_index = 0;
+            for (auto [child_index, child_id] : current.indexes) {
+                if (child_index < 0) {
+                    continue;
+                }
+                for (; next_index < child_index; ++next_index) {
+                    out.append(next_index == 0 ? "null" : ",null");
+                }
+                if (next_index++ > 0) {
+                    out.push_back(',');
+                }
+                if (!write(child_id, values, preserve_array_indexes, out)) {
+                    return false;
+                }
+            }
+        }
+        for (std::size_t child_id : current.children) {
+            if (preserve_array_indexes && nodes_[child_id].index >= 0) {
+                continue;
+            }
+            if (out.back() != '[') {
+                out.push_back(',');
+            }
+            if (!write(child_id, values, preserve_array_indexes, out)) {
+                return false;
+            }
+        }
+        out.push_back(']');
+        return true;
+    }
+
+    static std::size_t skip_whitespace(std::string_view input, std::size_t pos)
+    {
+        while (pos < input.size() && (input[pos] == ' ' || input[pos] == '\t' || input[pos] == '\n' || input[pos] == '\r')) {
+            ++pos;
+        }
+        return pos;
+    }
+
+    /**
+     * @return position right after the value which starts at pos, or npos if the value is malformed
+     */
+    static std::size_t skip_value(std::string_view input, std::size_t pos)
+    {
+        if (pos >= input.size()) {
+            return std::string_view::npos;
+        }
+        std::size_t depth = 0;
+        do {
+            switch (input[pos]) {
+                case '"':
+                    for (++pos; pos < input.size() && input[pos] != '"'; ++pos) {
+                        if (input[pos] == '\\') {
+                            ++pos;
+                        }
+                    }
+                    if (pos >= input.size()) {
+                        return std::string_view::npos;
+                    }
+                    ++pos;
+                    break;
+
+                case '{':
+                case '[':
+                    ++depth;
+                    ++pos;
+                    break;
+
+                case '}':
+                case ']':
+                    if (depth-- == 0) {
+                        return std::string_view::npos;
+                    }
+                    ++pos;
+                    break;
+
+                case ',':
+                case ':':
+                case ' ':
+                case '\t':
+                case '\n':
+                case '\r':
+                    if (depth == 0) {
+                        return std::string_view::npos;
+                    }
+                    ++pos;
+                    break;
+
+                default:
+                    while (pos < input.size() && std::string_view(",:]} \t\n\r").find(input[pos]) == std::string_view::npos) {
+                        ++pos;
+                    }
+                    break;
+            }
+        } while (depth > 0 && pos < input.size());
+        return depth == 0 ? pos : std::string_view::npos;
+    }
+
+    static bool unescape(std::string_view input, std::string& out)
+    {
+        out.clear();
+        for (std::size_t pos = 0; pos < input.size(); ++pos) {
+            if (input[pos] != '\\') {
+                out.push_back(input[pos]);
+                continue;
+            }
+            if (++pos == input.size()) {
+                return false;
+            }
+            switch (input[pos]) {
+                case 'b':
+                    out.push_back('\b');
+                    break;
+                case 'f':
+                    out.push_back('\f');
+                    break;
+                case 'n':
+                    out.push_back('\n');
+                    break;
+                case 'r':
+                    out.push_back('\r');
+                    break;
+                case 't':
+                    out.push_back('\t');
+                    break;
+                case 'u': {
+                    std::uint32_t code_point{};
+                    if (!parse_hex(input, pos + 1, code_point)) {
+                        return false;
+                    }
+                    pos += 4;
+                    if (code_point >= 0xd800 && code_point < 0xdc00) {
+                        std::uint32_t low{};
+                        if (pos + 2 >= input.size() || input[pos + 1] != '\\' || input[pos + 2] != 'u' ||
+                            !parse_hex(input, pos + 3, low) || low < 0xdc00 || low >= 0xe000) {
+                            return false;
+                        }
+                        pos += 6;
+                        code_point = 0x10000 + ((code_point - 0xd800) << 10U) + (low - 0xdc00);
+                    }
+                    append_utf8(code_point, out);
+                } break;
+                default:
+                    out.push_back(input[pos]);
+                    break;
+            }
+        }
+        return true;
+    }
+
+    static bool parse_hex(std::string_view input, std::size_t pos, std::uint32_t& value)
+    {
+        if (pos + 4 > input.size()) {
+            return false;
+        }
+        auto [ptr, ec] = std::from_chars(input.data() + pos, input.data() + pos + 4, value, 16);
+        return ec == std::errc{} && ptr == input.data() + pos + 4;
+    }
+
+    static void append_utf8(std::uint32_t code_point, std::string& out)
+    {
+        if (code_point < 0x80) {
+            out.push_back(static_cast<char>(code_point));
+        } else if (code_point < 0x800) {
+            out.push_back(static_cast<char>(0xc0 | (code_point >> 6U)));
+            out.push_back(static_cast<char>(0x80 | (code_point & 0x3fU)));
+        } else if (code_point < 0x10000) {
+            out.push_back(static_cast<char>(0xe0 | (code_point >> 12U)));
+            out.push_back(static_cast<char>(0x80 | ((code_point >> 6U) & 0x3fU)));
+            out.push_back(static_cast<char>(0x80 | (code_point & 0x3fU)));
+        } else {
+            out.push_back(static_cast<char>(0xf0 | (code_point >> 18U)));
+            out.push_back(static_cast<char>(0x80 | ((code_point >> 12U) & 0x3fU)));
+            out.push_back(static_cast<char>(0x80 | ((code_point >> 6U) & 0x3fU)));
+            out.push_back(static_cast<char>(0x80 | (code_point & 0x3fU)));
+        }
+    }
+
+    static void write_string(std::string_view value, std::string& out)
+    {
+        static constexpr char hex[] = "0123456789abcdef";
+        out.push_back('"');
+        for (char c : value) {
+            switch (c) {
+                case '"':
+                    out.append("\\\"");
+                    break;
+                case '\\':
+                    out.append("\\\\");
+                    break;
+                case '\n':
+                    out.append("\\n");
+                    break;
+                case '\r':
+                    out.append("\\r");
+                    break;
+                case '\t':
+                    out.append("\\t");
+                    break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        out.append("\\u00");
+                        out.push_back(hex[static_cast<unsigned char>(c) >> 4U]);
+                        out.push_back(hex[static_cast<unsigned char>(c) & 0x0fU]);
+                    } else {
+                        out.push_back(c);
+                    }
+                    break;
+            }
+        }
+        out.push_back('"');
+    }
+
+    std::vector<node> nodes_{};
+    std::vector<std::size_t> leaves_{};
+    bool valid_{ true };
+};
+
+} // namespace couchbase::utils
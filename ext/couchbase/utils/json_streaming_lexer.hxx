@@ -0,0 +1,204 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace couchbase::utils
+{
+
+/**
+ * Incremental lexer for the responses of query-like services, which look like JSON object with one big array of rows.
+ *
+ * It does not build any DOM: every element of the rows array (e.g. "results") is passed to the handler as raw JSON text as soon as
+ * it has been received, and everything else is copied to the metadata string with the rows array left empty, so that the metadata
+ * could be parsed in the usual way once the response completes.
+ */
+class json_streaming_lexer
+{
+  public:
+    explicit json_streaming_lexer(std::string rows_key = "results")
+      : rows_key_(std::move(rows_key))
+    {
+    }
+
+    /**
+     * Consumes next chunk of the response.
+     *
+     * The row handler has signature bool(std::string&& row), and returns false when the consumer would like to stop the flow of the
+     * rows. The chunk is always consumed completely, the result of the handlers is aggregated and returned from the function.
+     */
+    template<typename RowHandler>
+    bool feed(std::string_view chunk, std::string& meta, RowHandler&& on_row)
+    {
+        bool want_more = true;
+        std::size_t meta_start = in_rows_ ? std::string_view::npos : 0;
+        std::size_t row_start = row_open_ ? 0 : std::string_view::npos;
+
+        auto open_row = [&](std::size_t pos) {
+            row_open_ = true;
+            row_start = pos;
+        };
+        auto close_row = [&](std::size_t pos) {
+            if (!row_open_) {
+                return;
+            }
+            row_.append(chunk.data() + row_start, pos - row_start);
+            while (!row_.empty() && is_space(row_.back())) {
+                row_.pop_back();
+            }
+            row_open_ = false;
+            row_start = std::string_view::npos;
+            ++rows_count_;
+            if (!on_row(std::move(row_))) {
+                want_more = false;
+            }
+            row_.clear();
+        };
+
+        for (std::size_t i = 0; i < chunk.size(); ++i) {
+            char c = chunk[i];
+            if (in_string_) {
+                if (escape_) {
+                    escape_ = false;
+                } else if (c == '\\') {
+                    escape_ = true;
+                } else if (c == '"') {
+                    in_string_ = false;
+                    capturing_key_ = false;
+                } else if (capturing_key_) {
+                    key_.push_back(c);
+                }
+                continue;
+            }
+            switch (c) {
+                case '"':
+                    in_string_ = true;
+                    if (in_rows_) {
+                        if (depth_ == 2 && !row_open_) {
+                            open_row(i);
+                        }
+                    } else if (depth_ == 1 && expect_key_) {
+                        expect_key_ = false;
+                        capturing_key_ = true;
+                        key_.clear();
+                    }
+                    break;
+
+                case '{':
+                case '[':
+                    if (in_rows_) {
+                        if (depth_ == 2 && !row_open_) {
+                            open_row(i);
+                        }
+                    } else if (depth_ == 1 && c == '[' && rows_value_) {
+                        meta.append(chunk.data() + meta_start, i + 1 - meta_start);
+                        meta_start = std::string_view::npos;
+                        in_rows_ = true;
+                    }
+                    ++depth_;
+                    if (depth_ == 1) {
+                        expect_key_ = true;
+                    }
+                    break;
+
+                case '}':
+                case ']':
+                    if (in_rows_ && depth_ == 2) {
+                        close_row(i);
+                        in_rows_ = false;
+                        rows_value_ = false;
+                        meta_start = i;
+                    }
+                    --depth_;
+                    if (depth_ == 0) {
+                        complete_ = true;
+                    }
+                    break;
+
+                case ',':
+                    if (in_rows_) {
+                        if (depth_ == 2) {
+                            close_row(i);
+                        }
+                    } else if (depth_ == 1) {
+                        expect_key_ = true;
+                        rows_value_ = false;
+                    }
+                    break;
+
+                case ':':
+                    if (!in_rows_ && depth_ == 1) {
+                        rows_value_ = key_ == rows_key_;
+                    }
+                    break;
+
+                default:
+                    if (in_rows_ && depth_ == 2 && !row_open_ && !is_space(c)) {
+                        open_row(i);
+                    }
+                    break;
+            }
+        }
+        if (meta_start != std::string_view::npos) {
+            meta.append(chunk.data() + meta_start, chunk.size() - meta_start);
+        }
+        if (row_open_) {
+            row_.append(chunk.data() + row_start, chunk.size() - row_start);
+        }
+        return want_more;
+    }
+
+    /**
+     * Returns true when the top-level value has been closed.
+     */
+    [[nodiscard]] bool complete() const
+    {
+        return complete_;
+    }
+
+    [[nodiscard]] std::size_t rows_count() const
+    {
+        return rows_count_;
+    }
+
+  private:
+    static bool is_space(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+    }
+
+    std::string rows_key_;
+    std::string key_{};
+    std::string row_{};
+    std::size_t rows_count_{ 0 };
+    int depth_{ 0 };
+    bool in_string_{ false };
+    bool escape_{ false };
+    bool expect_key_{ false };
+    bool capturing_key_{ false };
+    bool rows_value_{ false };
+    bool in_rows_{ false };
+    bool row_open_{ false };
+    bool complete_{ false };
+};
+
+} // namespace couchbase::utils
@@ -0,0 +1,325 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <build_config.hxx>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include <cluster.hxx>
+#include <operations.hxx>
+
+#include <mock/mock_cluster.hxx>
+
+/*
+ * Checks the limits of the KV queues (kv_max_in_flight_requests, kv_max_queued_bytes, kv_max_deferred_commands), and waiting for
+ * the capacity with kv_backpressure_wait, against the in-process mock cluster (see mock/mock_cluster.hxx).
+ */
+
+namespace
+{
+int failures = 0;
+
+void
+check(bool condition, const char* description)
+{
+    if (!condition) {
+        std::fprintf(stderr, "FAILED: %s\n", description);
+        ++failures;
+    }
+}
+
+/**
+ * Mock cluster with the bucket opened by the client, the node responds after node_latency once the bucket is open.
+ */
+struct test_environment {
+    couchbase::mock::mock_options settings{};
+    couchbase::mock::mock_cluster mock;
+    asio::io_context ctx{};
+    couchbase::cluster cluster;
+    std::thread worker;
+
+    test_environment(const couchbase::cluster_options& options, std::chrono::milliseconds node_latency)
+      : mock(settings)
+      , cluster(ctx)
+      , worker([this]() { ctx.run(); })
+    {
+        {
+            std::promise<std::error_code> barrier;
+            cluster.open(couchbase::origin("Administrator", "password", "127.0.0.1", mock.kv_port(0), options),
+                         [&barrier](std::error_code ec) { barrier.set_value(ec); });
+            check(!barrier.get_future().get(), "cluster has to be opened");
+        }
+        {
+            std::promise<std::error_code> barrier;
+            cluster.open_bucket(settings.bucket_name, [&barrier](std::error_code ec) { barrier.set_value(ec); });
+            check(!barrier.get_future().get(), "bucket has to be opened");
+        }
+        couchbase::mock::fault_profile faults{};
+        faults.extra_latency = node_latency;
+        mock.set_faults(0, faults);
+    }
+
+    ~test_environment()
+    {
+        std::promise<void> closed;
+        cluster.close([&closed]() { closed.set_value(); });
+        closed.get_future().wait();
+        worker.join();
+        mock.stop();
+    }
+
+    [[nodiscard]] couchbase::document_id id(std::size_t index) const
+    {
+        return { settings.bucket_name, "_default._default", fmt::format("backpressure-{}", index) };
+    }
+
+    /**
+     * Issues the upserts one by one without waiting, and returns their error codes in the order of the requests.
+     */
+    std::vector<std::error_code> upsert(std::size_t number_of_requests)
+    {
+        std::vector<std::promise<couchbase::operations::upsert_response>> responses(number_of_requests);
+        for (std::size_t i = 0; i < number_of_requests; ++i) {
+            cluster.execute(couchbase::operations::upsert_request{ id(i), R"({"value":42})" },
+                            [&response = responses[i]](couchbase::operations::upsert_response&& resp) {
+                                response.set_value(std::move(resp));
+                            });
+        }
+        std::vector<std::error_code> errors;
+        for (auto& response : responses) {
+            errors.emplace_back(response.get_future().get().ec);
+        }
+        return errors;
+    }
+
+    [[nodiscard]] couchbase::metrics::bucket_metrics bucket_metrics()
+    {
+        std::promise<couchbase::metrics::cluster_metrics> barrier;
+        cluster.metrics([&barrier](couchbase::metrics::cluster_metrics&& metrics) { barrier.set_value(std::move(metrics)); });
+        auto metrics = barrier.get_future().get();
+        return metrics.buckets.empty() ? couchbase::metrics::bucket_metrics{} : metrics.buckets.front();
+    }
+
+    [[nodiscard]] std::uint64_t backpressure_events()
+    {
+        std::uint64_t events = 0;
+        for (const auto& session : bucket_metrics().sessions) {
+            events += session.backpressure_events;
+        }
+        return events;
+    }
+};
+
+std::size_t
+count(const std::vector<std::error_code>& errors, std::error_code expected)
+{
+    return static_cast<std::size_t>(std::count(errors.begin(), errors.end(), expected));
+}
+
+/**
+ * Only kv_max_in_flight_requests are sent to the slow node, the rest fail with request_queue_full without waiting for the node.
+ */
+void
+test_in_flight_limit_fails_fast()
+{
+    couchbase::cluster_options options{};
+    options.kv_max_in_flight_requests = 2;
+    test_environment env(options, std::chrono::milliseconds(300));
+
+    auto started = std::chrono::steady_clock::now();
+    std::vector<std::promise<std::chrono::steady_clock::duration>> rejected_at(6);
+    std::vector<std::promise<std::error_code>> errors(6);
+    for (std::size_t i = 0; i < errors.size(); ++i) {
+        env.cluster.execute(couchbase::operations::upsert_request{ env.id(i), R"({"value":42})" },
+                            [&error = errors[i], &at = rejected_at[i], started](couchbase::operations::upsert_response&& resp) {
+                                at.set_value(std::chrono::steady_clock::now() - started);
+                                error.set_value(resp.ec);
+                            });
+    }
+    std::size_t succeeded = 0;
+    std::size_t rejected = 0;
+    for (std::size_t i = 0; i < errors.size(); ++i) {
+        auto ec = errors[i].get_future().get();
+        auto elapsed = rejected_at[i].get_future().get();
+        if (!ec) {
+            ++succeeded;
+        } else if (ec == std::make_error_code(couchbase::error::common_errc::request_queue_full)) {
+            ++rejected;
+            check(elapsed < std::chrono::milliseconds(300), "rejected request must not wait for the node");
+        }
+    }
+    check(succeeded == 2, "requests within kv_max_in_flight_requests have to succeed");
+    check(rejected == 4, "requests over kv_max_in_flight_requests have to fail with request_queue_full");
+    check(env.backpressure_events() >= 4, "every rejected request has to be counted as backpressure event");
+}
+
+/**
+ * Requests queued for the socket count against kv_max_queued_bytes. The batch is flushed only after all its requests have been
+ * queued, so with the limit of one byte only the first request of the batch goes to the session.
+ */
+void
+test_queued_bytes_limit_fails_fast()
+{
+    couchbase::cluster_options options{};
+    options.kv_max_queued_bytes = 1;
+    test_environment env(options, std::chrono::milliseconds(0));
+
+    std::vector<couchbase::operations::upsert_request> requests;
+    for (std::size_t i = 0; i < 3; ++i) {
+        requests.emplace_back(couchbase::operations::upsert_request{ env.id(i), R"({"value":42})" });
+    }
+    std::promise<std::vector<couchbase::operations::upsert_response>> barrier;
+    env.cluster.execute_multi(std::move(requests), [&barrier](std::vector<couchbase::operations::upsert_response>&& responses) {
+        barrier.set_value(std::move(responses));
+    });
+    auto responses = barrier.get_future().get();
+    check(!responses[0].ec, "the first request of the batch has to succeed");
+    check(responses[1].ec == std::make_error_code(couchbase::error::common_errc::request_queue_full) &&
+            responses[2].ec == std::make_error_code(couchbase::error::common_errc::request_queue_full),
+          "requests over kv_max_queued_bytes have to fail with request_queue_full");
+    check(env.backpressure_events() >= 2, "every rejected request has to be counted as backpressure event");
+}
+
+/**
+ * With kv_backpressure_wait the requests over the limit wait for the capacity, and succeed once the node has responded to the
+ * earlier ones.
+ */
+void
+test_backpressure_wait_retries_until_capacity()
+{
+    couchbase::cluster_options options{};
+    options.kv_max_in_flight_requests = 2;
+    options.kv_backpressure_wait = true;
+    test_environment env(options, std::chrono::milliseconds(100));
+
+    auto retries_before = env.cluster.retry_stats()[couchbase::io::retry_reason::kv_backpressure];
+    auto errors = env.upsert(6);
+    check(count(errors, {}) == errors.size(), "all requests have to succeed once the capacity is available");
+    check(env.cluster.retry_stats()[couchbase::io::retry_reason::kv_backpressure] > retries_before,
+          "waiting for the capacity has to be counted as kv_backpressure retry");
+    check(env.backpressure_events() >= 4, "requests over the limit have to be counted as backpressure events");
+}
+
+/**
+ * The request, that is still waiting for the capacity at its deadline, fails with unambiguous_timeout, because it has never been
+ * sent.
+ */
+void
+test_backpressure_wait_stops_at_deadline()
+{
+    couchbase::cluster_options options{};
+    options.kv_max_in_flight_requests = 1;
+    options.kv_backpressure_wait = true;
+    test_environment env(options, std::chrono::milliseconds(1000));
+
+    std::vector<std::promise<std::error_code>> errors(3);
+    for (std::size_t i = 0; i < errors.size(); ++i) {
+        couchbase::operations::upsert_request request{ env.id(i), R"({"value":42})" };
+        request.timeout = std::chrono::milliseconds(200);
+        env.cluster.execute(request, [&error = errors[i]](couchbase::operations::upsert_response&& resp) { error.set_value(resp.ec); });
+    }
+    std::vector<std::error_code> results;
+    for (auto& error : errors) {
+        results.emplace_back(error.get_future().get());
+    }
+    check(results[0] == std::make_error_code(couchbase::error::common_errc::ambiguous_timeout),
+          "the request sent to the slow node has to time out");
+    check(results[1] == std::make_error_code(couchbase::error::common_errc::unambiguous_timeout) &&
+            results[2] == std::make_error_code(couchbase::error::common_errc::unambiguous_timeout),
+          "requests waiting for the capacity have to fail with unambiguous_timeout");
+}
+
+/**
+ * Commands issued before the bucket has its configuration wait in the deferred queue, those over kv_max_deferred_commands fail with
+ * request_queue_full and are counted by the bucket.
+ */
+void
+test_deferred_commands_limit()
+{
+    couchbase::mock::mock_options settings{};
+    settings.bucket_name = "default";
+    settings.kv_latency = std::chrono::milliseconds(50);
+    couchbase::mock::mock_cluster mock(settings);
+
+    couchbase::cluster_options options{};
+    options.kv_max_deferred_commands = 1;
+    asio::io_context ctx{};
+    couchbase::cluster cluster(ctx);
+    std::thread worker([&ctx]() { ctx.run(); });
+    {
+        std::promise<std::error_code> barrier;
+        cluster.open(couchbase::origin("Administrator", "password", "127.0.0.1", mock.kv_port(0), options),
+                     [&barrier](std::error_code ec) { barrier.set_value(ec); });
+        check(!barrier.get_future().get(), "cluster has to be opened");
+    }
+    std::promise<std::error_code> bucket_opened;
+    cluster.open_bucket(settings.bucket_name, [&bucket_opened](std::error_code ec) { bucket_opened.set_value(ec); });
+
+    std::vector<std::promise<std::error_code>> errors(3);
+    for (std::size_t i = 0; i < errors.size(); ++i) {
+        couchbase::document_id id{ settings.bucket_name, "_default._default", fmt::format("deferred-{}", i) };
+        cluster.execute(couchbase::operations::upsert_request{ id, R"({"value":42})" },
+                        [&error = errors[i]](couchbase::operations::upsert_response&& resp) { error.set_value(resp.ec); });
+    }
+    check(!bucket_opened.get_future().get(), "bucket has to be opened");
+    std::vector<std::error_code> results;
+    for (auto& error : errors) {
+        results.emplace_back(error.get_future().get());
+    }
+    check(!results[0], "the deferred command has to be sent once the bucket is open");
+    check(results[1] == std::make_error_code(couchbase::error::common_errc::request_queue_full) &&
+            results[2] == std::make_error_code(couchbase::error::common_errc::request_queue_full),
+          "commands over kv_max_deferred_commands have to fail with request_queue_full");
+
+    std::promise<couchbase::metrics::cluster_metrics> barrier;
+    cluster.metrics([&barrier](couchbase::metrics::cluster_metrics&& metrics) { barrier.set_value(std::move(metrics)); });
+    auto metrics = barrier.get_future().get();
+    check(!metrics.buckets.empty() && metrics.buckets.front().rejected_deferred_commands == 2,
+          "rejected commands have to be counted as rejected_deferred_commands");
+
+    std::promise<void> closed;
+    cluster.close([&closed]() { closed.set_value(); });
+    closed.get_future().wait();
+    worker.join();
+    mock.stop();
+}
+} // namespace
+
+int
+main()
+{
+    spdlog::set_level(spdlog::level::warn);
+    test_in_flight_limit_fails_fast();
+    test_queued_bytes_limit_fails_fast();
+    test_backpressure_wait_retries_until_capacity();
+    test_backpressure_wait_stops_at_deadline();
+    test_deferred_commands_limit();
+    if (failures > 0) {
+        return EXIT_FAILURE;
+    }
+    std::puts("OK");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,210 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+
+#include <build_config.hxx>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <string>
+#include <thread>
+
+#include <spdlog/spdlog.h>
+
+#include <cluster.hxx>
+#include <operations.hxx>
+
+#include <mock/mock_cluster.hxx>
+
+/*
+ * Checks that the session writes KV requests in the order they have been issued, against the in-process mock cluster (see
+ * mock/mock_cluster.hxx), which executes requests of the connection one by one.
+ */
+
+namespace
+{
+int failures = 0;
+
+void
+check(bool condition, const char* description)
+{
+    if (!condition) {
+        std::fprintf(stderr, "FAILED: %s\n", description);
+        ++failures;
+    }
+}
+
+/**
+ * Large value is compressed on the offload thread (compression_offload_threshold), the small mutation of the same document issued
+ * right after it must not overtake it, otherwise the large value would remain stored.
+ */
+void
+test_offloaded_mutation_keeps_order()
+{
+    couchbase::mock::mock_options settings{};
+    settings.bucket_name = "default";
+    couchbase::mock::mock_cluster mock(settings);
+
+    couchbase::cluster_options options{};
+    options.compression_offload_threshold = 1024 * 1024;
+    asio::io_context ctx{};
+    couchbase::cluster cluster(ctx);
+    std::thread worker([&ctx]() { ctx.run(); });
+    {
+        std::promise<std::error_code> barrier;
+        cluster.open(couchbase::origin("Administrator", "password", "127.0.0.1", mock.kv_port(0), options),
+                     [&barrier](std::error_code ec) { barrier.set_value(ec); });
+        check(!barrier.get_future().get(), "cluster has to be opened");
+    }
+    {
+        std::promise<std::error_code> barrier;
+        cluster.open_bucket(settings.bucket_name, [&barrier](std::error_code ec) { barrier.set_value(ec); });
+        check(!barrier.get_future().get(), "bucket has to be opened");
+    }
+
+    couchbase::document_id id{ settings.bucket_name, "_default._default", "ordering" };
+    std::string large_value = fmt::format(R"({{"value":"{}"}})", std::string(4 * 1024 * 1024, 'x'));
+    std::string small_value = R"({"value":"small"})";
+    auto offloaded_before = cluster.compression_stats().offloaded;
+    for (int round = 0; round < 5; ++round) {
+        std::promise<couchbase::operations::upsert_response> large;
+        std::promise<couchbase::operations::upsert_response> small;
+        cluster.execute(couchbase::operations::upsert_request{ id, large_value },
+                        [&large](couchbase::operations::upsert_response&& response) { large.set_value(std::move(response)); });
+        cluster.execute(couchbase::operations::upsert_request{ id, small_value },
+                        [&small](couchbase::operations::upsert_response&& response) { small.set_value(std::move(response)); });
+        auto large_response = large.get_future().get();
+        auto small_response = small.get_future().get();
+        check(!large_response.ec && !small_response.ec, "both upserts have to succeed");
+        check(large_response.cas < small_response.cas, "large value has to be stored first");
+
+        std::promise<couchbase::operations::get_response> barrier;
+        cluster.execute(couchbase::operations::get_request{ id },
+                        [&barrier](couchbase::operations::get_response&& response) { barrier.set_value(std::move(response)); });
+        auto response = barrier.get_future().get();
+        check(!response.ec && response.value == small_value, "the value issued last has to be stored");
+    }
+    check(cluster.compression_stats().offloaded >= offloaded_before + 5, "large values have to be compressed on the offload thread");
+
+    std::promise<void> closed;
+    cluster.close([&closed]() { closed.set_value(); });
+    closed.get_future().wait();
+    worker.join();
+    mock.stop();
+}
+
+/**
+ * Issues number_of_requests upserts of distinct documents against the node, that holds the responses, and returns the number of
+ * documents, that the session tracks for ordering while the requests are in flight.
+ */
+std::size_t
+ordered_documents_in_flight(bool enable_unordered_execution, std::size_t number_of_requests)
+{
+    couchbase::mock::mock_options settings{};
+    settings.bucket_name = "default";
+    couchbase::mock::mock_cluster mock(settings);
+
+    couchbase::cluster_options options{};
+    options.enable_unordered_execution = enable_unordered_execution;
+    asio::io_context ctx{};
+    couchbase::cluster cluster(ctx);
+    std::thread worker([&ctx]() { ctx.run(); });
+    {
+        std::promise<std::error_code> barrier;
+        cluster.open(couchbase::origin("Administrator", "password", "127.0.0.1", mock.kv_port(0), options),
+                     [&barrier](std::error_code ec) { barrier.set_value(ec); });
+        check(!barrier.get_future().get(), "cluster has to be opened");
+    }
+    {
+        std::promise<std::error_code> barrier;
+        cluster.open_bucket(settings.bucket_name, [&barrier](std::error_code ec) { barrier.set_value(ec); });
+        check(!barrier.get_future().get(), "bucket has to be opened");
+    }
+
+    couchbase::mock::fault_profile faults{};
+    faults.extra_latency = std::chrono::milliseconds(500);
+    mock.set_faults(0, faults);
+
+    std::atomic<std::size_t> completed{ 0 };
+    std::promise<void> all_completed;
+    for (std::size_t i = 0; i < number_of_requests; ++i) {
+        couchbase::document_id id{ settings.bucket_name, "_default._default", fmt::format("document-{}", i) };
+        cluster.execute(couchbase::operations::upsert_request{ id, R"({"value":42})" },
+                        [&completed, &all_completed, number_of_requests](couchbase::operations::upsert_response&& response) {
+                            check(!response.ec, "upsert has to succeed");
+                            if (++completed == number_of_requests) {
+                                all_completed.set_value();
+                            }
+                        });
+    }
+
+    std::size_t ordered_documents = 0;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (std::chrono::steady_clock::now() < deadline) {
+        std::promise<couchbase::metrics::cluster_metrics> barrier;
+        cluster.metrics([&barrier](couchbase::metrics::cluster_metrics&& metrics) { barrier.set_value(std::move(metrics)); });
+        auto metrics = barrier.get_future().get();
+        std::size_t in_flight = 0;
+        ordered_documents = 0;
+        for (const auto& bucket : metrics.buckets) {
+            for (const auto& session : bucket.sessions) {
+                in_flight += session.in_flight;
+                ordered_documents += session.ordered_documents;
+            }
+        }
+        if (in_flight == number_of_requests) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    all_completed.get_future().wait();
+
+    std::promise<void> closed;
+    cluster.close([&closed]() { closed.set_value(); });
+    closed.get_future().wait();
+    worker.join();
+    mock.stop();
+    return ordered_documents;
+}
+
+/**
+ * Documents are tracked for ordering only when the server might reorder the requests, otherwise every request would allocate the
+ * entry in the handler table for nothing.
+ */
+void
+test_ordering_is_tracked_only_for_unordered_execution()
+{
+    check(ordered_documents_in_flight(false, 32) == 0, "documents must not be tracked without unordered execution");
+    check(ordered_documents_in_flight(true, 32) == 32, "every document in flight has to be tracked under unordered execution");
+}
+} // namespace
+
+int
+main()
+{
+    spdlog::set_level(spdlog::level::warn);
+    test_offloaded_mutation_keeps_order();
+    test_ordering_is_tracked_only_for_unordered_execution();
+    if (failures > 0) {
+        return EXIT_FAILURE;
+    }
+    std::puts("OK");
+    return EXIT_SUCCESS;
+}
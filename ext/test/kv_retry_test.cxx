@@ -0,0 +1,110 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+
+#include <build_config.hxx>
+
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <string>
+#include <thread>
+
+#include <spdlog/spdlog.h>
+
+#include <cluster.hxx>
+#include <operations.hxx>
+
+#include <mock/mock_cluster.hxx>
+
+/*
+ * Checks retries of KV operations against the in-process mock cluster (see mock/mock_cluster.hxx), so that it runs without server.
+ */
+
+namespace
+{
+int failures = 0;
+
+void
+check(bool condition, const char* description)
+{
+    if (!condition) {
+        std::fprintf(stderr, "FAILED: %s\n", description);
+        ++failures;
+    }
+}
+
+/**
+ * The mock rejects the first mutation with NOT_MY_VBUCKET, the client has to redispatch it with the carried configuration, so that
+ * the operation succeeds and the retry is counted.
+ */
+void
+test_not_my_vbucket_is_redispatched()
+{
+    couchbase::mock::mock_options settings{};
+    settings.bucket_name = "default";
+    couchbase::mock::mock_cluster mock(settings);
+
+    asio::io_context ctx{};
+    couchbase::cluster cluster(ctx);
+    std::thread worker([&ctx]() { ctx.run(); });
+    {
+        std::promise<std::error_code> barrier;
+        cluster.open(couchbase::origin("Administrator", "password", "127.0.0.1", mock.kv_port(0), couchbase::cluster_options{}),
+                     [&barrier](std::error_code ec) { barrier.set_value(ec); });
+        check(!barrier.get_future().get(), "cluster has to be opened");
+    }
+    {
+        std::promise<std::error_code> barrier;
+        cluster.open_bucket(settings.bucket_name, [&barrier](std::error_code ec) { barrier.set_value(ec); });
+        check(!barrier.get_future().get(), "bucket has to be opened");
+    }
+
+    auto before = cluster.retry_stats()[couchbase::io::retry_reason::not_my_vbucket];
+    couchbase::mock::fault_profile faults{};
+    faults.not_my_vbucket_count = 1;
+    mock.set_faults(0, faults);
+    {
+        std::promise<couchbase::operations::upsert_response> barrier;
+        cluster.execute(couchbase::operations::upsert_request{ { settings.bucket_name, "_default._default", "nmvb" }, R"({"answer":42})" },
+                        [&barrier](couchbase::operations::upsert_response&& response) { barrier.set_value(std::move(response)); });
+        auto response = barrier.get_future().get();
+        check(!response.ec, "upsert has to succeed after not_my_vbucket");
+        check(response.cas != 0, "upsert has to return CAS");
+    }
+    check(mock.stats(0).not_my_vbucket_injected == 1, "mock has to inject exactly one not_my_vbucket");
+    check(cluster.retry_stats()[couchbase::io::retry_reason::not_my_vbucket] == before + 1, "retry has to be counted as not_my_vbucket");
+
+    std::promise<void> closed;
+    cluster.close([&closed]() { closed.set_value(); });
+    closed.get_future().wait();
+    worker.join();
+    mock.stop();
+}
+} // namespace
+
+int
+main()
+{
+    spdlog::set_level(spdlog::level::warn);
+    test_not_my_vbucket_is_redispatched();
+    if (failures > 0) {
+        return EXIT_FAILURE;
+    }
+    std::puts("OK");
+    return EXIT_SUCCESS;
+}
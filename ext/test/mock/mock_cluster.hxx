@@ -0,0 +1,760 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <asio.hpp>
+#include <gsl/gsl_assert>
+#include <spdlog/spdlog.h>
+#include <tao/json.hpp>
+
+#include <io/mcbp_message.hxx>
+#include <io/mcbp_parser.hxx>
+#include <protocol/client_opcode.hxx>
+#include <protocol/datatype.hxx>
+#include <protocol/hello_feature.hxx>
+#include <protocol/magic.hxx>
+#include <protocol/status.hxx>
+#include <utils/byteswap.hxx>
+
+namespace couchbase::mock
+{
+
+/**
+ * Misbehaviour of the node, applied to the data operations (get, upsert, insert, replace, remove) and to the query requests.
+ */
+struct fault_profile {
+    /** share of the data operations rejected with NOT_MY_VBUCKET (the current configuration is sent with the response) */
+    double not_my_vbucket_ratio{ 0 };
+    /** number of the next data operations rejected with NOT_MY_VBUCKET regardless of the ratio, for deterministic tests */
+    std::size_t not_my_vbucket_count{ 0 };
+    /** share of the data operations rejected with TMPFAIL */
+    double temporary_failure_ratio{ 0 };
+    /** added to the latency of every response of the node, to simulate slow node */
+    std::chrono::microseconds extra_latency{ 0 };
+};
+
+struct mock_options {
+    std::size_t number_of_nodes{ 1 };
+    std::string bucket_name{ "default" };
+    std::size_t number_of_partitions{ 64 };
+    /** collections in addition to "_default._default", as "scope.collection" */
+    std::vector<std::string> collections{};
+    std::chrono::microseconds kv_latency{ 0 };
+    std::chrono::microseconds query_latency{ 0 };
+    /** number of rows in every query response */
+    std::size_t query_rows{ 1 };
+};
+
+/**
+ * In-process cluster, which speaks enough of the KV protocol and of the query service to bootstrap couchbase::cluster and to run
+ * basic KV operations and queries against it. Every node listens on two ephemeral ports on 127.0.0.1 (KV and query).
+ *
+ * It is meant for load testing of the client, so that pipelining, backpressure and retries can be observed without real cluster:
+ *
+ * - SASL accepts any credentials in first step, selecting of the bucket checks only its name;
+ * - documents are kept in memory, shared by all nodes, and the partitions are assigned to the nodes round-robin;
+ * - values are stored as they are sent, so that snappy-compressed values are returned compressed with the same datatype;
+ * - responses might be delayed, and faults could be injected for every node with set_faults().
+ *
+ * The mock runs on its own thread, so that its work does not interfere with the IO threads of the client.
+ */
+class mock_cluster
+{
+  public:
+    struct node_stats {
+        std::uint64_t kv_requests{};
+        std::uint64_t query_requests{};
+        std::uint64_t not_my_vbucket_injected{};
+        std::uint64_t temporary_failures_injected{};
+    };
+
+    explicit mock_cluster(mock_options options = {})
+      : options_(std::move(options))
+    {
+        Expects(options_.number_of_nodes > 0 && options_.number_of_partitions > 0);
+        collection_uids_["_default._default"] = 0;
+        for (const auto& path : options_.collections) {
+            collection_uids_.emplace(path, static_cast<std::uint32_t>(8 + collection_uids_.size() - 1));
+        }
+        sequence_numbers_.resize(options_.number_of_partitions, 0);
+        for (std::size_t i = 0; i < options_.number_of_nodes; ++i) {
+            auto& n = nodes_.emplace_back(std::make_unique<node>(ctx_, i));
+            n->kv_port = n->kv_acceptor.local_endpoint().port();
+            n->query_port = n->query_acceptor.local_endpoint().port();
+        }
+        for (auto& n : nodes_) {
+            accept_kv(*n);
+            accept_query(*n);
+        }
+        worker_ = std::thread([this]() { ctx_.run(); });
+    }
+
+    mock_cluster(const mock_cluster&) = delete;
+    mock_cluster& operator=(const mock_cluster&) = delete;
+
+    ~mock_cluster()
+    {
+        stop();
+    }
+
+    void stop()
+    {
+        if (!worker_.joinable()) {
+            return;
+        }
+        asio::post(ctx_, [this]() {
+            for (auto& n : nodes_) {
+                n->kv_acceptor.close();
+                n->query_acceptor.close();
+            }
+            ctx_.stop();
+        });
+        worker_.join();
+    }
+
+    [[nodiscard]] const mock_options& options() const
+    {
+        return options_;
+    }
+
+    [[nodiscard]] std::uint16_t kv_port(std::size_t node_index) const
+    {
+        return nodes_.at(node_index)->kv_port;
+    }
+
+    [[nodiscard]] std::uint16_t query_port(std::size_t node_index) const
+    {
+        return nodes_.at(node_index)->query_port;
+    }
+
+    /**
+     * Replaces the faults of the node. Might be called from any thread, the change is applied to the requests received afterwards.
+     */
+    void set_faults(std::size_t node_index, fault_profile faults)
+    {
+        asio::post(ctx_, [this, node_index, faults]() { nodes_.at(node_index)->faults = faults; });
+    }
+
+    [[nodiscard]] node_stats stats(std::size_t node_index) const
+    {
+        const auto& n = *nodes_.at(node_index);
+        return { n.kv_requests.load(), n.query_requests.load(), n.not_my_vbucket_injected.load(), n.temporary_failures_injected.load() };
+    }
+
+  private:
+    struct node {
+        node(asio::io_context& ctx, std::size_t node_index)
+          : index(node_index)
+          , kv_acceptor(ctx, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0))
+          , query_acceptor(ctx, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0))
+        {
+        }
+
+        std::size_t index;
+        asio::ip::tcp::acceptor kv_acceptor;
+        asio::ip::tcp::acceptor query_acceptor;
+        std::uint16_t kv_port{};
+        std::uint16_t query_port{};
+        fault_profile faults{};
+        std::atomic<std::uint64_t> kv_requests{ 0 };
+        std::atomic<std::uint64_t> query_requests{ 0 };
+        std::atomic<std::uint64_t> not_my_vbucket_injected{ 0 };
+        std::atomic<std::uint64_t> temporary_failures_injected{ 0 };
+    };
+
+    struct document {
+        std::string value{};
+        std::uint32_t flags{};
+        std::uint8_t datatype{};
+        std::uint64_t cas{};
+    };
+
+    /**
+     * Request frame split into its parts. The views point into the body of the message.
+     */
+    struct request {
+        std::uint8_t opcode{};
+        std::uint8_t datatype{};
+        std::uint16_t partition{};
+        std::uint32_t opaque{}; // network byte order, copied to the response as is
+        std::uint64_t cas{};
+        std::string_view extras{};
+        std::string_view key{};
+        std::string_view value{};
+    };
+
+    class kv_connection : public std::enable_shared_from_this<kv_connection>
+    {
+      public:
+        kv_connection(mock_cluster& cluster, node& owner, asio::ip::tcp::socket&& socket)
+          : cluster_(cluster)
+          , node_(owner)
+          , socket_(std::move(socket))
+        {
+        }
+
+        void start()
+        {
+            socket_.set_option(asio::ip::tcp::no_delay(true));
+            do_read();
+        }
+
+        /**
+         * Schedules the response, delayed by the configured latency of the node.
+         */
+        void respond(const request& req,
+                     protocol::status status,
+                     std::string_view extras = {},
+                     std::string_view value = {},
+                     std::uint64_t cas = 0,
+                     std::uint8_t datatype = 0)
+        {
+            std::vector<std::uint8_t> frame(24 + extras.size() + value.size());
+            frame[0] = static_cast<std::uint8_t>(protocol::magic::client_response);
+            frame[1] = req.opcode;
+            frame[4] = static_cast<std::uint8_t>(extras.size());
+            frame[5] = datatype;
+            std::uint16_t status_code = htons(static_cast<std::uint16_t>(status));
+            std::memcpy(frame.data() + 6, &status_code, sizeof(status_code));
+            std::uint32_t body_size = htonl(static_cast<std::uint32_t>(extras.size() + value.size()));
+            std::memcpy(frame.data() + 8, &body_size, sizeof(body_size));
+            std::memcpy(frame.data() + 12, &req.opaque, sizeof(req.opaque));
+            std::uint64_t cas_be = utils::byte_swap_64(cas);
+            std::memcpy(frame.data() + 16, &cas_be, sizeof(cas_be));
+            std::copy(extras.begin(), extras.end(), frame.begin() + 24);
+            std::copy(value.begin(), value.end(), frame.begin() + 24 + static_cast<std::ptrdiff_t>(extras.size()));
+
+            auto latency = cluster_.options_.kv_latency + node_.faults.extra_latency;
+            if (latency.count() == 0) {
+                return write(std::move(frame));
+            }
+            auto timer = std::make_shared<asio::steady_timer>(socket_.get_executor(), latency);
+            timer->async_wait([self = shared_from_this(), timer, frame = std::move(frame)](std::error_code ec) mutable {
+                if (!ec) {
+                    self->write(std::move(frame));
+                }
+            });
+        }
+
+        [[nodiscard]] bool supports(protocol::hello_feature feature) const
+        {
+            return std::find(features_.begin(), features_.end(), feature) != features_.end();
+        }
+
+        std::vector<protocol::hello_feature> features_{};
+        std::optional<std::string> bucket_{};
+
+      private:
+        void do_read()
+        {
+            socket_.async_read_some(parser_.prepare(), [self = shared_from_this()](std::error_code ec, std::size_t bytes_transferred) {
+                if (ec) {
+                    return;
+                }
+                self->parser_.commit(bytes_transferred);
+                io::mcbp_message msg{};
+                while (true) {
+                    switch (self->parser_.next(msg)) {
+                        case io::mcbp_parser::result::ok:
+                            self->cluster_.handle(*self, self->node_, std::move(msg));
+                            break;
+                        case io::mcbp_parser::result::need_data:
+                            return self->do_read();
+                        case io::mcbp_parser::result::failure:
+                            return self->socket_.close();
+                    }
+                }
+            });
+        }
+
+        void write(std::vector<std::uint8_t>&& frame)
+        {
+            output_.emplace_back(std::move(frame));
+            if (writing_.empty()) {
+                do_write();
+            }
+        }
+
+        void do_write()
+        {
+            std::swap(writing_, output_);
+            std::vector<asio::const_buffer> buffers;
+            buffers.reserve(writing_.size());
+            for (const auto& frame : writing_) {
+                buffers.emplace_back(asio::buffer(frame));
+            }
+            asio::async_write(socket_, buffers, [self = shared_from_this()](std::error_code ec, std::size_t /* bytes_transferred */) {
+                self->writing_.clear();
+                if (ec) {
+                    return self->socket_.close();
+                }
+                if (!self->output_.empty()) {
+                    self->do_write();
+                }
+            });
+        }
+
+        mock_cluster& cluster_;
+        node& node_;
+        asio::ip::tcp::socket socket_;
+        io::mcbp_parser parser_{};
+        std::vector<std::vector<std::uint8_t>> output_{};
+        std::vector<std::vector<std::uint8_t>> writing_{};
+    };
+
+    class query_connection : public std::enable_shared_from_this<query_connection>
+    {
+      public:
+        query_connection(mock_cluster& cluster, node& owner, asio::ip::tcp::socket&& socket)
+          : cluster_(cluster)
+          , node_(owner)
+          , socket_(std::move(socket))
+        {
+        }
+
+        void start()
+        {
+            asio::async_read_until(
+              socket_, input_, "\r\n\r\n", [self = shared_from_this()](std::error_code ec, std::size_t header_size) {
+                  if (ec) {
+                      return;
+                  }
+                  std::string headers(asio::buffers_begin(self->input_.data()),
+                                      asio::buffers_begin(self->input_.data()) + static_cast<std::ptrdiff_t>(header_size));
+                  self->input_.consume(header_size);
+                  std::size_t content_length = 0;
+                  std::string lowercase(headers);
+                  std::transform(lowercase.begin(), lowercase.end(), lowercase.begin(), [](unsigned char c) {
+                      return static_cast<char>(std::tolower(c));
+                  });
+                  if (auto pos = lowercase.find("\r\ncontent-length:"); pos != std::string::npos) {
+                      content_length = std::stoul(lowercase.substr(pos + 17));
+                  }
+                  std::string path = headers.substr(0, headers.find("\r\n"));
+                  std::size_t missing = content_length > self->input_.size() ? content_length - self->input_.size() : 0;
+                  asio::async_read(self->socket_,
+                                   self->input_,
+                                   asio::transfer_exactly(missing),
+                                   [self, path = std::move(path), content_length](std::error_code read_ec, std::size_t) {
+                                       if (read_ec) {
+                                           return;
+                                       }
+                                       std::string body(asio::buffers_begin(self->input_.data()),
+                                                        asio::buffers_begin(self->input_.data()) +
+                                                          static_cast<std::ptrdiff_t>(content_length));
+                                       self->input_.consume(content_length);
+                                       self->handle(path, body);
+                                   });
+              });
+        }
+
+      private:
+        void handle(const std::string& request_line, const std::string& body)
+        {
+            ++node_.query_requests;
+            std::string status_line = "HTTP/1.1 200 OK";
+            std::string response_body;
+            if (request_line.rfind("POST /query/service ", 0) == 0) {
+                response_body = cluster_.query_response(node_, body);
+            } else {
+                status_line = "HTTP/1.1 404 Not Found";
+                response_body = R"({"errors":[{"code":4000,"msg":"not supported by the mock"}]})";
+            }
+            auto response = std::make_shared<std::string>(fmt::format("{}\r\n"
+                                                                      "Content-Type: application/json\r\n"
+                                                                      "Content-Length: {}\r\n"
+                                                                      "Connection: keep-alive\r\n\r\n{}",
+                                                                      status_line,
+                                                                      response_body.size(),
+                                                                      response_body));
+            auto latency = cluster_.options_.query_latency + node_.faults.extra_latency;
+            auto timer = std::make_shared<asio::steady_timer>(socket_.get_executor(), latency);
+            timer->async_wait([self = shared_from_this(), timer, response](std::error_code ec) {
+                if (ec) {
+                    return;
+                }
+                asio::async_write(self->socket_, asio::buffer(*response), [self, response](std::error_code write_ec, std::size_t) {
+                    if (!write_ec) {
+                        self->start();
+                    }
+                });
+            });
+        }
+
+        mock_cluster& cluster_;
+        node& node_;
+        asio::ip::tcp::socket socket_;
+        asio::streambuf input_{};
+    };
+
+    void accept_kv(node& n)
+    {
+        n.kv_acceptor.async_accept([this, &n](std::error_code ec, asio::ip::tcp::socket socket) {
+            if (ec) {
+                return;
+            }
+            std::make_shared<kv_connection>(*this, n, std::move(socket))->start();
+            accept_kv(n);
+        });
+    }
+
+    void accept_query(node& n)
+    {
+        n.query_acceptor.async_accept([this, &n](std::error_code ec, asio::ip::tcp::socket socket) {
+            if (ec) {
+                return;
+            }
+            std::make_shared<query_connection>(*this, n, std::move(socket))->start();
+            accept_query(n);
+        });
+    }
+
+    static request decode(const io::mcbp_message& msg)
+    {
+        request req{};
+        req.opcode = msg.header.opcode;
+        req.datatype = msg.header.datatype;
+        req.partition = ntohs(msg.header.specific);
+        req.opaque = msg.header.opaque;
+        req.cas = utils::byte_swap_64(msg.header.cas);
+        std::size_t framing_extras_size = 0;
+        std::size_t key_size = ntohs(msg.header.keylen);
+        if (msg.header.magic == static_cast<std::uint8_t>(protocol::magic::alt_client_request)) {
+            auto header = msg.header_data();
+            framing_extras_size = header[2];
+            key_size = header[3];
+        }
+        std::string_view body(reinterpret_cast<const char*>(msg.body.data()), msg.body.size());
+        if (framing_extras_size + msg.header.extlen + key_size > body.size()) {
+            return req;
+        }
+        req.extras = body.substr(framing_extras_size, msg.header.extlen);
+        req.key = body.substr(framing_extras_size + msg.header.extlen, key_size);
+        req.value = body.substr(framing_extras_size + msg.header.extlen + key_size);
+        return req;
+    }
+
+    void handle(kv_connection& connection, node& n, io::mcbp_message&& msg)
+    {
+        ++n.kv_requests;
+        request req = decode(msg);
+        switch (static_cast<protocol::client_opcode>(req.opcode)) {
+            case protocol::client_opcode::hello:
+                return handle_hello(connection, req);
+
+            case protocol::client_opcode::sasl_list_mechs:
+                return connection.respond(req, protocol::status::success, {}, "SCRAM-SHA512 SCRAM-SHA256 SCRAM-SHA1 PLAIN");
+
+            case protocol::client_opcode::sasl_auth:
+            case protocol::client_opcode::sasl_step:
+                return connection.respond(req, protocol::status::success);
+
+            case protocol::client_opcode::get_error_map:
+                return connection.respond(req, protocol::status::success, {}, R"({"version":1,"revision":1,"errors":{}})");
+
+            case protocol::client_opcode::select_bucket:
+                if (req.key != options_.bucket_name) {
+                    return connection.respond(req, protocol::status::no_access);
+                }
+                connection.bucket_ = options_.bucket_name;
+                return connection.respond(req, protocol::status::success);
+
+            case protocol::client_opcode::get_cluster_config:
+                return connection.respond(req,
+                                          protocol::status::success,
+                                          {},
+                                          configuration(n.index, connection.bucket_.has_value()),
+                                          0,
+                                          static_cast<std::uint8_t>(protocol::datatype::json));
+
+            case protocol::client_opcode::get_collections_manifest:
+                return connection.respond(
+                  req, protocol::status::success, {}, manifest(), 0, static_cast<std::uint8_t>(protocol::datatype::json));
+
+            case protocol::client_opcode::get_collection_id:
+                return handle_get_collection_id(connection, req);
+
+            case protocol::client_opcode::get:
+            case protocol::client_opcode::upsert:
+            case protocol::client_opcode::insert:
+            case protocol::client_opcode::replace:
+            case protocol::client_opcode::remove:
+                return handle_data(connection, n, req);
+
+            default:
+                return connection.respond(req, protocol::status::unknown_command);
+        }
+    }
+
+    void handle_hello(kv_connection& connection, const request& req)
+    {
+        static const std::vector<protocol::hello_feature> supported{
+            protocol::hello_feature::tcp_nodelay, protocol::hello_feature::mutation_seqno,         protocol::hello_feature::xerror,
+            protocol::hello_feature::select_bucket, protocol::hello_feature::json,                protocol::hello_feature::collections,
+            protocol::hello_feature::alt_request_support, protocol::hello_feature::unordered_execution,
+            protocol::hello_feature::snappy,
+        };
+        std::string value;
+        connection.features_.clear();
+        for (std::size_t offset = 0; offset + 1 < req.value.size(); offset += 2) {
+            std::uint16_t code = 0;
+            std::memcpy(&code, req.value.data() + offset, sizeof(code));
+            auto feature = static_cast<protocol::hello_feature>(ntohs(code));
+            if (std::find(supported.begin(), supported.end(), feature) != supported.end()) {
+                connection.features_.push_back(feature);
+                value.append(req.value.substr(offset, 2));
+            }
+        }
+        connection.respond(req, protocol::status::success, {}, value);
+    }
+
+    void handle_get_collection_id(kv_connection& connection, const request& req)
+    {
+        std::string path(req.key.empty() ? req.value : req.key);
+        auto uid = collection_uids_.find(path);
+        if (uid == collection_uids_.end()) {
+            return connection.respond(req, protocol::status::unknown_collection);
+        }
+        std::string extras(12, '\0');
+        std::uint64_t manifest_uid = utils::byte_swap_64(manifest_uid_);
+        std::uint32_t collection_uid = htonl(uid->second);
+        std::memcpy(extras.data(), &manifest_uid, sizeof(manifest_uid));
+        std::memcpy(extras.data() + 8, &collection_uid, sizeof(collection_uid));
+        connection.respond(req, protocol::status::success, extras);
+    }
+
+    /**
+     * With collections, the key starts with LEB128-encoded collection UID, which has to be known to the mock.
+     */
+    bool valid_collection(const kv_connection& connection, std::string_view key) const
+    {
+        if (!connection.supports(protocol::hello_feature::collections)) {
+            return true;
+        }
+        std::uint32_t uid = 0;
+        for (std::size_t i = 0; i < key.size() && i < 5; ++i) {
+            auto byte = static_cast<std::uint8_t>(key[i]);
+            uid |= (byte & 0x7fU) << (7 * i);
+            if ((byte & 0x80U) == 0) {
+                return std::any_of(
+                  collection_uids_.begin(), collection_uids_.end(), [uid](const auto& entry) { return entry.second == uid; });
+            }
+        }
+        return false;
+    }
+
+    void handle_data(kv_connection& connection, node& n, const request& req)
+    {
+        if (!connection.bucket_) {
+            return connection.respond(req, protocol::status::no_bucket);
+        }
+        if (req.partition >= options_.number_of_partitions || req.partition % nodes_.size() != n.index) {
+            return connection.respond(req, protocol::status::not_my_vbucket, {}, configuration(n.index, true));
+        }
+        if (n.faults.not_my_vbucket_count > 0) {
+            --n.faults.not_my_vbucket_count;
+            ++n.not_my_vbucket_injected;
+            return connection.respond(req, protocol::status::not_my_vbucket, {}, configuration(n.index, true));
+        }
+        if (n.faults.not_my_vbucket_ratio > 0 && chance(n.faults.not_my_vbucket_ratio)) {
+            ++n.not_my_vbucket_injected;
+            return connection.respond(req, protocol::status::not_my_vbucket, {}, configuration(n.index, true));
+        }
+        if (n.faults.temporary_failure_ratio > 0 && chance(n.faults.temporary_failure_ratio)) {
+            ++n.temporary_failures_injected;
+            return connection.respond(req, protocol::status::temp_failure);
+        }
+        if (!valid_collection(connection, req.key)) {
+            return connection.respond(req, protocol::status::unknown_collection);
+        }
+
+        std::string key(req.key);
+        auto existing = documents_.find(key);
+        auto opcode = static_cast<protocol::client_opcode>(req.opcode);
+        if (opcode == protocol::client_opcode::get) {
+            if (existing == documents_.end()) {
+                return connection.respond(req, protocol::status::not_found);
+            }
+            std::uint32_t flags = htonl(existing->second.flags);
+            return connection.respond(req,
+                                      protocol::status::success,
+                                      std::string_view(reinterpret_cast<const char*>(&flags), sizeof(flags)),
+                                      existing->second.value,
+                                      existing->second.cas,
+                                      existing->second.datatype);
+        }
+
+        if (opcode == protocol::client_opcode::insert && existing != documents_.end()) {
+            return connection.respond(req, protocol::status::exists);
+        }
+        if (opcode == protocol::client_opcode::replace || opcode == protocol::client_opcode::remove) {
+            if (existing == documents_.end()) {
+                return connection.respond(req, protocol::status::not_found);
+            }
+            if (req.cas != 0 && req.cas != existing->second.cas) {
+                return connection.respond(req, protocol::status::exists);
+            }
+        }
+
+        std::uint64_t cas = ++last_cas_;
+        if (opcode == protocol::client_opcode::remove) {
+            documents_.erase(existing);
+        } else {
+            std::uint32_t flags = 0;
+            if (req.extras.size() >= sizeof(flags)) {
+                std::memcpy(&flags, req.extras.data(), sizeof(flags));
+            }
+            documents_[key] = { std::string(req.value), ntohl(flags), req.datatype, cas };
+        }
+        std::string extras;
+        if (connection.supports(protocol::hello_feature::mutation_seqno)) {
+            extras.resize(16);
+            std::uint64_t partition_uuid = utils::byte_swap_64(0xcafe0000ULL + req.partition);
+            std::uint64_t sequence_number = utils::byte_swap_64(++sequence_numbers_[req.partition]);
+            std::memcpy(extras.data(), &partition_uuid, sizeof(partition_uuid));
+            std::memcpy(extras.data() + 8, &sequence_number, sizeof(sequence_number));
+        }
+        connection.respond(req, protocol::status::success, extras, {}, cas);
+    }
+
+    bool chance(double ratio)
+    {
+        return std::uniform_real_distribution<double>(0, 1)(random_) < ratio;
+    }
+
+    /**
+     * Cluster configuration as seen by given node, without the bucket part, if the connection has not selected the bucket.
+     */
+    [[nodiscard]] std::string configuration(std::size_t this_node, bool with_bucket) const
+    {
+        tao::json::value nodes = tao::json::empty_array;
+        tao::json::value server_list = tao::json::empty_array;
+        for (const auto& n : nodes_) {
+            tao::json::value entry{
+                { "hostname", "127.0.0.1" },
+                { "services", { { "kv", n->kv_port }, { "n1ql", n->query_port } } },
+            };
+            if (n->index == this_node) {
+                entry["thisNode"] = true;
+            }
+            nodes.get_array().emplace_back(std::move(entry));
+            server_list.get_array().emplace_back(fmt::format("127.0.0.1:{}", n->kv_port));
+        }
+        tao::json::value config{
+            { "rev", 1 },
+            { "nodesExt", nodes },
+            { "clusterCapabilitiesVer", tao::json::value::array({ 1, 0 }) },
+            { "clusterCapabilities", tao::json::empty_object },
+        };
+        if (with_bucket) {
+            tao::json::value vbucket_map = tao::json::empty_array;
+            for (std::size_t p = 0; p < options_.number_of_partitions; ++p) {
+                vbucket_map.get_array().emplace_back(tao::json::value::array({ p % nodes_.size() }));
+            }
+            config["name"] = options_.bucket_name;
+            config["uuid"] = "6d4e3c2b1a0f9e8d7c6b5a4f3e2d1c0b";
+            config["nodeLocator"] = "vbucket";
+            config["bucketCapabilities"] = tao::json::value::array({ "collections", "xattr", "dcp", "cbhello" });
+            config["vBucketServerMap"] = tao::json::value{
+                { "hashAlgorithm", "CRC" },
+                { "numReplicas", 0 },
+                { "serverList", server_list },
+                { "vBucketMap", vbucket_map },
+            };
+        }
+        return tao::json::to_string(config);
+    }
+
+    [[nodiscard]] std::string manifest() const
+    {
+        std::map<std::string, tao::json::value> scopes;
+        for (const auto& [path, uid] : collection_uids_) {
+            auto dot = path.find('.');
+            std::string scope_name = path.substr(0, dot);
+            auto& scope = scopes[scope_name];
+            if (!scope.is_object()) {
+                scope = tao::json::value{
+                    { "name", scope_name },
+                    { "uid", fmt::format("{:x}", scope_name == "_default" ? 0 : scopes.size() + 7) },
+                    { "collections", tao::json::empty_array },
+                };
+            }
+            scope["collections"].get_array().emplace_back(
+              tao::json::value{ { "name", path.substr(dot + 1) }, { "uid", fmt::format("{:x}", uid) } });
+        }
+        tao::json::value result{ { "uid", fmt::format("{:x}", manifest_uid_) }, { "scopes", tao::json::empty_array } };
+        for (auto& scope : scopes) {
+            result["scopes"].get_array().emplace_back(std::move(scope.second));
+        }
+        return tao::json::to_string(result);
+    }
+
+    /**
+     * Replies to any statement with the configured number of rows.
+     */
+    [[nodiscard]] std::string query_response(const node& n, const std::string& body)
+    {
+        std::string client_context_id;
+        try {
+            auto payload = tao::json::from_string(body);
+            client_context_id = payload.optional<std::string>("client_context_id").value_or("");
+        } catch (const std::exception&) {
+            return R"({"requestID":"mock","status":"fatal","errors":[{"code":1065,"msg":"unable to parse request"}]})";
+        }
+        tao::json::value rows = tao::json::empty_array;
+        for (std::size_t i = 0; i < options_.query_rows; ++i) {
+            rows.get_array().emplace_back(tao::json::value{ { "id", i }, { "node", n.index } });
+        }
+        std::string results = tao::json::to_string(rows);
+        return fmt::format(R"({{"requestID":"mock-{}","clientContextID":{},"signature":{{"*":"*"}},"results":{},"status":"success",)"
+                           R"("metrics":{{"elapsedTime":"0s","executionTime":"0s","resultCount":{},"resultSize":{}}}}})",
+                           ++last_request_id_,
+                           tao::json::to_string(tao::json::value(client_context_id)),
+                           results,
+                           options_.query_rows,
+                           results.size());
+    }
+
+    asio::io_context ctx_{};
+    mock_options options_;
+    std::vector<std::unique_ptr<node>> nodes_{};
+    std::thread worker_{};
+    std::map<std::string, std::uint32_t> collection_uids_{};
+    std::uint64_t manifest_uid_{ 1 };
+    std::unordered_map<std::string, document> documents_{};
+    std::vector<std::uint64_t> sequence_numbers_{};
+    std::uint64_t last_cas_{ 0x1600000000000000ULL };
+    std::uint64_t last_request_id_{ 0 };
+    std::mt19937_64 random_{ std::random_device{}() };
+};
+
+} // namespace couchbase::mock
@@ -55,57 +55,40 @@ module Couchbase
     #
     # @return [QueryResult]
     def query(statement, options = QueryOptions.new)
-      resp = @backend.document_query(statement, {
-          timeout: options.timeout,
-          adhoc: options.adhoc,
-          client_context_id: options.client_context_id,
-          max_parallelism: options.max_parallelism,
-          readonly: options.readonly,
-          scan_wait: options.scan_wait,
-          scan_cap: options.scan_cap,
-          pipeline_batch: options.pipeline_batch,
-          pipeline_cap: options.pipeline_cap,
-          metrics: options.metrics,
-          profile: options.profile,
-          positional_parameters: options.export_positional_parameters,
-          named_parameters: options.export_named_parameters,
-          raw_parameters: options.raw_parameters,
-          scan_consistency: options.scan_consistency,
-          mutation_state: (options.mutation_state.tokens.map { |t|
-            {
-                bucket_name: t.bucket_name,
-                partition_id: t.partition_id,
-                partition_uuid: t.partition_uuid,
-                sequence_number: t.sequence_number,
-            }
-          } if options.mutation_state),
-      })
+      resp = @backend.document_query(statement, query_request_options(options))
 
       QueryResult.new do |res|
-        res.meta_data = QueryMetaData.new do |meta|
-          meta.status = resp[:meta][:status]
-          meta.request_id = resp[:meta][:request_id]
-          meta.client_context_id = resp[:meta][:client_context_id]
-          meta.signature = JSON.parse(resp[:meta][:signature]) if resp[:meta][:signature]
-          meta.profile = JSON.parse(resp[:meta][:profile]) if resp[:meta][:profile]
-          meta.metrics = QueryMetrics.new do |metrics|
-            if resp[:meta][:metrics]
-              metrics.elapsed_time = resp[:meta][:metrics][:elapsed_time]
-              metrics.execution_time = resp[:meta][:metrics][:execution_time]
-              metrics.sort_count = resp[:meta][:metrics][:sort_count]
-              metrics.result_count = resp[:meta][:metrics][:result_count]
-              metrics.result_size = resp[:meta][:metrics][:result_size]
-              metrics.mutation_count = resp[:meta][:metrics][:mutation_count]
-              metrics.error_count = resp[:meta][:metrics][:error_count]
-              metrics.warning_count = resp[:meta][:metrics][:warning_count]
-            end
-          end
-          res[:warnings] = resp[:warnings].map { |warn| QueryWarning.new(warn[:code], warn[:message]) } if resp[:warnings]
-        end
+        res.meta_data = extract_query_meta_data(resp[:meta])
+        res[:warnings] = resp[:warnings].map { |warn| QueryWarning.new(warn[:code], warn[:message]) } if resp[:warnings]
         res.instance_variable_set("@rows", resp[:rows])
       end
     end
 
+    # Performs a query against the query (N1QL) services, and yields rows as soon as they have been received
+    #
+    # Unlike {#query}, the rows are not accumulated in memory, and the network reading is paused when the application does not keep
+    # up with the rows (see {QueryOptions#max_buffered_rows}).
+    #
+    # @param [String] statement the N1QL query statement
+    # @param [QueryOptions] options the custom options for this query
+    #
+    # @yieldparam [Object] row the row decoded from JSON
+    #
+    # @return [QueryMetaData, Enumerator] the metadata of the query, or enumerator of the rows when the block is not given
+    def query_each(statement, options = QueryOptions.new)
+      return enum_for(:query_each, statement, options) unless block_given?
+
+      stream = @backend.document_query_stream(statement, query_request_options(options).merge(max_buffered_rows: options.max_buffered_rows))
+      begin
+        while (rows = stream.next_rows)
+          rows.each { |row| yield JSON.parse(row) }
+        end
+      ensure
+        stream.cancel
+      end
+      extract_query_meta_data(stream.meta)
+    end
+
     # Performs an analytics query
     #
     # @param [String] statement the N1QL query statement
@@ -293,7 +276,12 @@ module Couchbase
     class ClusterOptions
       attr_accessor :authenticator
 
+      # @return [Boolean] when true, the backend returns structs instead of hashes for get and mutation operations, which allocates
+      #   fewer objects per operation
+      attr_accessor :lightweight_results
+
       def initialize
+        @lightweight_results = false
         yield self if block_given?
       end
 
@@ -314,6 +302,56 @@ module Couchbase
 
     private
 
+    def query_request_options(options)
+      {
+          timeout: options.timeout,
+          adhoc: options.adhoc,
+          client_context_id: options.client_context_id,
+          max_parallelism: options.max_parallelism,
+          readonly: options.readonly,
+          scan_wait: options.scan_wait,
+          scan_cap: options.scan_cap,
+          pipeline_batch: options.pipeline_batch,
+          pipeline_cap: options.pipeline_cap,
+          metrics: options.metrics,
+          profile: options.profile,
+          positional_parameters: options.export_positional_parameters,
+          named_parameters: options.export_named_parameters,
+          raw_parameters: options.raw_parameters,
+          scan_consistency: options.scan_consistency,
+          mutation_state: (options.mutation_state.tokens.map { |t|
+            {
+                bucket_name: t.bucket_name,
+                partition_id: t.partition_id,
+                partition_uuid: t.partition_uuid,
+                sequence_number: t.sequence_number,
+            }
+          } if options.mutation_state),
+      }
+    end
+
+    def extract_query_meta_data(meta_hash)
+      QueryMetaData.new do |meta|
+        meta.status = meta_hash[:status]
+        meta.request_id = meta_hash[:request_id]
+        meta.client_context_id = meta_hash[:client_context_id]
+        meta.signature = JSON.parse(meta_hash[:signature]) if meta_hash[:signature]
+        meta.profile = JSON.parse(meta_hash[:profile]) if meta_hash[:profile]
+        meta.metrics = QueryMetrics.new do |metrics|
+          if meta_hash[:metrics]
+            metrics.elapsed_time = meta_hash[:metrics][:elapsed_time]
+            metrics.execution_time = meta_hash[:metrics][:execution_time]
+            metrics.sort_count = meta_hash[:metrics][:sort_count]
+            metrics.result_count = meta_hash[:metrics][:result_count]
+            metrics.result_size = meta_hash[:metrics][:result_size]
+            metrics.mutation_count = meta_hash[:metrics][:mutation_count]
+            metrics.error_count = meta_hash[:metrics][:error_count]
+            metrics.warning_count = meta_hash[:metrics][:warning_count]
+          end
+        end
+      end
+    end
+
     # Initialize {Cluster} object
     #
     # @param [String] connection_string connection string used to locate the Couchbase Cluster
@@ -326,7 +364,7 @@ module Couchbase
       raise ArgumentError, "missing password" unless password
 
       @backend = Backend.new
-      @backend.open(connection_string, username, password, {})
+      @backend.open(connection_string, username, password, {lightweight_results: options.lightweight_results})
     end
   end
 end
@@ -63,7 +63,29 @@ module Couchbase
         res.cas = resp[:cas]
         res.flags = resp[:flags]
         res.encoded = resp[:content]
-        res.expiry = resp[:expiry] if resp.key?(:expiry)
+        res.expiry = resp[:expiry] if resp.is_a?(Hash) && resp.key?(:expiry)
+      end
+    end
+
+    # Fetches multiple documents from the collection.
+    #
+    # All requests are dispatched at once, and the method waits until every document is fetched. Failures do not
+    # interrupt the batch, check {GetResult#success?} and {GetResult#error} of the individual results.
+    #
+    # @param [Array<String>] ids the array of document identifiers
+    # @param [GetMultiOptions] options request customization
+    #
+    # @return [Array<GetResult>] results in the same order as ids
+    def get_multi(ids, options = GetMultiOptions.new)
+      resp = @backend.document_get_multi(bucket_name, "#{@scope_name}.#{@name}", ids, options.timeout)
+      resp.map do |entry|
+        GetResult.new do |res|
+          res.transcoder = options.transcoder
+          res.cas = entry[:cas]
+          res.flags = entry[:flags]
+          res.encoded = entry[:content]
+          res.error = entry[:error]
+        end
       end
     end
 
@@ -107,7 +129,10 @@ module Couchbase
     # @param [GetAllReplicasOptions] options request customization
     #
     # @return [Array<GetReplicaResult>]
-    def get_all_replicas(id, options = GetAllReplicasOptions.new) end
+    def get_all_replicas(id, options = GetAllReplicasOptions.new)
+      resp = @backend.document_get_all_replicas(bucket_name, "#{@scope_name}.#{@name}", id, options.timeout)
+      resp.map { |entry| extract_replica_result(entry, options) }
+    end
 
     # Reads all available replicas, and returns the first found
     #
@@ -115,7 +140,10 @@ module Couchbase
     # @param [GetAnyReplicaOptions] options request customization
     #
     # @return [GetReplicaResult]
-    def get_any_replica(id, options = GetAnyReplicaOptions.new) end
+    def get_any_replica(id, options = GetAnyReplicaOptions.new)
+      resp = @backend.document_get_any_replica(bucket_name, "#{@scope_name}.#{@name}", id, options.timeout)
+      extract_replica_result(resp, options)
+    end
 
     # Checks if the given document ID exists on the active partition.
     #
@@ -148,6 +176,25 @@ module Couchbase
       end
     end
 
+    # Removes a list of the documents from the collection
+    #
+    # @param [Array<String>] ids the array of document identifiers
+    # @param [RemoveMultiOptions] options request customization
+    #
+    # @return [Array<MutationResult>] results in the same order as ids
+    def remove_multi(ids, options = RemoveMultiOptions.new)
+      resp = @backend.document_remove_multi(bucket_name, "#{@scope_name}.#{@name}", options.timeout, ids, {
+          durability_level: options.durability_level
+      })
+      resp.map do |entry|
+        MutationResult.new do |res|
+          res.cas = entry[:cas]
+          res.mutation_token = extract_mutation_token(entry) if entry.key?(:mutation_token)
+          res.error = entry[:error]
+        end
+      end
+    end
+
     # Inserts a full document which does not exist yet
     #
     # @param [String] id the document id which is used to uniquely identify it.
@@ -186,6 +233,30 @@ module Couchbase
       end
     end
 
+    # Upserts (inserts or updates) a list of documents which might or might not exist yet
+    #
+    # @param [Array<Array>] id_content array of tuples +String,Object+, where first entry treated as document key,
+    #   and the second as value to upsert.
+    # @param [UpsertMultiOptions] options request customization
+    #
+    # @return [Array<MutationResult>] results in the same order as id_content
+    def upsert_multi(id_content, options = UpsertMultiOptions.new)
+      encoded = id_content.map do |(id, content)|
+        [id, *options.transcoder.encode(content)]
+      end
+      resp = @backend.document_upsert_multi(bucket_name, "#{@scope_name}.#{@name}", options.timeout, encoded, {
+          durability_level: options.durability_level,
+          expiry: options.expiry,
+      })
+      resp.map do |entry|
+        MutationResult.new do |res|
+          res.cas = entry[:cas]
+          res.mutation_token = extract_mutation_token(entry) if entry.key?(:mutation_token)
+          res.error = entry[:error]
+        end
+      end
+    end
+
     # Replaces a full document which already exists
     #
     # @param [String] id the document id which is used to uniquely identify it.
@@ -327,5 +398,15 @@ module Couchbase
         token.bucket_name = resp[:mutation_token][:bucket_name]
       end
     end
+
+    def extract_replica_result(resp, options)
+      GetReplicaResult.new do |res|
+        res.transcoder = options.transcoder
+        res.cas = resp[:cas]
+        res.flags = resp[:flags]
+        res.encoded = resp[:content]
+        res.is_replica = resp[:replica]
+      end
+    end
   end
 end
@@ -61,6 +61,17 @@ module Couchbase
       end
     end
 
+    class GetMultiOptions < CommonOptions
+      # @return [JsonTranscoder] transcoder used for decoding
+      attr_accessor :transcoder
+
+      # @yieldparam [GetMultiOptions] self
+      def initialize
+        @transcoder = JsonTranscoder.new
+        yield self if block_given?
+      end
+    end
+
     class GetAndLockOptions < CommonOptions
       # @return [JsonTranscoder] transcoder used for decoding
       attr_accessor :transcoder
@@ -114,6 +125,14 @@ module Couchbase
 
       # @return [JsonTranscoder] The default transcoder which should be used
       attr_accessor :transcoder
+
+      # @return [Error::CouchbaseError, nil] error, if the document has not been fetched (only for multi-operations)
+      attr_accessor :error
+
+      # @return [Boolean] true if error was not associated with the result
+      def success?
+        !error
+      end
     end
 
     class GetAllReplicasOptions < CommonOptions
@@ -122,6 +141,7 @@ module Couchbase
 
       # @yieldparam [GetAllReplicasOptions] self
       def initialize
+        @transcoder = JsonTranscoder.new
         yield self if block_given?
       end
     end
@@ -132,6 +152,7 @@ module Couchbase
 
       # @yieldparam [GetAnyReplicaOptions] self
       def initialize
+        @transcoder = JsonTranscoder.new
         yield self if block_given?
       end
     end
@@ -186,6 +207,17 @@ module Couchbase
       end
     end
 
+    class RemoveMultiOptions < CommonOptions
+      # @return [:none, :majority, :majority_and_persist_to_active, :persist_to_majority] level of durability
+      attr_accessor :durability_level
+
+      # @yieldparam [RemoveMultiOptions]
+      def initialize
+        @durability_level = :none
+        yield self if block_given?
+      end
+    end
+
     class InsertOptions < CommonOptions
       # @return [Integer] expiration time to associate with the document
       attr_accessor :expiry
@@ -222,6 +254,24 @@ module Couchbase
       end
     end
 
+    class UpsertMultiOptions < CommonOptions
+      # @return [Integer] expiration time to associate with the documents
+      attr_accessor :expiry
+
+      # @return [JsonTranscoder] transcoder used for encoding
+      attr_accessor :transcoder
+
+      # @return [:none, :majority, :majority_and_persist_to_active, :persist_to_majority] level of durability
+      attr_accessor :durability_level
+
+      # @yieldparam [UpsertMultiOptions]
+      def initialize
+        @transcoder = JsonTranscoder.new
+        @durability_level = :none
+        yield self if block_given?
+      end
+    end
+
     class ReplaceOptions < CommonOptions
       # @return [Integer] expiration time to associate with the document
       attr_accessor :expiry
@@ -250,6 +300,14 @@ module Couchbase
       # @return [MutationToken] if returned, holds the mutation token of the document after the mutation
       attr_accessor :mutation_token
 
+      # @return [Error::CouchbaseError, nil] error, if the mutation has failed (only for multi-operations)
+      attr_accessor :error
+
+      # @return [Boolean] true if error was not associated with the result
+      def success?
+        !error
+      end
+
       # @yieldparam [MutationResult] self
       def initialize
         yield self if block_given?
@@ -76,6 +76,9 @@ module Couchbase
     class FeatureNotAvailable < CouchbaseError
     end
 
+    class RequestQueueFull < CouchbaseError
+    end
+
     # KeyValue exceptions
 
     class DocumentNotFound < CouchbaseError
@@ -56,6 +56,9 @@ module Couchbase
       # @return [:off, :phases, :timings] Customize server profile level for this query
       attr_accessor :profile
 
+      # @return [Integer] Maximum number of rows buffered by {Cluster#query_each}, before it stops reading the response from the network
+      attr_accessor :max_buffered_rows
+
       # @return [:not_bounded, :request_plus]
       attr_reader :scan_consistency
 
@@ -71,6 +74,7 @@ module Couchbase
       def initialize
         @timeout = 75_000 # ms
         @adhoc = true
+        @max_buffered_rows = 1024
         @raw_parameters = {}
         @positional_parameters = nil
         @named_parameters = nil
@@ -12,6 +12,8 @@
 #  See the License for the specific language governing permissions and
 #  limitations under the License.
 
+require "objspace"
+
 require_relative "test_helper"
 
 module Couchbase
@@ -40,6 +42,30 @@ module Couchbase
       assert_equal document, res.content
     end
 
+    def test_lightweight_results
+      options = Cluster::ClusterOptions.new
+      options.authenticate(TEST_USERNAME, TEST_PASSWORD)
+      options.lightweight_results = true
+      cluster = Cluster.connect(TEST_CONNECTION_STRING, options)
+      collection = cluster.bucket(TEST_BUCKET).default_collection
+
+      doc_id = uniq_id(:foo)
+      document = {"value" => 42}
+      res = collection.upsert(doc_id, document)
+      assert res.cas
+      assert_equal TEST_BUCKET, res.mutation_token.bucket_name
+
+      lightweight = cluster.instance_variable_get(:@backend).document_get(TEST_BUCKET, "_default._default", doc_id, nil)
+      regular = @cluster.instance_variable_get(:@backend).document_get(TEST_BUCKET, "_default._default", doc_id, nil)
+      assert_kind_of Backend::GetResponse, lightweight
+      assert_kind_of Hash, regular
+      assert_equal regular[:cas], lightweight[:cas]
+      assert_operator ObjectSpace.memsize_of(lightweight), :<, ObjectSpace.memsize_of(regular)
+      assert_equal document, collection.get(doc_id).content
+    ensure
+      cluster&.disconnect
+    end
+
     def test_removes_documents
       doc_id = uniq_id(:foo)
       document = {"value" => 42}
@@ -52,6 +78,92 @@ module Couchbase
       end
     end
 
+    def test_multi_operations
+      doc_ids = Array.new(5) { |i| uniq_id("foo#{i}") }
+      res = @collection.upsert_multi(doc_ids.map { |id| [id, {"value" => id}] })
+      assert_equal 5, res.size
+      assert res.all?(&:success?)
+
+      missing_id = uniq_id(:missing)
+      res = @collection.get_multi(doc_ids + [missing_id])
+      assert_equal 6, res.size
+      doc_ids.each_with_index do |id, i|
+        assert res[i].success?
+        assert_equal({"value" => id}, res[i].content)
+      end
+      refute res.last.success?
+      assert_kind_of Couchbase::Error::DocumentNotFound, res.last.error
+
+      res = @collection.remove_multi(doc_ids)
+      assert res.all?(&:success?)
+      assert @collection.get_multi(doc_ids).none?(&:success?)
+    end
+
+    def test_replica_reads
+      doc_id = uniq_id(:foo)
+      document = {"value" => 42}
+      @collection.upsert(doc_id, document)
+
+      res = @collection.get_any_replica(doc_id)
+      assert_equal document, res.content
+
+      res = @collection.get_all_replicas(doc_id)
+      refute_empty res
+      assert res.any? { |copy| !copy.replica? }
+      res.each { |copy| assert_equal document, copy.content }
+
+      assert_raises(Couchbase::Error::DocumentIrretrievable) do
+        @collection.get_any_replica(uniq_id(:missing))
+      end
+    end
+
+    def test_retry_stats_reports_every_reason
+      backend = @cluster.instance_variable_get(:@backend)
+      stats = backend.retry_stats
+      [:not_my_vbucket, :unknown_collection, :kv_backpressure].each do |reason|
+        assert_kind_of Integer, stats[reason]
+      end
+    end
+
+    def test_compression_stats_counts_compressed_values
+      backend = @cluster.instance_variable_get(:@backend)
+      before = backend.compression_stats
+      @collection.upsert(uniq_id(:foo), {"value" => "x" * 4096})
+      after = backend.compression_stats
+      assert_operator after[:attempts], :>=, before[:attempts] + 1
+      assert_operator after[:compressed], :>=, before[:compressed] + 1
+      assert_operator after[:bytes_in], :>=, before[:bytes_in] + 4096
+      assert_operator after[:bytes_saved], :>, before[:bytes_saved]
+    end
+
+    def test_compression_stats_counts_offloaded_values
+      backend = @cluster.instance_variable_get(:@backend)
+      doc_id = uniq_id(:foo)
+      document = {"value" => "x" * (2 * 1024 * 1024)}
+      before = backend.compression_stats
+      @collection.upsert(doc_id, document)
+      after = backend.compression_stats
+      assert_operator after[:offloaded], :>=, before[:offloaded] + 1
+      assert_operator after[:compressed], :>=, before[:compressed] + 1
+      assert_operator after[:bytes_saved], :>, before[:bytes_saved]
+
+      res = @collection.get(doc_id)
+      assert_equal document, res.content
+    end
+
+    def test_metrics_reports_kv_latencies
+      @collection.upsert(uniq_id(:foo), {"value" => 42})
+      backend = @cluster.instance_variable_get(:@backend)
+      metrics = backend.metrics
+      bucket = metrics[:buckets].find { |b| b[:name] == TEST_BUCKET }
+      refute_nil bucket
+      refute_empty bucket[:sessions]
+      upserts = bucket[:sessions].map { |s| s[:latencies][:upsert] }.compact
+      refute_empty upserts
+      assert_operator upserts.sum { |l| l[:count] }, :>=, 1
+      assert_kind_of Array, metrics[:endpoints]
+    end
+
     def test_touch_sets_expiration
       document = {"value" => 42}
       doc_id = uniq_id(:foo)
@@ -668,6 +780,36 @@ module Couchbase
       end
     end
 
+    def test_projection_merges_shared_prefixes
+      doc_id = uniq_id(:project_doc)
+      person = load_json_test_dataset("projection_doc")
+
+      res = @collection.upsert(doc_id, person)
+      refute_equal 0, res.cas
+
+      hobby = person["attributes"]["hobbies"][1]
+      expected = {
+          "attributes" => {
+              "hobbies" => [
+                  {
+                      "type" => hobby["type"],
+                      "details" => {"location" => {"lat" => hobby["details"]["location"]["lat"]}}
+                  }
+              ]
+          }
+      }
+      paths = %w[attributes.hobbies[1].type attributes.hobbies[1].details.location.lat]
+
+      options = Collection::GetOptions.new
+      options.project(*paths)
+      assert_equal expected, @collection.get(doc_id, options).content
+
+      # over 16 paths the document is fetched in full and projected on the client
+      options = Collection::GetOptions.new
+      options.project(*(paths * 9))
+      assert_equal expected, @collection.get(doc_id, options).content
+    end
+
     def test_insert_get_projection_18_fields
       doc_id = uniq_id(:project_too_many_fields)
       doc = (1..18).each_with_object({}) do |n, obj|
@@ -165,5 +165,61 @@ module Couchbase
       assert_equal 1, res.rows.size
       assert_equal({"foo" => "bar"}, res.rows.first)
     end
+
+    def test_non_adhoc_query_uses_prepared_statement_cache
+      backend = @cluster.instance_variable_get(:@backend)
+      options = Cluster::QueryOptions.new
+      options.adhoc = false
+      statement = "SELECT $1 AS greeting, #{Time.now.to_f} AS stamp"
+
+      stats = backend.query_cache_stats
+      3.times do |i|
+        options.positional_parameters(["hello #{i}"])
+        res = @cluster.query(statement, options)
+        assert_equal "hello #{i}", res.rows.first["greeting"]
+      end
+      new_stats = backend.query_cache_stats
+      assert_equal stats[:misses] + 1, new_stats[:misses]
+      assert_equal stats[:hits] + 2, new_stats[:hits]
+    end
+
+    def test_query_each_streams_rows
+      options = Cluster::QueryOptions.new
+      options.metrics = true
+      options.max_buffered_rows = 10
+
+      rows = []
+      meta = @cluster.query_each("SELECT RAW i FROM ARRAY_RANGE(0, 1000) AS i", options) { |row| rows << row }
+      assert_equal((0...1000).to_a, rows)
+      assert_equal :success, meta.status
+      assert_equal 1000, meta.metrics.result_count
+
+      assert_equal [0, 1, 2], @cluster.query_each("SELECT RAW i FROM ARRAY_RANGE(0, 1000) AS i", options).first(3)
+    end
+
+    def test_query_each_with_http_compression
+      options = Cluster::ClusterOptions.new
+      options.authenticate(TEST_USERNAME, TEST_PASSWORD)
+      separator = TEST_CONNECTION_STRING.include?("?") ? "&" : "?"
+      cluster = Cluster.connect("#{TEST_CONNECTION_STRING}#{separator}http_compression_query=true", options)
+
+      rows = []
+      cluster.query_each("SELECT RAW REPEAT('x', 100) || TO_STRING(i) FROM ARRAY_RANGE(0, 1000) AS i") { |row| rows << row }
+      assert_equal 1000, rows.size
+      assert_equal "#{'x' * 100}999", rows.last
+
+      backend = cluster.instance_variable_get(:@backend)
+      query = backend.metrics[:endpoints].select { |e| e[:service] == :query }
+      refute_empty query
+      assert_operator query.sum { |e| e[:body_decoded_bytes] }, :>=, query.sum { |e| e[:body_wire_bytes] }
+    ensure
+      cluster&.disconnect
+    end
+
+    def test_query_each_raises_parsing_error
+      assert_raises(Error::ParsingFailure) do
+        @cluster.query_each('BAD QUERY') { |_| }
+      end
+    end
   end
 end